@@ -0,0 +1,444 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <crypto/sha256.h>
+#include <index/addressindex.h>
+#include <txmempool.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+#include <limits>
+#include <set>
+
+/* The index database stores a record for each output paying to a script and
+ * for each input spending one:
+ *
+ * - Key: script hash, block height, position of the transaction in the
+ *   block, whether it is a spend, output or input index. The numbers are
+ *   big-endian, so the records of a script sort in chain order.
+ * - Value: the txid, the output spent by an input, and the amount
+ */
+constexpr char DB_ADDRESS = 'a';
+
+namespace {
+
+struct DBKey {
+    uint256 script_hash;
+    uint32_t height;
+    uint32_t tx_pos;
+    uint8_t spending;
+    uint32_t index;
+
+    DBKey() : height(0), tx_pos(0), spending(0), index(0) {}
+    DBKey(const uint256& script_hash_in, uint32_t height_in, uint32_t tx_pos_in = 0,
+          bool spending_in = false, uint32_t index_in = 0) :
+        script_hash(script_hash_in), height(height_in), tx_pos(tx_pos_in),
+        spending(spending_in), index(index_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const {
+        s << DB_ADDRESS;
+        s << script_hash;
+        ser_writedata32be(s, height);
+        ser_writedata32be(s, tx_pos);
+        s << spending;
+        ser_writedata32be(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s) {
+        char prefix;
+        s >> prefix;
+        if (prefix != DB_ADDRESS) {
+            throw std::ios_base::failure("Invalid format for address index DB key");
+        }
+        s >> script_hash;
+        height = ser_readdata32be(s);
+        tx_pos = ser_readdata32be(s);
+        s >> spending;
+        index = ser_readdata32be(s);
+    }
+};
+
+struct DBVal {
+    uint256 txid;
+    COutPoint prevout;
+    CAmount amount;
+
+    DBVal() : amount(0) {}
+    DBVal(const uint256& txid_in, const COutPoint& prevout_in, CAmount amount_in) :
+        txid(txid_in), prevout(prevout_in), amount(amount_in) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(prevout);
+        READWRITE(amount);
+    }
+};
+
+typedef std::vector<std::pair<DBKey, DBVal>> BlockEntries;
+
+} // namespace
+
+static std::shared_ptr<AddressIndex> g_addressindex;
+//! Serializes StartAddressIndex and StopAddressIndex
+static std::mutex g_addressindex_mutex;
+
+uint256 AddressScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+/** Read the undo data of block from disk and list the records of the block */
+static bool ReadBlockEntries(const CBlock& block, const CBlockIndex* pindex, BlockEntries& entries)
+{
+    CBlockUndo block_undo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: undo data of block %s does not match the block", __func__,
+                     pindex->GetBlockHash().ToString());
+    }
+
+    for (uint32_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txid = tx.GetHash();
+        for (uint32_t n = 0; n < tx.vout.size(); n++) {
+            const CTxOut& out = tx.vout[n];
+            if (out.scriptPubKey.IsUnspendable()) continue;
+            entries.emplace_back(DBKey(AddressScriptHash(out.scriptPubKey), pindex->nHeight, i, false, n),
+                                 DBVal(txid, COutPoint(), out.nValue));
+        }
+        if (tx.IsCashBase()) continue;
+
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        if (tx_undo.vprevout.size() != tx.vin.size()) {
+            return error("%s: undo data of transaction %s does not match the transaction", __func__,
+                         txid.ToString());
+        }
+        for (uint32_t n = 0; n < tx.vin.size(); n++) {
+            const CTxOut& spent = tx_undo.vprevout[n].out;
+            entries.emplace_back(DBKey(AddressScriptHash(spent.scriptPubKey), pindex->nHeight, i, true, n),
+                                 DBVal(txid, tx.vin[n].prevout, spent.nValue));
+        }
+    }
+    return true;
+}
+
+static AddressIndexEntry MakeEntry(int height, const DBKey& key, const DBVal& value)
+{
+    AddressIndexEntry entry;
+    entry.height = height;
+    entry.txid = value.txid;
+    entry.spending = key.spending;
+    entry.index = key.index;
+    entry.prevout = value.prevout;
+    entry.amount = value.amount;
+    return entry;
+}
+
+/**
+ * Access to the address index database (indexes/addressindex/)
+ */
+class AddressIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+};
+
+AddressIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe)
+{}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<AddressIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+AddressIndex::~AddressIndex()
+{
+    // Stop the sync thread before the database it writes to goes away
+    Interrupt();
+    Stop();
+}
+
+BaseIndex::DB& AddressIndex::GetDB() const { return *m_db; }
+
+bool AddressIndex::Init()
+{
+    if (!BaseIndex::Init()) {
+        return false;
+    }
+
+    // Notifications about the mempool come in from here on, so pick up
+    // what is in it already
+    LOCK2(cs_main, mempool.cs);
+    m_entry_added_conn = mempool.NotifyEntryAdded.connect([this](CTransactionRef tx) {
+        MempoolEntryAdded(tx);
+    });
+    m_entry_removed_conn = mempool.NotifyEntryRemoved.connect([this](CTransactionRef tx, MemPoolRemovalReason) {
+        std::lock_guard<std::mutex> lock(m_mempool_mutex);
+        m_mempool_spent.erase(tx->GetHash());
+    });
+    for (const CTxMemPoolEntry& entry : mempool.mapTx) {
+        MempoolEntryAdded(entry.GetSharedTx());
+        TransactionAddedToMempool(entry.GetSharedTx());
+    }
+    return true;
+}
+
+bool AddressIndex::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    BlockEntries entries;
+    if (!ReadBlockEntries(block, pindex, entries)) {
+        return false;
+    }
+    for (const auto& entry : entries) {
+        batch.Write(entry.first, entry.second);
+    }
+    return true;
+}
+
+BaseIndex::BlockWriter AddressIndex::PrepareBlock(const CBlockIndex* pindex)
+{
+    // Hashing the scripts of the block is the bulk of the work, and does not
+    // depend on the blocks before
+    CBlock block;
+    auto entries = std::make_shared<BlockEntries>();
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) ||
+        !ReadBlockEntries(block, pindex, *entries)) {
+        return nullptr;
+    }
+    return [entries](CDBBatch& batch) {
+        for (const auto& entry : *entries) {
+            batch.Write(entry.first, entry.second);
+        }
+        return true;
+    };
+}
+
+bool AddressIndex::RewindBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    // The undo data of a disconnected block stays on disk
+    BlockEntries entries;
+    if (!ReadBlockEntries(block, pindex, entries)) {
+        return false;
+    }
+    for (const auto& entry : entries) {
+        batch.Erase(entry.first);
+    }
+    return true;
+}
+
+void AddressIndex::MempoolEntryAdded(const CTransactionRef& tx)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
+
+    // The view reads through the cash cache, which accepting the transaction
+    // filled with the outputs it spends
+    std::vector<CTxOut> spent(tx->vin.size());
+    CCashViewMemPool view(pcashTip.get(), mempool);
+    for (size_t n = 0; n < tx->vin.size(); n++) {
+        Cash cash;
+        if (view.GetCash(tx->vin[n].prevout, cash) && !cash.IsSpent()) {
+            spent[n] = cash.out;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mempool_mutex);
+    m_mempool_spent[tx->GetHash()] = std::move(spent);
+}
+
+void AddressIndex::AddMempoolTx(const CTransaction& tx, const std::vector<CTxOut>& spent)
+{
+    // Hash the scripts before taking the lock the mempool waits for
+    const uint256& txid = tx.GetHash();
+    std::vector<std::pair<uint256, AddressIndexEntry>> entries;
+    for (uint32_t n = 0; n < tx.vout.size(); n++) {
+        const CTxOut& out = tx.vout[n];
+        if (out.scriptPubKey.IsUnspendable()) continue;
+        entries.emplace_back(AddressScriptHash(out.scriptPubKey), MakeEntry(-1, DBKey(uint256(), 0, 0, false, n),
+                                                                            DBVal(txid, COutPoint(), out.nValue)));
+    }
+    for (uint32_t n = 0; n < tx.vin.size() && n < spent.size(); n++) {
+        if (spent[n].IsNull()) continue;
+        entries.emplace_back(AddressScriptHash(spent[n].scriptPubKey), MakeEntry(-1, DBKey(uint256(), 0, 0, true, n),
+                                                                                 DBVal(txid, tx.vin[n].prevout, spent[n].nValue)));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mempool_mutex);
+    auto inserted = m_mempool_scripts.emplace(txid, std::vector<uint256>());
+    if (!inserted.second) {
+        return;
+    }
+    std::vector<uint256>& scripts = inserted.first->second;
+    for (auto& entry : entries) {
+        scripts.push_back(entry.first);
+        m_mempool_entries.emplace(entry.first, std::move(entry.second));
+    }
+}
+
+void AddressIndex::RemoveMempoolTx(const uint256& txid)
+{
+    std::lock_guard<std::mutex> lock(m_mempool_mutex);
+    auto it_scripts = m_mempool_scripts.find(txid);
+    if (it_scripts == m_mempool_scripts.end()) {
+        return;
+    }
+    for (const uint256& script_hash : it_scripts->second) {
+        auto range = m_mempool_entries.equal_range(script_hash);
+        for (auto it = range.first; it != range.second;) {
+            if (it->second.txid == txid) {
+                it = m_mempool_entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    m_mempool_scripts.erase(it_scripts);
+}
+
+void AddressIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                                  const std::vector<CTransactionRef>& txn_conflicted)
+{
+    BaseIndex::BlockConnected(block, pindex, txn_conflicted);
+
+    // Transactions that leave the mempool for a block, or because they
+    // conflict with one, are not passed to TransactionRemovedFromMempool
+    for (const CTransactionRef& tx : block->vtx) {
+        RemoveMempoolTx(tx->GetHash());
+    }
+    for (const CTransactionRef& tx : txn_conflicted) {
+        RemoveMempoolTx(tx->GetHash());
+    }
+}
+
+void AddressIndex::TransactionAddedToMempool(const CTransactionRef& tx)
+{
+    std::vector<CTxOut> spent;
+    {
+        std::lock_guard<std::mutex> lock(m_mempool_mutex);
+        auto it = m_mempool_spent.find(tx->GetHash());
+        if (it == m_mempool_spent.end()) {
+            // It left the mempool again before this notification came in, and
+            // the notification of that is still to come
+            return;
+        }
+        spent = it->second;
+    }
+    AddMempoolTx(*tx, spent);
+}
+
+void AddressIndex::TransactionRemovedFromMempool(const CTransactionRef& tx)
+{
+    RemoveMempoolTx(tx->GetHash());
+}
+
+bool AddressIndex::FindHistory(const uint256& script_hash, int start_height, int stop_height,
+                               const std::function<bool(const AddressIndexEntry&)>& visitor) const
+{
+    if (stop_height < start_height || stop_height < 0) {
+        return true;
+    }
+
+    std::unique_ptr<CDBIterator> pcursor(m_db->NewIterator());
+    pcursor->Seek(DBKey(script_hash, std::max(start_height, 0)));
+    for (; pcursor->Valid(); pcursor->Next()) {
+        DBKey key;
+        if (!pcursor->GetKey(key) || key.script_hash != script_hash ||
+            key.height > static_cast<uint32_t>(stop_height)) {
+            break;
+        }
+        DBVal value;
+        if (!pcursor->GetValue(value)) {
+            return error("%s: failed to read entry of script %s at height %d", __func__,
+                         script_hash.ToString(), key.height);
+        }
+        if (!visitor(MakeEntry(key.height, key, value))) {
+            break;
+        }
+    }
+    return true;
+}
+
+std::vector<AddressIndexEntry> AddressIndex::FindMempoolHistory(const uint256& script_hash) const
+{
+    std::vector<AddressIndexEntry> entries;
+    std::lock_guard<std::mutex> lock(m_mempool_mutex);
+    auto range = m_mempool_entries.equal_range(script_hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        entries.push_back(it->second);
+    }
+    return entries;
+}
+
+bool AddressIndex::FindUnspent(const uint256& script_hash, bool include_mempool,
+                               std::vector<AddressIndexEntry>& outputs) const
+{
+    std::vector<AddressIndexEntry> created;
+    std::set<COutPoint> spent;
+    auto visit = [&](const AddressIndexEntry& entry) {
+        if (entry.spending) {
+            spent.insert(entry.prevout);
+        } else {
+            created.push_back(entry);
+        }
+        return true;
+    };
+
+    if (!FindHistory(script_hash, 0, std::numeric_limits<int>::max(), visit)) {
+        return false;
+    }
+    if (include_mempool) {
+        for (const AddressIndexEntry& entry : FindMempoolHistory(script_hash)) {
+            visit(entry);
+        }
+    }
+
+    outputs.clear();
+    for (const AddressIndexEntry& entry : created) {
+        if (!spent.count(COutPoint(entry.txid, entry.index))) {
+            outputs.push_back(entry);
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<AddressIndex> GetAddressIndex()
+{
+    return std::atomic_load(&g_addressindex);
+}
+
+bool StartAddressIndex(size_t n_cache_size)
+{
+    std::lock_guard<std::mutex> lock(g_addressindex_mutex);
+    if (std::atomic_load(&g_addressindex)) {
+        return true;
+    }
+    auto addressindex = std::make_shared<AddressIndex>(n_cache_size);
+    if (!addressindex->Start()) {
+        return false;
+    }
+    std::atomic_store(&g_addressindex, addressindex);
+    return true;
+}
+
+std::shared_ptr<AddressIndex> StopAddressIndex()
+{
+    std::lock_guard<std::mutex> lock(g_addressindex_mutex);
+    std::shared_ptr<AddressIndex> addressindex = std::atomic_exchange(&g_addressindex, std::shared_ptr<AddressIndex>());
+    if (addressindex) {
+        addressindex->Interrupt();
+        addressindex->Stop();
+    }
+    return addressindex;
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_INDEX_ADDRESSINDEX_H
+#define SALEMCASH_INDEX_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <uint256.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/signals2/connection.hpp>
+
+//! -addressindexcache default (MiB)
+static const int64_t DEFAULT_ADDRESSINDEX_CACHE = 64;
+
+/** The key scripts are looked up by in the address index: the SHA256 of the script */
+uint256 AddressScriptHash(const CScript& script);
+
+/** A transaction paying to or spending from a script */
+struct AddressIndexEntry
+{
+    //! Height of the block holding the transaction, -1 for a mempool transaction
+    int height;
+    uint256 txid;
+    //! Whether the transaction spends an output paying to the script, rather than creating one
+    bool spending;
+    //! Index of the output created, or of the input spending prevout
+    uint32_t index;
+    //! The output spent, null for an entry creating one
+    COutPoint prevout;
+    CAmount amount;
+
+    AddressIndexEntry() : height(-1), spending(false), index(0), amount(0) {}
+};
+
+/**
+ * AddressIndex records, for each script, the outputs paying to it and the
+ * inputs spending those outputs, along with the heights of the blocks holding
+ * them. Entries are keyed by script hash and height, so the history of a
+ * script over a range of heights is read with a single database seek. The
+ * transactions in the mempool are tracked in memory.
+ *
+ * As the entries of a block are keyed by height rather than block hash, the
+ * entries of blocks that are disconnected are removed again.
+ */
+class AddressIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    mutable std::mutex m_mempool_mutex;
+    //! Entries of the transactions in the mempool, by script hash
+    std::multimap<uint256, AddressIndexEntry> m_mempool_entries;
+    //! Script hashes of the entries of each mempool transaction, to remove them again
+    std::map<uint256, std::vector<uint256>> m_mempool_scripts;
+    //! The outputs spent by each transaction in the mempool, null where not
+    //! found. They are looked up as the transaction enters the mempool, while
+    //! cs_main is held anyway, so that the entries can be added later
+    //! without it.
+    std::map<uint256, std::vector<CTxOut>> m_mempool_spent;
+
+    /** Look up the outputs a transaction entering the mempool spends.
+     *  Requires cs_main and mempool.cs. */
+    void MempoolEntryAdded(const CTransactionRef& tx);
+
+    /** Add the entries of a mempool transaction, given the outputs it spends */
+    void AddMempoolTx(const CTransaction& tx, const std::vector<CTxOut>& spent);
+
+    /** Remove the entries of a transaction that left the mempool */
+    void RemoveMempoolTx(const uint256& txid);
+
+protected:
+    bool Init() override;
+
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+
+    BlockWriter PrepareBlock(const CBlockIndex* pindex) override;
+
+    bool RewindBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                        const std::vector<CTransactionRef>& txn_conflicted) override;
+
+    void TransactionAddedToMempool(const CTransactionRef& tx) override;
+
+    void TransactionRemovedFromMempool(const CTransactionRef& tx) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "addressindex"; }
+
+private:
+    // Declared last, so that the mempool stops calling in first on destruction
+    boost::signals2::scoped_connection m_entry_added_conn;
+    boost::signals2::scoped_connection m_entry_removed_conn;
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    ~AddressIndex() override;
+
+    /// Pass the entries of a script in blocks from start_height to
+    /// stop_height (inclusive) to visitor, in chain order, until it returns
+    /// false. Returns false if the database could not be read.
+    bool FindHistory(const uint256& script_hash, int start_height, int stop_height,
+                     const std::function<bool(const AddressIndexEntry&)>& visitor) const;
+
+    /// The entries of a script in mempool transactions.
+    std::vector<AddressIndexEntry> FindMempoolHistory(const uint256& script_hash) const;
+
+    /// The outputs paying to a script that are not spent, in chain order.
+    /// With include_mempool, outputs created by mempool transactions are
+    /// included and those spent by them are left out.
+    bool FindUnspent(const uint256& script_hash, bool include_mempool,
+                     std::vector<AddressIndexEntry>& outputs) const;
+};
+
+/// The global address index, or null if it is not enabled. As with
+/// GetTxIndex, callers hold on to the pointer for as long as they use it.
+std::shared_ptr<AddressIndex> GetAddressIndex();
+
+/// Open the address index and start building it in the background from
+/// where it left off. Does nothing if it is running already.
+bool StartAddressIndex(size_t n_cache_size);
+
+/// Stop updating the address index and drop it as the global one. As with
+/// StopTxIndex, the stopped index is returned.
+std::shared_ptr<AddressIndex> StopAddressIndex();
+
+#endif // SALEMCASH_INDEX_ADDRESSINDEX_H
@@ -0,0 +1,246 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addressindex.h>
+#include <key.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <test/test_salemcash.h>
+#include <txmempool.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestChain100Setup)
+
+static bool WaitUntilSynced(const BaseIndex& index)
+{
+    // Allow the sync thread up to 10 seconds to catch up with the chain
+    int64_t time_start = GetTimeMillis();
+    while (!index.IsSynced()) {
+        if (GetTimeMillis() - time_start > 10000) {
+            return false;
+        }
+        MilliSleep(100);
+    }
+    return true;
+}
+
+static std::vector<AddressIndexEntry> History(const AddressIndex& index, const CScript& script,
+                                              int start_height = 0, int stop_height = std::numeric_limits<int>::max())
+{
+    std::vector<AddressIndexEntry> entries;
+    BOOST_CHECK(index.FindHistory(AddressScriptHash(script), start_height, stop_height,
+                                  [&](const AddressIndexEntry& entry) {
+                                      entries.push_back(entry);
+                                      return true;
+                                  }));
+    return entries;
+}
+
+/** Spend the first output of cashbase to script, signing with key */
+static CMutableTransaction SpendCashbase(const CTransaction& cashbase, const CKey& key, const CScript& script)
+{
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(cashbase.GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = script;
+
+    std::vector<unsigned char> sig;
+    uint256 hash = SignatureHash(cashbase.vout[0].scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(key.Sign(hash, sig));
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << sig;
+    return spend;
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_initial_sync)
+{
+    AddressIndex address_index(1 << 20, true);
+    const CScript cashbase_script = cashbaseTxns[0].vout[0].scriptPubKey;
+
+    // Nothing should be found before the index is started
+    BOOST_CHECK(History(address_index, cashbase_script).empty());
+
+    BOOST_REQUIRE(address_index.Start());
+    BOOST_REQUIRE(WaitUntilSynced(address_index));
+
+    // Each of the blocks of the setup pays to the same script
+    std::vector<AddressIndexEntry> entries = History(address_index, cashbase_script);
+    BOOST_REQUIRE_EQUAL(entries.size(), cashbaseTxns.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        BOOST_CHECK_EQUAL(entries[i].height, (int)i + 1);
+        BOOST_CHECK(entries[i].txid == cashbaseTxns[i].GetHash());
+        BOOST_CHECK(!entries[i].spending);
+        BOOST_CHECK_EQUAL(entries[i].index, 0U);
+        BOOST_CHECK_EQUAL(entries[i].amount, cashbaseTxns[i].vout[0].nValue);
+    }
+
+    // Height ranges are inclusive
+    entries = History(address_index, cashbase_script, 10, 19);
+    BOOST_REQUIRE_EQUAL(entries.size(), 10U);
+    BOOST_CHECK_EQUAL(entries.front().height, 10);
+    BOOST_CHECK_EQUAL(entries.back().height, 19);
+    BOOST_CHECK(History(address_index, cashbase_script, 101, 200).empty());
+
+    // A spend in a new block shows up for both scripts
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript dest_script = GetScriptForDestination(key.GetPubKey().GetID());
+    std::vector<CMutableTransaction> spends{SpendCashbase(cashbaseTxns[0], cashbaseKey, dest_script)};
+    const CBlock block = CreateAndProcessBlock(spends, cashbase_script);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+
+    entries = History(address_index, cashbase_script, 101, 101);
+    BOOST_REQUIRE_EQUAL(entries.size(), 2U);
+    BOOST_CHECK(!entries[0].spending);
+    BOOST_CHECK(entries[0].txid == block.vtx[0]->GetHash());
+    BOOST_CHECK(entries[1].spending);
+    BOOST_CHECK(entries[1].txid == block.vtx[1]->GetHash());
+    BOOST_CHECK(entries[1].prevout == COutPoint(cashbaseTxns[0].GetHash(), 0));
+    BOOST_CHECK_EQUAL(entries[1].amount, cashbaseTxns[0].vout[0].nValue);
+
+    entries = History(address_index, dest_script);
+    BOOST_REQUIRE_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].height, 101);
+    BOOST_CHECK_EQUAL(entries[0].amount, 11 * CENT);
+
+    // The spent output is no longer unspent
+    std::vector<AddressIndexEntry> unspent;
+    BOOST_REQUIRE(address_index.FindUnspent(AddressScriptHash(cashbase_script), false, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), cashbaseTxns.size());
+    for (const AddressIndexEntry& entry : unspent) {
+        BOOST_CHECK(entry.txid != cashbaseTxns[0].GetHash());
+    }
+
+    // Disconnecting the block takes its entries out again
+    {
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive.Tip()));
+    }
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(History(address_index, cashbase_script, 101, 101).empty());
+    BOOST_CHECK_EQUAL(address_index.GetBestHeight(), 100);
+
+    address_index.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_mempool)
+{
+    AddressIndex address_index(1 << 20, true);
+    BOOST_REQUIRE(address_index.Start());
+    BOOST_REQUIRE(WaitUntilSynced(address_index));
+
+    const CScript cashbase_script = cashbaseTxns[0].vout[0].scriptPubKey;
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript dest_script = GetScriptForDestination(key.GetPubKey().GetID());
+    CMutableTransaction spend = SpendCashbase(cashbaseTxns[0], cashbaseKey, dest_script);
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_REQUIRE(AcceptToMemoryPool(mempool, state, MakeTransactionRef(spend), nullptr, nullptr, true, 0));
+    }
+    SyncWithValidationInterfaceQueue();
+
+    std::vector<AddressIndexEntry> entries = address_index.FindMempoolHistory(AddressScriptHash(cashbase_script));
+    BOOST_REQUIRE_EQUAL(entries.size(), 1U);
+    BOOST_CHECK_EQUAL(entries[0].height, -1);
+    BOOST_CHECK(entries[0].spending);
+    BOOST_CHECK(entries[0].prevout == COutPoint(cashbaseTxns[0].GetHash(), 0));
+    entries = address_index.FindMempoolHistory(AddressScriptHash(dest_script));
+    BOOST_REQUIRE_EQUAL(entries.size(), 1U);
+    BOOST_CHECK(!entries[0].spending);
+
+    // Unspent outputs count mempool spends only when asked to
+    std::vector<AddressIndexEntry> unspent;
+    BOOST_REQUIRE(address_index.FindUnspent(AddressScriptHash(cashbase_script), false, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), cashbaseTxns.size());
+    BOOST_REQUIRE(address_index.FindUnspent(AddressScriptHash(cashbase_script), true, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), cashbaseTxns.size() - 1);
+
+    // Once mined, the transaction moves from the mempool entries to the database
+    std::vector<CMutableTransaction> spends{spend};
+    CreateAndProcessBlock(spends, cashbase_script);
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(address_index.FindMempoolHistory(AddressScriptHash(cashbase_script)).empty());
+    BOOST_CHECK(address_index.FindMempoolHistory(AddressScriptHash(dest_script)).empty());
+    BOOST_CHECK_EQUAL(History(address_index, dest_script).size(), 1U);
+
+    address_index.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_mempool_chain)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript dest_script = GetScriptForDestination(key.GetPubKey().GetID());
+    const CMutableTransaction parent = SpendCashbase(cashbaseTxns[0], cashbaseKey, dest_script);
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_REQUIRE(AcceptToMemoryPool(mempool, state, MakeTransactionRef(parent), nullptr, nullptr, true, 0));
+    }
+
+    // A transaction in the mempool before the index starts is picked up by it
+    AddressIndex address_index(1 << 20, true);
+    BOOST_REQUIRE(address_index.Start());
+    BOOST_REQUIRE(WaitUntilSynced(address_index));
+    BOOST_CHECK_EQUAL(address_index.FindMempoolHistory(AddressScriptHash(dest_script)).size(), 1U);
+
+    // The output a child spends is found in the mempool
+    CMutableTransaction child;
+    child.nVersion = 1;
+    child.vin.resize(1);
+    child.vin[0].prevout = COutPoint(parent.GetHash(), 0);
+    child.vout.resize(1);
+    child.vout[0].nValue = 10 * CENT;
+    child.vout[0].scriptPubKey = cashbaseTxns[0].vout[0].scriptPubKey;
+    std::vector<unsigned char> sig;
+    BOOST_CHECK(key.Sign(SignatureHash(dest_script, child, 0, SIGHASH_ALL, 0, SIGVERSION_BASE), sig));
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    child.vin[0].scriptSig << sig << ToByteVector(key.GetPubKey());
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_REQUIRE(AcceptToMemoryPool(mempool, state, MakeTransactionRef(child), nullptr, nullptr, true, 0));
+    }
+    SyncWithValidationInterfaceQueue();
+
+    std::vector<AddressIndexEntry> entries = address_index.FindMempoolHistory(AddressScriptHash(dest_script));
+    BOOST_REQUIRE_EQUAL(entries.size(), 2U);
+    const AddressIndexEntry& spend = entries[0].spending ? entries[0] : entries[1];
+    BOOST_CHECK(spend.spending);
+    BOOST_CHECK(spend.txid == child.GetHash());
+    BOOST_CHECK(spend.prevout == COutPoint(parent.GetHash(), 0));
+    BOOST_CHECK_EQUAL(spend.amount, 11 * CENT);
+
+    // A transaction that leaves the mempool before its notification is handled is left out
+    {
+        LOCK2(cs_main, mempool.cs);
+        mempool.removeRecursive(parent);
+        CValidationState state;
+        BOOST_REQUIRE(AcceptToMemoryPool(mempool, state, MakeTransactionRef(parent), nullptr, nullptr, true, 0));
+        mempool.removeRecursive(parent);
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(address_index.FindMempoolHistory(AddressScriptHash(dest_script)).empty());
+    BOOST_CHECK(address_index.FindMempoolHistory(AddressScriptHash(cashbaseTxns[0].vout[0].scriptPubKey)).empty());
+
+    address_index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,7 +3,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <iostream>
+#include <map>
+#include <vector>
 #include <util.h>
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_salemcash.h>
 #include <boost/test/unit_test.hpp>
@@ -231,4 +234,55 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<128, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), 0U);
+
+    // Sizes are rounded up to the alignment
+    void* a = resource.Allocate(20, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 48U);
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), 1024U);
+    BOOST_CHECK_EQUAL((char*)b - (char*)a, 24);
+
+    // Freed blocks are handed out again for the same size
+    resource.Deallocate(a, 20, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 24U);
+    BOOST_CHECK(resource.Allocate(17, 8) == a);
+
+    // Large requests bypass the pool
+    void* large = resource.Allocate(256, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 48U);
+    BOOST_CHECK_EQUAL(resource.LargeBytes(), 256U);
+    resource.Deallocate(large, 256, 8);
+    BOOST_CHECK_EQUAL(resource.LargeBytes(), 0U);
+
+    // Filling the chunk takes another one
+    std::vector<void*> blocks;
+    for (int i = 0; i < 16; i++) {
+        blocks.push_back(resource.Allocate(128, 8));
+    }
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), 3 * 1024U);
+    for (void* p : blocks) {
+        resource.Deallocate(p, 128, 8);
+    }
+    resource.Deallocate(a, 17, 8);
+    resource.Deallocate(b, 24, 8);
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+    resource.ReleaseChunks();
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), 0U);
+
+    // Containers share the resource
+    {
+        std::map<int, int, std::less<int>, PoolAllocator<std::pair<const int, int>, 128, 8>> map(std::less<int>(), &resource);
+        for (int i = 0; i < 100; i++) {
+            map[i] = i;
+        }
+        BOOST_CHECK(resource.UsedBytes() >= 100 * sizeof(std::pair<const int, int>));
+    }
+    BOOST_CHECK_EQUAL(resource.UsedBytes(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,410 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <checkqueue.h>
+#include <index/base.h>
+#include <init.h>
+#include <tinyformat.h>
+#include <ui_interface.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <warnings.h>
+
+#include <boost/thread.hpp>
+
+constexpr char DB_BEST_BLOCK = 'B';
+
+//! Write the blocks read while catching up once they take this many bytes
+constexpr size_t MAX_SYNC_BATCH_SIZE = 16 << 20;
+//! or when this many seconds have passed since the last write
+constexpr int64_t SYNC_COMMIT_INTERVAL = 30;
+constexpr int64_t SYNC_LOG_INTERVAL = 30;
+//! Most threads preparing blocks while catching up
+constexpr int MAX_SYNC_THREADS = 8;
+//! Blocks prepared at once per thread, which bounds the blocks held in memory
+constexpr size_t SYNC_BLOCKS_PER_THREAD = 4;
+
+template<typename... Args>
+static void FatalError(const char* fmt, const Args&... args)
+{
+    std::string strMessage = tfm::format(fmt, args...);
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        "Error: A fatal internal error occurred, see debug.log for details",
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
+    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+{}
+
+bool BaseIndex::DB::ReadBestBlock(uint256& hash) const
+{
+    return Read(DB_BEST_BLOCK, hash);
+}
+
+void BaseIndex::DB::WriteBestBlock(CDBBatch& batch, const uint256& hash)
+{
+    batch.Write(DB_BEST_BLOCK, hash);
+}
+
+BaseIndex::BaseIndex() : m_synced(false), m_best_block_index(nullptr)
+{
+}
+
+BaseIndex::~BaseIndex()
+{
+    Interrupt();
+    Stop();
+}
+
+bool BaseIndex::Init()
+{
+    uint256 hash;
+    const bool have_best = GetDB().ReadBestBlock(hash);
+
+    LOCK(cs_main);
+    const CBlockIndex* pindex = have_best ? LookupBlockIndex(hash) : nullptr;
+    if (have_best && !pindex) {
+        // The block index was rebuilt without this block, start over
+        LogPrintf("%s: best block %s of %s is not known, indexing from genesis\n", __func__, hash.ToString(), GetName());
+    }
+    m_best_block_index = pindex;
+    m_synced = pindex == chainActive.Tip();
+    return true;
+}
+
+static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev)
+{
+    AssertLockHeld(cs_main);
+
+    if (!pindex_prev) {
+        return chainActive.Genesis();
+    }
+
+    const CBlockIndex* pindex = chainActive.Next(pindex_prev);
+    if (pindex) {
+        return pindex;
+    }
+
+    return chainActive.Next(chainActive.FindFork(pindex_prev));
+}
+
+class BaseIndex::BlockPrepare
+{
+private:
+    BaseIndex* m_index;
+    const CBlockIndex* m_pindex;
+    BlockWriter* m_writer;
+
+public:
+    BlockPrepare() : m_index(nullptr), m_pindex(nullptr), m_writer(nullptr) {}
+    BlockPrepare(BaseIndex& index, const CBlockIndex* pindex, BlockWriter& writer) : m_index(&index), m_pindex(pindex), m_writer(&writer) {}
+
+    bool operator()()
+    {
+        // Skipped blocks are left with an empty writer, which is not used
+        // as the caller checks for the interrupt first
+        if (!m_index->m_interrupt) {
+            *m_writer = m_index->PrepareBlock(m_pindex);
+        }
+        return true;
+    }
+
+    void swap(BlockPrepare& prepare)
+    {
+        std::swap(m_index, prepare.m_index);
+        std::swap(m_pindex, prepare.m_pindex);
+        std::swap(m_writer, prepare.m_writer);
+    }
+};
+
+/** Threads running the workers of a CCheckQueue until going out of scope */
+template <typename T>
+class CheckQueueWorkers
+{
+private:
+    boost::thread_group m_threads;
+
+public:
+    CheckQueueWorkers(CCheckQueue<T>& queue, int n_threads)
+    {
+        for (int i = 0; i < n_threads; i++) {
+            m_threads.create_thread([&queue] { queue.Thread(); });
+        }
+    }
+
+    ~CheckQueueWorkers()
+    {
+        m_threads.interrupt_all();
+        m_threads.join_all();
+    }
+};
+
+void BaseIndex::ThreadSync()
+{
+    const CBlockIndex* pindex = m_best_block_index.load();
+    if (!m_synced) {
+        const int n_threads = std::max(1, std::min(GetNumCores(), MAX_SYNC_THREADS));
+        const size_t max_blocks = SYNC_BLOCKS_PER_THREAD * n_threads;
+
+        // Reading a block is the unit of work, so take one at a time
+        CCheckQueue<BlockPrepare> queue(1);
+        CheckQueueWorkers<BlockPrepare> workers(queue, n_threads - 1);
+
+        CDBBatch batch(GetDB());
+        //! Last block whose data is in batch but not written yet
+        const CBlockIndex* pindex_batch = nullptr;
+        int64_t last_log_time = 0;
+        int64_t last_commit_time = GetTime();
+        while (true) {
+            if (m_interrupt) {
+                // Keep what was read so far
+                if (pindex_batch && !Commit(batch, pindex_batch)) {
+                    FatalError("%s: Failed to write %s state", __func__, GetName());
+                }
+                return;
+            }
+
+            std::vector<const CBlockIndex*> blocks;
+            std::vector<const CBlockIndex*> stale_blocks;
+            {
+                LOCK(cs_main);
+                if (pindex && !chainActive.Contains(pindex)) {
+                    // The chain was reorganized away from the last block
+                    // read, so take out the blocks down to the fork first
+                    const CBlockIndex* fork = chainActive.FindFork(pindex);
+                    for (const CBlockIndex* stale = pindex; stale != fork; stale = stale->pprev) {
+                        stale_blocks.push_back(stale);
+                    }
+                }
+                const CBlockIndex* pindex_next = pindex;
+                while (stale_blocks.empty() && blocks.size() < max_blocks && (pindex_next = NextSyncBlock(pindex_next))) {
+                    blocks.push_back(pindex_next);
+                }
+                if (blocks.empty() && stale_blocks.empty() && !pindex_batch) {
+                    // From here on, blocks connected to the chain are
+                    // written as they come through BlockConnected
+                    m_best_block_index = pindex;
+                    m_synced = true;
+                    break;
+                }
+            }
+
+            if (!stale_blocks.empty()) {
+                for (const CBlockIndex* stale : stale_blocks) {
+                    CBlock block;
+                    if (!ReadBlockFromDisk(block, stale, Params().GetConsensus())) {
+                        FatalError("%s: Failed to read block %s from disk", __func__, stale->GetBlockHash().ToString());
+                        return;
+                    }
+                    if (!RewindBlock(batch, block, stale)) {
+                        FatalError("%s: Failed to rewind %s past block %s", __func__, GetName(), stale->GetBlockHash().ToString());
+                        return;
+                    }
+                    pindex = pindex_batch = stale->pprev;
+                }
+                continue;
+            }
+
+            int64_t current_time = GetTime();
+            if (pindex_batch && (blocks.empty() || batch.SizeEstimate() >= MAX_SYNC_BATCH_SIZE ||
+                                 current_time - last_commit_time >= SYNC_COMMIT_INTERVAL)) {
+                // Write the batch without holding cs_main, then check again
+                // whether the chain grew in the meantime
+                if (!Commit(batch, pindex_batch)) {
+                    FatalError("%s: Failed to write %s state", __func__, GetName());
+                    return;
+                }
+                batch.Clear();
+                pindex_batch = nullptr;
+                last_commit_time = current_time;
+                continue;
+            }
+
+            if (current_time - last_log_time >= SYNC_LOG_INTERVAL) {
+                LogPrintf("Syncing %s with block chain from height %d\n", GetName(), blocks.front()->nHeight);
+                last_log_time = current_time;
+            }
+
+            std::vector<BlockWriter> writers = PrepareBlocks(queue, blocks);
+            if (m_interrupt) {
+                continue;
+            }
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (!writers[i]) {
+                    FatalError("%s: Failed to read block %s from disk", __func__, blocks[i]->GetBlockHash().ToString());
+                    return;
+                }
+                if (!writers[i](batch)) {
+                    FatalError("%s: Failed to write block %s to index database", __func__, blocks[i]->GetBlockHash().ToString());
+                    return;
+                }
+                pindex = pindex_batch = blocks[i];
+            }
+        }
+    }
+
+    if (pindex) {
+        LogPrintf("%s is enabled at height %d\n", GetName(), pindex->nHeight);
+    } else {
+        LogPrintf("%s is enabled\n", GetName());
+    }
+}
+
+std::vector<BaseIndex::BlockWriter> BaseIndex::PrepareBlocks(CCheckQueue<BlockPrepare>& queue, const std::vector<const CBlockIndex*>& blocks)
+{
+    std::vector<BlockWriter> writers(blocks.size());
+    std::vector<BlockPrepare> prepares;
+    prepares.reserve(blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        prepares.emplace_back(*this, blocks[i], writers[i]);
+    }
+
+    CCheckQueueControl<BlockPrepare> control(&queue);
+    control.Add(prepares);
+    control.Wait();
+    return writers;
+}
+
+BaseIndex::BlockWriter BaseIndex::PrepareBlock(const CBlockIndex* pindex)
+{
+    auto block = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*block, pindex, Params().GetConsensus())) {
+        return nullptr;
+    }
+    return [this, block, pindex](CDBBatch& batch) {
+        return WriteBlock(batch, *block, pindex);
+    };
+}
+
+bool BaseIndex::Commit(CDBBatch& batch, const CBlockIndex* pindex)
+{
+    GetDB().WriteBestBlock(batch, pindex->GetBlockHash());
+    if (!GetDB().WriteBatch(batch)) {
+        return error("%s: Failed to commit latest %s state", __func__, GetName());
+    }
+    m_best_block_index = pindex;
+    return true;
+}
+
+void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                               const std::vector<CTransactionRef>& txn_conflicted)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (!best_block_index) {
+        if (pindex->nHeight != 0) {
+            FatalError("%s: First block connected is not the genesis block (height=%d)",
+                       __func__, pindex->nHeight);
+            return;
+        }
+    } else {
+        // Ensure block connects to an ancestor of the current best block. This should be the case
+        // most of the time, but may not be immediately after the sync thread catches up and sets
+        // m_synced. Consider the case where there is a reorg and the blocks on the stale branch are
+        // in the ValidationInterface queue backlog even after the sync thread has caught up to the
+        // new chain tip. In this unlikely event, log a warning and let the queue clear.
+        if (best_block_index->GetAncestor(pindex->nHeight - 1) != pindex->pprev) {
+            LogPrintf("%s: WARNING: Block %s does not connect to an ancestor of known best chain "
+                      "(tip=%s); not updating index\n",
+                      __func__, pindex->GetBlockHash().ToString(),
+                      best_block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    CDBBatch batch(GetDB());
+    if (!WriteBlock(batch, *block, pindex) || !Commit(batch, pindex)) {
+        FatalError("%s: Failed to write block %s to index",
+                   __func__, pindex->GetBlockHash().ToString());
+        return;
+    }
+}
+
+void BaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    // Step the best block back, so that the blocks of the new branch connect
+    // to it as they come in.
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (!best_block_index || best_block_index->GetBlockHash() != block->GetHash() || !best_block_index->pprev) {
+        return;
+    }
+
+    CDBBatch batch(GetDB());
+    if (!RewindBlock(batch, *block, best_block_index) || !Commit(batch, best_block_index->pprev)) {
+        FatalError("%s: Failed to rewind %s to block %s", __func__, GetName(),
+                   best_block_index->pprev->GetBlockHash().ToString());
+    }
+}
+
+bool BaseIndex::BlockUntilSyncedToCurrentChain()
+{
+    AssertLockNotHeld(cs_main);
+
+    if (!m_synced) {
+        return false;
+    }
+
+    {
+        // Skip the queue-draining stuff if we know we're caught up with
+        // chainActive.Tip().
+        LOCK(cs_main);
+        const CBlockIndex* chain_tip = chainActive.Tip();
+        const CBlockIndex* best_block_index = m_best_block_index.load();
+        if (!chain_tip || (best_block_index && best_block_index->GetAncestor(chain_tip->nHeight) == chain_tip)) {
+            return true;
+        }
+    }
+
+    LogPrintf("%s: %s is catching up on block notifications\n", __func__, GetName());
+    SyncWithValidationInterfaceQueue();
+    return true;
+}
+
+int BaseIndex::GetBestHeight() const
+{
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    return best_block_index ? best_block_index->nHeight : -1;
+}
+
+void BaseIndex::Interrupt()
+{
+    m_interrupt();
+}
+
+bool BaseIndex::Start()
+{
+    // Need to register this ValidationInterface before running Init(), so that
+    // callbacks are not missed if Init sets m_synced to true.
+    RegisterValidationInterface(this);
+    if (!Init()) {
+        UnregisterValidationInterface(this);
+        return error("%s: %s failed to initialize", __func__, GetName());
+    }
+
+    m_thread_sync = std::thread(&TraceThread<std::function<void()>>, GetName(),
+                                std::bind(&BaseIndex::ThreadSync, this));
+    return true;
+}
+
+void BaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+
+    if (m_thread_sync.joinable()) {
+        m_thread_sync.join();
+    }
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_INDEX_BASE_H
+#define SALEMCASH_INDEX_BASE_H
+
+#include <dbwrapper.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <threadinterrupt.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class CBlockIndex;
+template <typename T>
+class CCheckQueue;
+
+/**
+ * Base class for indices of blockchain data. It keeps its own database up to
+ * date with the active chain through the validation interface, and catches
+ * up with blocks that were connected while it was not running by reading
+ * them from disk on threads of its own. So an index can be turned on at any
+ * time, without reindexing the chain.
+ */
+class BaseIndex : public CValidationInterface
+{
+protected:
+    /** The database of an index, which also records the block it is up to date with */
+    class DB : public CDBWrapper
+    {
+    public:
+        DB(const fs::path& path, size_t n_cache_size, bool f_memory = false, bool f_wipe = false, bool f_obfuscate = false);
+
+        /** Read the hash of the last block written to the index */
+        bool ReadBestBlock(uint256& hash) const;
+
+        /** Record the last block written to the index, along with its data in batch */
+        void WriteBestBlock(CDBBatch& batch, const uint256& hash);
+    };
+
+    /** Writes the result of PrepareBlock to a batch */
+    typedef std::function<bool(CDBBatch& batch)> BlockWriter;
+
+private:
+    /** Whether the index has caught up with the active chain, so that
+     *  BlockConnected notifications are to be written to it */
+    std::atomic<bool> m_synced;
+
+    /** The last block written to the index */
+    std::atomic<const CBlockIndex*> m_best_block_index;
+
+    std::thread m_thread_sync;
+    CThreadInterrupt m_interrupt;
+
+    /** A call of PrepareBlock, queued for the threads catching up */
+    class BlockPrepare;
+
+    /** Catch up with the active chain from disk, in batches of many blocks.
+     *  Runs on m_thread_sync, along with workers that live as long. */
+    void ThreadSync();
+
+    /** Run PrepareBlock for each of blocks, spread over the workers of queue
+     *  and the calling thread */
+    std::vector<BlockWriter> PrepareBlocks(CCheckQueue<BlockPrepare>& queue, const std::vector<const CBlockIndex*>& blocks);
+
+    /** Write batch, which holds the data of blocks up to pindex, and record
+     *  pindex as the best block along with it */
+    bool Commit(CDBBatch& batch, const CBlockIndex* pindex);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
+                        const std::vector<CTransactionRef>& txn_conflicted) override;
+
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
+    /** Initialize internal state from the database. Called before the index
+     *  starts following the chain. */
+    virtual bool Init();
+
+    /** Add the data of a block that is connected to the active chain to batch */
+    virtual bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) = 0;
+
+    /** While catching up, do the part of the work on a block that does not
+     *  depend on earlier blocks, such as reading it from disk. This runs for
+     *  many blocks at once on several threads, so it must not change the
+     *  state of the index; the writers returned are then run in chain order.
+     *  Returns an empty writer on failure. The default reads the block and
+     *  leaves the rest to WriteBlock. */
+    virtual BlockWriter PrepareBlock(const CBlockIndex* pindex);
+
+    /** Take the data of a block that was disconnected from the active chain
+     *  out of the index, adding the changes to batch. Indexes keyed by block
+     *  hash can leave the data of stale blocks in place, which is the
+     *  default. */
+    virtual bool RewindBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) { return true; }
+
+    virtual DB& GetDB() const = 0;
+
+    /** Name of the index, for logging */
+    virtual const char* GetName() const = 0;
+
+public:
+    BaseIndex();
+    /** Destructor interrupts sync thread if running and blocks until it exits. */
+    virtual ~BaseIndex();
+
+    /** Blocks the current thread until the index is caught up to the current
+     *  state of the block chain. This only blocks if the index has gotten in
+     *  sync once and only needs to process blocks in the ValidationInterface
+     *  queue. If the index is catching up from far behind, this method does
+     *  not block and immediately returns false. */
+    bool BlockUntilSyncedToCurrentChain();
+
+    /** Whether the index has caught up with the active chain */
+    bool IsSynced() const { return m_synced; }
+
+    /** Height of the last block written to the index, -1 if none */
+    int GetBestHeight() const;
+
+    void Interrupt();
+
+    /** Start initializes the sync state and registers the instance as a
+     *  ValidationInterface so that it stays in sync with blockchain updates. */
+    bool Start();
+
+    /** Stops the instance from staying in sync with blockchain updates. */
+    void Stop();
+};
+
+#endif // SALEMCASH_INDEX_BASE_H
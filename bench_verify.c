@@ -79,6 +79,70 @@ static void benchmark_verify_openssl(void* arg) {
 }
 #endif
 
+#define MULTI_MAX_POINTS 4096
+#define MULTI_POINTS_PER_RUN 4096
+
+typedef struct {
+    secp256k1_context *ctx;
+    secp256k1_scratch_space *scratch;
+    secp256k1_pubkey pubkeys[MULTI_MAX_POINTS];
+    const secp256k1_pubkey *pubkey_ptrs[MULTI_MAX_POINTS];
+    unsigned char scalars[MULTI_MAX_POINTS][32];
+    const unsigned char *scalar_ptrs[MULTI_MAX_POINTS];
+    size_t count;
+} benchmark_ecmult_multi_t;
+
+static void benchmark_ecmult_multi(void* arg) {
+    size_t i;
+    benchmark_ecmult_multi_t* data = (benchmark_ecmult_multi_t*)arg;
+    size_t iters = MULTI_POINTS_PER_RUN / data->count;
+
+    for (i = 0; i < iters; i++) {
+        secp256k1_pubkey out;
+        /* Perturb one scalar per iteration so successive sums differ. */
+        data->scalars[i % data->count][31] ^= (i & 0xFF) | 1;
+        CHECK(secp256k1_ecmult_multi(data->ctx, data->scratch, &out, NULL, data->pubkey_ptrs, data->scalar_ptrs, data->count) == 1);
+    }
+}
+
+static void run_ecmult_multi_benchmarks(secp256k1_context *ctx) {
+    static benchmark_ecmult_multi_t data;
+    static const size_t counts[] = {1, 2, 16, 64, 256, 1024, MULTI_MAX_POINTS};
+    char name[64];
+    size_t i;
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(ctx, 1 << 24);
+
+    data.ctx = ctx;
+    for (i = 0; i < MULTI_MAX_POINTS; i++) {
+        unsigned char key[32];
+        memset(key, 0, sizeof(key));
+        key[0] = 1 + (i >> 16);
+        key[1] = i >> 8;
+        key[2] = i;
+        key[31] = 7;
+        CHECK(secp256k1_ec_pubkey_create(ctx, &data.pubkeys[i], key));
+        data.pubkey_ptrs[i] = &data.pubkeys[i];
+        memset(data.scalars[i], 0x5a, 32);
+        data.scalars[i][0] = 0x3f;
+        data.scalars[i][30] = i;
+        data.scalars[i][29] = i >> 8;
+        data.scalar_ptrs[i] = data.scalars[i];
+    }
+
+    /* Times are reported per point; without a scratch space every point costs a full ecmult. */
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        data.count = counts[i];
+        data.scratch = scratch;
+        sprintf(name, "ecmult_multi_%i", (int)data.count);
+        run_benchmark(name, benchmark_ecmult_multi, NULL, NULL, &data, 10, (MULTI_POINTS_PER_RUN / data.count) * data.count);
+        data.scratch = NULL;
+        sprintf(name, "ecmult_multi_%i_noscratch", (int)data.count);
+        run_benchmark(name, benchmark_ecmult_multi, NULL, NULL, &data, 3, (MULTI_POINTS_PER_RUN / data.count) * data.count);
+    }
+
+    secp256k1_scratch_space_destroy(scratch);
+}
+
 int main(void) {
     int i;
     secp256k1_pubkey pubkey;
@@ -107,6 +171,8 @@ int main(void) {
     EC_GROUP_free(data.ec_group);
 #endif
 
+    run_ecmult_multi_benchmarks(data.ctx);
+
     secp256k1_context_destroy(data.ctx);
     return 0;
 }
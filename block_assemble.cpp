@@ -0,0 +1,205 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <consensus/consensus.h>
+#include <consensus/validation.h>
+#include <fs.h>
+#include <miner.h>
+#include <pow.h>
+#include <scheduler.h>
+#include <script/sigcache.h>
+#include <txdb.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+static const CScript SCRIPT_PUB = CScript() << OP_TRUE;
+static const size_t FANOUT_TXS = 100;
+static const size_t FANOUT_OUTPUTS = 1000;
+
+static void MineBlock()
+{
+    std::unique_ptr<CBlockTemplate> ptemplate = BlockAssembler(Params()).CreateNewBlock(SCRIPT_PUB);
+    CBlock& block = ptemplate->block;
+    unsigned int nExtraNonce = 0;
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+    bool processed = ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr);
+    assert(processed);
+}
+
+static void AddToMempool(const CTransactionRef& tx, CAmount nFee)
+{
+    LOCK2(cs_main, mempool.cs);
+    LockPoints lp;
+    mempool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, nFee, GetTime(), chainActive.Height(), false, 0, lp));
+}
+
+/** A regtest chain with FANOUT_TXS * FANOUT_OUTPUTS confirmed outputs that
+ *  anyone can spend, set up once for all benchmarks below */
+class AssembleChain
+{
+public:
+    std::vector<CTxOut> vOutputs;
+    std::vector<COutPoint> vOutpoints;
+
+    AssembleChain()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        InitSignatureCache();
+        InitScriptExecutionCache();
+        pathTemp = fs::temp_directory_path() / strprintf("bench_salemcash_assemble_%lu", (unsigned long)GetTime());
+        fs::create_directories(pathTemp);
+        gArgs.ForceSetArg("-datadir", pathTemp.string());
+
+        threadGroup.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+        GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+        GetMainSignals().RegisterWithMempoolSignals(mempool);
+        pblocktree.reset(new CBlockTreeDB(1 << 20, true));
+        pcashdbview.reset(new CCashViewDB(1 << 23, true));
+        pcashTip.reset(new CCashViewCache(pcashdbview.get()));
+        bool loaded = LoadGenesisBlock(Params());
+        assert(loaded);
+        CValidationState state;
+        bool activated = ActivateBestChain(state, Params());
+        assert(activated);
+
+        // Mature cashbases, each fanned out to many outputs
+        std::vector<CTransactionRef> vCashbases;
+        for (int i = 0; i < CASHBASE_MATURITY + (int)FANOUT_TXS; i++) {
+            MineBlock();
+            LOCK(cs_main);
+            CBlock block;
+            bool read = ReadBlockFromDisk(block, chainActive.Tip(), Params().GetConsensus());
+            assert(read);
+            vCashbases.push_back(block.vtx[0]);
+        }
+        for (size_t i = 0; i < FANOUT_TXS; i++) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back(COutPoint(vCashbases[i]->GetHash(), 0));
+            const CAmount nFee = 100000;
+            for (size_t j = 0; j < FANOUT_OUTPUTS; j++) {
+                tx.vout.emplace_back((vCashbases[i]->vout[0].nValue - nFee) / FANOUT_OUTPUTS, SCRIPT_PUB);
+            }
+            CTransactionRef ptx = MakeTransactionRef(std::move(tx));
+            for (size_t j = 0; j < FANOUT_OUTPUTS; j++) {
+                vOutpoints.emplace_back(ptx->GetHash(), j);
+                vOutputs.push_back(ptx->vout[j]);
+            }
+            AddToMempool(ptx, nFee);
+        }
+        while (mempool.size() > 0) {
+            MineBlock();
+        }
+    }
+
+    ~AssembleChain()
+    {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        GetMainSignals().FlushBackgroundCallbacks();
+        GetMainSignals().UnregisterBackgroundSignalScheduler();
+        GetMainSignals().UnregisterWithMempoolSignals(mempool);
+        UnloadBlockIndex();
+        pcashTip.reset();
+        pcashdbview.reset();
+        pblocktree.reset();
+        fs::remove_all(pathTemp);
+    }
+
+    /** Fill the mempool with nTxs independent transactions at varying feerates */
+    std::vector<CTransactionRef> FillMempool(size_t nTxs)
+    {
+        assert(nTxs <= vOutpoints.size());
+        mempool.clear();
+        std::vector<CTransactionRef> vtx;
+        for (size_t i = 0; i < nTxs; i++) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back(vOutpoints[i]);
+            const CAmount nFee = 1000 + (i * 7919) % 20000;
+            tx.vout.emplace_back(vOutputs[i].nValue - nFee, SCRIPT_PUB);
+            vtx.push_back(MakeTransactionRef(std::move(tx)));
+            AddToMempool(vtx.back(), nFee);
+        }
+        return vtx;
+    }
+
+private:
+    fs::path pathTemp;
+    boost::thread_group threadGroup;
+    CScheduler scheduler;
+};
+
+static AssembleChain& GetAssembleChain()
+{
+    static AssembleChain chain;
+    return chain;
+}
+
+// What getblocktemplate used to do on every call
+static void AssembleBlock(benchmark::State& state, size_t nMempoolTxs)
+{
+    GetAssembleChain().FillMempool(nMempoolTxs);
+    while (state.KeepRunning()) {
+        BlockAssembler(Params()).CreateNewBlock(SCRIPT_PUB);
+    }
+    mempool.clear();
+}
+
+// Fetching the live template after a transaction in it left the mempool and
+// came back, which drops it and appends it again
+static void LiveTemplate(benchmark::State& state, size_t nMempoolTxs)
+{
+    GetAssembleChain().FillMempool(nMempoolTxs);
+    // Keep the time still, so the freed space does not trigger a rebuild
+    SetMockTime(GetTime());
+    LiveBlockTemplate live(Params(), SCRIPT_PUB);
+    RegisterValidationInterface(&live);
+    live.Rebuild();
+
+    std::shared_ptr<const CBlockTemplate> ptemplate;
+    {
+        LOCK(cs_main);
+        ptemplate = live.GetBlockTemplate();
+    }
+    assert(ptemplate && ptemplate->block.vtx.size() > 1);
+    const CTransactionRef tx = ptemplate->block.vtx[1];
+    CAmount nFee = ptemplate->vTxFees[1];
+    while (state.KeepRunning()) {
+        mempool.removeRecursive(*tx);
+        AddToMempool(tx, nFee);
+        GetMainSignals().TransactionAddedToMempool(tx);
+        SyncWithValidationInterfaceQueue();
+        LOCK(cs_main);
+        ptemplate = live.GetBlockTemplate();
+    }
+    assert(ptemplate && ptemplate->block.vtx.back() == tx);
+
+    UnregisterValidationInterface(&live);
+    SyncWithValidationInterfaceQueue();
+    SetMockTime(0);
+    mempool.clear();
+}
+
+static void AssembleBlock10k(benchmark::State& state) { AssembleBlock(state, 10000); }
+static void AssembleBlock100k(benchmark::State& state) { AssembleBlock(state, 100000); }
+static void LiveTemplate10k(benchmark::State& state) { LiveTemplate(state, 10000); }
+static void LiveTemplate100k(benchmark::State& state) { LiveTemplate(state, 100000); }
+
+BENCHMARK(AssembleBlock10k, 10);
+BENCHMARK(AssembleBlock100k, 2);
+BENCHMARK(LiveTemplate10k, 500);
+BENCHMARK(LiveTemplate100k, 500);
@@ -5,6 +5,7 @@
 #include <rpc/blockchain.h>
 
 #include <amount.h>
+#include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -12,16 +13,23 @@
 #include <consensus/validation.h>
 #include <validation.h>
 #include <core_io.h>
+#include <key_io.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
+#include <index/txindex.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/server.h>
+#include <script/standard.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <utxostats.h>
 #include <hash.h>
 #include <validationinterface.h>
 #include <warnings.h>
@@ -32,6 +40,7 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <limits>
 #include <mutex>
 #include <condition_variable>
 
@@ -114,47 +123,61 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
 {
-    AssertLockHeld(cs_main);
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", blockindex->GetBlockHash().GetHex());
+    JSONValueWriter writer;
+    blockToJSON(block, blockindex, txDetails, writer);
+    return writer.GetValue();
+}
+
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, JSONWriter& writer)
+{
+    // Only what depends on the active chain is looked up under cs_main, as
+    // the writer may wait for a slow client
     int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
-    result.pushKV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
-    result.pushKV("weight", (int)::GetBlockWeight(block));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("versionHex", strprintf("%08x", block.nVersion));
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    UniValue txs(UniValue::VARR);
+    const CBlockIndex* pnext;
+    {
+        LOCK(cs_main);
+        // Only report confirmations if the block is on the main chain
+        if (chainActive.Contains(blockindex))
+            confirmations = chainActive.Height() - blockindex->nHeight + 1;
+        pnext = chainActive.Next(blockindex);
+    }
+
+    writer.BeginObject();
+    writer.KeyValue("hash", blockindex->GetBlockHash().GetHex());
+    writer.KeyValue("confirmations", confirmations);
+    writer.KeyValue("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    writer.KeyValue("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.KeyValue("weight", (int)::GetBlockWeight(block));
+    writer.KeyValue("height", blockindex->nHeight);
+    writer.KeyValue("version", block.nVersion);
+    writer.KeyValue("versionHex", strprintf("%08x", block.nVersion));
+    writer.KeyValue("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.Key("tx");
+    writer.BeginArray();
     for(const auto& tx : block.vtx)
     {
         if(txDetails)
         {
             UniValue objTx(UniValue::VOBJ);
             TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
-            txs.push_back(objTx);
+            writer.Value(objTx);
         }
         else
-            txs.push_back(tx->GetHash().GetHex());
+            writer.Value(tx->GetHash().GetHex());
     }
-    result.pushKV("tx", txs);
-    result.pushKV("time", block.GetBlockTime());
-    result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
+    writer.EndArray();
+    writer.KeyValue("time", block.GetBlockTime());
+    writer.KeyValue("mediantime", (int64_t)blockindex->GetMedianTimePast());
+    writer.KeyValue("nonce", (uint64_t)block.nNonce);
+    writer.KeyValue("bits", strprintf("%08x", block.nBits));
+    writer.KeyValue("difficulty", GetDifficulty(blockindex));
+    writer.KeyValue("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+        writer.KeyValue("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
-    return result;
+        writer.KeyValue("nextblockhash", pnext->GetBlockHash().GetHex());
+    writer.EndObject();
 }
 
 UniValue getblockcount(const JSONRPCRequest& request)
@@ -411,7 +434,9 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
 
     UniValue spent(UniValue::VARR);
     const CTxMemPool::txiter &it = mempool.mapTx.find(tx.GetHash());
-    const CTxMemPool::setEntries &setChildren = mempool.GetMemPoolChildren(it);
+    // Sorted by hash, as the children are kept in no particular order
+    const CTxMemPool::linkEntries &children = mempool.GetMemPoolChildren(it);
+    const CTxMemPool::setEntries setChildren(children.begin(), children.end());
     for (const CTxMemPool::txiter &childiter : setChildren) {
         spent.push_back(childiter->GetTx().GetHash().ToString());
     }
@@ -419,35 +444,61 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.pushKV("spentby", spent);
 }
 
+/** Mempool entries described at a time by mempoolToJSON */
+static const size_t MEMPOOL_JSON_BATCH_SIZE = 256;
+
 UniValue mempoolToJSON(bool fVerbose)
+{
+    JSONValueWriter writer;
+    mempoolToJSON(fVerbose, writer);
+    return writer.GetValue();
+}
+
+void mempoolToJSON(bool fVerbose, JSONWriter& writer)
 {
     if (fVerbose)
     {
-        LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx)
+        // The entries are described a batch at a time under mempool.cs and
+        // written without it, as the writer may wait for a slow client.
+        // Transactions that leave the mempool in between are left out.
+        std::vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        writer.BeginObject();
+        std::vector<std::pair<std::string, UniValue>> batch;
+        for (size_t start = 0; start < vtxid.size(); start += MEMPOOL_JSON_BATCH_SIZE)
         {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.pushKV(hash.ToString(), info);
+            const size_t end = std::min(vtxid.size(), start + MEMPOOL_JSON_BATCH_SIZE);
+            {
+                LOCK(mempool.cs);
+                for (size_t i = start; i < end; i++)
+                {
+                    CTxMemPool::txiter it = mempool.mapTx.find(vtxid[i]);
+                    if (it == mempool.mapTx.end()) continue;
+                    UniValue info(UniValue::VOBJ);
+                    entryToJSON(info, *it);
+                    batch.emplace_back(vtxid[i].ToString(), std::move(info));
+                }
+            }
+            for (const auto& entry : batch)
+                writer.KeyValue(entry.first, entry.second);
+            batch.clear();
         }
-        return o;
+        writer.EndObject();
     }
     else
     {
         std::vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        writer.BeginArray();
         for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            writer.Value(hash.ToString());
+        writer.EndArray();
     }
 }
 
-UniValue getrawmempool(const JSONRPCRequest& request)
+static void getrawmempool_stream(const JSONRPCRequest& request, JSONWriter& writer)
 {
     if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
@@ -476,7 +527,14 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    mempoolToJSON(fVerbose, writer);
+}
+
+UniValue getrawmempool(const JSONRPCRequest& request)
+{
+    JSONValueWriter writer;
+    getrawmempool_stream(request, writer);
+    return writer.GetValue();
 }
 
 UniValue getmempoolancestors(const JSONRPCRequest& request)
@@ -724,7 +782,7 @@ UniValue getblockheader(const JSONRPCRequest& request)
     return blockheaderToJSON(pblockindex);
 }
 
-UniValue getblock(const JSONRPCRequest& request)
+static void getblock_stream(const JSONRPCRequest& request, JSONWriter& writer)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
         throw std::runtime_error(
@@ -774,8 +832,6 @@ UniValue getblock(const JSONRPCRequest& request)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -787,32 +843,45 @@ UniValue getblock(const JSONRPCRequest& request)
             verbosity = request.params[1].get_bool() ? 1 : 0;
     }
 
-    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
-    if (!pblockindex) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-    }
-
+    const CBlockIndex* pblockindex;
     CBlock block;
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    {
+        // The reply is written without cs_main, see blockToJSON
+        LOCK(cs_main);
+        pblockindex = LookupBlockIndex(hash);
+        if (!pblockindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
 
-    if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        // Block not found on disk. This could be because we have the block
-        // header in our index but don't have the block (for example if a
-        // non-whitelisted node sends us an unrequested long chain of valid
-        // blocks, we add the headers to our index, but don't accept the
-        // block).
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            // Block not found on disk. This could be because we have the block
+            // header in our index but don't have the block (for example if a
+            // non-whitelisted node sends us an unrequested long chain of valid
+            // blocks, we add the headers to our index, but don't accept the
+            // block).
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    }
 
     if (verbosity <= 0)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
         ssBlock << block;
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        writer.Value(strHex);
+        return;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    blockToJSON(block, pblockindex, verbosity >= 2, writer);
+}
+
+UniValue getblock(const JSONRPCRequest& request)
+{
+    JSONValueWriter writer;
+    getblock_stream(request, writer);
+    return writer.GetValue();
 }
 
 struct CCashStats
@@ -937,43 +1006,88 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
 
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless muhash is requested. The statistics for muhash are\n"
+            "kept up to date as blocks are connected, so only the first such call after an upgrade scans the set.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"    (string, optional, default=\"hash_serialized_2\") Which UTXO set hash to return:\n"
+            "                   \"hash_serialized_2\" for the hash over the serialized set, or \"muhash\" for the rolling hash\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, only with hash_serialized_2\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
+            "  \"muhash\": \"hash\",      (string) The rolling hash of the set, with muhash\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash, with hash_serialized_2\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\"")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    std::string hash_type = "hash_serialized_2";
+    if (!request.params[0].isNull()) {
+        hash_type = request.params[0].get_str();
+    }
+    if (hash_type != "muhash" && hash_type != "hash_serialized_2") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + hash_type);
+    }
+
     UniValue ret(UniValue::VOBJ);
 
-    CCashStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcashdbview.get(), stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
-        ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
-        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    if (hash_type == "hash_serialized_2") {
+        CCashStats stats;
+        FlushStateToDisk();
+        if (GetUTXOStats(pcashdbview.get(), stats)) {
+            ret.pushKV("height", (int64_t)stats.nHeight);
+            ret.pushKV("bestblock", stats.hashBlock.GetHex());
+            ret.pushKV("transactions", (int64_t)stats.nTransactions);
+            ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+            ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+            ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+            ret.pushKV("disk_size", stats.nDiskSize);
+            ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        } else {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        return ret;
+    }
+
+    CUTXOStats stats;
+    bool fKnown;
+    {
+        LOCK(cs_main);
+        fKnown = chainActive.Tip() && utxoStatsTip.hashBlock == chainActive.Tip()->GetBlockHash();
+        if (fKnown) stats = utxoStatsTip;
+    }
+    if (!fKnown) {
+        // Nodes that were not tracking the statistics yet need one scan,
+        // after which blocks keep them up to date
+        FlushStateToDisk();
+        if (!ComputeUTXOStats(pcashdbview.get(), stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        LOCK(cs_main);
+        if (utxoStatsTip.hashBlock.IsNull() && chainActive.Tip() && chainActive.Tip()->GetBlockHash() == stats.hashBlock) {
+            utxoStatsTip = stats;
+        }
     }
+
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    ret.pushKV("muhash", stats.GetSetHash().GetHex());
+    ret.pushKV("disk_size", (uint64_t)pcashdbview->EstimateSize());
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     return ret;
 }
 
@@ -1386,6 +1500,17 @@ UniValue mempoolInfoToJSON()
     ret.pushKV("mempoolminfee", ValueFromAmount(std::max(mempool.GetMinFee(maxmempool), ::minRelayTxFee).GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
 
+    const CTxMemPool::MemoryUsageStats stats = mempool.GetMemoryUsageStats();
+    UniValue memory(UniValue::VOBJ);
+    memory.pushKV("transactions", (int64_t) stats.nTransactions);
+    memory.pushKV("entries", (int64_t) stats.nEntries);
+    memory.pushKV("links", (int64_t) stats.nLinks);
+    memory.pushKV("clusters", (int64_t) stats.nClusters);
+    memory.pushKV("spends", (int64_t) stats.nSpends);
+    memory.pushKV("other", (int64_t) stats.nOther);
+    memory.pushKV("poolfree", (int64_t) stats.nPoolFree);
+    ret.pushKV("memory", memory);
+
     return ret;
 }
 
@@ -1402,7 +1527,16 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
-            "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
+            "  \"minrelaytxfee\": xxxxx,      (numeric) Current minimum relay fee for transactions\n"
+            "  \"memory\": {                  (json object) Memory usage by component, adding up to usage\n"
+            "    \"transactions\": xxxxx,     (numeric) The transactions themselves\n"
+            "    \"entries\": xxxxx,          (numeric) Mempool entries, their index nodes and hash buckets\n"
+            "    \"links\": xxxxx,            (numeric) Parent and child lists too long to be stored in the entries\n"
+            "    \"clusters\": xxxxx,         (numeric) Cluster linearizations\n"
+            "    \"spends\": xxxxx,           (numeric) Index of the spent outputs\n"
+            "    \"other\": xxxxx,            (numeric) Prioritisation deltas and the witness hash list\n"
+            "    \"poolfree\": xxxxx          (numeric) Memory of freed entries kept for reuse by future ones\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -1601,6 +1735,371 @@ UniValue getchaintxstats(const JSONRPCRequest& request)
     return ret;
 }
 
+static void IndexInfoToJSON(UniValue& ret, const std::string& name, const BaseIndex* index)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("enabled", index != nullptr);
+    if (index) {
+        obj.pushKV("synced", index->IsSynced());
+        obj.pushKV("best_block_height", index->GetBestHeight());
+    }
+    ret.pushKV(name, obj);
+}
+
+UniValue getindexinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getindexinfo\n"
+            "\nReturns the status of the optional indexes.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                     (json object) One entry per index, e.g. \"txindex\"\n"
+            "    \"enabled\": true|false,       (boolean) Whether the index is kept up to date\n"
+            "    \"synced\": true|false,        (boolean) Whether the index has caught up with the active chain\n"
+            "    \"best_block_height\": xxxxx,  (numeric) The height of the last block in the index, -1 if none\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    IndexInfoToJSON(ret, "txindex", GetTxIndex().get());
+    IndexInfoToJSON(ret, "blockfilterindex", GetBlockFilterIndex(BlockFilterType::BASIC).get());
+    IndexInfoToJSON(ret, "addressindex", GetAddressIndex().get());
+    return ret;
+}
+
+UniValue setindex(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 2)
+        throw std::runtime_error(
+            "setindex \"name\" enable\n"
+            "\nSwitches an optional index on or off while the node runs.\n"
+            "An index that is switched on catches up with the blocks it is missing in the\n"
+            "background, starting from where it was last switched off. Use getindexinfo to\n"
+            "follow its progress. This does not change the setting used at the next start.\n"
+            "\nArguments:\n"
+            "1. \"name\"    (string, required) The index, \"txindex\", \"blockfilterindex\" (basic filters) or \"addressindex\"\n"
+            "2. enable    (boolean, required) Whether to switch the index on or off\n"
+            "\nExamples:\n"
+            + HelpExampleCli("setindex", "\"txindex\" true")
+            + HelpExampleRpc("setindex", "\"txindex\", false")
+        );
+
+    const std::string name = request.params[0].get_str();
+    const bool enable = request.params[1].get_bool();
+    if (name != "txindex" && name != "blockfilterindex" && name != "addressindex") {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown index: " + name);
+    }
+
+    if (enable) {
+        // All indexes read old blocks from disk to catch up
+        if (fPruneMode) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Index " + name + " cannot be built in prune mode.");
+        }
+        bool started;
+        if (name == "txindex") {
+            started = StartTxIndex(gArgs.GetArg("-txindexcache", DEFAULT_TXINDEX_CACHE) << 20);
+        } else if (name == "addressindex") {
+            started = StartAddressIndex(gArgs.GetArg("-addressindexcache", DEFAULT_ADDRESSINDEX_CACHE) << 20);
+        } else {
+            started = StartBlockFilterIndex(BlockFilterType::BASIC,
+                                            gArgs.GetArg("-blockfilterindexcache", DEFAULT_BLOCKFILTERINDEX_CACHE) << 20);
+        }
+        if (!started) {
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to start index " + name + ", see debug.log for details");
+        }
+    } else {
+        std::shared_ptr<BaseIndex> stopped;
+        if (name == "txindex") {
+            stopped = StopTxIndex();
+        } else if (name == "addressindex") {
+            stopped = StopAddressIndex();
+        } else {
+            stopped = StopBlockFilterIndex(BlockFilterType::BASIC);
+        }
+        // A block notification may still be running on the index; let it
+        // finish before the index goes away
+        SyncWithValidationInterfaceQueue();
+    }
+
+    return NullUniValue;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block.\n"
+            "The filter index has to be enabled with -blockfilterindex or setindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"   (string, required) The hash of the block\n"
+            "2. \"filtertype\"  (string, optional, default=\"basic\") The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+    }
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    std::shared_ptr<BlockFilterIndex> index = GetBlockFilterIndex(filtertype);
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
+bool AddressOrScriptToScript(const std::string& str, CScript& script)
+{
+    CTxDestination dest = DecodeDestination(str);
+    if (IsValidDestination(dest)) {
+        script = GetScriptForDestination(dest);
+        return true;
+    }
+    if (!str.empty() && IsHex(str)) {
+        std::vector<unsigned char> data(ParseHex(str));
+        script = CScript(data.begin(), data.end());
+        return true;
+    }
+    return false;
+}
+
+static void AddressEntryToJSON(const AddressIndexEntry& entry, JSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.KeyValue("txid", entry.txid.GetHex());
+    if (entry.height >= 0) {
+        writer.KeyValue("height", entry.height);
+    } else {
+        writer.KeyValue("mempool", true);
+    }
+    if (entry.spending) {
+        writer.KeyValue("vin", (int64_t)entry.index);
+        writer.Key("prevout");
+        writer.BeginObject();
+        writer.KeyValue("txid", entry.prevout.hash.GetHex());
+        writer.KeyValue("vout", (int64_t)entry.prevout.n);
+        writer.EndObject();
+    } else {
+        writer.KeyValue("vout", (int64_t)entry.index);
+    }
+    writer.KeyValue("amount", ValueFromAmount(entry.amount));
+    writer.EndObject();
+}
+
+void addressHistoryToJSON(const AddressIndex& index, const uint256& script_hash, int start_height, int stop_height,
+                          bool include_mempool, JSONWriter& writer)
+{
+    // The list is only opened with its first entry, so that the call can
+    // still fail as a whole while nothing was written
+    bool opened = false;
+    bool found = index.FindHistory(script_hash, start_height, stop_height, [&](const AddressIndexEntry& entry) {
+        if (!opened) {
+            writer.BeginArray();
+            opened = true;
+        }
+        AddressEntryToJSON(entry, writer);
+        return true;
+    });
+    if (!found) {
+        // Past the first entry, the caller cuts the reply short
+        throw std::runtime_error("Unable to read the address index, see debug.log for details");
+    }
+    if (!opened) {
+        writer.BeginArray();
+    }
+    if (include_mempool) {
+        for (const AddressIndexEntry& entry : index.FindMempoolHistory(script_hash)) {
+            AddressEntryToJSON(entry, writer);
+        }
+    }
+    writer.EndArray();
+}
+
+void addressUnspentToJSON(const AddressIndex& index, const uint256& script_hash, bool include_mempool, JSONWriter& writer)
+{
+    std::vector<AddressIndexEntry> outputs;
+    if (!index.FindUnspent(script_hash, include_mempool, outputs)) {
+        throw std::runtime_error("Unable to read the address index, see debug.log for details");
+    }
+    writer.BeginArray();
+    for (const AddressIndexEntry& entry : outputs) {
+        AddressEntryToJSON(entry, writer);
+    }
+    writer.EndArray();
+}
+
+/** The address index, waiting for it to catch up with the notifications in the queue */
+static std::shared_ptr<AddressIndex> GetSyncedAddressIndex()
+{
+    std::shared_ptr<AddressIndex> index = GetAddressIndex();
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The address index is not enabled, see -addressindex and setindex");
+    }
+    if (!index->BlockUntilSyncedToCurrentChain()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The address index is still being built, see getindexinfo");
+    }
+    return index;
+}
+
+static uint256 ParseAddressScriptHash(const UniValue& param)
+{
+    CScript script;
+    if (!AddressOrScriptToScript(param.get_str(), script)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or script: " + param.get_str());
+    }
+    return AddressScriptHash(script);
+}
+
+static std::string AddressEntryDescriptionString()
+{
+    return "  {\n"
+           "    \"txid\" : \"hash\",          (string) The transaction id\n"
+           "    \"height\" : n,             (numeric) The height of the block holding the transaction\n"
+           "    \"mempool\" : true,         (boolean) Instead of height, for a transaction in the mempool\n"
+           "    \"vout\" : n,               (numeric) The output paying to the address, for a payment\n"
+           "    \"vin\" : n,                (numeric) The input spending from the address, for a spend\n"
+           "    \"prevout\" : {             (json object) The output spent, for a spend\n"
+           "      \"txid\" : \"hash\",\n"
+           "      \"vout\" : n\n"
+           "    },\n"
+           "    \"amount\" : x.xxx          (numeric) The amount paid or spent in " + CURRENCY_UNIT + "\n"
+           "  }, ...\n";
+}
+
+static void getaddresshistory_stream(const JSONRPCRequest& request, JSONWriter& writer)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
+        throw std::runtime_error(
+            "getaddresshistory \"address\" ( start_height stop_height )\n"
+            "\nReturns the transactions paying to and spending from an address, in chain order.\n"
+            "The address index has to be enabled with -addressindex or setindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"      (string, required) The address, or a script in hex\n"
+            "2. start_height   (numeric, optional, default=0) The first block height to return transactions of\n"
+            "3. stop_height    (numeric, optional) The last block height to return transactions of. Without it,\n"
+            "                  transactions up to the tip are returned, followed by those in the mempool\n"
+            "\nResult:\n"
+            "[\n"
+            + AddressEntryDescriptionString() +
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresshistory", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
+            + HelpExampleCli("getaddresshistory", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\" 500000 510000")
+            + HelpExampleRpc("getaddresshistory", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\", 500000")
+        );
+
+    const uint256 script_hash = ParseAddressScriptHash(request.params[0]);
+    const int start_height = request.params[1].isNull() ? 0 : request.params[1].get_int();
+    const bool include_mempool = request.params[2].isNull();
+    const int stop_height = include_mempool ? std::numeric_limits<int>::max() : request.params[2].get_int();
+    if (start_height < 0 || stop_height < start_height) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid height range");
+    }
+
+    std::shared_ptr<AddressIndex> index = GetSyncedAddressIndex();
+    addressHistoryToJSON(*index, script_hash, start_height, stop_height, include_mempool, writer);
+}
+
+UniValue getaddresshistory(const JSONRPCRequest& request)
+{
+    JSONValueWriter writer;
+    getaddresshistory_stream(request, writer);
+    return writer.GetValue();
+}
+
+static void getaddressutxos_stream(const JSONRPCRequest& request, JSONWriter& writer)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getaddressutxos \"address\" ( include_mempool )\n"
+            "\nReturns the unspent outputs paying to an address, in chain order.\n"
+            "The address index has to be enabled with -addressindex or setindex.\n"
+            "\nArguments:\n"
+            "1. \"address\"        (string, required) The address, or a script in hex\n"
+            "2. include_mempool  (boolean, optional, default=true) Whether to include the outputs created\n"
+            "                    and leave out those spent by transactions in the mempool\n"
+            "\nResult:\n"
+            "[\n"
+            + AddressEntryDescriptionString() +
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
+            + HelpExampleRpc("getaddressutxos", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\", false")
+        );
+
+    const uint256 script_hash = ParseAddressScriptHash(request.params[0]);
+    const bool include_mempool = request.params[1].isNull() || request.params[1].get_bool();
+
+    std::shared_ptr<AddressIndex> index = GetSyncedAddressIndex();
+    addressUnspentToJSON(*index, script_hash, include_mempool, writer);
+}
+
+UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    JSONValueWriter writer;
+    getaddressutxos_stream(request, writer);
+    return writer.GetValue();
+}
+
 UniValue savemempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0) {
@@ -1625,22 +2124,27 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"} },
+    { "blockchain",         "getaddresshistory",      &getaddresshistory,      {"address","start_height","stop_height"}, &getaddresshistory_stream },
+    { "blockchain",         "getaddressutxos",        &getaddressutxos,        {"address","include_mempool"}, &getaddressutxos_stream },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
     { "blockchain",         "getblockcount",          &getblockcount,          {} },
-    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
+    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"}, &getblock_stream },
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
+    { "blockchain",         "getindexinfo",           &getindexinfo,           {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"}, &getrawmempool_stream },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "setindex",               &setindex,               {"name","enable"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
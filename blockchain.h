@@ -5,9 +5,15 @@
 #ifndef SALEMCASH_RPC_BLOCKCHAIN_H
 #define SALEMCASH_RPC_BLOCKCHAIN_H
 
+#include <string>
+
+class AddressIndex;
 class CBlock;
 class CBlockIndex;
+class CScript;
+class JSONWriter;
 class UniValue;
+class uint256;
 
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
@@ -23,15 +29,32 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+/** Block description to JSON, a transaction at a time. Takes cs_main only
+ *  briefly, so that callers can write to a client without holding it. */
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, JSONWriter& writer);
 
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
 UniValue mempoolToJSON(bool fVerbose = false);
+/** Mempool to JSON, an entry at a time. Holds mempool.cs only while
+ *  describing a batch of entries, not while writing them. */
+void mempoolToJSON(bool fVerbose, JSONWriter& writer);
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/** Parse an address, or a script in hex, into the script it pays to */
+bool AddressOrScriptToScript(const std::string& str, CScript& script);
+/** Entries of a script in the address index from start_height to stop_height
+ *  to JSON, an entry at a time, followed by those in the mempool if
+ *  include_mempool is set. Throws if the index cannot be read, which leaves
+ *  the list unfinished when entries were written already. */
+void addressHistoryToJSON(const AddressIndex& index, const uint256& script_hash, int start_height, int stop_height,
+                          bool include_mempool, JSONWriter& writer);
+/** Unspent outputs paying to a script to JSON */
+void addressUnspentToJSON(const AddressIndex& index, const uint256& script_hash, bool include_mempool, JSONWriter& writer);
+
 #endif // SALEMCASH_RPC_BLOCKCHAIN_H
 
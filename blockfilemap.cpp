@@ -0,0 +1,102 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+
+#include <util.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const CMappedBlockFile> CMappedBlockFile::Open(const fs::path& path)
+{
+#ifdef WIN32
+    // Windows does not allow deleting a file that is mapped, which would get
+    // in the way of pruning; keep using regular reads there.
+    return nullptr;
+#else
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t nSize = st.st_size;
+    void* p = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    int nErr = errno;
+    // The mapping holds its own reference to the file.
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("Unable to map %s: %s\n", path.string(), strerror(nErr));
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedBlockFile>(new CMappedBlockFile(static_cast<const unsigned char*>(p), nSize));
+#endif
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pbegin), nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedBlockFile> CBlockFileMapCache::Get(int nFile, size_t nMinSize)
+{
+    if (nMaxMappings == 0) {
+        return nullptr;
+    }
+    LOCK(cs);
+    auto it = mapFiles.find(nFile);
+    if (it != mapFiles.end()) {
+        if (it->second->second->size() >= nMinSize) {
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->second;
+        }
+        // Blocks were appended since the file was mapped.
+        lru.erase(it->second);
+        mapFiles.erase(it);
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapping = CMappedBlockFile::Open(path(nFile));
+    if (!mapping) {
+        return nullptr;
+    }
+    lru.emplace_front(nFile, mapping);
+    mapFiles.emplace(nFile, lru.begin());
+    while (lru.size() > nMaxMappings) {
+        mapFiles.erase(lru.back().first);
+        lru.pop_back();
+    }
+    if (mapping->size() < nMinSize) {
+        return nullptr;
+    }
+    return mapping;
+}
+
+void CBlockFileMapCache::Invalidate(int nFile)
+{
+    LOCK(cs);
+    auto it = mapFiles.find(nFile);
+    if (it != mapFiles.end()) {
+        lru.erase(it->second);
+        mapFiles.erase(it);
+    }
+}
+
+void CBlockFileMapCache::Clear()
+{
+    LOCK(cs);
+    mapFiles.clear();
+    lru.clear();
+}
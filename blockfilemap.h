@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_BLOCKFILEMAP_H
+#define SALEMCASH_BLOCKFILEMAP_H
+
+#include <fs.h>
+#include <sync.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <stddef.h>
+#include <unordered_map>
+
+/** Number of block files kept mapped at once. Each mapping reserves address
+ *  space for a whole blk?????.dat file (up to MAX_BLOCKFILE_SIZE), so mapping
+ *  is disabled on 32-bit builds where that space is scarce. */
+static const unsigned int DEFAULT_BLOCKFILE_MAPPINGS = sizeof(void*) >= 8 ? 64 : 0;
+
+/** A read-only memory mapping of a whole block file. The mapping stays valid
+ *  for as long as a reference to it is held, even after it has been evicted
+ *  from CBlockFileMapCache or the file has been pruned. */
+class CMappedBlockFile
+{
+public:
+    /** Map the file at path. Returns nullptr if it cannot be mapped, in which
+     *  case callers should fall back to regular file reads. */
+    static std::shared_ptr<const CMappedBlockFile> Open(const fs::path& path);
+
+    ~CMappedBlockFile();
+    CMappedBlockFile(const CMappedBlockFile&) = delete;
+    CMappedBlockFile& operator=(const CMappedBlockFile&) = delete;
+
+    const unsigned char* data() const { return pbegin; }
+    size_t size() const { return nSize; }
+
+private:
+    CMappedBlockFile(const unsigned char* pbeginIn, size_t nSizeIn) : pbegin(pbeginIn), nSize(nSizeIn) {}
+
+    const unsigned char* pbegin;
+    size_t nSize;
+};
+
+/** Bounded, least-recently-used cache of block file mappings. */
+class CBlockFileMapCache
+{
+public:
+    typedef std::function<fs::path(int nFile)> PathFunction;
+
+    CBlockFileMapCache(PathFunction pathIn, size_t nMaxMappingsIn) : path(std::move(pathIn)), nMaxMappings(nMaxMappingsIn) {}
+
+    /** Get a mapping of block file nFile that is at least nMinSize bytes
+     *  long. Files grow as blocks are appended, so a cached mapping that is
+     *  too short is replaced by a fresh one. Returns nullptr if the file
+     *  cannot be mapped or is shorter than nMinSize. */
+    std::shared_ptr<const CMappedBlockFile> Get(int nFile, size_t nMinSize);
+
+    /** Drop the mapping of nFile, e.g. because the file is being deleted. */
+    void Invalidate(int nFile);
+
+    /** Drop all mappings. */
+    void Clear();
+
+private:
+    typedef std::list<std::pair<int, std::shared_ptr<const CMappedBlockFile>>> MappingList;
+
+    const PathFunction path;
+    const size_t nMaxMappings;
+
+    CCriticalSection cs;
+    //! Most recently used mapping first
+    MappingList lru;
+    std::unordered_map<int, MappingList::iterator> mapFiles;
+};
+
+#endif // SALEMCASH_BLOCKFILEMAP_H
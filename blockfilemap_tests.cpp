@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+#include <util.h>
+
+#include <test/test_salemcash.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, BasicTestingSetup)
+
+static void AppendToFile(const fs::path& path, const std::vector<unsigned char>& data)
+{
+    FILE* file = fsbridge::fopen(path, "ab");
+    BOOST_REQUIRE(file != nullptr);
+    BOOST_REQUIRE_EQUAL(fwrite(data.data(), 1, data.size(), file), data.size());
+    fclose(file);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_cache)
+{
+    const fs::path dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    auto path = [&dir](int nFile) { return dir / strprintf("blk%05u.dat", nFile); };
+    CBlockFileMapCache cache(path, 2);
+
+    // Missing and empty files cannot be mapped
+    BOOST_CHECK(!cache.Get(0, 0));
+    AppendToFile(path(0), {});
+    BOOST_CHECK(!cache.Get(0, 0));
+
+    std::vector<unsigned char> data(1000);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i * 7;
+    }
+    AppendToFile(path(0), data);
+    auto mapping = cache.Get(0, data.size());
+    BOOST_REQUIRE(mapping);
+    BOOST_CHECK_EQUAL(mapping->size(), data.size());
+    BOOST_CHECK(std::equal(data.begin(), data.end(), mapping->data()));
+    // Cached mappings are shared
+    BOOST_CHECK(cache.Get(0, 10) == mapping);
+    // Asking for more than the file holds fails
+    BOOST_CHECK(!cache.Get(0, data.size() + 1));
+
+    // After appending, a request for the new data replaces the mapping
+    AppendToFile(path(0), data);
+    auto grown = cache.Get(0, 2 * data.size());
+    BOOST_REQUIRE(grown);
+    BOOST_CHECK(grown != mapping);
+    BOOST_CHECK_EQUAL(grown->size(), 2 * data.size());
+    BOOST_CHECK(std::equal(data.begin(), data.end(), grown->data() + data.size()));
+    // The old mapping stays readable while referenced
+    BOOST_CHECK(std::equal(data.begin(), data.end(), mapping->data()));
+    mapping.reset();
+
+    // Only the two most recently used files stay mapped
+    AppendToFile(path(1), data);
+    AppendToFile(path(2), data);
+    auto map1 = cache.Get(1, 1);
+    BOOST_CHECK(cache.Get(0, 1) == grown);
+    auto map2 = cache.Get(2, 1);
+    BOOST_REQUIRE(map1 && map2);
+    BOOST_CHECK(cache.Get(0, 1) == grown);
+    BOOST_CHECK(cache.Get(1, 1) != map1);
+
+    // Invalidated files are mapped afresh, and mappings outlive deletion
+    cache.Invalidate(0);
+    BOOST_CHECK(cache.Get(0, 1) != grown);
+    cache.Invalidate(2);
+    fs::remove(path(2));
+    BOOST_CHECK(!cache.Get(2, 1));
+    BOOST_CHECK(std::equal(data.begin(), data.end(), map2->data()));
+
+    cache.Clear();
+    fs::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,114 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <chainparams.h>
+#include <index/blockfilterindex.h>
+#include <script/standard.h>
+#include <test/test_salemcash.h>
+#include <undo.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_index_tests, TestChain100Setup)
+
+static bool CheckFilterLookups(BlockFilterIndex& filter_index, const CBlockIndex* block_index,
+                               uint256& last_header)
+{
+    BlockFilter expected_filter;
+    {
+        CBlock block;
+        CBlockUndo block_undo;
+        if (!ReadBlockFromDisk(block, block_index, Params().GetConsensus()) ||
+            (block_index->nHeight > 0 && !UndoReadFromDisk(block_undo, block_index))) {
+            BOOST_ERROR("Error reading block " << block_index->nHeight);
+            return false;
+        }
+        expected_filter = BlockFilter(filter_index.GetFilterType(), block, block_undo);
+    }
+
+    BlockFilter filter;
+    uint256 filter_header;
+    BOOST_CHECK(filter_index.LookupFilter(block_index, filter));
+    BOOST_CHECK(filter_index.LookupFilterHeader(block_index, filter_header));
+
+    BOOST_CHECK(filter.GetFilterType() == expected_filter.GetFilterType());
+    BOOST_CHECK(filter.GetBlockHash() == expected_filter.GetBlockHash());
+    BOOST_CHECK(filter.GetEncodedFilter() == expected_filter.GetEncodedFilter());
+    BOOST_CHECK(filter_header == expected_filter.ComputeHeader(last_header));
+
+    last_header = filter_header;
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_index_initial_sync)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC, 1 << 20, true);
+
+    uint256 last_header;
+
+    // Filter should not be found in the index before it is started.
+    {
+        LOCK(cs_main);
+
+        BlockFilter filter;
+        uint256 filter_header;
+        std::vector<uint256> filter_headers;
+        for (const CBlockIndex* block_index = chainActive.Genesis();
+             block_index != nullptr;
+             block_index = chainActive.Next(block_index)) {
+            BOOST_CHECK(!filter_index.LookupFilter(block_index, filter));
+            BOOST_CHECK(!filter_index.LookupFilterHeader(block_index, filter_header));
+        }
+        BOOST_CHECK(!filter_index.LookupFilterHeaders(0, chainActive.Tip(), filter_headers));
+    }
+
+    // BlockUntilSyncedToCurrentChain should return false before index is started.
+    BOOST_CHECK(!filter_index.BlockUntilSyncedToCurrentChain());
+
+    BOOST_REQUIRE(filter_index.Start());
+
+    // Allow filter index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!filter_index.IsSynced()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // Check that filter index has all blocks that were in the chain before it started.
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Genesis();
+             block_index != nullptr;
+             block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+
+        std::vector<uint256> filter_headers;
+        BOOST_CHECK(filter_index.LookupFilterHeaders(1, chainActive.Tip(), filter_headers));
+        BOOST_CHECK_EQUAL(filter_headers.size(), (size_t)chainActive.Height());
+        BOOST_CHECK(filter_headers.back() == last_header);
+    }
+
+    // Check that new blocks get indexed.
+    CScript cashbase_script_pub_key = GetScriptForDestination(cashbaseKey.GetPubKey().GetID());
+    for (int i = 0; i < 10; i++) {
+        std::vector<CMutableTransaction> no_txns;
+        const CBlock& block = CreateAndProcessBlock(no_txns, cashbase_script_pub_key);
+
+        BOOST_CHECK(filter_index.BlockUntilSyncedToCurrentChain());
+
+        LOCK(cs_main);
+        const CBlockIndex* block_index = LookupBlockIndex(block.GetHash());
+        BOOST_REQUIRE(block_index);
+        CheckFilterLookups(filter_index, block_index, last_header);
+    }
+
+    filter_index.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
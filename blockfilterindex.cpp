@@ -0,0 +1,225 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/blockfilterindex.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+#include <mutex>
+
+/* The index database stores a single record per block, keyed by its hash:
+ *
+ * - The encoded filter, its hash and the filter header of the block
+ *
+ * Keying by hash keeps the records of blocks that were disconnected valid,
+ * so the filters and headers of stale blocks can still be served.
+ */
+constexpr char DB_FILTER = 'f';
+
+//! Headers kept in m_recent_headers
+constexpr size_t MAX_RECENT_HEADERS = 1024;
+
+namespace {
+
+struct DBVal {
+    uint256 hash;
+    uint256 header;
+    std::vector<unsigned char> encoded_filter;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(header);
+        READWRITE(encoded_filter);
+    }
+};
+
+} // namespace
+
+static std::shared_ptr<BlockFilterIndex> g_basic_filter_index;
+//! Serializes starting and stopping the filter indexes
+static std::mutex g_filter_index_mutex;
+
+BlockFilterIndex::BlockFilterIndex(BlockFilterType filter_type,
+                                   size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_filter_type(filter_type)
+{
+    const std::string& filter_name = BlockFilterTypeName(filter_type);
+    if (filter_name.empty()) throw std::invalid_argument("unknown filter_type");
+
+    m_name = filter_name + " block filter index";
+    m_db = MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "blockfilter" / filter_name,
+                                     n_cache_size, f_memory, f_wipe);
+}
+
+BlockFilterIndex::~BlockFilterIndex()
+{
+    // Stop the sync thread before the database it writes to goes away
+    Interrupt();
+    Stop();
+}
+
+bool BlockFilterIndex::BuildFilter(const CBlock& block, const CBlockIndex* pindex, BlockFilter& filter) const
+{
+    CBlockUndo block_undo;
+    if (pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    filter = BlockFilter(m_filter_type, block, block_undo);
+    return true;
+}
+
+bool BlockFilterIndex::WriteFilter(CDBBatch& batch, const BlockFilter& filter, const CBlockIndex* pindex)
+{
+    uint256 prev_header;
+    if (pindex->pprev) {
+        const uint256& prev_hash = pindex->pprev->GetBlockHash();
+        auto it = m_recent_headers.rbegin();
+        while (it != m_recent_headers.rend() && it->first != prev_hash) {
+            ++it;
+        }
+        if (it != m_recent_headers.rend()) {
+            prev_header = it->second;
+        } else if (!LookupFilterHeader(pindex->pprev, prev_header)) {
+            return error("%s: previous filter header of block %s not found", __func__,
+                         pindex->GetBlockHash().ToString());
+        }
+    }
+
+    DBVal value;
+    value.hash = filter.GetHash();
+    value.header = filter.ComputeHeader(prev_header);
+    value.encoded_filter = filter.GetEncodedFilter();
+    batch.Write(std::make_pair(DB_FILTER, pindex->GetBlockHash()), value);
+
+    m_recent_headers.emplace_back(pindex->GetBlockHash(), value.header);
+    if (m_recent_headers.size() > MAX_RECENT_HEADERS) {
+        m_recent_headers.pop_front();
+    }
+    return true;
+}
+
+bool BlockFilterIndex::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    BlockFilter filter;
+    if (!BuildFilter(block, pindex, filter)) {
+        return false;
+    }
+    return WriteFilter(batch, filter, pindex);
+}
+
+BaseIndex::BlockWriter BlockFilterIndex::PrepareBlock(const CBlockIndex* pindex)
+{
+    // Reading the block and its undo data and building the filter do not
+    // depend on the blocks before, only chaining the header does
+    CBlock block;
+    auto filter = std::make_shared<BlockFilter>();
+    if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()) ||
+        !BuildFilter(block, pindex, *filter)) {
+        return nullptr;
+    }
+    return [this, filter, pindex](CDBBatch& batch) {
+        return WriteFilter(batch, *filter, pindex);
+    };
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
+{
+    DBVal entry;
+    if (!m_db->Read(std::make_pair(DB_FILTER, block_index->GetBlockHash()), entry)) {
+        return false;
+    }
+
+    try {
+        filter_out = BlockFilter(m_filter_type, block_index->GetBlockHash(), std::move(entry.encoded_filter));
+    } catch (const std::exception& e) {
+        return error("%s: Failed to decode filter of block %s: %s", __func__,
+                     block_index->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
+{
+    DBVal entry;
+    if (!m_db->Read(std::make_pair(DB_FILTER, block_index->GetBlockHash()), entry)) {
+        return false;
+    }
+
+    header_out = entry.header;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHeaders(int start_height, const CBlockIndex* stop_index,
+                                           std::vector<uint256>& headers_out) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight ||
+        stop_index->nHeight - start_height >= MAX_FILTER_HEADERS_RESULTS) {
+        return false;
+    }
+
+    headers_out.resize(stop_index->nHeight - start_height + 1);
+    const CBlockIndex* pindex = stop_index;
+    for (auto it = headers_out.rbegin(); it != headers_out.rend(); ++it) {
+        if (!LookupFilterHeader(pindex, *it)) {
+            return false;
+        }
+        pindex = pindex->pprev;
+    }
+    return true;
+}
+
+static std::shared_ptr<BlockFilterIndex>* FilterIndexSlot(BlockFilterType filter_type)
+{
+    switch (filter_type) {
+    case BlockFilterType::BASIC: return &g_basic_filter_index;
+    case BlockFilterType::INVALID: return nullptr;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<BlockFilterIndex> GetBlockFilterIndex(BlockFilterType filter_type)
+{
+    std::shared_ptr<BlockFilterIndex>* slot = FilterIndexSlot(filter_type);
+    return slot ? std::atomic_load(slot) : nullptr;
+}
+
+bool StartBlockFilterIndex(BlockFilterType filter_type, size_t n_cache_size)
+{
+    std::shared_ptr<BlockFilterIndex>* slot = FilterIndexSlot(filter_type);
+    if (!slot) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(g_filter_index_mutex);
+    if (std::atomic_load(slot)) {
+        return true;
+    }
+    auto filter_index = std::make_shared<BlockFilterIndex>(filter_type, n_cache_size);
+    if (!filter_index->Start()) {
+        return false;
+    }
+    std::atomic_store(slot, filter_index);
+    return true;
+}
+
+std::shared_ptr<BlockFilterIndex> StopBlockFilterIndex(BlockFilterType filter_type)
+{
+    std::shared_ptr<BlockFilterIndex>* slot = FilterIndexSlot(filter_type);
+    if (!slot) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_filter_index_mutex);
+    std::shared_ptr<BlockFilterIndex> filter_index = std::atomic_exchange(slot, std::shared_ptr<BlockFilterIndex>());
+    if (filter_index) {
+        filter_index->Interrupt();
+        filter_index->Stop();
+    }
+    return filter_index;
+}
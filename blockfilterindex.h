@@ -0,0 +1,91 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_INDEX_BLOCKFILTERINDEX_H
+#define SALEMCASH_INDEX_BLOCKFILTERINDEX_H
+
+#include <blockfilter.h>
+#include <chain.h>
+#include <index/base.h>
+
+#include <deque>
+#include <memory>
+
+//! -blockfilterindexcache default (MiB)
+static const int64_t DEFAULT_BLOCKFILTERINDEX_CACHE = 16;
+
+/** Most filter headers returned by one LookupFilterHeaders call */
+static const int MAX_FILTER_HEADERS_RESULTS = 2000;
+
+/**
+ * BlockFilterIndex is used to store and retrieve block filters, hashes, and
+ * headers for a range of blocks by height. An index is constructed for each
+ * supported filter type with its own database (indexes/blockfilter/<type>).
+ *
+ * Entries are keyed by block hash, so the entries of blocks that were
+ * disconnected stay valid and a reorg needs no rewriting.
+ */
+class BlockFilterIndex final : public BaseIndex
+{
+private:
+    BlockFilterType m_filter_type;
+    std::string m_name;
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    //! Block hashes and filter headers of the last blocks written, newest
+    //! last. The headers of the next blocks are chained onto these while the
+    //! batch holding them may not be written to the database yet. Only used
+    //! by the thread writing blocks.
+    std::deque<std::pair<uint256, uint256>> m_recent_headers;
+
+    /** Compute the header of filter, which belongs to pindex, and add both to batch */
+    bool WriteFilter(CDBBatch& batch, const BlockFilter& filter, const CBlockIndex* pindex);
+
+    /** Read the undo data of block from disk and build the filter of the block */
+    bool BuildFilter(const CBlock& block, const CBlockIndex* pindex, BlockFilter& filter) const;
+
+protected:
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+
+    BlockWriter PrepareBlock(const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return m_name.c_str(); }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit BlockFilterIndex(BlockFilterType filter_type,
+                              size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    ~BlockFilterIndex() override;
+
+    BlockFilterType GetFilterType() const { return m_filter_type; }
+
+    /** Get a single filter by block. */
+    bool LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const;
+
+    /** Get a single filter header by block. */
+    bool LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const;
+
+    /** Get filter headers for the blocks from start_height up to stop_index, at
+     *  most MAX_FILTER_HEADERS_RESULTS of them. */
+    bool LookupFilterHeaders(int start_height, const CBlockIndex* stop_index,
+                             std::vector<uint256>& headers_out) const;
+};
+
+/// The filter index for the given type, or null if it is not enabled. As the
+/// index can be switched on and off while the node runs, callers hold on to
+/// the pointer returned here for as long as they use the index.
+std::shared_ptr<BlockFilterIndex> GetBlockFilterIndex(BlockFilterType filter_type);
+
+/// Open the filter index of the given type and start building it in the
+/// background from where it left off. Does nothing if it is running already.
+bool StartBlockFilterIndex(BlockFilterType filter_type, size_t n_cache_size);
+
+/// Stop updating the filter index of the given type and drop it as the global
+/// one. As with StopTxIndex, the stopped index is returned.
+std::shared_ptr<BlockFilterIndex> StopBlockFilterIndex(BlockFilterType filter_type);
+
+#endif // SALEMCASH_INDEX_BLOCKFILTERINDEX_H
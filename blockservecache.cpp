@@ -0,0 +1,79 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockservecache.h>
+
+void CBlockServeCache::SetMaxSize(size_t nMaxBytesIn)
+{
+    LOCK(cs);
+    nMaxBytes = nMaxBytesIn;
+    Trim();
+}
+
+CBlockServeCache::BlockData CBlockServeCache::Get(const uint256& hash, bool fWitness)
+{
+    LOCK(cs);
+    if (nMaxBytes == 0) {
+        return nullptr;
+    }
+    auto it = mapEntries.find(Key(hash, fWitness));
+    if (it == mapEntries.end()) {
+        nMisses++;
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    nHits++;
+    nBytesServed += it->second->second->size();
+    return it->second->second;
+}
+
+void CBlockServeCache::Put(const uint256& hash, bool fWitness, BlockData data)
+{
+    LOCK(cs);
+    if (!data || data->size() > nMaxBytes) {
+        return;
+    }
+    const Key key(hash, fWitness);
+    auto it = mapEntries.find(key);
+    if (it != mapEntries.end()) {
+        // Another peer asked for the same block in the meantime
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    nBytes += data->size();
+    entries.emplace_front(key, std::move(data));
+    mapEntries.emplace(key, entries.begin());
+    Trim();
+}
+
+CBlockServeCache::Stats CBlockServeCache::GetStats() const
+{
+    LOCK(cs);
+    Stats stats;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nBytesServed = nBytesServed;
+    stats.nEntries = entries.size();
+    stats.nBytes = nBytes;
+    stats.nMaxBytes = nMaxBytes;
+    return stats;
+}
+
+void CBlockServeCache::Clear()
+{
+    LOCK(cs);
+    mapEntries.clear();
+    entries.clear();
+    nBytes = 0;
+}
+
+void CBlockServeCache::Trim()
+{
+    AssertLockHeld(cs);
+    while (nBytes > nMaxBytes) {
+        nBytes -= entries.back().second->size();
+        mapEntries.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_BLOCKSERVECACHE_H
+#define SALEMCASH_BLOCKSERVECACHE_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/** Default for -blockservecache, the memory in MiB kept for serialized blocks served to peers */
+static const int64_t DEFAULT_BLOCK_SERVE_CACHE_SIZE = 32;
+
+/** Least-recently-used cache of blocks serialized the way they are sent in
+ *  "block" messages, with and without witness data. Lets a burst of peers
+ *  asking for the same recent blocks be served without reading and
+ *  serializing each block again. */
+class CBlockServeCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char>> BlockData;
+
+    struct Stats {
+        uint64_t nHits;
+        uint64_t nMisses;
+        //! Bytes sent to peers out of the cache
+        uint64_t nBytesServed;
+        size_t nEntries;
+        size_t nBytes;
+        size_t nMaxBytes;
+    };
+
+    explicit CBlockServeCache(size_t nMaxBytesIn = 0) : nMaxBytes(nMaxBytesIn) {}
+
+    /** Change the memory limit, evicting entries as needed. 0 disables the cache. */
+    void SetMaxSize(size_t nMaxBytesIn);
+
+    /** Look up a serialized block, counting a hit or a miss. */
+    BlockData Get(const uint256& hash, bool fWitness);
+
+    /** Add a serialized block as most recently used. Blocks that do not fit
+     *  in the cache by themselves are not kept. */
+    void Put(const uint256& hash, bool fWitness, BlockData data);
+
+    Stats GetStats() const;
+
+    void Clear();
+
+private:
+    typedef std::pair<uint256, bool> Key;
+    typedef std::list<std::pair<Key, BlockData>> EntryList;
+
+    //! Evict least recently used entries until within nMaxBytes
+    void Trim();
+
+    mutable CCriticalSection cs;
+    size_t nMaxBytes;
+    size_t nBytes = 0;
+    //! Most recently used entry first
+    EntryList entries;
+    std::map<Key, EntryList::iterator> mapEntries;
+    uint64_t nHits = 0;
+    uint64_t nMisses = 0;
+    uint64_t nBytesServed = 0;
+};
+
+#endif // SALEMCASH_BLOCKSERVECACHE_H
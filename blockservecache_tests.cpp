@@ -0,0 +1,78 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockservecache.h>
+
+#include <test/test_salemcash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockservecache_tests, BasicTestingSetup)
+
+static CBlockServeCache::BlockData MakeData(size_t nSize, unsigned char fill)
+{
+    return std::make_shared<const std::vector<unsigned char>>(nSize, fill);
+}
+
+BOOST_AUTO_TEST_CASE(blockservecache_lru)
+{
+    CBlockServeCache cache(300);
+    const uint256 a = InsecureRand256();
+    const uint256 b = InsecureRand256();
+    const uint256 c = InsecureRand256();
+
+    BOOST_CHECK(!cache.Get(a, true));
+    cache.Put(a, true, MakeData(100, 1));
+    cache.Put(a, false, MakeData(90, 2));
+    // Witness and non-witness forms are kept apart
+    BOOST_CHECK_EQUAL(cache.Get(a, true)->front(), 1);
+    BOOST_CHECK_EQUAL(cache.Get(a, false)->front(), 2);
+    BOOST_CHECK(!cache.Get(b, true));
+
+    CBlockServeCache::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nHits, 2U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 2U);
+    BOOST_CHECK_EQUAL(stats.nBytesServed, 190U);
+    BOOST_CHECK_EQUAL(stats.nEntries, 2U);
+    BOOST_CHECK_EQUAL(stats.nBytes, 190U);
+
+    // Touch (a, witness) so that (a, non-witness) is evicted first
+    BOOST_CHECK(cache.Get(a, true));
+    cache.Put(b, true, MakeData(100, 3));
+    cache.Put(c, true, MakeData(100, 4));
+    stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBytes, 300U);
+    BOOST_CHECK(cache.Get(a, true));
+    BOOST_CHECK(!cache.Get(a, false));
+    BOOST_CHECK(cache.Get(b, true));
+    BOOST_CHECK(cache.Get(c, true));
+
+    // Re-adding an entry does not count its size twice
+    cache.Put(c, true, MakeData(100, 5));
+    BOOST_CHECK_EQUAL(cache.GetStats().nBytes, 300U);
+    BOOST_CHECK_EQUAL(cache.Get(c, true)->front(), 4);
+
+    // Blocks bigger than the whole cache are not kept
+    cache.Put(b, false, MakeData(301, 6));
+    BOOST_CHECK(!cache.Get(b, false));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEntries, 3U);
+
+    // Shrinking evicts the least recently used entries
+    cache.SetMaxSize(150);
+    stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nEntries, 1U);
+    BOOST_CHECK(cache.Get(c, true));
+
+    // A disabled cache neither stores nor counts
+    cache.SetMaxSize(0);
+    const uint64_t nMisses = cache.GetStats().nMisses;
+    cache.Put(a, true, MakeData(1, 7));
+    BOOST_CHECK(!cache.Get(a, true));
+    stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nEntries, 0U);
+    BOOST_CHECK_EQUAL(stats.nBytes, 0U);
+    BOOST_CHECK_EQUAL(stats.nMisses, nMisses);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,7 @@ bool CCashViewBacked::HaveCash(const COutPoint &outpoint) const { return base->H
 uint256 CCashViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCashViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 void CCashViewBacked::SetBackend(CCashView &viewIn) { base = &viewIn; }
+CCashView* CCashViewBacked::GetBackend() const { return base; }
 bool CCashViewBacked::BatchWrite(CCashMap &mapCash, const uint256 &hashBlock) { return base->BatchWrite(mapCash, hashBlock); }
 CCashViewCursor *CCashViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCashViewBacked::EstimateSize() const { return base->EstimateSize(); }
@@ -111,6 +112,17 @@ bool CCashViewCache::SpendCash(const COutPoint &outpoint, Cash* moveout) {
     return true;
 }
 
+void CCashViewCache::WarmCash(const COutPoint &outpoint, Cash&& cash) {
+    CCashMap::iterator it;
+    bool inserted;
+    std::tie(it, inserted) = cacheCash.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(cash)));
+    if (!inserted) return;
+    if (it->second.cash.IsSpent()) {
+        it->second.flags = CCashCacheEntry::FRESH;
+    }
+    cachedCashUsage += it->second.cash.DynamicMemoryUsage();
+}
+
 static const Cash cashEmpty;
 
 const Cash& CCashViewCache::AccessCash(const COutPoint &outpoint) const {
@@ -132,6 +144,10 @@ bool CCashViewCache::HaveCashInCache(const COutPoint &outpoint) const {
     return (it != cacheCash.end() && !it->second.cash.IsSpent());
 }
 
+bool CCashViewCache::HaveCacheEntry(const COutPoint &outpoint) const {
+    return cacheCash.find(outpoint) != cacheCash.end();
+}
+
 uint256 CCashViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -8,6 +8,7 @@
 #include <primitives/transaction.h>
 #include <compressor.h>
 #include <core_memusage.h>
+#include <flathashmap.h>
 #include <hash.h>
 #include <memusage.h>
 #include <serialize.h>
@@ -16,8 +17,6 @@
 #include <assert.h>
 #include <stdint.h>
 
-#include <unordered_map>
-
 /**
  * A UTXO entry.
  *
@@ -118,7 +117,12 @@ struct CCashCacheEntry
     explicit CCashCacheEntry(Cash&& cash_) : cash(std::move(cash_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCashCacheEntry, SaltedOutpointHasher> CCashMap;
+/**
+ * The UTXO cache map. An open-addressing table with pooled entries holds
+ * noticeably more UTXOs per byte of -dbcache than std::unordered_map, which
+ * pays for a separate heap node plus a bucket pointer per entry.
+ */
+typedef flathashmap<COutPoint, CCashCacheEntry, SaltedOutpointHasher> CCashMap;
 
 /** Cursor for iterating over CashView state */
 class CCashViewCursor
@@ -189,6 +193,7 @@ public:
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     void SetBackend(CashView &viewIn);
+    CCashView* GetBackend() const;
     bool BatchWrite(CCashMap &mapCash, const uint256 &hashBlock) override;
     CCashViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
@@ -233,6 +238,12 @@ public:
      */
     bool HaveCashInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Check if the cache holds an entry for the given outpoint at all, spent
+     * or not, so that a lookup will not reach the backing CCashView.
+     */
+    bool HaveCacheEntry(const COutPoint &outpoint) const;
+
     /**
      * Return a reference to Cash in the cache, or a pruned one if not found. This is
      * more efficient than GetCash.
@@ -258,6 +269,14 @@ public:
      */
     bool SpendCash(const COutPoint &outpoint, Cash* moveto = nullptr);
 
+    /**
+     * Insert an unmodified entry that the caller read from the backing view
+     * itself, exactly as a lookup through this cache would have. Used to warm
+     * the cache with lookups done in parallel outside of it. Has no effect if
+     * the outpoint is already cached.
+     */
+    void WarmCash(const COutPoint &outpoint, Cash&& cash);
+
     /**
      * Push the modifications applied to this cache to its base.
      * Failure to call this method before destruction will cause the changes to be forgotten.
@@ -855,4 +855,24 @@ BOOST_AUTO_TEST_CASE(ccash_write)
                     CheckWriteCash(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccash_warm)
+{
+    CCashViewTest base;
+    CCashViewCacheTest cache(&base);
+    COutPoint outpoint(InsecureRand256(), 0);
+
+    // A warmed entry is clean and counted in the cache's memory usage.
+    Cash cash(CTxOut(VALUE1, CScript() << OP_TRUE), 1, false);
+    cache.WarmCash(outpoint, Cash(cash));
+    BOOST_CHECK(cache.HaveCashInCache(outpoint));
+    BOOST_CHECK_EQUAL(cache.map().find(outpoint)->second.flags, 0);
+    cache.SelfTest();
+
+    // Warming never overrides an entry that is already cached.
+    BOOST_CHECK(cache.SpendCash(outpoint));
+    cache.WarmCash(outpoint, Cash(cash));
+    BOOST_CHECK(!cache.HaveCashInCache(outpoint));
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,7 +4,9 @@
 
 #include <bench/bench.h>
 #include <cash.h>
+#include <crypto/common.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
 #include <vector>
@@ -85,3 +87,110 @@ static void CCashCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCashCaching, 170 * 1000);
+
+// The benchmarks below measure the raw cost of the CCashViewCache map at
+// chainstate-like sizes. Each one fills its own cache before timing starts;
+// the 50M variants need several GB of memory, use -filter to skip them.
+
+/** CCashView that drops whatever is flushed into it, like a database write without the I/O. */
+class CCashViewDiscard : public CCashView
+{
+public:
+    bool BatchWrite(CCashMap& mapCash, const uint256& hashBlock) override
+    {
+        for (CCashMap::iterator it = mapCash.begin(); it != mapCash.end(); it = mapCash.erase(it)) {}
+        return true;
+    }
+};
+
+static COutPoint BenchOutPoint(uint64_t i)
+{
+    uint256 txid;
+    WriteLE64(txid.begin(), i);
+    return COutPoint(txid, i & 3);
+}
+
+static void FillCache(CCashViewCache& cache, uint64_t first, uint64_t count)
+{
+    const CScript script = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0) << OP_EQUALVERIFY << OP_CHECKSIG;
+    for (uint64_t i = first; i < first + count; ++i) {
+        cache.AddCash(BenchOutPoint(i), Cash(CTxOut(CENT, script), 1, false), false);
+    }
+}
+
+static void CashCacheInsert(benchmark::State& state, uint64_t entries)
+{
+    CCashView base;
+    CCashViewCache cache(&base);
+    FillCache(cache, 0, entries);
+    uint64_t next = entries;
+    while (state.KeepRunning()) {
+        FillCache(cache, next++, 1);
+    }
+}
+
+static void CashCacheLookup(benchmark::State& state, uint64_t entries)
+{
+    CCashView base;
+    CCashViewCache cache(&base);
+    FillCache(cache, 0, entries);
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        const Cash& cash = cache.AccessCash(BenchOutPoint(rng.randrange(entries)));
+        assert(!cash.IsSpent());
+    }
+}
+
+static void CashCacheSpend(benchmark::State& state, uint64_t entries)
+{
+    CCashView base;
+    CCashViewCache cache(&base);
+    FillCache(cache, 0, entries);
+    FastRandomContext rng(true);
+    Cash spent;
+    while (state.KeepRunning()) {
+        // Spend a random entry and put it back, so the cache size stays constant.
+        const COutPoint outpoint = BenchOutPoint(rng.randrange(entries));
+        bool success = cache.SpendCash(outpoint, &spent);
+        assert(success);
+        cache.AddCash(outpoint, std::move(spent), false);
+    }
+}
+
+static void CashCacheFlush(benchmark::State& state, uint64_t entries)
+{
+    CCashViewDiscard base;
+    CCashViewCache cache(&base);
+    cache.SetBestBlock(uint256S("1"));
+    while (state.KeepRunning()) {
+        FillCache(cache, 0, entries);
+        bool success = cache.Flush();
+        assert(success);
+    }
+}
+
+static void CCashCachingInsert1M(benchmark::State& state) { CashCacheInsert(state, 1000000); }
+static void CCashCachingInsert10M(benchmark::State& state) { CashCacheInsert(state, 10000000); }
+static void CCashCachingInsert50M(benchmark::State& state) { CashCacheInsert(state, 50000000); }
+static void CCashCachingLookup1M(benchmark::State& state) { CashCacheLookup(state, 1000000); }
+static void CCashCachingLookup10M(benchmark::State& state) { CashCacheLookup(state, 10000000); }
+static void CCashCachingLookup50M(benchmark::State& state) { CashCacheLookup(state, 50000000); }
+static void CCashCachingSpend1M(benchmark::State& state) { CashCacheSpend(state, 1000000); }
+static void CCashCachingSpend10M(benchmark::State& state) { CashCacheSpend(state, 10000000); }
+static void CCashCachingSpend50M(benchmark::State& state) { CashCacheSpend(state, 50000000); }
+static void CCashCachingFlush1M(benchmark::State& state) { CashCacheFlush(state, 1000000); }
+static void CCashCachingFlush10M(benchmark::State& state) { CashCacheFlush(state, 10000000); }
+static void CCashCachingFlush50M(benchmark::State& state) { CashCacheFlush(state, 50000000); }
+
+BENCHMARK(CCashCachingInsert1M, 4 * 1000 * 1000);
+BENCHMARK(CCashCachingInsert10M, 3 * 1000 * 1000);
+BENCHMARK(CCashCachingInsert50M, 2 * 1000 * 1000);
+BENCHMARK(CCashCachingLookup1M, 5 * 1000 * 1000);
+BENCHMARK(CCashCachingLookup10M, 3 * 1000 * 1000);
+BENCHMARK(CCashCachingLookup50M, 2 * 1000 * 1000);
+BENCHMARK(CCashCachingSpend1M, 3 * 1000 * 1000);
+BENCHMARK(CCashCachingSpend10M, 2 * 1000 * 1000);
+BENCHMARK(CCashCachingSpend50M, 1 * 1000 * 1000);
+BENCHMARK(CCashCachingFlush1M, 4);
+BENCHMARK(CCashCachingFlush10M, 1);
+BENCHMARK(CCashCachingFlush50M, 1);
@@ -21,7 +21,8 @@ static const unsigned int QUEUE_BATCH_SIZE = 128;
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+// nThreads counts the master, so 1 means the master verifies everything itself.
+static void RunCheckQueuePrevectorJob(benchmark::State& state, int nThreads)
 {
     struct PrevectorJob {
         prevector<PREVECTOR_SIZE, uint8_t> p;
@@ -38,7 +39,7 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     };
     CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < nThreads - 1; ++x) {
        tg.create_thread([&]{queue.Thread();});
     }
     while (state.KeepRunning()) {
@@ -59,4 +60,26 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    RunCheckQueuePrevectorJob(state, std::max(MIN_CORES, GetNumCores()) + 1);
+}
+
+// Scaling curve of the work-stealing queue over the number of threads.
+static void CCheckQueueSpeedPrevectorJob_1(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 1); }
+static void CCheckQueueSpeedPrevectorJob_2(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 2); }
+static void CCheckQueueSpeedPrevectorJob_4(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 4); }
+static void CCheckQueueSpeedPrevectorJob_8(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 8); }
+static void CCheckQueueSpeedPrevectorJob_16(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 16); }
+static void CCheckQueueSpeedPrevectorJob_32(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 32); }
+static void CCheckQueueSpeedPrevectorJob_64(benchmark::State& state) { RunCheckQueuePrevectorJob(state, 64); }
+
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_1, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_2, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_4, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_8, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_16, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_32, 1400);
+BENCHMARK(CCheckQueueSpeedPrevectorJob_64, 1400);
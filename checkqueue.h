@@ -8,6 +8,8 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +27,30 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker owns a deque of pending checks. The master spreads added
+  * checks over the deques; a worker takes batches from the back of its own
+  * deque and, once that is empty, steals from the front of the others. There
+  * is no lock shared by all workers on the hot path: each deque has its own
+  * mutex and the bookkeeping is atomic. The shared mutex is only taken to go
+  * to sleep when no work is queued anywhere.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Maximum number of deques; slot 0 belongs to the master, further workers share slots.
+    enum : size_t { MAX_QUEUES = 65 };
+
+    //! A deque of checks, owned by one worker and stolen from by the others.
+    struct WorkQueue {
+        boost::mutex mutex;
+        std::deque<T> checks;
+        //! Number of checks in the deque, readable without taking the mutex.
+        std::atomic<size_t> nSize{0};
+    };
+
+    //! Mutex that idle threads sleep on
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +59,139 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! Per-worker deques of elements to be processed.
+    std::vector<WorkQueue> queues;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of worker threads (excluding the master) that have started.
+    std::atomic<size_t> nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! Next deque that Add() pushes to.
+    size_t nNextQueue;
+
+    //! The number of workers that are idle.
+    std::atomic<int> nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
+
+    //! Number of verifications queued in the deques, not yet taken by any worker.
+    std::atomic<size_t> nQueued;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<size_t> nTodo;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Number of deques in use: the master's plus one per worker.
+    size_t ActiveQueues() const
+    {
+        return std::min<size_t>(MAX_QUEUES, nWorkers.load() + 1);
+    }
+
+    /**
+     * Decide how many work units to take at once.
+     * Do not try to do everything at once, but aim for increasingly smaller batches as the
+     * queue drains, so all workers finish approximately simultaneously. Don't do batches
+     * smaller than 1 (duh), or larger than nBatchSize.
+     */
+    size_t BatchLimit() const
+    {
+        return std::max<size_t>(1, std::min<size_t>(nBatchSize, nQueued.load(std::memory_order_relaxed) / (2 * (nWorkers.load(std::memory_order_relaxed) + 1))));
+    }
+
+    //! Move up to nMax checks from one end of a deque into vChecks. Returns whether any were taken.
+    bool Take(WorkQueue& q, std::vector<T>& vChecks, size_t nMax, bool fSteal)
+    {
+        if (q.nSize.load(std::memory_order_relaxed) == 0) return false;
+        boost::unique_lock<boost::mutex> lock(q.mutex);
+        size_t nNow = std::min(nMax, q.checks.size());
+        if (fSteal) {
+            // Leave at least half of the victim's work to its owner.
+            nNow = std::min(nNow, (q.checks.size() + 1) / 2);
+        }
+        if (nNow == 0) return false;
+        vChecks.resize(nNow);
+        for (size_t i = 0; i < nNow; i++) {
+            // Keep the critical section short: swap checks out rather than copying them.
+            if (fSteal) {
+                vChecks[i].swap(q.checks.front());
+                q.checks.pop_front();
+            } else {
+                vChecks[i].swap(q.checks.back());
+                q.checks.pop_back();
+            }
+        }
+        q.nSize = q.checks.size();
+        nQueued -= nNow;
+        return true;
+    }
+
+    //! Fill vChecks from our own deque, or failing that, from another thread's.
+    bool Fetch(size_t nSlot, std::vector<T>& vChecks)
+    {
+        const size_t nMax = BatchLimit();
+        if (Take(queues[nSlot], vChecks, nMax, false)) return true;
+        const size_t nActive = ActiveQueues();
+        for (size_t i = 1; i < nActive; i++) {
+            if (Take(queues[(nSlot + i) % nActive], vChecks, nMax, true)) return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        // The master always uses slot 0; workers get their own slot, sharing once they run out.
+        const size_t nSlot = fMaster ? 0 : 1 + nWorkers++ % (MAX_QUEUES - 1);
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
+            if (!Fetch(nSlot, vChecks)) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
+                if (fMaster) {
+                    // Nothing left to take; wait for the workers to finish their batches.
+                    while (nTodo != 0 && nQueued == 0) {
+                        condMaster.wait(lock);
+                    }
+                    if (nTodo == 0) {
                         bool fRet = fAllOk;
                         // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
+                        fAllOk = true;
                         // return the current status
                         return fRet;
                     }
+                } else {
+                    // nIdle is raised before checking nQueued, so Add() either sees us idle and
+                    // notifies, or we see its work.
                     nIdle++;
-                    cond.wait(lock); // wait
+                    while (nQueued == 0) {
+                        condWorker.wait(lock); // wait
+                    }
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
+            // Check whether we need to do work at all
+            bool fOk = fAllOk.load(std::memory_order_relaxed);
             // execute work
             for (T& check : vChecks)
                 if (fOk)
                     fOk = check();
+            // Destroy the checks before reporting them done, so Wait() only returns once all are cleaned up.
+            const size_t nNow = vChecks.size();
             vChecks.clear();
+            if (!fOk)
+                fAllOk = false;
+            if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
@@ -128,7 +200,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : queues(MAX_QUEUES), nWorkers(0), nNextQueue(0), nIdle(0), fAllOk(true), nQueued(0), nTodo(0), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -145,16 +217,32 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // Spread the checks over the workers' deques in runs of at most nBatchSize. Only fall
+        // back to the master's own deque while no worker has started yet.
+        const size_t nActive = ActiveQueues();
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        for (size_t nPos = 0; nPos < vChecks.size(); nPos += nBatchSize) {
+            const size_t nEnd = std::min<size_t>(vChecks.size(), nPos + nBatchSize);
+            WorkQueue& q = queues[nActive > 1 ? 1 + nNextQueue++ % (nActive - 1) : 0];
+            {
+                boost::unique_lock<boost::mutex> lock(q.mutex);
+                for (size_t i = nPos; i < nEnd; i++) {
+                    q.checks.push_back(T());
+                    vChecks[i].swap(q.checks.back());
+                }
+                q.nSize = q.checks.size();
+            }
+            nQueued += nEnd - nPos;
+        }
+        if (nIdle > 0) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vChecks.size() == 1)
+                condWorker.notify_one();
+            else
+                condWorker.notify_all();
+        }
     }
 
     ~CCheckQueue()
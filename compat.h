@@ -54,6 +54,7 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
@@ -91,6 +92,17 @@ typedef int32_t ssize_t;
 #endif
 #endif
 
+// poll() has no limit on descriptor numbers and is used for the single socket
+// waits in netbase. WIN32's WSAPoll is broken, so select() is kept there.
+#ifndef WIN32
+#define USE_POLL
+#endif
+
+// epoll is available as an alternative socket event backend for CConnman.
+#if defined(__linux__)
+#define USE_EPOLL
+#endif
+
 #if HAVE_DECL_STRNLEN == 0
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
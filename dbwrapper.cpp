@@ -89,7 +89,7 @@ static leveldb::Options GetOptions(size_t nCacheSize)
 }
 
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
-    : m_name(fs::basename(path))
+    : m_name(fs::basename(path)), m_obfuscated(false)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
@@ -137,6 +137,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
         LogPrintf("Wrote new obfuscate key for %s: %s\n", path.string(), HexStr(obfuscate_key));
     }
 
+    m_obfuscated = obfuscate_key != std::vector<unsigned char>(OBFUSCATE_KEY_NUM_BYTES, '\000');
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
 }
 
@@ -200,6 +201,26 @@ std::vector<unsigned char> CDBWrapper::CreateObfuscateKey() const
 
 }
 
+const std::string* CDBWrapper::ReadValue(const leveldb::Slice& key, bool deobfuscate) const
+{
+    static thread_local std::string value;
+    if (value.capacity() > DBWRAPPER_MAX_VALUE_BUFFER_SIZE) {
+        // Do not hold on to the memory of a rare large value
+        std::string().swap(value);
+    }
+    leveldb::Status status = pdb->Get(readoptions, key, &value);
+    if (!status.ok()) {
+        if (status.IsNotFound())
+            return nullptr;
+        LogPrintf("LevelDB read failure: %s\n", status.ToString());
+        dbwrapper_private::HandleError(status);
+    }
+    if (m_obfuscated && deobfuscate) {
+        XorBytes(&value[0], value.size(), obfuscate_key);
+    }
+    return &value;
+}
+
 bool CDBWrapper::IsEmpty()
 {
     std::unique_ptr<CDBIterator> it(NewIterator());
@@ -229,4 +250,9 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w)
     return w.obfuscate_key;
 }
 
+bool IsObfuscated(const CDBWrapper &w)
+{
+    return w.m_obfuscated;
+}
+
 } // namespace dbwrapper_private
@@ -7,6 +7,7 @@
 
 #include <clientversion.h>
 #include <fs.h>
+#include <prevector.h>
 #include <serialize.h>
 #include <streams.h>
 #include <util.h>
@@ -18,6 +19,8 @@
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! Largest buffer a thread keeps around for reading values into
+static const size_t DBWRAPPER_MAX_VALUE_BUFFER_SIZE = 64 * 1024;
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -41,6 +44,44 @@ void HandleError(const leveldb::Status& status);
  */
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
+/** Whether the values in the database are obfuscated with a key other than zeros.
+ */
+bool IsObfuscated(const CDBWrapper &w);
+
+};
+
+/** Serializes a database key into a buffer on the stack, so that handing a
+ *  key to LevelDB does not allocate. Keys longer than
+ *  DBWRAPPER_PREALLOC_KEY_SIZE spill over to the heap. */
+class CDBKeyWriter
+{
+private:
+    prevector<DBWRAPPER_PREALLOC_KEY_SIZE, char> m_data;
+
+public:
+    template <typename K>
+    explicit CDBKeyWriter(const K& key)
+    {
+        ::Serialize(*this, key);
+    }
+
+    template <typename T>
+    CDBKeyWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+
+    void write(const char* pch, size_t size)
+    {
+        m_data.insert(m_data.end(), pch, pch + size);
+    }
+
+    int GetType() const { return SER_DISK; }
+    int GetVersion() const { return CLIENT_VERSION; }
+
+    /** The serialized key, valid for as long as this writer is */
+    leveldb::Slice GetSlice() const { return leveldb::Slice(m_data.data(), m_data.size()); }
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -52,7 +93,6 @@ private:
     const CDBWrapper &parent;
     leveldb::WriteBatch batch;
 
-    CDataStream ssKey;
     CDataStream ssValue;
 
     size_t size_estimate;
@@ -61,7 +101,7 @@ public:
     /**
      * @param[in] _parent   CDBWrapper that this batch is to be submitted to
      */
-    explicit CDBBatch(const CDBWrapper &_parent) : parent(_parent), ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), size_estimate(0) { };
+    explicit CDBBatch(const CDBWrapper &_parent) : parent(_parent), ssValue(SER_DISK, CLIENT_VERSION), size_estimate(0) { };
 
     void Clear()
     {
@@ -72,13 +112,14 @@ public:
     template <typename K, typename V>
     void Write(const K& key, const V& value)
     {
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        CDBKeyWriter ssKey(key);
+        leveldb::Slice slKey = ssKey.GetSlice();
 
         ssValue.reserve(DBWRAPPER_PREALLOC_VALUE_SIZE);
         ssValue << value;
-        ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        if (dbwrapper_private::IsObfuscated(parent)) {
+            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+        }
         leveldb::Slice slValue(ssValue.data(), ssValue.size());
 
         batch.Put(slKey, slValue);
@@ -90,16 +131,14 @@ public:
         // - byte[]: value
         // The formula below assumes the key and value are both less than 16k.
         size_estimate += 3 + (slKey.size() > 127) + slKey.size() + (slValue.size() > 127) + slValue.size();
-        ssKey.clear();
         ssValue.clear();
     }
 
     template <typename K>
     void Erase(const K& key)
     {
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+        CDBKeyWriter ssKey(key);
+        leveldb::Slice slKey = ssKey.GetSlice();
 
         batch.Delete(slKey);
         // LevelDB serializes erases as:
@@ -108,7 +147,6 @@ public:
         // - byte[]: key
         // The formula below assumes the key is less than 16kB.
         size_estimate += 2 + (slKey.size() > 127) + slKey.size();
-        ssKey.clear();
     }
 
     size_t SizeEstimate() const { return size_estimate; }
@@ -120,6 +158,9 @@ private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
 
+    //! Deobfuscated copy of the current value, reused from one value to the next
+    std::vector<char> value_buffer;
+
 public:
 
     /**
@@ -135,11 +176,8 @@ public:
     void SeekToFirst();
 
     template<typename K> void Seek(const K& key) {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
-        piter->Seek(slKey);
+        CDBKeyWriter ssKey(key);
+        piter->Seek(ssKey.GetSlice());
     }
 
     void Next();
@@ -147,7 +185,8 @@ public:
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            // Read straight from the memory LevelDB holds the key in
+            CSpanReader ssKey(SER_DISK, CLIENT_VERSION, reinterpret_cast<const unsigned char*>(slKey.data()), slKey.size());
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -158,8 +197,15 @@ public:
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            const char* data = slValue.data();
+            if (dbwrapper_private::IsObfuscated(parent)) {
+                value_buffer.assign(slValue.data(), slValue.data() + slValue.size());
+                XorBytes(value_buffer.data(), value_buffer.size(), dbwrapper_private::GetObfuscateKey(parent));
+                data = value_buffer.data();
+            }
+            // Without obfuscation, read straight from the block LevelDB
+            // holds in memory while the iterator points into it
+            CSpanReader ssValue(SER_DISK, CLIENT_VERSION, reinterpret_cast<const unsigned char*>(data), slValue.size());
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -176,6 +222,7 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend bool dbwrapper_private::IsObfuscated(const CDBWrapper &w);
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -204,6 +251,9 @@ private:
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
+    //! whether obfuscate_key is other than zeros, so that values need to be XOR'd
+    bool m_obfuscated;
+
     //! the key under which the obfuscation key is stored
     static const std::string OBFUSCATE_KEY_KEY;
 
@@ -212,6 +262,13 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    /** Look up the value stored under key into a buffer of the calling
+     *  thread, deobfuscated unless deobfuscate is false. The buffer is reused
+     *  by the next lookup on the thread, which saves allocating a string for
+     *  each value read, unless it grew beyond DBWRAPPER_MAX_VALUE_BUFFER_SIZE.
+     *  Returns null if there is no such key. */
+    const std::string* ReadValue(const leveldb::Slice& key, bool deobfuscate = true) const;
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -227,22 +284,13 @@ public:
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
-
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
+        CDBKeyWriter ssKey(key);
+        const std::string* strValue = ReadValue(ssKey.GetSlice());
+        if (!strValue) {
+            return false;
         }
         try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(obfuscate_key);
+            CSpanReader ssValue(SER_DISK, CLIENT_VERSION, reinterpret_cast<const unsigned char*>(strValue->data()), strValue->size());
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -261,20 +309,8 @@ public:
     template <typename K>
     bool Exists(const K& key) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
-
-        std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
-        if (!status.ok()) {
-            if (status.IsNotFound())
-                return false;
-            LogPrintf("LevelDB read failure: %s\n", status.ToString());
-            dbwrapper_private::HandleError(status);
-        }
-        return true;
+        CDBKeyWriter ssKey(key);
+        return ReadValue(ssKey.GetSlice(), false) != nullptr;
     }
 
     template <typename K>
@@ -315,13 +351,9 @@ public:
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
-        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
-        ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey1 << key_begin;
-        ssKey2 << key_end;
-        leveldb::Slice slKey1(ssKey1.data(), ssKey1.size());
-        leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
+        CDBKeyWriter ssKey1(key_begin), ssKey2(key_end);
+        leveldb::Slice slKey1 = ssKey1.GetSlice();
+        leveldb::Slice slKey2 = ssKey2.GetSlice();
         uint64_t size = 0;
         leveldb::Range range(slKey1, slKey2);
         pdb->GetApproximateSizes(&range, 1, &size);
@@ -334,13 +366,9 @@ public:
     template<typename K>
     void CompactRange(const K& key_begin, const K& key_end) const
     {
-        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
-        ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey1 << key_begin;
-        ssKey2 << key_end;
-        leveldb::Slice slKey1(ssKey1.data(), ssKey1.size());
-        leveldb::Slice slKey2(ssKey2.data(), ssKey2.size());
+        CDBKeyWriter ssKey1(key_begin), ssKey2(key_end);
+        leveldb::Slice slKey1 = ssKey1.GetSlice();
+        leveldb::Slice slKey2 = ssKey2.GetSlice();
         pdb->CompactRange(&slKey1, &slKey2);
     }
 
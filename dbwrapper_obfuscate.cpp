@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <cash.h>
+#include <dbwrapper.h>
+#include <random.h>
+#include <streams.h>
+
+#include <assert.h>
+
+// Records written per batch, and looked up, by the database benchmarks
+static const uint32_t DB_RECORDS = 1000;
+
+static const char DB_BENCH_CASH = 'C';
+
+/** A chainstate-like record: an outpoint mapped to a P2PKH output */
+static std::pair<std::pair<char, COutPoint>, Cash> BenchRecord(uint32_t n)
+{
+    CScript script;
+    script << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, static_cast<unsigned char>(n)) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return {std::make_pair(DB_BENCH_CASH, COutPoint(uint256S("0123456789abcdef"), n)),
+            Cash(CTxOut(n * 1000, script), 500000 + n, false)};
+}
+
+static void DBWrapperWrite(benchmark::State& state, bool obfuscate)
+{
+    CDBWrapper db(fs::path("bench_dbwrapper"), 1 << 20, true, false, obfuscate);
+    std::vector<std::pair<std::pair<char, COutPoint>, Cash>> records;
+    for (uint32_t n = 0; n < DB_RECORDS; n++) {
+        records.push_back(BenchRecord(n));
+    }
+
+    while (state.KeepRunning()) {
+        CDBBatch batch(db);
+        for (const auto& record : records) {
+            batch.Write(record.first, record.second);
+        }
+        bool written = db.WriteBatch(batch);
+        assert(written);
+    }
+}
+
+static void DBWrapperRead(benchmark::State& state, bool obfuscate)
+{
+    CDBWrapper db(fs::path("bench_dbwrapper"), 1 << 20, true, false, obfuscate);
+    std::vector<std::pair<char, COutPoint>> keys;
+    CDBBatch batch(db);
+    for (uint32_t n = 0; n < DB_RECORDS; n++) {
+        const auto record = BenchRecord(n);
+        batch.Write(record.first, record.second);
+        keys.push_back(record.first);
+    }
+    bool written = db.WriteBatch(batch);
+    assert(written);
+
+    while (state.KeepRunning()) {
+        for (const auto& key : keys) {
+            Cash cash;
+            bool found = db.Read(key, cash);
+            assert(found);
+        }
+    }
+}
+
+static void DBWrapperWritePlain(benchmark::State& state) { DBWrapperWrite(state, false); }
+static void DBWrapperWriteObfuscated(benchmark::State& state) { DBWrapperWrite(state, true); }
+static void DBWrapperReadPlain(benchmark::State& state) { DBWrapperRead(state, false); }
+static void DBWrapperReadObfuscated(benchmark::State& state) { DBWrapperRead(state, true); }
+
+static void ObfuscateXor(benchmark::State& state)
+{
+    CDataStream stream(std::vector<char>(1 << 20), SER_DISK, 0);
+    std::vector<unsigned char> key(8);
+    GetRandBytes(key.data(), key.size());
+
+    while (state.KeepRunning()) {
+        stream.Xor(key);
+    }
+}
+
+BENCHMARK(DBWrapperWritePlain, 100);
+BENCHMARK(DBWrapperWriteObfuscated, 100);
+BENCHMARK(DBWrapperReadPlain, 100);
+BENCHMARK(DBWrapperReadObfuscated, 100);
+BENCHMARK(ObfuscateXor, 1000);
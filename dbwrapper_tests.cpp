@@ -77,6 +77,51 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+// Keys are serialized on the stack up to DBWRAPPER_PREALLOC_KEY_SIZE bytes,
+// and values are read from a buffer shared by the lookups of a thread
+BOOST_AUTO_TEST_CASE(dbwrapper_key_sizes)
+{
+    for (bool obfuscate : {false, true}) {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        for (size_t key_size : {0, 1, 63, 64, 65, 1000}) {
+            const std::string key(key_size, 'k');
+            const std::vector<unsigned char> in(key_size + 10, static_cast<unsigned char>(key_size));
+            BOOST_CHECK(dbw.Write(key, in));
+        }
+        for (size_t key_size : {0, 1, 63, 64, 65, 1000}) {
+            const std::string key(key_size, 'k');
+            std::vector<unsigned char> res;
+            BOOST_CHECK(dbw.Exists(key));
+            BOOST_CHECK(dbw.Read(key, res));
+            BOOST_CHECK(res == std::vector<unsigned char>(key_size + 10, static_cast<unsigned char>(key_size)));
+        }
+        BOOST_CHECK(!dbw.Exists(std::string(2, 'k')));
+
+        // A value larger than the buffer a thread keeps does not affect the
+        // values read after it
+        const std::vector<unsigned char> large(DBWRAPPER_MAX_VALUE_BUFFER_SIZE * 2, 0x5a);
+        BOOST_CHECK(dbw.Write(std::string("large"), large));
+        std::vector<unsigned char> res;
+        BOOST_CHECK(dbw.Exists(std::string("large")));
+        BOOST_CHECK(dbw.Read(std::string("large"), res));
+        BOOST_CHECK(res == large);
+        BOOST_CHECK(dbw.Read(std::string(1, 'k'), res));
+        BOOST_CHECK(res == std::vector<unsigned char>(11, 1));
+
+        // The values read through an iterator match
+        std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+        it->Seek(std::string(64, 'k'));
+        BOOST_REQUIRE(it->Valid());
+        std::string key;
+        BOOST_CHECK(it->GetKey(key));
+        BOOST_CHECK(key == std::string(64, 'k'));
+        BOOST_CHECK(it->GetValue(res));
+        BOOST_CHECK(res == std::vector<unsigned char>(74, 64));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     // Perform tests both obfuscated and non-obfuscated.
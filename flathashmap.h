@@ -0,0 +1,329 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_FLATHASHMAP_H
+#define SALEMCASH_FLATHASHMAP_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** Open-addressing hash map with pool-allocated values.
+ *
+ * The table itself is two flat arrays: one control byte per slot (empty,
+ * deleted, or 7 bits of the element's hash) and one pointer per slot. Lookups
+ * probe linearly over the control bytes and only dereference a slot pointer
+ * when its hash fragment matches, so a miss rarely touches more than one
+ * cache line.
+ *
+ * Elements are constructed inside large chunks owned by the map and recycled
+ * through a free list, instead of one heap allocation per element. Because
+ * elements never move, references and pointers to them stay valid until the
+ * element is erased, exactly like std::unordered_map.
+ *
+ * Iterators are invalidated by insertion (which may rehash) but not by
+ * erasure: erased slots become tombstones, so both `it = m.erase(it)` and
+ * `m.erase(it++)` are safe while iterating.
+ *
+ * Only the subset of the std::unordered_map interface that is used in the
+ * codebase is provided.
+ */
+template <typename K, typename T, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K> >
+class flathashmap
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+    typedef Hash hasher;
+    typedef KeyEqual key_equal;
+
+    enum {
+        //! Number of elements in the first pool chunk; later chunks double up to MAX_CHUNK_ELEMENTS.
+        MIN_CHUNK_ELEMENTS = 16,
+        MAX_CHUNK_ELEMENTS = 65536,
+    };
+
+private:
+    enum : uint8_t {
+        CTRL_EMPTY = 0x80,
+        CTRL_DELETED = 0xfe,
+    };
+    enum { MIN_BUCKETS = 16 };
+
+    /** Raw storage for one element; doubles as a free list link when unused. */
+    union node {
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+        node* next_free;
+    };
+
+    struct chunk {
+        std::unique_ptr<node[]> nodes;
+        size_t count;
+    };
+
+    std::vector<uint8_t> m_ctrl;
+    std::vector<value_type*> m_slots;
+    size_t m_size;
+    size_t m_deleted;
+
+    std::vector<chunk> m_chunks;
+    size_t m_chunk_used;
+    size_t m_pool_capacity;
+    node* m_free;
+
+    Hash m_hash;
+    KeyEqual m_equal;
+
+    static uint8_t ctrl_hash(size_t h) { return h & 0x7f; }
+    static size_t slot_hash(size_t h) { return h >> 7; }
+    static bool is_full(uint8_t c) { return (c & 0x80) == 0; }
+
+    size_t mask() const { return m_slots.size() - 1; }
+
+    value_type* allocate_node()
+    {
+        if (m_free) {
+            node* n = m_free;
+            m_free = n->next_free;
+            return reinterpret_cast<value_type*>(&n->storage);
+        }
+        if (m_chunks.empty() || m_chunk_used == m_chunks.back().count) {
+            size_t count = m_pool_capacity;
+            if (count < MIN_CHUNK_ELEMENTS) count = MIN_CHUNK_ELEMENTS;
+            if (count > MAX_CHUNK_ELEMENTS) count = MAX_CHUNK_ELEMENTS;
+            m_chunks.push_back(chunk{std::unique_ptr<node[]>(new node[count]), count});
+            m_pool_capacity += count;
+            m_chunk_used = 0;
+        }
+        return reinterpret_cast<value_type*>(&m_chunks.back().nodes[m_chunk_used++].storage);
+    }
+
+    void free_node(value_type* p)
+    {
+        p->~value_type();
+        node* n = reinterpret_cast<node*>(p);
+        n->next_free = m_free;
+        m_free = n;
+    }
+
+    /** Return the slot holding key, or m_slots.size() if absent. */
+    size_t find_slot(const K& key, size_t h) const
+    {
+        if (m_size == 0) return m_slots.size();
+        const uint8_t c = ctrl_hash(h);
+        for (size_t i = slot_hash(h) & mask(); ; i = (i + 1) & mask()) {
+            if (m_ctrl[i] == c && m_equal(m_slots[i]->first, key)) return i;
+            if (m_ctrl[i] == CTRL_EMPTY) return m_slots.size();
+        }
+    }
+
+    /** Return the first reusable slot for hash h. The table must have room. */
+    size_t find_insert_slot(size_t h) const
+    {
+        for (size_t i = slot_hash(h) & mask(); ; i = (i + 1) & mask()) {
+            if (!is_full(m_ctrl[i])) return i;
+        }
+    }
+
+    void rehash_to(size_t buckets)
+    {
+        std::vector<uint8_t> old_ctrl(buckets, uint8_t(CTRL_EMPTY));
+        std::vector<value_type*> old_slots(buckets, nullptr);
+        old_ctrl.swap(m_ctrl);
+        old_slots.swap(m_slots);
+        m_deleted = 0;
+        for (size_t i = 0; i < old_slots.size(); ++i) {
+            if (!is_full(old_ctrl[i])) continue;
+            size_t h = m_hash(old_slots[i]->first);
+            size_t j = find_insert_slot(h);
+            m_ctrl[j] = ctrl_hash(h);
+            m_slots[j] = old_slots[i];
+        }
+    }
+
+    /** Make room for one more element, keeping occupied plus deleted slots under 7/8. */
+    void reserve_one()
+    {
+        if (m_slots.empty()) {
+            rehash_to(MIN_BUCKETS);
+            return;
+        }
+        if ((m_size + m_deleted + 1) * 8 <= m_slots.size() * 7) return;
+        // Mostly tombstones: rebuild in place instead of growing.
+        rehash_to(m_size * 16 < m_slots.size() * 7 ? m_slots.size() : m_slots.size() * 2);
+    }
+
+    template <typename... Args>
+    std::pair<size_t, bool> emplace_slot(const K& key, size_t h, Args&&... args)
+    {
+        size_t i = find_slot(key, h);
+        if (i != m_slots.size()) return std::make_pair(i, false);
+        reserve_one();
+        i = find_insert_slot(h);
+        value_type* p = allocate_node();
+        try {
+            new (p) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            node* n = reinterpret_cast<node*>(p);
+            n->next_free = m_free;
+            m_free = n;
+            throw;
+        }
+        if (m_ctrl[i] == CTRL_DELETED) --m_deleted;
+        m_ctrl[i] = ctrl_hash(h);
+        m_slots[i] = p;
+        ++m_size;
+        return std::make_pair(i, true);
+    }
+
+    template <bool Const>
+    class iter_base
+    {
+        friend class flathashmap;
+        typedef typename std::conditional<Const, const flathashmap*, flathashmap*>::type map_ptr;
+        map_ptr m_map;
+        size_t m_pos;
+
+        void skip() { while (m_pos < m_map->m_slots.size() && !is_full(m_map->m_ctrl[m_pos])) ++m_pos; }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename flathashmap::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+        iter_base() : m_map(nullptr), m_pos(0) {}
+        iter_base(map_ptr map, size_t pos) : m_map(map), m_pos(pos) {}
+        template <bool C = Const, typename = typename std::enable_if<C>::type>
+        iter_base(const iter_base<false>& other) : m_map(other.m_map), m_pos(other.m_pos) {}
+
+        reference operator*() const { return *m_map->m_slots[m_pos]; }
+        pointer operator->() const { return m_map->m_slots[m_pos]; }
+        iter_base& operator++() { ++m_pos; skip(); return *this; }
+        iter_base operator++(int) { iter_base copy(*this); ++(*this); return copy; }
+        bool operator==(const iter_base& other) const { return m_pos == other.m_pos; }
+        bool operator!=(const iter_base& other) const { return m_pos != other.m_pos; }
+
+        friend class iter_base<!Const>;
+    };
+
+public:
+    typedef iter_base<false> iterator;
+    typedef iter_base<true> const_iterator;
+
+    flathashmap() : m_size(0), m_deleted(0), m_chunk_used(0), m_pool_capacity(0), m_free(nullptr) {}
+    ~flathashmap() { clear(); }
+
+    // Hashers may be salted per instance (see SaltedOutpointHasher), so the
+    // table cannot be handed over to another map.
+    flathashmap(const flathashmap&) = delete;
+    flathashmap& operator=(const flathashmap&) = delete;
+
+    iterator begin() { iterator it(this, 0); it.skip(); return it; }
+    iterator end() { return iterator(this, m_slots.size()); }
+    const_iterator begin() const { const_iterator it(this, 0); it.skip(); return it; }
+    const_iterator end() const { return const_iterator(this, m_slots.size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool empty() const { return m_size == 0; }
+    size_type size() const { return m_size; }
+    size_type bucket_count() const { return m_slots.size(); }
+
+    //! Number of elements the pool can hold without allocating another chunk.
+    size_type pool_capacity() const { return m_pool_capacity; }
+    //! Number of pool chunks currently allocated.
+    size_type pool_chunk_count() const { return m_chunks.size(); }
+
+    iterator find(const K& key) { return iterator(this, find_slot(key, m_hash(key))); }
+    const_iterator find(const K& key) const { return const_iterator(this, find_slot(key, m_hash(key))); }
+    size_type count(const K& key) const { return find_slot(key, m_hash(key)) != m_slots.size(); }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const K& key, Args&&... args)
+    {
+        std::pair<size_t, bool> r = emplace_slot(key, m_hash(key), key, std::forward<Args>(args)...);
+        return std::make_pair(iterator(this, r.first), r.second);
+    }
+
+    template <typename KeyTuple, typename ArgTuple>
+    std::pair<iterator, bool> emplace(std::piecewise_construct_t pc, KeyTuple&& key, ArgTuple&& args)
+    {
+        const K& k = std::get<0>(key);
+        std::pair<size_t, bool> r = emplace_slot(k, m_hash(k), pc, std::forward<KeyTuple>(key), std::forward<ArgTuple>(args));
+        return std::make_pair(iterator(this, r.first), r.second);
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) { return emplace(value.first, value.second); }
+    std::pair<iterator, bool> insert(value_type&& value) { return emplace(value.first, std::move(value.second)); }
+
+    T& operator[](const K& key)
+    {
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        size_t i = it.m_pos;
+        assert(i < m_slots.size() && is_full(m_ctrl[i]));
+        free_node(m_slots[i]);
+        m_slots[i] = nullptr;
+        // A slot followed by an empty one terminates no probe sequence, so it can be emptied outright.
+        if (m_ctrl[(i + 1) & mask()] == CTRL_EMPTY) {
+            m_ctrl[i] = CTRL_EMPTY;
+        } else {
+            m_ctrl[i] = CTRL_DELETED;
+            ++m_deleted;
+        }
+        --m_size;
+        iterator next(this, i);
+        ++next;
+        return next;
+    }
+
+    size_type erase(const K& key)
+    {
+        const_iterator it = find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Destroy all elements and release the table and the pool. */
+    void clear()
+    {
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            if (is_full(m_ctrl[i])) m_slots[i]->~value_type();
+        }
+        std::vector<uint8_t>().swap(m_ctrl);
+        std::vector<value_type*>().swap(m_slots);
+        std::vector<chunk>().swap(m_chunks);
+        m_size = 0;
+        m_deleted = 0;
+        m_chunk_used = 0;
+        m_pool_capacity = 0;
+        m_free = nullptr;
+    }
+
+    void reserve(size_t n)
+    {
+        size_t buckets = MIN_BUCKETS;
+        while (buckets * 7 < n * 8) buckets *= 2;
+        if (buckets > m_slots.size()) rehash_to(buckets);
+    }
+};
+
+#endif // SALEMCASH_FLATHASHMAP_H
@@ -0,0 +1,109 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <flathashmap.h>
+#include <memusage.h>
+
+#include <test/test_salemcash.h>
+
+#include <unordered_map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(flathashmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(flathashmap_randomized)
+{
+    // Apply the same random operations to a flathashmap and a std::unordered_map.
+    flathashmap<uint32_t, std::string> map;
+    std::unordered_map<uint32_t, std::string> ref;
+    for (int i = 0; i < 200000; ++i) {
+        uint32_t key = InsecureRandRange(2000);
+        switch (InsecureRandRange(5)) {
+        case 0: {
+            auto a = map.emplace(key, std::to_string(i));
+            auto b = ref.emplace(key, std::to_string(i));
+            BOOST_CHECK_EQUAL(a.second, b.second);
+            BOOST_CHECK_EQUAL(a.first->second, b.first->second);
+            break;
+        }
+        case 1:
+            map[key] += "x";
+            ref[key] += "x";
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), ref.erase(key));
+            break;
+        case 3: {
+            auto it = map.find(key);
+            BOOST_CHECK_EQUAL(it == map.end(), ref.count(key) == 0);
+            if (it != map.end()) BOOST_CHECK_EQUAL(it->second, ref[key]);
+            break;
+        }
+        case 4:
+            if (InsecureRandRange(1000) == 0) {
+                // Erasing while iterating must not skip or revisit elements.
+                for (auto it = map.begin(); it != map.end(); ) {
+                    if (it->first % 3 == 0) {
+                        ref.erase(it->first);
+                        map.erase(it++);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            break;
+        }
+        BOOST_CHECK_EQUAL(map.size(), ref.size());
+    }
+
+    size_t count = 0;
+    for (const auto& entry : map) {
+        BOOST_CHECK_EQUAL(entry.second, ref.at(entry.first));
+        ++count;
+    }
+    BOOST_CHECK_EQUAL(count, ref.size());
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(flathashmap_usage)
+{
+    // The usage kept in total matches that of each chunk allocation.
+    flathashmap<uint64_t, uint32_t> map;
+    for (uint64_t i = 0; i < 100000; ++i) map[i] = i;
+    BOOST_CHECK(map.pool_chunk_count() > 2);
+
+    size_t usage = memusage::MallocUsage(map.bucket_count()) + memusage::MallocUsage(sizeof(void*) * map.bucket_count());
+    for (size_t capacity = 0; capacity < map.pool_capacity();) {
+        size_t count = capacity;
+        if (count < flathashmap<uint64_t, uint32_t>::MIN_CHUNK_ELEMENTS) count = flathashmap<uint64_t, uint32_t>::MIN_CHUNK_ELEMENTS;
+        if (count > flathashmap<uint64_t, uint32_t>::MAX_CHUNK_ELEMENTS) count = flathashmap<uint64_t, uint32_t>::MAX_CHUNK_ELEMENTS;
+        usage += memusage::MallocUsage(sizeof(std::pair<const uint64_t, uint32_t>) * count);
+        capacity += count;
+    }
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), usage);
+}
+
+BOOST_AUTO_TEST_CASE(flathashmap_stable_references)
+{
+    // References to elements survive rehashing, and erased nodes are reused.
+    flathashmap<int, int> map;
+    int& first = map[0];
+    first = 42;
+    for (int i = 1; i < 10000; ++i) map[i] = i;
+    BOOST_CHECK_EQUAL(&first, &map.find(0)->second);
+    BOOST_CHECK_EQUAL(first, 42);
+
+    size_t pool = map.pool_capacity();
+    for (int i = 0; i < 10000; i += 2) map.erase(i);
+    for (int i = 10000; i < 15000; ++i) map[i] = i;
+    BOOST_CHECK_EQUAL(map.size(), 10000U);
+    BOOST_CHECK_EQUAL(map.pool_capacity(), pool);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <blockfilter.h>
+
+#include <assert.h>
+
+// About the number of distinct scripts of a full block
+static const int GCS_ELEMENTS = 10000;
+
+static GCSFilter::ElementSet BenchElements()
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < GCS_ELEMENTS; ++i) {
+        GCSFilter::Element element(32);
+        element[0] = static_cast<unsigned char>(i);
+        element[1] = static_cast<unsigned char>(i >> 8);
+        element[2] = static_cast<unsigned char>(i >> 16);
+        elements.insert(std::move(element));
+    }
+    return elements;
+}
+
+static void ConstructGCSFilter(benchmark::State& state)
+{
+    GCSFilter::ElementSet elements = BenchElements();
+
+    uint64_t siphash_k0 = 0;
+    while (state.KeepRunning()) {
+        GCSFilter filter(siphash_k0, 0, BASIC_FILTER_P, BASIC_FILTER_M, elements);
+
+        siphash_k0++;
+    }
+}
+
+static void DecodeGCSFilter(benchmark::State& state)
+{
+    GCSFilter filter(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, BenchElements());
+    const std::vector<unsigned char>& encoded = filter.GetEncoded();
+
+    while (state.KeepRunning()) {
+        GCSFilter decoded(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, encoded);
+        assert(decoded.GetN() == GCS_ELEMENTS);
+    }
+}
+
+static void MatchGCSFilter(benchmark::State& state)
+{
+    GCSFilter filter(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, BenchElements());
+
+    while (state.KeepRunning()) {
+        filter.Match(GCSFilter::Element());
+    }
+}
+
+// A wallet checking a block against all of its scripts at once
+static void MatchAnyGCSFilter(benchmark::State& state)
+{
+    GCSFilter filter(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, BenchElements());
+
+    GCSFilter::ElementSet queries;
+    for (int i = 0; i < 1000; ++i) {
+        GCSFilter::Element query(25, 0xff);
+        query[0] = static_cast<unsigned char>(i);
+        query[1] = static_cast<unsigned char>(i >> 8);
+        queries.insert(std::move(query));
+    }
+
+    while (state.KeepRunning()) {
+        filter.MatchAny(queries);
+    }
+}
+
+BENCHMARK(ConstructGCSFilter, 1000);
+BENCHMARK(DecodeGCSFilter, 1000);
+BENCHMARK(MatchGCSFilter, 50 * 1000);
+BENCHMARK(MatchAnyGCSFilter, 1000);
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <crypto/sha256.h>
 #include <hash.h>
 #include <utilstrencodings.h>
 #include <test/test_salemcash.h>
@@ -147,4 +148,24 @@ BOOST_AUTO_TEST_CASE(siphash)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // Batch sizes cover every combination of the 8, 4, 2 and 1-way kernels.
+    for (int blocks = 0; blocks <= 34; ++blocks) {
+        std::vector<unsigned char> in(64 * blocks);
+        for (auto& x : in) x = InsecureRandBits(8);
+        std::vector<unsigned char> expected(32 * blocks);
+        for (int i = 0; i < blocks; ++i) {
+            CHash256().Write(in.data() + 64 * i, 64).Finalize(expected.data() + 32 * i);
+        }
+        std::vector<unsigned char> out(32 * blocks);
+        SHA256D64(out.data(), in.data(), blocks);
+        BOOST_CHECK(out == expected);
+        // The output is allowed to alias the input.
+        SHA256D64(in.data(), in.data(), blocks);
+        in.resize(32 * blocks);
+        BOOST_CHECK(in == expected);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,8 @@
 #include <chainparams.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonwriter.h>
+#include <rpc/mining.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -17,11 +19,28 @@
 #include <crypto/hmac_sha256.h>
 #include <stdio.h>
 
+#include <set>
+
 #include <boost/algorithm/string.hpp> // boost::trim
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
+/** Commands that can keep a worker thread busy for long */
+static const std::set<std::string> setHeavyCommands = {
+    "generate",
+    "generatetoaddress",
+    "getchaintxstats",
+    "gettxoutproof",
+    "gettxoutsetinfo",
+    "invalidateblock",
+    "preciousblock",
+    "pruneblockchain",
+    "reconsiderblock",
+    "savemempool",
+    "verifychain",
+};
+
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wallet.
  */
@@ -141,14 +160,10 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
-static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
+/** Check the credentials of a request, replying 401 Unauthorized if they are
+ *  missing or wrong */
+static bool HTTPAuthorized(HTTPRequest* req, std::string& strAuthUsernameOut)
 {
-    // JSONRPC handles only POST
-    if (req->GetRequestMethod() != HTTPRequest::POST) {
-        req->WriteReply(HTTP_BAD_METHOD, "JSONRPC server handles only POST requests");
-        return false;
-    }
-    // Check authorization
     std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
     if (!authHeader.first) {
         req->WriteHeader("WWW-Authenticate", WWW_AUTH_HEADER_DATA);
@@ -156,8 +171,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
-    JSONRPCRequest jreq;
-    if (!RPCAuthorized(authHeader.second, jreq.authUser)) {
+    if (!RPCAuthorized(authHeader.second, strAuthUsernameOut)) {
         LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", req->GetPeer().ToString());
 
         /* Deter brute-forcing
@@ -169,6 +183,80 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteReply(HTTP_UNAUTHORIZED);
         return false;
     }
+    return true;
+}
+
+std::vector<std::string> PeekRPCMethods(const std::string& strBody)
+{
+    static const std::string strKey = "\"method\"";
+    std::vector<std::string> vMethods;
+    const char* end = strBody.data() + strBody.size();
+    for (size_t pos = strBody.find(strKey); pos != std::string::npos; pos = strBody.find(strKey, pos + 1)) {
+        // Skip a "method" that is part of a string or a value
+        if (pos > 0 && strBody[pos - 1] == '\\')
+            continue;
+        const char* raw = strBody.data() + pos + strKey.size();
+        std::string tokenVal;
+        unsigned int consumed;
+        if (getJsonToken(tokenVal, consumed, raw, end) != JTOK_COLON)
+            continue;
+        raw += consumed;
+        if (getJsonToken(tokenVal, consumed, raw, end) == JTOK_STRING)
+            vMethods.push_back(tokenVal);
+        else
+            vMethods.push_back("");
+    }
+    return vMethods;
+}
+
+/** Work lane for a single call */
+static HTTPWorkLane SelectMethodLane(const std::string& strMethod)
+{
+    if (setHeavyCommands.count(strMethod))
+        return HTTPWorkLane::RPC_HEAVY;
+    const CRPCCommand* pcmd = tableRPC[strMethod];
+    if (pcmd && pcmd->category == "wallet")
+        return HTTPWorkLane::WALLET;
+    return HTTPWorkLane::RPC;
+}
+
+HTTPWorkLane SelectRPCLane(const std::string& strBody)
+{
+    const std::vector<std::string> vMethods = PeekRPCMethods(strBody);
+    const size_t nFirst = strBody.find_first_not_of(" \t\n\r");
+    if (nFirst == std::string::npos || strBody[nFirst] != '[') {
+        if (vMethods.empty() || vMethods[0].empty())
+            return HTTPWorkLane::RPC;
+        return SelectMethodLane(vMethods[0]);
+    }
+
+    // A batch goes to the lane of its heaviest call
+    HTTPWorkLane lane = HTTPWorkLane::RPC;
+    for (const std::string& strMethod : vMethods) {
+        switch (SelectMethodLane(strMethod)) {
+        case HTTPWorkLane::RPC_HEAVY:
+            return HTTPWorkLane::RPC_HEAVY;
+        case HTTPWorkLane::WALLET:
+            lane = HTTPWorkLane::WALLET;
+            break;
+        default:
+            break;
+        }
+    }
+    return lane;
+}
+
+static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
+{
+    // JSONRPC handles only POST
+    if (req->GetRequestMethod() != HTTPRequest::POST) {
+        req->WriteReply(HTTP_BAD_METHOD, "JSONRPC server handles only POST requests");
+        return false;
+    }
+    // Check authorization
+    JSONRPCRequest jreq;
+    if (!HTTPAuthorized(req, jreq.authUser))
+        return false;
 
     try {
         // Parse request
@@ -184,14 +272,39 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Send the reply as it is written, so that a large result goes
+            // out in chunks instead of being held as a whole
+            bool fChunked = false;
+            JSONStreamWriter writer([req, &fChunked](const std::string& strChunk) {
+                if (!fChunked) {
+                    req->WriteHeader("Content-Type", "application/json");
+                    fChunked = true;
+                }
+                req->WriteReplyChunk(HTTP_OK, strChunk);
+            });
+            try {
+                writer.BeginObject();
+                writer.Key("result");
+                tableRPC.execute(jreq, writer);
+                writer.KeyValue("error", NullUniValue);
+                writer.KeyValue("id", jreq.id);
+                writer.EndObject();
+            } catch (...) {
+                if (!fChunked) throw;
+                // Too late for an error reply, cut the reply short instead
+                LogPrintf("%s: %s failed after part of its result was sent\n", __func__, jreq.strMethod);
+                req->WriteReply(HTTP_OK);
+                return false;
+            }
+            strReply = writer.TakeBuffer() + "\n";
+            if (fChunked) {
+                req->WriteReply(HTTP_OK, strReply);
+                return true;
+            }
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(jreq, valRequest.get_array());
+            strReply = JSONRPCExecBatch(jreq, valRequest.get_array(), QueueHTTPWork, HTTPLaneThreads() - 1);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
@@ -207,6 +320,60 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Binary getblocktemplate and submitblock, see rpc/mining.h:
+ *  GET  /mining/template[/<known id>]  the current template, as a delta
+ *  GET  /mining/longpoll/<known id>    the same, once it has changed
+ *  POST /mining/submit[/<template id>] a serialized block, or its header and
+ *                                      cashbase on top of a template
+ *  Submissions are answered with the BIP22 result, empty if accepted. */
+static bool HTTPReq_Mining(HTTPRequest* req, const std::string& strURIPart)
+{
+    std::string strAuthUser;
+    if (!HTTPAuthorized(req, strAuthUser))
+        return false;
+
+    std::string strCommand = strURIPart;
+    uint64_t nId = 0;
+    size_t pos = strURIPart.find('/');
+    if (pos != std::string::npos) {
+        strCommand = strURIPart.substr(0, pos);
+        if (!ParseUInt64(strURIPart.substr(pos + 1), &nId)) {
+            req->WriteReply(HTTP_BAD_REQUEST, "Invalid template id: " + strURIPart.substr(pos + 1));
+            return false;
+        }
+    }
+
+    try {
+        if (strCommand == "template" || strCommand == "longpoll") {
+            if (req->GetRequestMethod() != HTTPRequest::GET) {
+                req->WriteReply(HTTP_BAD_METHOD, "Templates can only be fetched with GET requests");
+                return false;
+            }
+            std::string strTemplate = GetBinaryBlockTemplate(nId, strCommand == "longpoll");
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            req->WriteReply(HTTP_OK, strTemplate);
+        } else if (strCommand == "submit") {
+            if (req->GetRequestMethod() != HTTPRequest::POST) {
+                req->WriteReply(HTTP_BAD_METHOD, "Blocks can only be submitted with POST requests");
+                return false;
+            }
+            UniValue result = SubmitBinaryBlock(req->ReadBody(), nId);
+            req->WriteHeader("Content-Type", "text/plain");
+            req->WriteReply(HTTP_OK, result.isNull() ? "" : result.get_str());
+        } else {
+            req->WriteReply(HTTP_NOT_FOUND, "Unknown mining command: " + strCommand);
+            return false;
+        }
+    } catch (const UniValue& objError) {
+        JSONErrorReply(req, objError, NullUniValue);
+        return false;
+    } catch (const std::exception& e) {
+        JSONErrorReply(req, JSONRPCError(RPC_MISC_ERROR, e.what()), NullUniValue);
+        return false;
+    }
+    return true;
+}
+
 static bool InitRPCAuthentication()
 {
     if (gArgs.GetArg("-rpcpassword", "") == "")
@@ -231,10 +398,14 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPWorkLane::RPC, [](HTTPRequest* req) {
+        // The whole body has been received by now, so all calls of a batch are seen
+        return SelectRPCLane(req->PeekBody());
+    });
+    RegisterHTTPHandler("/mining/", false, HTTPReq_Mining, HTTPWorkLane::RPC);
 #ifdef ENABLE_WALLET
     // ifdef can be removed once we switch to better endpoint support and API versioning
-    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, HTTPWorkLane::WALLET);
 #endif
     assert(EventBase());
     httpRPCTimerInterface = MakeUnique<HTTPRPCTimerInterface>(EventBase());
@@ -251,6 +422,7 @@ void StopHTTPRPC()
 {
     LogPrint(BCLog::RPC, "Stopping HTTP RPC server\n");
     UnregisterHTTPHandler("/", true);
+    UnregisterHTTPHandler("/mining/", false);
     if (httpRPCTimerInterface) {
         RPCUnsetTimerInterface(httpRPCTimerInterface.get());
         httpRPCTimerInterface.reset();
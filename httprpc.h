@@ -7,6 +7,9 @@
 
 #include <string>
 #include <map>
+#include <vector>
+
+enum class HTTPWorkLane;
 
 /** Start HTTP RPC subsystem.
  * Precondition; HTTP and RPC has been started.
@@ -36,4 +39,14 @@ void InterruptREST();
  */
 void StopREST();
 
+/** The methods of the calls in a JSON-RPC request or batch, in order, found
+ * without parsing all of it. A method that is not a string is returned empty.
+ */
+std::vector<std::string> PeekRPCMethods(const std::string& strBody);
+
+/** Work lane for a JSON-RPC request, given its body. A batch goes to the
+ * lane of its heaviest call.
+ */
+HTTPWorkLane SelectRPCLane(const std::string& strBody);
+
 #endif // SALEMCASH_HTTPRPC_H
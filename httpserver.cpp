@@ -20,6 +20,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <array>
+#include <chrono>
 #include <future>
 
 #include <event2/thread.h>
@@ -40,6 +42,10 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Chunks of a reply that may wait to be written to the client before
+ * WriteReplyChunk holds back the next one */
+static const uint64_t MAX_UNWRITTEN_REPLY_CHUNKS = 2;
+
 /** HTTP request work item */
 class HTTPWorkItem final : public HTTPClosure
 {
@@ -60,6 +66,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item running a plain task, see QueueHTTPWork */
+class HTTPTaskItem final : public HTTPClosure
+{
+public:
+    explicit HTTPTaskItem(const std::function<void()>& _task) : task(_task)
+    {
+    }
+    void operator()() override
+    {
+        task();
+    }
+
+private:
+    std::function<void()> task;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -70,13 +92,19 @@ private:
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    /** Work items with the time they were queued at */
+    std::deque<std::pair<int64_t, std::unique_ptr<WorkItem>>> queue;
     bool running;
     size_t maxDepth;
+    uint64_t nRejected;
+    HTTPHistogram depthHistogram;
+    HTTPHistogram waitHistogram;
+    HTTPHistogram runHistogram;
 
 public:
     explicit WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth)
+                                 maxDepth(_maxDepth),
+                                 nRejected(0)
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -88,10 +116,12 @@ public:
     bool Enqueue(WorkItem* item)
     {
         std::unique_lock<std::mutex> lock(cs);
+        depthHistogram.Add(queue.size());
         if (queue.size() >= maxDepth) {
+            nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(GetTimeMicros(), std::unique_ptr<WorkItem>(item));
         cond.notify_one();
         return true;
     }
@@ -100,18 +130,35 @@ public:
     {
         while (true) {
             std::unique_ptr<WorkItem> i;
+            int64_t nStart;
             {
                 std::unique_lock<std::mutex> lock(cs);
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                nStart = GetTimeMicros();
+                waitHistogram.Add(std::max<int64_t>(nStart - queue.front().first, 0));
+                i = std::move(queue.front().second);
                 queue.pop_front();
             }
             (*i)();
+            const int64_t nRun = std::max<int64_t>(GetTimeMicros() - nStart, 0);
+            std::unique_lock<std::mutex> lock(cs);
+            runHistogram.Add(nRun);
         }
     }
+    /** Fill in the queue part of stats */
+    void GetStats(HTTPLaneStats& stats)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        stats.nMaxDepth = maxDepth;
+        stats.nDepth = queue.size();
+        stats.nRejected = nRejected;
+        stats.vDepthHistogram = depthHistogram.Get();
+        stats.vWaitHistogram = waitHistogram.Get();
+        stats.vRunHistogram = runHistogram.Get();
+    }
     /** Interrupt and exit loops */
     void Interrupt()
     {
@@ -124,13 +171,26 @@ public:
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPWorkLane _lane, HTTPLaneSelector _selectLane):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), lane(_lane), selectLane(_selectLane)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPWorkLane lane;
+    HTTPLaneSelector selectLane;
+};
+
+/** A lane of the HTTP work queue, see HTTPWorkLane */
+struct HTTPLane
+{
+    const char* name;
+    const char* threadsArg;
+    int defaultThreads;
+    int nThreads;
+    WorkQueue<HTTPClosure>* queue;
+    std::vector<std::thread> threads;
 };
 
 /** HTTP module state */
@@ -141,8 +201,16 @@ static struct event_base* eventBase = nullptr;
 struct evhttp* eventHTTP = nullptr;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
-//! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = nullptr;
+//! Work queues for handling longer requests off the event loop thread, in
+//! the order of HTTPWorkLane
+static std::array<HTTPLane, HTTP_WORK_LANES> lanes = {{
+    {"rest", "-restthreads", DEFAULT_HTTP_REST_THREADS, 0, nullptr, {}},
+    {"rpc", "-rpcthreads", DEFAULT_HTTP_THREADS, 0, nullptr, {}},
+    {"rpcheavy", "-rpcheavythreads", DEFAULT_HTTP_HEAVY_THREADS, 0, nullptr, {}},
+    {"wallet", "-rpcwalletthreads", DEFAULT_HTTP_WALLET_THREADS, 0, nullptr, {}},
+}};
+//! Lane served by the current thread, if it is an HTTP worker thread
+static thread_local HTTPLane* currentLane = nullptr;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -257,12 +325,13 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        HTTPLane& lane = lanes[(size_t)(i->selectLane ? i->selectLane(hreq.get()) : i->lane)];
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        assert(lane.queue);
+        if (lane.queue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http work queue depth of lane %s exceeded, it can be increased with the -rpcworkqueue= setting\n", lane.name);
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -327,10 +396,11 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(HTTPLane* lane)
 {
     RenameThread("salemcash-httpworker");
-    queue->Run();
+    currentLane = lane;
+    lane->queue->Run();
 }
 
 /** libevent event log callback */
@@ -395,9 +465,11 @@ bool InitHTTPServer()
 
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    LogPrintf("HTTP: creating work queues of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    for (HTTPLane& lane : lanes) {
+        lane.queue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    }
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -420,19 +492,20 @@ bool UpdateHTTPServerLogging(bool enable) {
 
 std::thread threadHTTP;
 std::future<bool> threadResult;
-static std::vector<std::thread> g_thread_http_workers;
 
 bool StartHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Starting HTTP server\n");
-    int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     std::packaged_task<bool(event_base*, evhttp*)> task(ThreadHTTP);
     threadResult = task.get_future();
     threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
 
-    for (int i = 0; i < rpcThreads; i++) {
-        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue);
+    for (HTTPLane& lane : lanes) {
+        lane.nThreads = std::max((long)gArgs.GetArg(lane.threadsArg, lane.defaultThreads), 1L);
+        LogPrintf("HTTP: starting %d worker threads for lane %s\n", lane.nThreads, lane.name);
+        for (int i = 0; i < lane.nThreads; i++) {
+            lane.threads.emplace_back(HTTPWorkQueueRun, &lane);
+        }
     }
     return true;
 }
@@ -448,21 +521,24 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, nullptr);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    for (HTTPLane& lane : lanes) {
+        if (lane.queue)
+            lane.queue->Interrupt();
+    }
 }
 
 void StopHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Stopping HTTP server\n");
-    if (workQueue) {
-        LogPrint(BCLog::HTTP, "Waiting for HTTP worker threads to exit\n");
-        for (auto& thread: g_thread_http_workers) {
+    LogPrint(BCLog::HTTP, "Waiting for HTTP worker threads to exit\n");
+    for (HTTPLane& lane : lanes) {
+        for (auto& thread: lane.threads) {
             thread.join();
         }
-        g_thread_http_workers.clear();
-        delete workQueue;
-        workQueue = nullptr;
+        lane.threads.clear();
+        lane.nThreads = 0;
+        delete lane.queue;
+        lane.queue = nullptr;
     }
     if (eventBase) {
         LogPrint(BCLog::HTTP, "Waiting for HTTP event thread to exit\n");
@@ -491,6 +567,39 @@ void StopHTTPServer()
     LogPrint(BCLog::HTTP, "Stopped HTTP server\n");
 }
 
+bool QueueHTTPWork(const std::function<void()>& task)
+{
+    if (!currentLane)
+        return false;
+    std::unique_ptr<HTTPTaskItem> item(new HTTPTaskItem(task));
+    if (!currentLane->queue->Enqueue(item.get()))
+        return false;
+    item.release(); /* if true, queue took ownership */
+    return true;
+}
+
+int HTTPLaneThreads()
+{
+    return currentLane ? currentLane->nThreads : 0;
+}
+
+std::vector<HTTPLaneStats> GetHTTPLaneStats()
+{
+    std::vector<HTTPLaneStats> vStats;
+    for (HTTPLane& lane : lanes) {
+        HTTPLaneStats stats;
+        stats.name = lane.name;
+        stats.nThreads = lane.nThreads;
+        if (lane.queue) {
+            lane.queue->GetStats(stats);
+        } else {
+            stats.nMaxDepth = stats.nDepth = stats.nRejected = 0;
+        }
+        vStats.push_back(std::move(stats));
+    }
+    return vStats;
+}
+
 struct event_base* EventBase()
 {
     return eventBase;
@@ -523,7 +632,8 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyChunked(false)
 {
 }
 HTTPRequest::~HTTPRequest()
@@ -567,6 +677,19 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody()
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(evbuffer_get_length(buf), '\0');
+    if (rv.empty())
+        return rv;
+    ev_ssize_t copied = evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(copied < 0 ? 0 : copied);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -574,6 +697,22 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/** Re-enable reading from the socket once the reply is sent. This is the
+ * second part of the libevent workaround above.
+ */
+static void EnableReadAfterReply(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -582,30 +721,113 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
     assert(!replySent && req);
-    // Send event to main http thread to send reply message
-    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
-    assert(evb);
-    evbuffer_add(evb, strReply.data(), strReply.size());
     auto req_copy = req;
-    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
-        evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
+    HTTPEvent* ev;
+    if (replyChunked) {
+        struct evbuffer* chunk = nullptr;
+        if (!strReply.empty()) {
+            chunk = evbuffer_new();
+            assert(chunk);
+            evbuffer_add(chunk, strReply.data(), strReply.size());
         }
-    });
+        // Ending the reply replaces the write callback, so the progress the
+        // callback points to is kept until then
+        std::shared_ptr<HTTPReplyProgress> progress = std::move(replyProgress);
+        ev = new HTTPEvent(eventBase, true, [req_copy, chunk, progress]{
+            if (chunk) {
+                evhttp_send_reply_chunk(req_copy, chunk);
+                evbuffer_free(chunk);
+            }
+            evhttp_send_reply_end(req_copy);
+            EnableReadAfterReply(req_copy);
+        });
+    } else {
+        // Send event to main http thread to send reply message
+        struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+        assert(evb);
+        evbuffer_add(evb, strReply.data(), strReply.size());
+        ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+            evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
+            EnableReadAfterReply(req_copy);
+        });
+    }
     ev->trigger(nullptr);
     replySent = true;
     req = nullptr; // transferred back to main thread
 }
 
+/** Progress of a chunked reply, shared by the worker writing it and the
+ * event loop sending it */
+struct HTTPReplyProgress
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    //! Chunks handed to the event loop
+    uint64_t nQueued = 0;
+    //! Chunks handed to libevent
+    uint64_t nSent = 0;
+    //! Chunks written to the socket
+    uint64_t nWritten = 0;
+};
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+/** Called by libevent once the output buffer of the connection is drained,
+ * that is, every chunk sent so far was written */
+static void http_reply_written_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyProgress* progress = static_cast<HTTPReplyProgress*>(arg);
+    std::lock_guard<std::mutex> lock(progress->cs);
+    progress->nWritten = progress->nSent;
+    progress->cond.notify_all();
+}
+#endif
+
+/** Like WriteReply, but the request stays with the worker thread. The events
+ * are handled in the order they are triggered, so the chunks arrive in order.
+ */
+void HTTPRequest::WriteReplyChunk(int nStatus, const std::string& strChunk)
+{
+    assert(!replySent && req);
+    const bool start = !replyChunked;
+    if (start) {
+        replyProgress = std::make_shared<HTTPReplyProgress>();
+    }
+    std::shared_ptr<HTTPReplyProgress> progress = replyProgress;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    {
+        // Give a client that stopped reading until the server timeout, after
+        // which libevent drops the connection
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT));
+        std::unique_lock<std::mutex> lock(progress->cs);
+        progress->cond.wait_until(lock, deadline, [&progress] {
+            return progress->nQueued - progress->nWritten < MAX_UNWRITTEN_REPLY_CHUNKS;
+        });
+        progress->nQueued++;
+    }
+#endif
+    struct evbuffer* chunk = evbuffer_new();
+    assert(chunk);
+    evbuffer_add(chunk, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus, start, chunk, progress]{
+        if (start) {
+            evhttp_send_reply_start(req_copy, nStatus, nullptr);
+        }
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        {
+            std::lock_guard<std::mutex> lock(progress->cs);
+            progress->nSent++;
+        }
+        evhttp_send_reply_chunk_with_cb(req_copy, chunk, http_reply_written_cb, progress.get());
+#else
+        evhttp_send_reply_chunk(req_copy, chunk);
+#endif
+        evbuffer_free(chunk);
+    });
+    ev->trigger(nullptr);
+    replyChunked = true;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -646,10 +868,11 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         HTTPWorkLane lane, const HTTPLaneSelector& selectLane)
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, lane, selectLane));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
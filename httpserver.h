@@ -5,11 +5,17 @@
 #ifndef SALEMCASH_HTTPSERVER_H
 #define SALEMCASH_HTTPSERVER_H
 
+#include <array>
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_HEAVY_THREADS=2;
+static const int DEFAULT_HTTP_WALLET_THREADS=2;
+static const int DEFAULT_HTTP_REST_THREADS=2;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -38,21 +44,91 @@ void StopHTTPServer();
  * libevent doesn't support debug logging.*/
 bool UpdateHTTPServerLogging(bool enable);
 
+/** Lanes of the HTTP work queue. Each lane has its own queue and worker
+ * threads, so that slow requests in one lane cannot hold up the others.
+ */
+enum class HTTPWorkLane {
+    REST,       //!< REST interface (-restthreads)
+    RPC,        //!< RPC calls that return quickly (-rpcthreads)
+    RPC_HEAVY,  //!< RPC calls that may take long, and batches with them (-rpcheavythreads)
+    WALLET,     //!< RPC calls to the wallet (-rpcwalletthreads)
+};
+static const size_t HTTP_WORK_LANES = 4;
+
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Chooses the lane for a request before it is handed to a worker thread.
+ * This runs on the event loop thread, so it has to be quick.
+ */
+typedef std::function<HTTPWorkLane(HTTPRequest* req)> HTTPLaneSelector;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests go to the given lane, or the one selectLane picks.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         HTTPWorkLane lane = HTTPWorkLane::RPC, const HTTPLaneSelector& selectLane = nullptr);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Run task on one of the HTTP worker threads of the lane the calling thread
+ * serves, after the work queued before. Returns false, without running it,
+ * if the queue is full or this is not an HTTP worker thread.
+ */
+bool QueueHTTPWork(const std::function<void()>& task);
+
+/** Number of worker threads in the lane the calling thread serves, or 0 */
+int HTTPLaneThreads();
+
+/** Samples counted in buckets of up to 0, 1, 2, 4, 8, ... */
+class HTTPHistogram
+{
+public:
+    static const size_t BUCKETS = 28;
+
+    HTTPHistogram() { counts.fill(0); }
+
+    void Add(uint64_t value)
+    {
+        size_t i = 0;
+        while (i < BUCKETS - 1 && (i == 0 ? value > 0 : value > (1ULL << (i - 1))))
+            i++;
+        counts[i]++;
+    }
+
+    std::vector<uint64_t> Get() const { return std::vector<uint64_t>(counts.begin(), counts.end()); }
+
+private:
+    std::array<uint64_t, BUCKETS> counts;
+};
+
+/** Statistics of one lane of the HTTP work queue */
+struct HTTPLaneStats
+{
+    std::string name;
+    int nThreads;
+    size_t nMaxDepth;
+    size_t nDepth;
+    uint64_t nRejected;
+    //! The histograms count samples in buckets of up to 0, 1, 2, 4, 8, ...
+    //! with the last bucket open ended.
+    //! Queue depth each request found on arrival
+    std::vector<uint64_t> vDepthHistogram;
+    //! Microseconds requests waited for a worker
+    std::vector<uint64_t> vWaitHistogram;
+    //! Microseconds workers took to handle requests
+    std::vector<uint64_t> vRunHistogram;
+};
+
+/** Statistics of all lanes, in the order of HTTPWorkLane */
+std::vector<HTTPLaneStats> GetHTTPLaneStats();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
 struct event_base* EventBase();
 
+struct HTTPReplyProgress;
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -61,6 +137,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyChunked;
+    //! How far the chunks of the reply got, to hold back the next one
+    std::shared_ptr<HTTPReplyProgress> replyProgress;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -100,6 +179,11 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Get the request body without consuming it.
+     */
+    std::string PeekBody();
+
     /**
      * Write output header.
      *
@@ -116,6 +200,19 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write part of the HTTP reply body.
+     * The first call sends nStatus and the headers, and the body follows in
+     * chunks, using chunked transfer encoding for HTTP/1.1 clients. Finish
+     * with WriteReply, which sends strReply as the last part.
+     * While a few chunks are still waiting to be written to the client, this
+     * waits for them first, so that a slow client does not make the reply
+     * pile up in memory.
+     *
+     * @note Call this before WriteReply, and WriteHeader before this.
+     */
+    void WriteReplyChunk(int nStatus, const std::string& strChunk);
 };
 
 /** Event handler closure.
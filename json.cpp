@@ -0,0 +1,70 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <random.h>
+#include <uint256.h>
+
+#include <assert.h>
+
+#include <univalue.h>
+
+static const int JSON_ENTRIES = 20000;
+
+// The amounts argument of a sendmany paying JSON_ENTRIES addresses
+static std::string SendManyJSON()
+{
+    FastRandomContext rng(true);
+    UniValue amounts(UniValue::VOBJ);
+    for (int i = 0; i < JSON_ENTRIES; i++) {
+        amounts.__pushKV("SZ" + rng.rand256().GetHex().substr(0, 32), UniValue(UniValue::VNUM, "0.00012345"));
+    }
+    return amounts.write();
+}
+
+// The inputs argument of a createrawtransaction spending JSON_ENTRIES outputs
+static std::string CreateRawTransactionJSON()
+{
+    FastRandomContext rng(true);
+    UniValue inputs(UniValue::VARR);
+    for (int i = 0; i < JSON_ENTRIES; i++) {
+        UniValue input(UniValue::VOBJ);
+        input.pushKV("txid", rng.rand256().GetHex());
+        input.pushKV("vout", (int)rng.randrange(100));
+        input.pushKV("sequence", (int64_t)0xfffffffe);
+        inputs.push_back(input);
+    }
+    return inputs.write();
+}
+
+static void JSONParse(benchmark::State& state, const std::string& strJSON)
+{
+    while (state.KeepRunning()) {
+        UniValue value;
+        bool read = value.read(strJSON);
+        assert(read);
+    }
+}
+
+static void JSONWrite(benchmark::State& state, const std::string& strJSON)
+{
+    UniValue value;
+    bool read = value.read(strJSON);
+    assert(read);
+    while (state.KeepRunning()) {
+        std::string strWritten = value.write();
+        assert(strWritten.size() == strJSON.size());
+    }
+}
+
+static void JSONParseSendMany(benchmark::State& state) { JSONParse(state, SendManyJSON()); }
+static void JSONParseCreateRawTransaction(benchmark::State& state) { JSONParse(state, CreateRawTransactionJSON()); }
+static void JSONWriteSendMany(benchmark::State& state) { JSONWrite(state, SendManyJSON()); }
+static void JSONWriteCreateRawTransaction(benchmark::State& state) { JSONWrite(state, CreateRawTransactionJSON()); }
+
+BENCHMARK(JSONParseSendMany, 20);
+BENCHMARK(JSONParseCreateRawTransaction, 10);
+BENCHMARK(JSONWriteSendMany, 50);
+BENCHMARK(JSONWriteCreateRawTransaction, 20);
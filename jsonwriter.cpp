@@ -0,0 +1,119 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonwriter.h>
+
+#include <assert.h>
+
+void JSONValueWriter::Begin(UniValue::VType type)
+{
+    m_open.emplace_back(m_key, UniValue(type));
+    m_key.clear();
+}
+
+void JSONValueWriter::End()
+{
+    assert(!m_open.empty());
+    std::pair<std::string, UniValue> closed = std::move(m_open.back());
+    m_open.pop_back();
+    m_key = std::move(closed.first);
+    Add(std::move(closed.second));
+}
+
+void JSONValueWriter::Value(const UniValue& value)
+{
+    Add(UniValue(value));
+}
+
+void JSONValueWriter::Add(UniValue&& value)
+{
+    if (m_open.empty()) {
+        m_root = std::move(value);
+    } else if (m_open.back().second.isObject()) {
+        m_open.back().second.pushKV(m_key, std::move(value));
+    } else {
+        m_open.back().second.push_back(std::move(value));
+    }
+    m_key.clear();
+}
+
+JSONStreamWriter::JSONStreamWriter(SinkFn sink, size_t nChunkSize)
+    : m_sink(std::move(sink)), m_chunk_size(nChunkSize), m_flushed(false), m_after_key(false)
+{
+    m_buffer.reserve(m_chunk_size + m_chunk_size / 4);
+}
+
+void JSONStreamWriter::Separator()
+{
+    if (m_after_key) {
+        m_after_key = false;
+    } else if (!m_first.empty()) {
+        if (!m_first.back()) {
+            m_buffer += ',';
+        }
+        m_first.back() = false;
+    }
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (m_buffer.size() >= m_chunk_size) {
+        m_sink(m_buffer);
+        m_buffer.clear();
+        m_flushed = true;
+    }
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separator();
+    m_buffer += '{';
+    m_first.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!m_first.empty() && !m_after_key);
+    m_buffer += '}';
+    m_first.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separator();
+    m_buffer += '[';
+    m_first.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!m_first.empty() && !m_after_key);
+    m_buffer += ']';
+    m_first.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!m_first.empty() && !m_after_key);
+    Separator();
+    m_buffer += UniValue(key).write();
+    m_buffer += ':';
+    m_after_key = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    Separator();
+    m_buffer += value.write();
+    MaybeFlush();
+}
+
+std::string JSONStreamWriter::TakeBuffer()
+{
+    std::string ret;
+    ret.swap(m_buffer);
+    return ret;
+}
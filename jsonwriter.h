@@ -0,0 +1,101 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_RPC_JSONWRITER_H
+#define SALEMCASH_RPC_JSONWRITER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Size of the pieces a JSONStreamWriter hands out */
+static const size_t DEFAULT_JSON_CHUNK_SIZE = 64 * 1024;
+
+/** Receives a JSON document piece by piece, so that a large one never has to
+ *  be held as a whole. Values are written as a whole, while objects and
+ *  arrays can be opened and closed around the members written in between. */
+class JSONWriter
+{
+public:
+    virtual ~JSONWriter() {}
+
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+    /** The key of the next value, object or array, inside an object */
+    virtual void Key(const std::string& key) = 0;
+    virtual void Value(const UniValue& value) = 0;
+
+    void KeyValue(const std::string& key, const UniValue& value)
+    {
+        Key(key);
+        Value(value);
+    }
+};
+
+/** Builds the document as a UniValue, for callers that need it as a whole */
+class JSONValueWriter : public JSONWriter
+{
+public:
+    void BeginObject() override { Begin(UniValue::VOBJ); }
+    void EndObject() override { End(); }
+    void BeginArray() override { Begin(UniValue::VARR); }
+    void EndArray() override { End(); }
+    void Key(const std::string& key) override { m_key = key; }
+    void Value(const UniValue& value) override;
+
+    const UniValue& GetValue() const { return m_root; }
+
+private:
+    UniValue m_root;
+    //! Objects and arrays not closed yet, with the keys they go under
+    std::vector<std::pair<std::string, UniValue>> m_open;
+    std::string m_key;
+
+    void Begin(UniValue::VType type);
+    //! Closed objects and arrays are moved into their parent, not copied
+    void End();
+    void Add(UniValue&& value);
+};
+
+/** Renders the document as JSON text and hands it to a sink in pieces of
+ *  about nChunkSize bytes. What is left once the document is complete is
+ *  taken with TakeBuffer. */
+class JSONStreamWriter : public JSONWriter
+{
+public:
+    typedef std::function<void(const std::string& chunk)> SinkFn;
+
+    explicit JSONStreamWriter(SinkFn sink, size_t nChunkSize = DEFAULT_JSON_CHUNK_SIZE);
+
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Value(const UniValue& value) override;
+
+    /** Whether any of the document was handed to the sink yet */
+    bool HasFlushed() const { return m_flushed; }
+    /** The text not handed to the sink yet */
+    std::string TakeBuffer();
+
+private:
+    SinkFn m_sink;
+    const size_t m_chunk_size;
+    std::string m_buffer;
+    bool m_flushed;
+    //! Per open object or array, whether it has no members yet
+    std::vector<bool> m_first;
+    //! Whether a key was just written, so no separator is due
+    bool m_after_key;
+
+    void Separator();
+    void MaybeFlush();
+};
+
+#endif // SALEMCASH_RPC_JSONWRITER_H
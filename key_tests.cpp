@@ -152,4 +152,66 @@ BOOST_AUTO_TEST_CASE(key_test1)
     BOOST_CHECK(detsigc == ParseHex("2052d8a32079c11e79db95af63bb9600c5b04f21a9ca33dc129c2bfa8ac9dc1cd561d8ae5e0f6c1a16bde3719c64c2fd70e404b6428ab9a69566962e8771b5944d"));
 }
 
+/** Big-endian scalar, and the public key of the secret, with a small integer value. */
+static uint256 SmallScalar(unsigned char n)
+{
+    uint256 ret;
+    *(ret.end() - 1) = n;
+    return ret;
+}
+
+static CPubKey SmallPubKey(unsigned char n)
+{
+    uint256 secret = SmallScalar(n);
+    CKey key;
+    key.Set(secret.begin(), secret.end(), true);
+    return key.GetPubKey();
+}
+
+BOOST_AUTO_TEST_CASE(pubkey_multi_scalar_mul)
+{
+    CPubKey result;
+    const uint256 two = SmallScalar(2);
+
+    // Generator term only
+    BOOST_CHECK(CPubKey::MultiScalarMul(result, &two, {}, {}));
+    BOOST_CHECK(result == SmallPubKey(2));
+
+    // 3*(5G) + 4*(5G) == 35G, with and without a 2G term
+    const CPubKey five = SmallPubKey(5);
+    BOOST_CHECK(CPubKey::MultiScalarMul(result, nullptr, {five, five}, {SmallScalar(3), SmallScalar(4)}));
+    BOOST_CHECK(result == SmallPubKey(35));
+    BOOST_CHECK(CPubKey::MultiScalarMul(result, &two, {five, five}, {SmallScalar(3), SmallScalar(4)}));
+    BOOST_CHECK(result == SmallPubKey(37));
+    BOOST_CHECK(CPubKey::MultiScalarMul(result, &two, {five, five}, {SmallScalar(3), SmallScalar(4)}, false));
+    CPubKey uncompressed = SmallPubKey(37);
+    BOOST_CHECK(uncompressed.Decompress());
+    BOOST_CHECK(result == uncompressed);
+
+    // A larger batch agrees with adding up the terms by hand: sum(i*(iG)) == (sum(i*i))G
+    std::vector<CPubKey> pubkeys;
+    std::vector<uint256> scalars;
+    unsigned int expected = 0;
+    for (unsigned char i = 1; i <= 11; i++) {
+        pubkeys.push_back(SmallPubKey(i));
+        scalars.push_back(SmallScalar(i));
+        expected += i * i;
+    }
+    BOOST_CHECK(CPubKey::MultiScalarMul(result, nullptr, pubkeys, scalars));
+    CKey key;
+    uint256 secret;
+    *(secret.end() - 2) = expected >> 8;
+    *(secret.end() - 1) = expected & 0xff;
+    key.Set(secret.begin(), secret.end(), true);
+    BOOST_CHECK(result == key.GetPubKey());
+
+    // Mismatched inputs, invalid keys and overflowing scalars are rejected
+    BOOST_CHECK(!CPubKey::MultiScalarMul(result, nullptr, {five}, {}));
+    BOOST_CHECK(!CPubKey::MultiScalarMul(result, nullptr, {CPubKey()}, {two}));
+    const uint256 overflow = uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    BOOST_CHECK(!CPubKey::MultiScalarMul(result, nullptr, {five}, {overflow}));
+    // An empty sum is the point at infinity
+    BOOST_CHECK(!CPubKey::MultiScalarMul(result, nullptr, {}, {}));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
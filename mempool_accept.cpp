@@ -0,0 +1,198 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <consensus/consensus.h>
+#include <consensus/validation.h>
+#include <fs.h>
+#include <key.h>
+#include <keystore.h>
+#include <miner.h>
+#include <pow.h>
+#include <pubkey.h>
+#include <scheduler.h>
+#include <script/sigcache.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <txdb.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+static const size_t FANOUT_TXS = 5;
+static const size_t FANOUT_OUTPUTS = 1000;
+
+/** A regtest chain with FANOUT_TXS * FANOUT_OUTPUTS confirmed P2PKH outputs
+ *  to a single key, set up once for all benchmarks below */
+class AcceptChain
+{
+public:
+    CBasicKeyStore keystore;
+    CScript scriptPubKey;
+    std::vector<CTxOut> vOutputs;
+    std::vector<COutPoint> vOutpoints;
+
+    AcceptChain()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        InitSignatureCache();
+        InitScriptExecutionCache();
+        pathTemp = fs::temp_directory_path() / strprintf("bench_salemcash_accept_%lu", (unsigned long)GetTime());
+        fs::create_directories(pathTemp);
+        gArgs.ForceSetArg("-datadir", pathTemp.string());
+
+        CKey key;
+        key.MakeNewKey(true);
+        keystore.AddKey(key);
+        scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+        threadGroup.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+        GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+        GetMainSignals().RegisterWithMempoolSignals(mempool);
+        pblocktree.reset(new CBlockTreeDB(1 << 20, true));
+        pcashdbview.reset(new CCashViewDB(1 << 23, true));
+        pcashTip.reset(new CCashViewCache(pcashdbview.get()));
+        bool loaded = LoadGenesisBlock(Params());
+        assert(loaded);
+        CValidationState state;
+        bool activated = ActivateBestChain(state, Params());
+        assert(activated);
+
+        // Mature cashbases, each fanned out to many outputs
+        std::vector<CTransactionRef> vCashbases;
+        for (int i = 0; i < CASHBASE_MATURITY + (int)FANOUT_TXS; i++) {
+            MineBlock();
+            LOCK(cs_main);
+            CBlock block;
+            bool read = ReadBlockFromDisk(block, chainActive.Tip(), Params().GetConsensus());
+            assert(read);
+            vCashbases.push_back(block.vtx[0]);
+        }
+        for (size_t i = 0; i < FANOUT_TXS; i++) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back(COutPoint(vCashbases[i]->GetHash(), 0));
+            const CAmount nFee = 100000;
+            for (size_t j = 0; j < FANOUT_OUTPUTS; j++) {
+                tx.vout.emplace_back((vCashbases[i]->vout[0].nValue - nFee) / FANOUT_OUTPUTS, scriptPubKey);
+            }
+            bool signed_ok = SignSignature(keystore, *vCashbases[i], tx, 0, SIGHASH_ALL);
+            assert(signed_ok);
+            CTransactionRef ptx = MakeTransactionRef(std::move(tx));
+            for (size_t j = 0; j < FANOUT_OUTPUTS; j++) {
+                vOutpoints.emplace_back(ptx->GetHash(), j);
+                vOutputs.push_back(ptx->vout[j]);
+            }
+            LOCK2(cs_main, mempool.cs);
+            LockPoints lp;
+            mempool.addUnchecked(ptx->GetHash(), CTxMemPoolEntry(ptx, nFee, GetTime(), chainActive.Height(), false, 0, lp));
+        }
+        while (mempool.size() > 0) {
+            MineBlock();
+        }
+    }
+
+    ~AcceptChain()
+    {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        GetMainSignals().FlushBackgroundCallbacks();
+        GetMainSignals().UnregisterBackgroundSignalScheduler();
+        GetMainSignals().UnregisterWithMempoolSignals(mempool);
+        UnloadBlockIndex();
+        pcashTip.reset();
+        pcashdbview.reset();
+        pblocktree.reset();
+        fs::remove_all(pathTemp);
+    }
+
+    /** Sign nBatches batches of nTxs transactions each spending one of the
+     *  outputs. The batches spend the same outputs at different fees, so no
+     *  batch finds its signatures in the cache of an earlier one. */
+    std::vector<std::vector<CTransactionRef>> SignBatches(size_t nBatches, size_t nTxs)
+    {
+        assert(nTxs <= vOutpoints.size());
+        std::vector<std::vector<CTransactionRef>> vBatches(nBatches);
+        for (size_t b = 0; b < nBatches; b++) {
+            vBatches[b].reserve(nTxs);
+            for (size_t i = 0; i < nTxs; i++) {
+                CMutableTransaction tx;
+                tx.vin.emplace_back(vOutpoints[i]);
+                tx.vout.emplace_back(vOutputs[i].nValue - 1000 - b, scriptPubKey);
+                bool signed_ok = SignSignature(keystore, vOutputs[i].scriptPubKey, tx, 0, vOutputs[i].nValue, SIGHASH_ALL);
+                assert(signed_ok);
+                vBatches[b].push_back(MakeTransactionRef(std::move(tx)));
+            }
+        }
+        return vBatches;
+    }
+
+private:
+    ECCVerifyHandle verifyHandle;
+    fs::path pathTemp;
+    boost::thread_group threadGroup;
+    CScheduler scheduler;
+
+    void MineBlock()
+    {
+        std::unique_ptr<CBlockTemplate> ptemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey);
+        CBlock& block = ptemplate->block;
+        unsigned int nExtraNonce = 0;
+        {
+            LOCK(cs_main);
+            IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+        }
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+        bool processed = ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr);
+        assert(processed);
+    }
+};
+
+static AcceptChain& GetAcceptChain()
+{
+    static AcceptChain chain;
+    return chain;
+}
+
+// Feed a batch of pre-signed transactions to AcceptToMemoryPool from
+// nThreads threads at once, as the message handler workers do with tx
+// messages from different peers
+static void MempoolAccept(benchmark::State& state, size_t nTxs, int nThreads)
+{
+    std::vector<std::vector<CTransactionRef>> vBatches = GetAcceptChain().SignBatches(state.m_num_evals * state.m_num_iters, nTxs);
+    size_t nBatch = 0;
+    while (state.KeepRunning()) {
+        const std::vector<CTransactionRef>& vtx = vBatches[nBatch++ % vBatches.size()];
+        boost::thread_group tg;
+        for (int t = 0; t < nThreads; t++) {
+            tg.create_thread([&vtx, t, nThreads] {
+                for (size_t i = t; i < vtx.size(); i += nThreads) {
+                    CValidationState val_state;
+                    bool accepted = AcceptToMemoryPool(mempool, val_state, vtx[i], nullptr, nullptr, false, 0);
+                    assert(accepted);
+                }
+            });
+        }
+        tg.join_all();
+        assert(mempool.size() == vtx.size());
+        mempool.clear();
+    }
+}
+
+static void MempoolAccept_1(benchmark::State& state) { MempoolAccept(state, 5000, 1); }
+static void MempoolAccept_2(benchmark::State& state) { MempoolAccept(state, 5000, 2); }
+static void MempoolAccept_4(benchmark::State& state) { MempoolAccept(state, 5000, 4); }
+static void MempoolAccept_8(benchmark::State& state) { MempoolAccept(state, 5000, 8); }
+
+BENCHMARK(MempoolAccept_1, 1);
+BENCHMARK(MempoolAccept_2, 1);
+BENCHMARK(MempoolAccept_4, 1);
+BENCHMARK(MempoolAccept_8, 1);
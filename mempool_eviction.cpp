@@ -111,4 +111,87 @@ static void MempoolEviction(benchmark::State& state)
     }
 }
 
+// A long chain of transactions with alternating fees: every addition extends
+// the same cluster, which has to be relinearized before mining or eviction.
+static void MempoolClusterChain(benchmark::State& state)
+{
+    const size_t CHAIN_LENGTH = 500;
+    std::vector<CTransactionRef> vtx;
+    uint256 prevHash;
+    for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+        CMutableTransaction tx = CMutableTransaction();
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vin[0].prevout = COutPoint(prevHash, 0);
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * CASH;
+        vtx.push_back(MakeTransactionRef(tx));
+        prevHash = vtx.back()->GetHash();
+    }
+
+    CTxMemPool pool;
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < vtx.size(); i++) {
+            AddTx(*vtx[i], i % 2 ? 20000LL : 1000LL, pool);
+        }
+        {
+            LOCK(pool.cs);
+            assert(!pool.GetChunksByFeeRate().empty());
+        }
+        pool.TrimToSize(pool.DynamicMemoryUsage() / 2);
+        pool.clear();
+    }
+}
+
+// A parent fanning out to many children which are all spent by a single
+// transaction, so that the cluster has many competing ancestor sets.
+static void MempoolClusterDiamond(benchmark::State& state)
+{
+    const size_t WIDTH = 100;
+    CMutableTransaction parent = CMutableTransaction();
+    parent.vin.resize(1);
+    parent.vin[0].scriptSig = CScript() << OP_1;
+    parent.vout.resize(WIDTH);
+    for (size_t i = 0; i < WIDTH; i++) {
+        parent.vout[i].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        parent.vout[i].nValue = 10 * CASH;
+    }
+    std::vector<CTransactionRef> vChildren;
+    CMutableTransaction sink = CMutableTransaction();
+    sink.vout.resize(1);
+    sink.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    sink.vout[0].nValue = 10 * CASH;
+    for (size_t i = 0; i < WIDTH; i++) {
+        CMutableTransaction child = CMutableTransaction();
+        child.vin.resize(1);
+        child.vin[0].prevout = COutPoint(parent.GetHash(), i);
+        child.vin[0].scriptSig = CScript() << OP_2;
+        child.vout.resize(1);
+        child.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+        child.vout[0].nValue = 10 * CASH;
+        vChildren.push_back(MakeTransactionRef(child));
+        sink.vin.emplace_back(COutPoint(vChildren.back()->GetHash(), 0));
+    }
+
+    CTxMemPool pool;
+
+    while (state.KeepRunning()) {
+        AddTx(parent, 1000LL, pool);
+        for (size_t i = 0; i < vChildren.size(); i++) {
+            AddTx(*vChildren[i], 1000LL + (i * 7919) % 20000, pool);
+        }
+        AddTx(sink, 50000LL, pool);
+        {
+            LOCK(pool.cs);
+            assert(!pool.GetChunksByFeeRate().empty());
+        }
+        pool.TrimToSize(pool.DynamicMemoryUsage() / 2);
+        pool.clear();
+    }
+}
+
 BENCHMARK(MempoolEviction, 41000);
+BENCHMARK(MempoolClusterChain, 20);
+BENCHMARK(MempoolClusterDiamond, 50);
@@ -523,14 +523,16 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     pool.addUnchecked(tx6.GetHash(), entry.Fee(1100LL).FromTx(tx6));
     pool.addUnchecked(tx7.GetHash(), entry.Fee(9000LL).FromTx(tx7));
 
-    // we only require this to remove, at max, 2 txn, because it's not clear what we're really optimizing for aside from that
+    // tx7 pays for tx5 and tx6, but not enough to join tx4's chunk: that last chunk goes as a whole
     pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
     BOOST_CHECK(pool.exists(tx4.GetHash()));
-    BOOST_CHECK(pool.exists(tx6.GetHash()));
+    BOOST_CHECK(!pool.exists(tx5.GetHash()));
+    BOOST_CHECK(!pool.exists(tx6.GetHash()));
     BOOST_CHECK(!pool.exists(tx7.GetHash()));
 
-    if (!pool.exists(tx5.GetHash()))
-        pool.addUnchecked(tx5.GetHash(), entry.Fee(1000LL).FromTx(tx5));
+    // With tx6 paying for tx4, tx5 and tx7 make up the last chunk
+    pool.addUnchecked(tx5.GetHash(), entry.Fee(1000LL).FromTx(tx5));
+    pool.addUnchecked(tx6.GetHash(), entry.Fee(50000LL).FromTx(tx6));
     pool.addUnchecked(tx7.GetHash(), entry.Fee(9000LL).FromTx(tx7));
 
     pool.TrimToSize(pool.DynamicMemoryUsage() / 2); // should maximize mempool size by only removing 5/7
@@ -571,4 +573,130 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+static std::vector<std::vector<uint256>> GetChunkHashes(CTxMemPool& pool)
+{
+    LOCK(pool.cs);
+    std::vector<std::vector<uint256>> chunks;
+    for (const CTxMemPool::TxClusterChunk* chunk : pool.GetChunksByFeeRate()) {
+        chunks.emplace_back();
+        for (CTxMemPool::txiter it : chunk->vTxs) {
+            chunks.back().push_back(it->GetTx().GetHash());
+        }
+    }
+    return chunks;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClusterTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    // Low-fee parent, high-fee child: mined together, parent first
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(2);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * CASH;
+    tx1.vout[1].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[1].nValue = 10 * CASH;
+    pool.addUnchecked(tx1.GetHash(), entry.Fee(1000LL).FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * CASH;
+    pool.addUnchecked(tx2.GetHash(), entry.Fee(20000LL).FromTx(tx2));
+
+    std::vector<std::vector<uint256>> chunks = GetChunkHashes(pool);
+    BOOST_CHECK_EQUAL(chunks.size(), 1);
+    BOOST_CHECK(chunks[0] == std::vector<uint256>({tx1.GetHash(), tx2.GetHash()}));
+    {
+        LOCK(pool.cs);
+        CFeeRate chunkRate(21000, GetVirtualTransactionSize(tx1) + GetVirtualTransactionSize(tx2));
+        BOOST_CHECK(pool.GetChunkFeeRate(pool.mapTx.find(tx1.GetHash())) == chunkRate);
+        BOOST_CHECK(pool.GetChunkFeeRate(pool.mapTx.find(tx2.GetHash())) == chunkRate);
+    }
+
+    // A second, low-fee child joins the cluster but not tx1's chunk
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(tx1.GetHash(), 1);
+    tx3.vin[0].scriptSig = CScript() << OP_3;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * CASH;
+    pool.addUnchecked(tx3.GetHash(), entry.Fee(500LL).FromTx(tx3));
+
+    chunks = GetChunkHashes(pool);
+    BOOST_CHECK_EQUAL(chunks.size(), 2);
+    BOOST_CHECK(chunks[0] == std::vector<uint256>({tx1.GetHash(), tx2.GetHash()}));
+    BOOST_CHECK(chunks[1] == std::vector<uint256>({tx3.GetHash()}));
+
+    // Once tx1 is mined, its children are unrelated and ordered by their own feerate
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeTransactionRef(tx1));
+    pool.removeForBlock(vtx, 1);
+
+    chunks = GetChunkHashes(pool);
+    BOOST_CHECK_EQUAL(chunks.size(), 2);
+    BOOST_CHECK(chunks[0] == std::vector<uint256>({tx2.GetHash()}));
+    BOOST_CHECK(chunks[1] == std::vector<uint256>({tx3.GetHash()}));
+
+    // Prioritising tx3 reorders the chunks
+    pool.PrioritiseTransaction(tx3.GetHash(), 100000LL);
+    chunks = GetChunkHashes(pool);
+    BOOST_CHECK_EQUAL(chunks.size(), 2);
+    BOOST_CHECK(chunks[0] == std::vector<uint256>({tx3.GetHash()}));
+    BOOST_CHECK(chunks[1] == std::vector<uint256>({tx2.GetHash()}));
+
+    // The memory usage components add up
+    CTxMemPool::MemoryUsageStats stats = pool.GetMemoryUsageStats();
+    BOOST_CHECK(stats.nEntries > 0);
+    BOOST_CHECK_EQUAL(stats.nTransactions + stats.nEntries + stats.nLinks + stats.nClusters + stats.nSpends + stats.nOther + stats.nPoolFree, pool.DynamicMemoryUsage());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolClearTest)
+{
+    // The entry pool keeps the nodes that survive clearing mapTx
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    for (int round = 0; round < 2; round++) {
+        CMutableTransaction parent = CMutableTransaction();
+        parent.vin.resize(1);
+        parent.vin[0].scriptSig = CScript() << round;
+        parent.vout.resize(100);
+        for (CTxOut& out : parent.vout) {
+            out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+            out.nValue = CASH;
+        }
+        pool.addUnchecked(parent.GetHash(), entry.Fee(1000LL).FromTx(parent));
+        for (uint32_t n = 0; n < parent.vout.size(); n++) {
+            CMutableTransaction child = CMutableTransaction();
+            child.vin.resize(1);
+            child.vin[0].prevout = COutPoint(parent.GetHash(), n);
+            child.vin[0].scriptSig = CScript() << OP_1;
+            child.vout.resize(1);
+            child.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+            child.vout[0].nValue = CASH;
+            pool.addUnchecked(child.GetHash(), entry.Fee(1000LL).FromTx(child));
+        }
+        BOOST_CHECK_EQUAL(pool.size(), 101U);
+        const size_t full_usage = pool.DynamicMemoryUsage();
+
+        pool.clear();
+        BOOST_CHECK_EQUAL(pool.size(), 0U);
+        BOOST_CHECK(!pool.exists(parent.GetHash()));
+        // The freed entries are kept for reuse and still counted
+        CTxMemPool::MemoryUsageStats stats = pool.GetMemoryUsageStats();
+        BOOST_CHECK(stats.nPoolFree > 0);
+        BOOST_CHECK_EQUAL(stats.nTransactions, 0U);
+        BOOST_CHECK(pool.DynamicMemoryUsage() < full_usage);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,7 +5,9 @@
 #ifndef SALEMCASH_MEMUSAGE_H
 #define SALEMCASH_MEMUSAGE_H
 
+#include <flathashmap.h>
 #include <indirectmap.h>
+#include <prevector.h>
 
 #include <stdlib.h>
 
@@ -163,6 +165,24 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+// flathashmap stores one control byte and one pointer per bucket, and its
+// elements in pool chunks that are only released by clear(). Chunks hold a
+// multiple of MIN_CHUNK_ELEMENTS, so malloc rounds each of them up by the
+// same amount.
+template<typename X, typename Y, typename Z, typename W>
+static inline size_t DynamicUsage(const flathashmap<X, Y, Z, W>& m)
+{
+    size_t usage = 0;
+    if (m.bucket_count()) {
+        usage += MallocUsage(m.bucket_count()) + MallocUsage(sizeof(void*) * m.bucket_count());
+    }
+    if (m.pool_chunk_count()) {
+        const size_t min_chunk = sizeof(std::pair<const X, Y>) * flathashmap<X, Y, Z, W>::MIN_CHUNK_ELEMENTS;
+        usage += sizeof(std::pair<const X, Y>) * m.pool_capacity() + (MallocUsage(min_chunk) - min_chunk) * m.pool_chunk_count();
+    }
+    return usage;
+}
+
 }
 
 #endif // SALEMCASH_MEMUSAGE_H
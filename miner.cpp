@@ -31,8 +31,8 @@
 
 // Unconfirmed transactions in the memory pool often depend on other
 // transactions in the memory pool. When we select transactions from the
-// pool, we select by highest fee rate of a transaction combined with all
-// its ancestors.
+// pool, we select by the feerate of the chunks the mempool's clusters are
+// linearized into.
 
 uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockWeight = 0;
@@ -96,6 +96,7 @@ void BlockAssembler::resetBlock()
     // These counters do not include cashbase tx
     nBlockTx = 0;
     nFees = 0;
+    lowestPackageFeeRate = CFeeRate(MAX_MONEY);
 }
 
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx)
@@ -142,8 +143,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus()) && fMineWitnessTx;
 
     int nPackagesSelected = 0;
-    int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    addPackageTxs(nPackagesSelected);
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -177,24 +177,11 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
 
-void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
-{
-    for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
-        // Only test txs not already in the block
-        if (inBlock.count(*iit)) {
-            testSet.erase(iit++);
-        }
-        else {
-            iit++;
-        }
-    }
-}
-
 bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost) const
 {
     // TODO: switch to weight-based accounting for packages instead of vsize-based accounting.
@@ -209,7 +196,7 @@ bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost
 // - transaction finality (locktime)
 // - premature witness (in case segwit transactions are added to mempool before
 //   segwit activation)
-bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package)
+bool BlockAssembler::TestPackageTransactions(const std::vector<CTxMemPool::txiter>& package)
 {
     for (const CTxMemPool::txiter it : package) {
         if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
@@ -220,6 +207,17 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
     return true;
 }
 
+bool BlockAssembler::TestPackageParents(const std::vector<CTxMemPool::txiter>& package) const
+{
+    for (const CTxMemPool::txiter it : package) {
+        for (const CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+            if (!inBlock.count(parent) && std::find(package.begin(), package.end(), parent) == package.end())
+                return false;
+        }
+    }
+    return true;
+}
+
 void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
 {
     pblock->vtx.emplace_back(iter->GetSharedTx());
@@ -239,152 +237,27 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     }
 }
 
-int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
-        indexed_modified_transaction_set &mapModifiedTx)
+// The mempool keeps its clusters linearized, and each linearization split
+// into chunks of non-increasing feerate, the best ancestor sets first. So
+// taking all chunks by decreasing feerate gives a valid block order, without
+// having to update the ancestor state of transactions as their parents get
+// included. A chunk that does not fit is skipped; a later chunk of the same
+// cluster may still fit if it does not depend on it.
+void BlockAssembler::addPackageTxs(int &nPackagesSelected)
 {
-    int nDescendantsUpdated = 0;
-    for (const CTxMemPool::txiter it : alreadyAdded) {
-        CTxMemPool::setEntries descendants;
-        mempool.CalculateDescendants(it, descendants);
-        // Insert all descendants (not yet in block) into the modified set
-        for (CTxMemPool::txiter desc : descendants) {
-            if (alreadyAdded.count(desc))
-                continue;
-            ++nDescendantsUpdated;
-            modtxiter mit = mapModifiedTx.find(desc);
-            if (mit == mapModifiedTx.end()) {
-                CTxMemPoolModifiedEntry modEntry(desc);
-                modEntry.nSizeWithAncestors -= it->GetTxSize();
-                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
-                modEntry.nSigOpCostWithAncestors -= it->GetSigOpCost();
-                mapModifiedTx.insert(modEntry);
-            } else {
-                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
-            }
-        }
-    }
-    return nDescendantsUpdated;
-}
-
-// Skip entries in mapTx that are already in a block or are present
-// in mapModifiedTx (which implies that the mapTx ancestor state is
-// stale due to ancestor inclusion in the block)
-// Also skip transactions that we've already failed to add. This can happen if
-// we consider a transaction in mapModifiedTx and it fails: we can then
-// potentially consider it again while walking mapTx.  It's currently
-// guaranteed to fail again, but as a belt-and-suspenders check we put it in
-// failedTx and avoid re-evaluation, since the re-evaluation would be using
-// cached size/sigops/fee values that are not actually correct.
-bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx)
-{
-    assert (it != mempool.mapTx.end());
-    return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
-}
-
-void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries)
-{
-    // Sort package by ancestor count
-    // If a transaction A depends on transaction B, then A's ancestor count
-    // must be greater than B's.  So this is sufficient to validly order the
-    // transactions for block inclusion.
-    sortedEntries.clear();
-    sortedEntries.insert(sortedEntries.begin(), package.begin(), package.end());
-    std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
-}
-
-// This transaction selection algorithm orders the mempool based
-// on feerate of a transaction including all unconfirmed ancestors.
-// Since we don't remove transactions from the mempool as we select them
-// for block inclusion, we need an alternate method of updating the feerate
-// of a transaction with its not-yet-selected ancestors as we go.
-// This is accomplished by walking the in-mempool descendants of selected
-// transactions and storing a temporary modified state in mapModifiedTxs.
-// Each time through the loop, we compare the best transaction in
-// mapModifiedTxs with the next transaction in the mempool to decide what
-// transaction package to work on next.
-void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated)
-{
-    // mapModifiedTx will store sorted packages after they are modified
-    // because some of their txs are already in the block
-    indexed_modified_transaction_set mapModifiedTx;
-    // Keep track of entries that failed inclusion, to avoid duplicate work
-    CTxMemPool::setEntries failedTx;
-
-    // Start by adding all descendants of previously added txs to mapModifiedTx
-    // and modifying them for their already included ancestors
-    UpdatePackagesForAdded(inBlock, mapModifiedTx);
-
-    CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
-    CTxMemPool::txiter iter;
-
     // Limit the number of attempts to add transactions to the block when it is
     // close to full; this is just a simple heuristic to finish quickly if the
     // mempool has a lot of entries.
     const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
     int64_t nConsecutiveFailed = 0;
 
-    while (mi != mempool.mapTx.get<ancestor_score>().end() || !mapModifiedTx.empty())
-    {
-        // First try to find a new transaction in mapTx to evaluate.
-        if (mi != mempool.mapTx.get<ancestor_score>().end() &&
-                SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
-            ++mi;
-            continue;
-        }
-
-        // Now that mi is not stale, determine which transaction to evaluate:
-        // the next entry from mapTx, or the best from mapModifiedTx?
-        bool fUsingModified = false;
-
-        modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
-        if (mi == mempool.mapTx.get<ancestor_score>().end()) {
-            // We're out of entries in mapTx; use the entry from mapModifiedTx
-            iter = modit->iter;
-            fUsingModified = true;
-        } else {
-            // Try to compare the mapTx entry to the mapModifiedTx entry
-            iter = mempool.mapTx.project<0>(mi);
-            if (modit != mapModifiedTx.get<ancestor_score>().end() &&
-                    CompareTxMemPoolEntryByAncestorFee()(*modit, CTxMemPoolModifiedEntry(iter))) {
-                // The best entry in mapModifiedTx has higher score
-                // than the one from mapTx.
-                // Switch which transaction (package) to consider
-                iter = modit->iter;
-                fUsingModified = true;
-            } else {
-                // Either no entry in mapModifiedTx, or it's worse than mapTx.
-                // Increment mi for the next loop iteration.
-                ++mi;
-            }
-        }
-
-        // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
-        // contain anything that is inBlock.
-        assert(!inBlock.count(iter));
-
-        uint64_t packageSize = iter->GetSizeWithAncestors();
-        CAmount packageFees = iter->GetModFeesWithAncestors();
-        int64_t packageSigOpsCost = iter->GetSigOpCostWithAncestors();
-        if (fUsingModified) {
-            packageSize = modit->nSizeWithAncestors;
-            packageFees = modit->nModFeesWithAncestors;
-            packageSigOpsCost = modit->nSigOpCostWithAncestors;
-        }
-
-        if (packageFees < blockMinFeeRate.GetFee(packageSize)) {
+    for (const CTxMemPool::TxClusterChunk* chunk : mempool.GetChunksByFeeRate()) {
+        if (chunk->nModFees < blockMinFeeRate.GetFee(chunk->nSize)) {
             // Everything else we might consider has a lower fee rate
             return;
         }
 
-        if (!TestPackage(packageSize, packageSigOpsCost)) {
-            if (fUsingModified) {
-                // Since we always look at the best entry in mapModifiedTx,
-                // we must erase failed entries so that we can consider the
-                // next best entry on the next loop iteration
-                mapModifiedTx.get<ancestor_score>().erase(modit);
-                failedTx.insert(iter);
-            }
-
+        if (!TestPackage(chunk->nSize, chunk->nSigOpCost) || !TestPackageParents(chunk->vTxs)) {
             ++nConsecutiveFailed;
 
             if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockWeight >
@@ -395,41 +268,272 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
             continue;
         }
 
-        CTxMemPool::setEntries ancestors;
-        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-        std::string dummy;
-        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-
-        onlyUnconfirmed(ancestors);
-        ancestors.insert(iter);
-
         // Test if all tx's are Final
-        if (!TestPackageTransactions(ancestors)) {
-            if (fUsingModified) {
-                mapModifiedTx.get<ancestor_score>().erase(modit);
-                failedTx.insert(iter);
-            }
+        if (!TestPackageTransactions(chunk->vTxs)) {
             continue;
         }
 
-        // This transaction will make it in; reset the failed counter.
+        // This chunk will make it in; reset the failed counter.
         nConsecutiveFailed = 0;
 
-        // Package can be added. Sort the entries in a valid order.
-        std::vector<CTxMemPool::txiter> sortedEntries;
-        SortForBlock(ancestors, sortedEntries);
-
-        for (size_t i=0; i<sortedEntries.size(); ++i) {
-            AddToBlock(sortedEntries[i]);
-            // Erase from the modified set, if present
-            mapModifiedTx.erase(sortedEntries[i]);
+        // Chunks are already in a valid order
+        for (const CTxMemPool::txiter it : chunk->vTxs) {
+            AddToBlock(it);
         }
 
         ++nPackagesSelected;
+        lowestPackageFeeRate = std::min(lowestPackageFeeRate, CFeeRate(chunk->nModFees, chunk->nSize));
+    }
+}
+
+LiveBlockTemplate::LiveBlockTemplate(const CChainParams& params, const CScript& scriptPubKeyIn)
+    : chainparams(params), scriptPubKey(scriptPubKeyIn), pindexPrev(nullptr), nHeight(0), nLockTimeCutoff(0),
+      fIncludeWitness(false), nBlockMaxWeight(0), nBlockWeight(0), nBlockSigOpsCost(0), nFees(0),
+      fStale(false), nLastRebuild(0)
+{
+}
+
+void LiveBlockTemplate::Rebuild()
+{
+    LOCK2(cs_main, mempool.cs);
+    BlockAssembler assembler(chainparams);
+    std::unique_ptr<CBlockTemplate> ptemplate = assembler.CreateNewBlock(scriptPubKey);
+    if (!ptemplate)
+        throw std::runtime_error(strprintf("%s: out of memory", __func__));
+    const CBlock& block = ptemplate->block;
+
+    LOCK(cs_template);
+    pindexPrev = chainActive.Tip();
+    header = block.GetBlockHeader();
+    nHeight = assembler.nHeight;
+    nLockTimeCutoff = assembler.nLockTimeCutoff;
+    fIncludeWitness = assembler.fIncludeWitness;
+    nBlockMaxWeight = assembler.nBlockMaxWeight;
+    blockMinFeeRate = assembler.blockMinFeeRate;
+    nBlockWeight = assembler.nBlockWeight;
+    nBlockSigOpsCost = assembler.nBlockSigOpsCost;
+    nFees = assembler.nFees;
+    lowestPackageFeeRate = assembler.lowestPackageFeeRate;
+
+    vEntries.clear();
+    setTxids.clear();
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        vEntries.push_back(Entry{block.vtx[i], ptemplate->vTxFees[i], ptemplate->vTxSigOpsCost[i], GetTransactionWeight(*block.vtx[i])});
+        setTxids.insert(block.vtx[i]->GetHash());
+    }
+    // The assembled block is what the next request gets
+    pcached = std::move(ptemplate);
+    fStale = false;
+    nLastRebuild = GetTime();
+}
+
+std::shared_ptr<const CBlockTemplate> LiveBlockTemplate::GetBlockTemplate()
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs_template);
+    if (pindexPrev == nullptr || pindexPrev != chainActive.Tip())
+        return nullptr;
+    if (fStale && GetTime() - nLastRebuild >= LIVE_TEMPLATE_REBUILD_INTERVAL) {
+        // Nothing may arrive on the queue for a while to do it
+        CallFunctionInValidationInterfaceQueue([this] { MaybeRebuild(); });
+    }
+    if (pcached)
+        return pcached;
+
+    std::unique_ptr<CBlockTemplate> ptemplate(new CBlockTemplate());
+    CBlock& block = ptemplate->block;
+    block.nVersion = header.nVersion;
+    block.hashPrevBlock = header.hashPrevBlock;
+    block.nTime = header.nTime;
+    block.nBits = header.nBits;
+    block.nNonce = 0;
+
+    CMutableTransaction cashbaseTx;
+    cashbaseTx.vin.resize(1);
+    cashbaseTx.vin[0].prevout.SetNull();
+    cashbaseTx.vout.resize(1);
+    cashbaseTx.vout[0].scriptPubKey = scriptPubKey;
+    cashbaseTx.vout[0].nValue = nFees + GetBlockSubsidy(nHeight, chainparams.GetConsensus());
+    cashbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    block.vtx.reserve(vEntries.size() + 1);
+    block.vtx.push_back(MakeTransactionRef(std::move(cashbaseTx)));
+    ptemplate->vTxFees.reserve(vEntries.size() + 1);
+    ptemplate->vTxFees.push_back(-nFees);
+    ptemplate->vTxSigOpsCost.reserve(vEntries.size() + 1);
+    ptemplate->vTxSigOpsCost.push_back(-1); // updated below
+    for (const Entry& entry : vEntries) {
+        block.vtx.push_back(entry.tx);
+        ptemplate->vTxFees.push_back(entry.nFee);
+        ptemplate->vTxSigOpsCost.push_back(entry.nSigOpsCost);
+    }
+    ptemplate->vchCashbaseCommitment = GenerateCashbaseCommitment(block, pindexPrev, chainparams.GetConsensus());
+    ptemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*block.vtx[0]);
+
+    pcached = std::move(ptemplate);
+    return pcached;
+}
+
+void LiveBlockTemplate::SetStale()
+{
+    {
+        LOCK(cs_template);
+        fStale = true;
+    }
+    CallFunctionInValidationInterfaceQueue([this] { MaybeRebuild(); });
+}
 
-        // Update transactions that depend on each of these
-        nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
+void LiveBlockTemplate::MaybeRebuild()
+{
+    {
+        LOCK(cs_template);
+        if (!fStale || pindexPrev == nullptr || GetTime() - nLastRebuild < LIVE_TEMPLATE_REBUILD_INTERVAL)
+            return;
+    }
+    try {
+        Rebuild();
+    } catch (const std::runtime_error& e) {
+        // Leave it to the next request to assemble and report the error
+        LogPrintf("%s: %s\n", __func__, e.what());
+        LOCK(cs_template);
+        pindexPrev = nullptr;
+        pcached.reset();
+    }
+}
+
+void LiveBlockTemplate::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    {
+        LOCK(cs_template);
+        if (pindexPrev == pindexNew)
+            return;
+        // Blocks are not mined during initial block download
+        if (fInitialDownload) {
+            pindexPrev = nullptr;
+            pcached.reset();
+            vEntries.clear();
+            setTxids.clear();
+            vPendingAdded.clear();
+            return;
+        }
+        fStale = true;
+        nLastRebuild = 0;
+    }
+    MaybeRebuild();
+}
+
+void LiveBlockTemplate::TransactionAddedToMempool(const CTransactionRef &ptx)
+{
+    {
+        LOCK(cs_template);
+        if (pindexPrev == nullptr)
+            return;
+        vPendingAdded.push_back(ptx);
+        // Transactions come in bursts; one run adds all that arrived by then
+        if (vPendingAdded.size() > 1)
+            return;
+    }
+    CallFunctionInValidationInterfaceQueue([this] { AddPendingTransactions(); });
+}
+
+void LiveBlockTemplate::AddPendingTransactions()
+{
+    std::vector<CTransactionRef> vAdded;
+    {
+        LOCK(cs_template);
+        vAdded.swap(vPendingAdded);
+    }
+    if (vAdded.empty())
+        return;
+    {
+        LOCK2(cs_main, mempool.cs);
+        LOCK(cs_template);
+        // A new tip is dealt with by UpdatedBlockTip
+        if (pindexPrev == nullptr || pindexPrev != chainActive.Tip())
+            return;
+        for (const CTransactionRef& ptx : vAdded) {
+            AddTransaction(ptx);
+        }
+    }
+    MaybeRebuild();
+}
+
+void LiveBlockTemplate::AddTransaction(const CTransactionRef &ptx)
+{
+    AssertLockHeld(mempool.cs);
+    AssertLockHeld(cs_template);
+    if (setTxids.count(ptx->GetHash()))
+        return;
+    CTxMemPool::txiter it = mempool.mapTx.find(ptx->GetHash());
+    if (it == mempool.mapTx.end())
+        return;
+
+    // BlockAssembler would not pick these either
+    if (!IsFinalTx(*ptx, nHeight, nLockTimeCutoff) || (!fIncludeWitness && ptx->HasWitness()))
+        return;
+    if (it->GetModFeesWithAncestors() < blockMinFeeRate.GetFee(it->GetSizeWithAncestors()))
+        return;
+
+    bool fParentsIncluded = true;
+    for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+        if (!setTxids.count(parent->GetTx().GetHash())) {
+            fParentsIncluded = false;
+            break;
+        }
+    }
+    if (fParentsIncluded &&
+            it->GetModifiedFee() >= blockMinFeeRate.GetFee(it->GetTxSize()) &&
+            nBlockWeight + WITNESS_SCALE_FACTOR * it->GetTxSize() < nBlockMaxWeight &&
+            nBlockSigOpsCost + it->GetSigOpCost() < MAX_BLOCK_SIGOPS_COST) {
+        vEntries.push_back(Entry{it->GetSharedTx(), it->GetFee(), it->GetSigOpCost(), (int64_t)it->GetTxWeight()});
+        setTxids.insert(ptx->GetHash());
+        nBlockWeight += it->GetTxWeight();
+        nBlockSigOpsCost += it->GetSigOpCost();
+        nFees += it->GetFee();
+        lowestPackageFeeRate = std::min(lowestPackageFeeRate, CFeeRate(it->GetModifiedFee(), it->GetTxSize()));
+        pcached.reset();
+        return;
+    }
+    // It could have displaced part of the template
+    if (CFeeRate(it->GetModFeesWithAncestors(), it->GetSizeWithAncestors()) > lowestPackageFeeRate)
+        fStale = true;
+}
+
+void LiveBlockTemplate::TransactionRemovedFromMempool(const CTransactionRef &ptx)
+{
+    {
+        LOCK(cs_template);
+        if (!setTxids.count(ptx->GetHash()))
+            return;
+        RemoveWithDescendants(ptx->GetHash());
+        // The freed space may fit something else
+        fStale = true;
+    }
+    MaybeRebuild();
+}
+
+void LiveBlockTemplate::RemoveWithDescendants(const uint256& hash)
+{
+    AssertLockHeld(cs_template);
+    std::set<uint256> setRemoved{hash};
+    std::vector<Entry> vKept;
+    vKept.reserve(vEntries.size());
+    for (Entry& entry : vEntries) {
+        bool fRemove = setRemoved.count(entry.tx->GetHash());
+        for (const CTxIn& txin : entry.tx->vin) {
+            fRemove = fRemove || setRemoved.count(txin.prevout.hash);
+        }
+        if (fRemove) {
+            setRemoved.insert(entry.tx->GetHash());
+            setTxids.erase(entry.tx->GetHash());
+            nBlockWeight -= entry.nWeight;
+            nBlockSigOpsCost -= entry.nSigOpsCost;
+            nFees -= entry.nFee;
+        } else {
+            vKept.push_back(std::move(entry));
+        }
     }
+    vEntries.swap(vKept);
+    pcached.reset();
 }
 
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
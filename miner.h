@@ -5,13 +5,17 @@
 #ifndef SALEMCASH_MINER_H
 #define SALEMCASH_MINER_H
 
+#include <policy/feerate.h>
 #include <primitives/block.h>
+#include <script/script.h>
+#include <sync.h>
 #include <txmempool.h>
+#include <validationinterface.h>
 
 #include <stdint.h>
 #include <memory>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
+#include <set>
+#include <vector>
 
 class CBlockIndex;
 class CChainParams;
@@ -20,6 +24,8 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+/** Minimum seconds between full rebuilds of a LiveBlockTemplate that fell behind the mempool */
+static const int64_t LIVE_TEMPLATE_REBUILD_INTERVAL = 5;
 
 struct CBlockTemplate
 {
@@ -29,95 +35,6 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCashbaseCommitment;
 };
 
-// Container for tracking updates to ancestor feerate as we include (parent)
-// transactions in a block
-struct CTxMemPoolModifiedEntry {
-    explicit CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
-    {
-        iter = entry;
-        nSizeWithAncestors = entry->GetSizeWithAncestors();
-        nModFeesWithAncestors = entry->GetModFeesWithAncestors();
-        nSigOpCostWithAncestors = entry->GetSigOpCostWithAncestors();
-    }
-
-    int64_t GetModifiedFee() const { return iter->GetModifiedFee(); }
-    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
-    CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
-    size_t GetTxSize() const { return iter->GetTxSize(); }
-    const CTransaction& GetTx() const { return iter->GetTx(); }
-
-    CTxMemPool::txiter iter;
-    uint64_t nSizeWithAncestors;
-    CAmount nModFeesWithAncestors;
-    int64_t nSigOpCostWithAncestors;
-};
-
-/** Comparator for CTxMemPool::txiter objects.
- *  It simply compares the internal memory address of the CTxMemPoolEntry object
- *  pointed to. This means it has no meaning, and is only useful for using them
- *  as key in other indexes.
- */
-struct CompareCTxMemPoolIter {
-    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
-    {
-        return &(*a) < &(*b);
-    }
-};
-
-struct modifiedentry_iter {
-    typedef CTxMemPool::txiter result_type;
-    result_type operator() (const CTxMemPoolModifiedEntry &entry) const
-    {
-        return entry.iter;
-    }
-};
-
-// A comparator that sorts transactions based on number of ancestors.
-// This is sufficient to sort an ancestor package in an order that is valid
-// to appear in a block.
-struct CompareTxIterByAncestorCount {
-    bool operator()(const CTxMemPool::txiter &a, const CTxMemPool::txiter &b) const
-    {
-        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
-            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
-        return CTxMemPool::CompareIteratorByHash()(a, b);
-    }
-};
-
-typedef boost::multi_index_container<
-    CTxMemPoolModifiedEntry,
-    boost::multi_index::indexed_by<
-        boost::multi_index::ordered_unique<
-            modifiedentry_iter,
-            CompareCTxMemPoolIter
-        >,
-        // sorted by modified ancestor fee rate
-        boost::multi_index::ordered_non_unique<
-            // Reuse same tag from CTxMemPool's similar index
-            boost::multi_index::tag<ancestor_score>,
-            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
-            CompareTxMemPoolEntryByAncestorFee
-        >
-    >
-> indexed_modified_transaction_set;
-
-typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
-typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator modtxscoreiter;
-
-struct update_for_parent_inclusion
-{
-    explicit update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
-
-    void operator() (CTxMemPoolModifiedEntry &e)
-    {
-        e.nModFeesWithAncestors -= iter->GetFee();
-        e.nSizeWithAncestors -= iter->GetTxSize();
-        e.nSigOpCostWithAncestors -= iter->GetSigOpCost();
-    }
-
-    CTxMemPool::txiter iter;
-};
-
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler
 {
@@ -138,6 +55,8 @@ private:
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    // Lowest feerate of a package that was added
+    CFeeRate lowestPackageFeeRate;
 
     // Chain context for the block
     int nHeight;
@@ -165,30 +84,104 @@ private:
     void AddToBlock(CTxMemPool::txiter iter);
 
     // Methods for how to add transactions to a block.
-    /** Add transactions based on feerate including unconfirmed ancestors
-      * Increments nPackagesSelected / nDescendantsUpdated with corresponding
-      * statistics from the package selection (for logging statistics). */
-    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated);
+    /** Add the mempool's chunks by decreasing feerate, as long as they fit
+      * Increments nPackagesSelected with the number of chunks added (for
+      * logging statistics). */
+    void addPackageTxs(int &nPackagesSelected);
 
     // helper functions for addPackageTxs()
-    /** Remove confirmed (inBlock) entries from given set */
-    void onlyUnconfirmed(CTxMemPool::setEntries& testSet);
     /** Test if a new package would "fit" in the block */
     bool TestPackage(uint64_t packageSize, int64_t packageSigOpsCost) const;
     /** Perform checks on each transaction in a package:
       * locktime, premature-witness, serialized size (if necessary)
       * These checks should always succeed, and they're here
       * only as an extra check in case of suboptimal node configuration */
-    bool TestPackageTransactions(const CTxMemPool::setEntries& package);
-    /** Return true if given transaction from mapTx has already been evaluated,
-      * or if the transaction's cached data in mapTx is incorrect. */
-    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx);
-    /** Sort the package in an order that is valid to appear in a block */
-    void SortForBlock(const CTxMemPool::setEntries& package, std::vector<CTxMemPool::txiter>& sortedEntries);
-    /** Add descendants of given transactions to mapModifiedTx with ancestor
-      * state updated assuming given transactions are inBlock. Returns number
-      * of updated descendants. */
-    int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
+    bool TestPackageTransactions(const std::vector<CTxMemPool::txiter>& package);
+    /** Whether the in-mempool parents of a package are in the block or the package */
+    bool TestPackageParents(const std::vector<CTxMemPool::txiter>& package) const;
+
+    friend class LiveBlockTemplate;
+};
+
+/**
+ * A block template that follows the mempool, so that it can be handed out
+ * without assembling a new block on every request.
+ *
+ * It is assembled in full by BlockAssembler when the tip changes. After
+ * that, a transaction entering the mempool is appended when its in-mempool
+ * parents are in the template already and it fits (transactions arriving
+ * together are added in one go, so cs_main is not taken for each), and a transaction
+ * leaving the mempool is dropped together with its descendants in the
+ * template. When this stops matching what BlockAssembler would select,
+ * because a better package did not fit or space was freed, the template is
+ * marked stale and assembled again, at most every
+ * LIVE_TEMPLATE_REBUILD_INTERVAL seconds. It remains a valid block in the
+ * meantime.
+ */
+class LiveBlockTemplate final : public CValidationInterface
+{
+public:
+    LiveBlockTemplate(const CChainParams& params, const CScript& scriptPubKeyIn);
+
+    /** Assemble the template for the current tip from scratch. Throws if the
+     *  assembled block is not valid, like BlockAssembler::CreateNewBlock. */
+    void Rebuild();
+    /** The template for the current tip, or nullptr if it has not been
+     *  assembled for that tip yet. Returned templates are never modified;
+     *  a new one is made after the next change. Requires cs_main. */
+    std::shared_ptr<const CBlockTemplate> GetBlockTemplate();
+    /** Have the template assembled again, e.g. after fee deltas changed */
+    void SetStale();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef &ptx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef &ptx) override;
+
+private:
+    struct Entry {
+        CTransactionRef tx;
+        CAmount nFee;
+        int64_t nSigOpsCost;
+        int64_t nWeight;
+    };
+
+    /** Rebuild if stale and the last rebuild is long enough ago */
+    void MaybeRebuild();
+    /** Add the transactions that entered the mempool since the last call,
+     *  taking cs_main and mempool.cs once for all of them */
+    void AddPendingTransactions();
+    /** Append a mempool transaction if it fits, or mark the template stale if
+     *  it should have displaced part of it. Requires mempool.cs and cs_template. */
+    void AddTransaction(const CTransactionRef &ptx);
+    /** Drop a transaction and everything in the template spending from it */
+    void RemoveWithDescendants(const uint256& hash);
+
+    const CChainParams& chainparams;
+    const CScript scriptPubKey;
+
+    CCriticalSection cs_template;
+    // Chain context and limits the template was assembled with
+    const CBlockIndex* pindexPrev;
+    CBlockHeader header;
+    int nHeight;
+    int64_t nLockTimeCutoff;
+    bool fIncludeWitness;
+    uint64_t nBlockMaxWeight;
+    CFeeRate blockMinFeeRate;
+    // The transactions after the cashbase, in a valid order
+    std::vector<Entry> vEntries;
+    std::set<uint256> setTxids;
+    // Transactions that entered the mempool, waiting for AddPendingTransactions
+    std::vector<CTransactionRef> vPendingAdded;
+    uint64_t nBlockWeight;
+    int64_t nBlockSigOpsCost;
+    CAmount nFees;
+    CFeeRate lowestPackageFeeRate;
+    bool fStale;
+    int64_t nLastRebuild;
+    // Handed out by GetBlockTemplate until the next change
+    std::shared_ptr<const CBlockTemplate> pcached;
 };
 
 /** Modify the extranonce in a block */
@@ -12,11 +12,13 @@
 #include <miner.h>
 #include <policy/policy.h>
 #include <pubkey.h>
+#include <script/sign.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <validationinterface.h>
 
 #include <test/test_salemcash.h>
 
@@ -520,4 +522,94 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+
+/** Spend prevout, paying to key, into n_outputs equal outputs to script */
+static CMutableTransaction SpendToOutputs(const COutPoint& prevout, const CScript& prev_script, CAmount value_in,
+                                          const CKey& key, const CScript& script, int n_outputs, CAmount fee)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(n_outputs);
+    for (CTxOut& out : tx.vout) {
+        out.scriptPubKey = script;
+        out.nValue = (value_in - fee) / n_outputs;
+    }
+
+    std::vector<unsigned char> sig;
+    uint256 hash = SignatureHash(prev_script, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(key.Sign(hash, sig));
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << sig;
+    return tx;
+}
+
+static void AcceptTransaction(const CMutableTransaction& tx)
+{
+    LOCK(cs_main);
+    CValidationState state;
+    BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), nullptr, nullptr, true, 0));
+}
+
+/** Check that the live template is a valid block of expected_txs transactions
+ *  collecting about the fees a freshly assembled block would */
+static void CheckLiveTemplate(LiveBlockTemplate& live, const CChainParams& chainparams, size_t expected_txs)
+{
+    SyncWithValidationInterfaceQueue();
+    LOCK(cs_main);
+    std::shared_ptr<const CBlockTemplate> plive = live.GetBlockTemplate();
+    BOOST_REQUIRE(plive);
+    BOOST_CHECK_EQUAL(plive->block.vtx.size(), expected_txs + 1);
+    CValidationState state;
+    BOOST_CHECK(TestBlockValidity(state, chainparams, plive->block, chainActive.Tip(), false, false));
+
+    std::unique_ptr<CBlockTemplate> passembled = BlockAssembler(chainparams).CreateNewBlock(CScript() << OP_TRUE);
+    BOOST_REQUIRE(passembled);
+    // Updates in place may miss a better selection until the next rebuild
+    const CAmount live_fees = -plive->vTxFees[0];
+    const CAmount assembled_fees = -passembled->vTxFees[0];
+    BOOST_CHECK(std::abs(live_fees - assembled_fees) * 100 <= assembled_fees);
+}
+
+BOOST_FIXTURE_TEST_CASE(LiveBlockTemplate_updates, TestChain100Setup)
+{
+    const CChainParams& chainparams = Params();
+    const CScript script = CScript() << ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    LiveBlockTemplate live(chainparams, CScript() << OP_TRUE);
+    RegisterValidationInterface(&live);
+    GetMainSignals().RegisterWithMempoolSignals(mempool);
+    live.Rebuild();
+    CheckLiveTemplate(live, chainparams, 0);
+
+    // A parent and its children, added one by one
+    const CTransaction& cashbase = cashbaseTxns[0];
+    CMutableTransaction parent = SpendToOutputs(COutPoint(cashbase.GetHash(), 0), cashbase.vout[0].scriptPubKey,
+                                                cashbase.vout[0].nValue, cashbaseKey, script, 20, 100000);
+    AcceptTransaction(parent);
+    std::vector<CMutableTransaction> children;
+    for (uint32_t n = 0; n < parent.vout.size(); n++) {
+        children.push_back(SpendToOutputs(COutPoint(parent.GetHash(), n), script, parent.vout[n].nValue,
+                                          cashbaseKey, script, 1, 10000 + 1000 * n));
+        AcceptTransaction(children.back());
+    }
+    CheckLiveTemplate(live, chainparams, 21);
+
+    // A transaction leaving the mempool leaves the template
+    mempool.removeRecursive(children[5], MemPoolRemovalReason::REPLACED);
+    CheckLiveTemplate(live, chainparams, 20);
+
+    // A new block has the template assembled again for the new tip
+    CreateAndProcessBlock({parent, children[0], children[1]}, script);
+    CheckLiveTemplate(live, chainparams, 17);
+
+    // and it follows the mempool from there
+    AcceptTransaction(SpendToOutputs(COutPoint(children[2].GetHash(), 0), script, children[2].vout[0].nValue,
+                                     cashbaseKey, script, 1, 50000));
+    CheckLiveTemplate(live, chainparams, 18);
+
+    GetMainSignals().UnregisterWithMempoolSignals(mempool);
+    UnregisterValidationInterface(&live);
+    SyncWithValidationInterfaceQueue();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,14 +19,17 @@
 #include <rpc/blockchain.h>
 #include <rpc/mining.h>
 #include <rpc/server.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <deque>
 #include <memory>
 #include <stdint.h>
+#include <unordered_map>
 
 unsigned int ParseConfirmTarget(const UniValue& value)
 {
@@ -102,6 +105,48 @@ UniValue getnetworkhashps(const JSONRPCRequest& request)
     return GetNetworkHashPS(!request.params[0].isNull() ? request.params[0].get_int() : 120, !request.params[1].isNull() ? request.params[1].get_int() : -1);
 }
 
+/** The template getblocktemplate hands out to segwit-aware callers, created
+ *  on first use (protected by cs_main). It is never deleted, as the
+ *  validation interface queue may still hold callbacks for it at shutdown. */
+static LiveBlockTemplate* g_live_template = nullptr;
+
+static LiveBlockTemplate& GetLiveBlockTemplate()
+{
+    AssertLockHeld(cs_main);
+    if (!g_live_template) {
+        g_live_template = new LiveBlockTemplate(Params(), CScript() << OP_TRUE);
+        RegisterValidationInterface(g_live_template);
+    }
+    return *g_live_template;
+}
+
+/** The live template for the current tip, assembled right away if the
+ *  validation queue has not caught up with a new tip yet */
+static std::shared_ptr<const CBlockTemplate> GetCurrentLiveBlockTemplate()
+{
+    LiveBlockTemplate& live = GetLiveBlockTemplate();
+    std::shared_ptr<const CBlockTemplate> plive = live.GetBlockTemplate();
+    if (!plive) {
+        live.Rebuild();
+        plive = live.GetBlockTemplate();
+        assert(plive);
+    }
+    return plive;
+}
+
+/** Throw unless the node is in a state where it makes sense to mine on its tip */
+static void EnsureReadyForMining()
+{
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    if (g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
+        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Salemcash is not connected!");
+
+    if (IsInitialBlockDownload())
+        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Salemcash is downloading blocks...");
+}
+
 UniValue generateBlocks(std::shared_ptr<CReserveScript> cashbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript)
 {
     static const int nInnerLoopCount = 0x10000;
@@ -253,6 +298,8 @@ UniValue prioritisetransaction(const JSONRPCRequest& request)
     }
 
     mempool.PrioritiseTransaction(hash, nAmount);
+    if (g_live_template)
+        g_live_template->SetStale();
     return true;
 }
 
@@ -431,14 +478,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     if (strMode != "template")
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid mode");
 
-    if(!g_connman)
-        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
-
-    if (g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0)
-        throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Salemcash is not connected!");
-
-    if (IsInitialBlockDownload())
-        throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Salemcash is downloading blocks...");
+    EnsureReadyForMining();
 
     static unsigned int nTransactionsUpdatedLast;
 
@@ -501,7 +541,21 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     // Cache whether the last invocation was with segwit support, to avoid returning
     // a segwit-block to a non-segwit caller.
     static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
+    // The template last copied from the live template
+    static std::shared_ptr<const CBlockTemplate> plivetemplate;
+    if (fSupportsSegwit) {
+        // Segwit-aware callers get the live template, which is only
+        // assembled from scratch here before the first request and right
+        // after a new tip, until the validation queue has caught up.
+        std::shared_ptr<const CBlockTemplate> plive = GetCurrentLiveBlockTemplate();
+        if (plive != plivetemplate || !pblocktemplate || !fLastTemplateSupportsSegwit) {
+            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+            pblocktemplate.reset(new CBlockTemplate(*plive));
+            plivetemplate = plive;
+            fLastTemplateSupportsSegwit = true;
+            pindexPrev = chainActive.Tip();
+        }
+    } else if (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
         fLastTemplateSupportsSegwit != fSupportsSegwit)
     {
@@ -522,6 +576,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Need to update only after we know CreateNewBlock succeeded
         pindexPrev = pindexPrevNew;
+        plivetemplate.reset();
     }
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -692,31 +747,10 @@ protected:
     }
 };
 
-UniValue submitblock(const JSONRPCRequest& request)
+/** Process a block handed in by a miner, returning the BIP22 result */
+static UniValue SubmitBlock(const std::shared_ptr<CBlock>& blockptr)
 {
-    // We allow 2 arguments for compliance with BIP22. Argument 2 is ignored.
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
-        throw std::runtime_error(
-            "submitblock \"hexdata\"  ( \"dummy\" )\n"
-            "\nAttempts to submit new block to network.\n"
-            "See https://en.salemcash.it/wiki/BIP_0022 for full specification.\n"
-
-            "\nArguments\n"
-            "1. \"hexdata\"        (string, required) the hex-encoded block data to submit\n"
-            "2. \"dummy\"          (optional) dummy value, for compatibility with BIP22. This value is ignored.\n"
-            "\nResult:\n"
-            "\nExamples:\n"
-            + HelpExampleCli("submitblock", "\"mydata\"")
-            + HelpExampleRpc("submitblock", "\"mydata\"")
-        );
-    }
-
-    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
     CBlock& block = *blockptr;
-    if (!DecodeHexBlk(block, request.params[0].get_str())) {
-        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
-    }
-
     if (block.vtx.empty() || !block.vtx[0]->IsCashBase()) {
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with cashbase");
     }
@@ -762,6 +796,159 @@ UniValue submitblock(const JSONRPCRequest& request)
     return BIP22ValidationResult(sc.state);
 }
 
+UniValue submitblock(const JSONRPCRequest& request)
+{
+    // We allow 2 arguments for compliance with BIP22. Argument 2 is ignored.
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            "submitblock \"hexdata\"  ( \"dummy\" )\n"
+            "\nAttempts to submit new block to network.\n"
+            "See https://en.salemcash.it/wiki/BIP_0022 for full specification.\n"
+
+            "\nArguments\n"
+            "1. \"hexdata\"        (string, required) the hex-encoded block data to submit\n"
+            "2. \"dummy\"          (optional) dummy value, for compatibility with BIP22. This value is ignored.\n"
+            "\nResult:\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitblock", "\"mydata\"")
+            + HelpExampleRpc("submitblock", "\"mydata\"")
+        );
+    }
+
+    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
+    CBlock& block = *blockptr;
+    if (!DecodeHexBlk(block, request.params[0].get_str())) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+    }
+
+    return SubmitBlock(blockptr);
+}
+
+/** Templates recently served over the binary mining interface, oldest
+ *  first, so that the next one can be sent as a delta against any of them
+ *  (protected by cs_main) */
+static std::deque<std::pair<uint64_t, std::shared_ptr<const CBlockTemplate>>> g_binary_templates;
+static uint64_t g_next_binary_template_id = 1;
+static const size_t MAX_BINARY_TEMPLATES = 8;
+/** How often a binary long poll checks the mempool for changes, in seconds */
+static const int64_t BINARY_TEMPLATE_LONGPOLL_INTERVAL = 10;
+
+static const CBlockTemplate* FindBinaryTemplate(uint64_t nId)
+{
+    AssertLockHeld(cs_main);
+    for (const auto& entry : g_binary_templates) {
+        if (entry.first == nId) return entry.second.get();
+    }
+    return nullptr;
+}
+
+std::string GetBinaryBlockTemplate(uint64_t nKnownId, bool fLongPoll)
+{
+    LOCK(cs_main);
+    EnsureReadyForMining();
+
+    if (fLongPoll && !g_binary_templates.empty() && g_binary_templates.back().first == nKnownId) {
+        const std::shared_ptr<const CBlockTemplate> pknown = g_binary_templates.back().second;
+        while (GetCurrentLiveBlockTemplate() == pknown) {
+            // Wait like getblocktemplate's long poll, until the best block
+            // changes or the mempool did
+            const uint256 hashWatchedChain = chainActive.Tip()->GetBlockHash();
+            const unsigned int nTransactionsUpdatedLP = mempool.GetTransactionsUpdated();
+            LEAVE_CRITICAL_SECTION(cs_main);
+            {
+                std::chrono::steady_clock::time_point checktxtime = std::chrono::steady_clock::now() + std::chrono::seconds(BINARY_TEMPLATE_LONGPOLL_INTERVAL);
+
+                WaitableLock lock(csBestBlock);
+                while (chainActive.Tip()->GetBlockHash() == hashWatchedChain && IsRPCRunning())
+                {
+                    if (cvBlockChange.wait_until(lock, checktxtime) == std::cv_status::timeout)
+                    {
+                        if (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLP)
+                            break;
+                        checktxtime += std::chrono::seconds(BINARY_TEMPLATE_LONGPOLL_INTERVAL);
+                    }
+                }
+            }
+            // Let the live template catch up with what woke us up. If it
+            // did not change after all, keep waiting.
+            SyncWithValidationInterfaceQueue();
+            ENTER_CRITICAL_SECTION(cs_main);
+
+            if (!IsRPCRunning())
+                throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Shutting down");
+        }
+    }
+
+    std::shared_ptr<const CBlockTemplate> ptemplate = GetCurrentLiveBlockTemplate();
+    if (g_binary_templates.empty() || g_binary_templates.back().second != ptemplate) {
+        g_binary_templates.emplace_back(g_next_binary_template_id++, ptemplate);
+        if (g_binary_templates.size() > MAX_BINARY_TEMPLATES) {
+            g_binary_templates.pop_front();
+        }
+    }
+    const uint64_t nId = g_binary_templates.back().first;
+    const CBlockTemplate* pbase = FindBinaryTemplate(nKnownId);
+
+    std::unordered_map<uint256, uint64_t, SaltedTxidHasher> mapBasePos;
+    if (pbase) {
+        for (size_t i = 1; i < pbase->block.vtx.size(); i++) {
+            mapBasePos.emplace(pbase->block.vtx[i]->GetWitnessHash(), i);
+        }
+    }
+
+    const CBlockIndex* pindexPrev = chainActive.Tip();
+    CBlockHeader header = ptemplate->block.GetBlockHeader();
+    UpdateTime(&header, Params().GetConsensus(), pindexPrev);
+    header.nNonce = 0;
+
+    CDataStream ssTemplate(SER_NETWORK, PROTOCOL_VERSION);
+    ssTemplate << nId << (pbase ? nKnownId : (uint64_t)0);
+    ssTemplate << header << (int32_t)(pindexPrev->nHeight + 1) << (int64_t)(pindexPrev->GetMedianTimePast() + 1);
+    ssTemplate << ptemplate->block.vtx[0]->vout[0].nValue << ptemplate->vchCashbaseCommitment;
+    WriteCompactSize(ssTemplate, ptemplate->block.vtx.size() - 1);
+    for (size_t i = 1; i < ptemplate->block.vtx.size(); i++) {
+        const CTransaction& tx = *ptemplate->block.vtx[i];
+        auto it = mapBasePos.find(tx.GetWitnessHash());
+        uint64_t nBasePos = it == mapBasePos.end() ? 0 : it->second;
+        ssTemplate << VARINT(nBasePos);
+        if (nBasePos == 0) {
+            ssTemplate << tx;
+        }
+        ssTemplate << ptemplate->vTxFees[i] << ptemplate->vTxSigOpsCost[i];
+    }
+    return ssTemplate.str();
+}
+
+UniValue SubmitBinaryBlock(const std::string& strData, uint64_t nTemplateId)
+{
+    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
+    CDataStream ssBlock(strData.data(), strData.data() + strData.size(), SER_NETWORK, PROTOCOL_VERSION);
+    try {
+        if (nTemplateId == 0) {
+            ssBlock >> *blockptr;
+        } else {
+            CBlockHeader header;
+            CTransactionRef cashbase;
+            ssBlock >> header >> cashbase;
+
+            LOCK(cs_main);
+            const CBlockTemplate* ptemplate = FindBinaryTemplate(nTemplateId);
+            if (!ptemplate)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown template id");
+            *blockptr = CBlock(header);
+            blockptr->vtx = ptemplate->block.vtx;
+            blockptr->vtx[0] = cashbase;
+        }
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+    }
+    if (!ssBlock.empty()) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+    }
+
+    return SubmitBlock(blockptr);
+}
+
 UniValue estimatefee(const JSONRPCRequest& request)
 {
     throw JSONRPCError(RPC_METHOD_DEPRECATED, "estimatefee was removed in v0.17.\n"
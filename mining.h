@@ -9,10 +9,40 @@
 
 #include <univalue.h>
 
+#include <stdint.h>
+#include <string>
+
 /** Generate blocks (mine) */
 UniValue generateBlocks(std::shared_ptr<CReserveScript> cashbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript);
 
 /** Check bounds on a command line confirm target */
 unsigned int ParseConfirmTarget(const UniValue& value);
 
+/**
+ * Return the current block template for the binary mining interface
+ * (GET /mining/template). It is for segwit-aware miners and is serialized as:
+ *
+ * - uint64_t id of this template, and of the template the transactions
+ *   refer to (0 if none)
+ * - the block header, with time and bits updated and a null merkle root
+ * - int32_t height, int64_t minimum time, int64_t cashbase value and the
+ *   witness commitment script (empty if none)
+ * - the transactions after the cashbase, each as a VARINT position: 0 if
+ *   the transaction follows in full, else its position in the block of the
+ *   referenced template. Then int64_t fee and sigop cost.
+ *
+ * Transactions are referenced only if nKnownId is one of the last few
+ * templates served. With fLongPoll and nKnownId being the latest one, first
+ * wait for the template to change.
+ */
+std::string GetBinaryBlockTemplate(uint64_t nKnownId, bool fLongPoll);
+
+/**
+ * Process a serialized block from the binary mining interface
+ * (POST /mining/submit) and return its BIP22 result. Given nTemplateId,
+ * strData only holds the header and the cashbase, and the other
+ * transactions are taken from that template.
+ */
+UniValue SubmitBinaryBlock(const std::string& strData, uint64_t nTemplateId);
+
 #endif // SALEMCASH_RPC_MINING_H
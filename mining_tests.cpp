@@ -0,0 +1,258 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <consensus/validation.h>
+#include <net.h>
+#include <pow.h>
+#include <rpc/mining.h>
+#include <rpc/protocol.h>
+#include <rpc/server.h>
+#include <script/sign.h>
+#include <streams.h>
+#include <test/test_salemcash.h>
+#include <txmempool.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+/** The binary mining interface needs a peer and a chain out of IBD */
+struct BinaryMiningSetup : public TestChain100Setup {
+    BinaryMiningSetup()
+    {
+        CAddress addr(CService(CNetAddr(), Params().GetDefaultPort()), NODE_NONE);
+        CConnmanTest::AddNode(*new CNode(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/ true));
+    }
+
+    ~BinaryMiningSetup()
+    {
+        CConnmanTest::ClearNodes();
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(mining_tests, BinaryMiningSetup)
+
+/** A template as read back from GetBinaryBlockTemplate */
+struct BinaryTemplate {
+    uint64_t id;
+    uint64_t base_id;
+    CBlockHeader header;
+    int32_t height;
+    int64_t min_time;
+    CAmount cashbase_value;
+    std::vector<unsigned char> commitment;
+    //! Transactions after the cashbase, with the position each was referenced by (0 if sent in full)
+    std::vector<CTransactionRef> vtx;
+    std::vector<uint64_t> base_pos;
+    std::vector<CAmount> fees;
+};
+
+static BinaryTemplate ReadTemplate(const std::string& data, const BinaryTemplate* base = nullptr)
+{
+    BinaryTemplate t;
+    CDataStream ss(data.data(), data.data() + data.size(), SER_NETWORK, PROTOCOL_VERSION);
+    ss >> t.id >> t.base_id >> t.header >> t.height >> t.min_time >> t.cashbase_value >> t.commitment;
+    const uint64_t tx_count = ReadCompactSize(ss);
+    for (uint64_t i = 0; i < tx_count; i++) {
+        uint64_t pos;
+        ss >> VARINT(pos);
+        CTransactionRef tx;
+        if (pos == 0) {
+            ss >> tx;
+        } else {
+            BOOST_REQUIRE(base && base->id == t.base_id && pos <= base->vtx.size());
+            tx = base->vtx[pos - 1];
+        }
+        int64_t fee, sigops_cost;
+        ss >> fee >> sigops_cost;
+        t.vtx.push_back(tx);
+        t.base_pos.push_back(pos);
+        t.fees.push_back(fee);
+    }
+    BOOST_CHECK(ss.empty());
+    return t;
+}
+
+/** Complete a template with a cashbase and a valid proof of work, returning
+ *  the header and cashbase as sent to SubmitBinaryBlock */
+static std::string SolveTemplate(const BinaryTemplate& t, CBlock& block)
+{
+    BOOST_CHECK(t.commitment.empty());
+    CMutableTransaction cashbase;
+    cashbase.vin.resize(1);
+    cashbase.vin[0].prevout.SetNull();
+    cashbase.vin[0].scriptSig = CScript() << t.height << OP_0;
+    cashbase.vout.resize(1);
+    cashbase.vout[0].nValue = t.cashbase_value;
+    cashbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    block = CBlock(t.header);
+    block.vtx.push_back(MakeTransactionRef(cashbase));
+    block.vtx.insert(block.vtx.end(), t.vtx.begin(), t.vtx.end());
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block.GetBlockHeader() << block.vtx[0];
+    return ss.str();
+}
+
+static CMutableTransaction Spend(const COutPoint& prevout, const CScript& script, CAmount value_in, const CKey& key, CAmount fee)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = script;
+    tx.vout[0].nValue = value_in - fee;
+
+    std::vector<unsigned char> sig;
+    uint256 hash = SignatureHash(script, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(key.Sign(hash, sig));
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << sig;
+    return tx;
+}
+
+static void AcceptTransaction(const CMutableTransaction& tx)
+{
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), nullptr, nullptr, false, 0));
+    }
+    // Have the live template pick it up
+    SyncWithValidationInterfaceQueue();
+}
+
+static bool IsInvalidParameter(const UniValue& error)
+{
+    return find_value(error, "code").get_int() == RPC_INVALID_PARAMETER;
+}
+
+BOOST_AUTO_TEST_CASE(binary_template_delta)
+{
+    const CScript script = cashbaseTxns[0].vout[0].scriptPubKey;
+    const CMutableTransaction parent = Spend(COutPoint(cashbaseTxns[0].GetHash(), 0), script,
+                                             cashbaseTxns[0].vout[0].nValue, cashbaseKey, 10000);
+    AcceptTransaction(parent);
+
+    // Without a known template, all transactions are sent in full
+    const BinaryTemplate full = ReadTemplate(GetBinaryBlockTemplate(0, false));
+    BOOST_CHECK(full.id != 0);
+    BOOST_CHECK_EQUAL(full.base_id, 0U);
+    BOOST_CHECK(full.header.hashPrevBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(full.header.hashMerkleRoot.IsNull());
+    BOOST_CHECK_EQUAL(full.height, chainActive.Height() + 1);
+    BOOST_REQUIRE_EQUAL(full.vtx.size(), 1U);
+    BOOST_CHECK_EQUAL(full.base_pos[0], 0U);
+    BOOST_CHECK(full.vtx[0]->GetHash() == parent.GetHash());
+    BOOST_CHECK_EQUAL(full.fees[0], 10000);
+
+    // Asking again without a change hands out the same template
+    BOOST_CHECK_EQUAL(ReadTemplate(GetBinaryBlockTemplate(full.id, false), &full).id, full.id);
+
+    // Against a known template, the transactions in it are referenced by position
+    const CMutableTransaction child = Spend(COutPoint(parent.GetHash(), 0), script, parent.vout[0].nValue, cashbaseKey, 20000);
+    AcceptTransaction(child);
+    const BinaryTemplate delta = ReadTemplate(GetBinaryBlockTemplate(full.id, false), &full);
+    BOOST_CHECK(delta.id > full.id);
+    BOOST_CHECK_EQUAL(delta.base_id, full.id);
+    BOOST_REQUIRE_EQUAL(delta.vtx.size(), 2U);
+    BOOST_CHECK_EQUAL(delta.base_pos[0], 1U);
+    BOOST_CHECK(delta.vtx[0]->GetHash() == parent.GetHash());
+    BOOST_CHECK_EQUAL(delta.base_pos[1], 0U);
+    BOOST_CHECK(delta.vtx[1]->GetHash() == child.GetHash());
+    BOOST_CHECK_EQUAL(delta.fees[1], 20000);
+    BOOST_CHECK_EQUAL(delta.cashbase_value, full.cashbase_value + 20000);
+
+    // An unknown template id gets everything in full
+    const BinaryTemplate unknown = ReadTemplate(GetBinaryBlockTemplate(delta.id + 1000, false));
+    BOOST_CHECK_EQUAL(unknown.id, delta.id);
+    BOOST_CHECK_EQUAL(unknown.base_id, 0U);
+    BOOST_CHECK_EQUAL(unknown.base_pos[0], 0U);
+    BOOST_CHECK_EQUAL(unknown.base_pos[1], 0U);
+
+    // The reassembled delta template is a valid block
+    CBlock block;
+    SolveTemplate(delta, block);
+    LOCK(cs_main);
+    CValidationState state;
+    BOOST_CHECK(TestBlockValidity(state, Params(), block, chainActive.Tip(), true, true));
+}
+
+BOOST_AUTO_TEST_CASE(binary_submit)
+{
+    const CScript script = cashbaseTxns[0].vout[0].scriptPubKey;
+    AcceptTransaction(Spend(COutPoint(cashbaseTxns[0].GetHash(), 0), script,
+                            cashbaseTxns[0].vout[0].nValue, cashbaseKey, 10000));
+    const BinaryTemplate t = ReadTemplate(GetBinaryBlockTemplate(0, false));
+    BOOST_REQUIRE_EQUAL(t.vtx.size(), 1U);
+
+    // Only the header and cashbase are sent; the rest comes from the template
+    CBlock block;
+    const std::string data = SolveTemplate(t, block);
+    BOOST_CHECK(SubmitBinaryBlock(data, t.id).isNull());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    }
+    BOOST_CHECK_EQUAL(SubmitBinaryBlock(data, t.id).get_str(), "duplicate");
+
+    // Trailing data is not a block
+    BOOST_CHECK_THROW(SubmitBinaryBlock(data + '\0', t.id), UniValue);
+
+    // Once enough newer templates were served, the id is not known anymore
+    for (int i = 0; i < 8; i++) {
+        CreateAndProcessBlock({}, script);
+        ReadTemplate(GetBinaryBlockTemplate(0, false));
+    }
+    BOOST_CHECK_EXCEPTION(SubmitBinaryBlock(data, t.id), UniValue, IsInvalidParameter);
+    BOOST_CHECK_EXCEPTION(SubmitBinaryBlock(data, 0xffffffff), UniValue, IsInvalidParameter);
+
+    // A whole block needs no template
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    BOOST_CHECK_EQUAL(SubmitBinaryBlock(ss.str(), 0).get_str(), "duplicate");
+}
+
+BOOST_AUTO_TEST_CASE(binary_longpoll)
+{
+    const BinaryTemplate t = ReadTemplate(GetBinaryBlockTemplate(0, false));
+
+    StartRPC();
+    std::atomic<bool> done(false);
+    std::string result;
+    std::thread longpoll([&] {
+        try {
+            result = GetBinaryBlockTemplate(t.id, true);
+        } catch (...) {
+        }
+        done = true;
+    });
+
+    // The long poll waits for the template to change
+    MilliSleep(200);
+    BOOST_CHECK(!done);
+
+    const CBlock block = CreateAndProcessBlock({}, cashbaseTxns[0].vout[0].scriptPubKey);
+    longpoll.join();
+    InterruptRPC();
+
+    BOOST_REQUIRE(!result.empty());
+    const BinaryTemplate next = ReadTemplate(result);
+    BOOST_CHECK(next.id > t.id);
+    BOOST_CHECK(next.header.hashPrevBlock == block.GetHash());
+    BOOST_CHECK_EQUAL(next.height, t.height + 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include <validation.h>
 #include <httpserver.h>
 #include <net.h>
+#include <net_processing.h>
 #include <netbase.h>
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
@@ -345,6 +346,59 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+/** Non-empty buckets of a histogram from GetHTTPLaneStats, keyed by their upper bound */
+static UniValue HTTPHistogramToJSON(const std::vector<uint64_t>& vCounts)
+{
+    UniValue obj(UniValue::VOBJ);
+    for (size_t i = 0; i < vCounts.size(); i++) {
+        if (vCounts[i] == 0) continue;
+        std::string strBound = i + 1 == vCounts.size() ? "more" : i == 0 ? "0" : std::to_string(1ULL << (i - 1));
+        obj.pushKV(strBound, vCounts[i]);
+    }
+    return obj;
+}
+
+UniValue gethttpqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "gethttpqueueinfo\n"
+            "Returns an object with the state of each lane of the HTTP work queue.\n"
+            "Histograms count samples in buckets keyed by their upper bound, 0, 1, 2, 4, ...\n"
+            "and \"more\" for the rest. Empty buckets are left out.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"lane\": {              (json object) One of rest, rpc, rpcheavy and wallet\n"
+            "    \"threads\": n,         (numeric) Number of worker threads\n"
+            "    \"maxdepth\": n,        (numeric) Maximum number of queued requests\n"
+            "    \"depth\": n,           (numeric) Number of requests queued now\n"
+            "    \"rejected\": n,        (numeric) Number of requests rejected because the queue was full\n"
+            "    \"depth_histogram\": {...},  (json object) Queue depth each request found on arrival\n"
+            "    \"wait_histogram\": {...},   (json object) Microseconds requests waited for a worker\n"
+            "    \"run_histogram\": {...},    (json object) Microseconds workers took to handle requests\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gethttpqueueinfo", "")
+            + HelpExampleRpc("gethttpqueueinfo", "")
+        );
+
+    UniValue obj(UniValue::VOBJ);
+    for (const HTTPLaneStats& stats : GetHTTPLaneStats()) {
+        UniValue lane(UniValue::VOBJ);
+        lane.pushKV("threads", stats.nThreads);
+        lane.pushKV("maxdepth", (uint64_t)stats.nMaxDepth);
+        lane.pushKV("depth", (uint64_t)stats.nDepth);
+        lane.pushKV("rejected", stats.nRejected);
+        lane.pushKV("depth_histogram", HTTPHistogramToJSON(stats.vDepthHistogram));
+        lane.pushKV("wait_histogram", HTTPHistogramToJSON(stats.vWaitHistogram));
+        lane.pushKV("run_histogram", HTTPHistogramToJSON(stats.vRunHistogram));
+        obj.pushKV(stats.name, lane);
+    }
+    return obj;
+}
+
 uint32_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint32_t mask = 0;
@@ -362,6 +416,40 @@ uint32_t getCategoryMask(UniValue cats) {
     return mask;
 }
 
+UniValue getblockservecacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getblockservecacheinfo\n"
+            "Returns statistics about the cache of serialized blocks served to peers.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"hits\": xxxxx,           (numeric) Number of block requests answered from the cache\n"
+            "  \"misses\": xxxxx,         (numeric) Number of block requests that had to read the block from disk\n"
+            "  \"hitrate\": x.xxx,        (numeric) Fraction of block requests answered from the cache\n"
+            "  \"bytes_served\": xxxxx,   (numeric) Number of bytes sent to peers out of the cache\n"
+            "  \"entries\": xxxxx,        (numeric) Number of serialized blocks in the cache\n"
+            "  \"bytes\": xxxxx,          (numeric) Size of the cached blocks in bytes\n"
+            "  \"maxbytes\": xxxxx        (numeric) Size limit of the cache in bytes (set with -blockservecache)\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockservecacheinfo", "")
+            + HelpExampleRpc("getblockservecacheinfo", "")
+        );
+
+    const CBlockServeCache::Stats stats = g_block_serve_cache.GetStats();
+    const uint64_t nRequests = stats.nHits + stats.nMisses;
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("hits", stats.nHits);
+    obj.pushKV("misses", stats.nMisses);
+    obj.pushKV("hitrate", nRequests ? (double)stats.nHits / nRequests : 0.0);
+    obj.pushKV("bytes_served", stats.nBytesServed);
+    obj.pushKV("entries", (uint64_t)stats.nEntries);
+    obj.pushKV("bytes", (uint64_t)stats.nBytes);
+    obj.pushKV("maxbytes", (uint64_t)stats.nMaxBytes);
+    return obj;
+}
+
 UniValue logging(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 2) {
@@ -460,7 +548,9 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "gethttpqueueinfo",       &gethttpqueueinfo,       {} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
+    { "network",            "getblockservecacheinfo", &getblockservecacheinfo, {} },
     { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
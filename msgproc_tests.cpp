@@ -0,0 +1,262 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Stress tests for processing messages of many peers on the message handler
+// and message worker threads
+
+#include <chainparams.h>
+#include <hash.h>
+#include <net.h>
+#include <net_processing.h>
+#include <netmessagemaker.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <util.h>
+#include <utiltime.h>
+
+#include <test/test_salemcash.h>
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+const int NUM_PEERS = 500;
+const int NUM_MESSAGES = 20;
+const int64_t TIMEOUT_MILLIS = 120 * 1000;
+
+/** Feed a message to pnode as if the socket handler had received it */
+void ReceiveMessage(CConnman& connman, CNode& node, CSerializedNetMsg&& msg)
+{
+    uint256 hash = Hash(msg.data.begin(), msg.data.end());
+    CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    std::vector<unsigned char> data;
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, data, 0, hdr};
+    data.insert(data.end(), msg.data.begin(), msg.data.end());
+
+    std::list<CNetMessage> msgs;
+    msgs.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    int nHeaderBytes = msgs.back().readHeader((const char*)data.data(), data.size());
+    BOOST_REQUIRE(nHeaderBytes == CMessageHeader::HEADER_SIZE);
+    msgs.back().readData((const char*)data.data() + nHeaderBytes, data.size() - nHeaderBytes);
+    BOOST_REQUIRE(msgs.back().complete());
+    {
+        LOCK(node.cs_vProcessMsg);
+        node.nProcessQueueSize += msgs.back().vRecv.size() + CMessageHeader::HEADER_SIZE;
+        node.vProcessMsg.splice(node.vProcessMsg.end(), msgs);
+    }
+    connman.WakeMessageHandler();
+}
+
+std::vector<CNode*> AddPeers(int nPeers)
+{
+    std::vector<CNode*> nodes;
+    for (int i = 0; i < nPeers; i++) {
+        in_addr ip;
+        ip.s_addr = htonl(0x0a000000 + i);
+        CAddress addr(CService(CNetAddr(ip), Params().GetDefaultPort()), NODE_NONE);
+        CNode* node = new CNode(i, ServiceFlags(NODE_NETWORK | NODE_WITNESS), 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", /*fInboundIn=*/ true);
+        node->SetSendVersion(PROTOCOL_VERSION);
+        node->nVersion = PROTOCOL_VERSION;
+        nodes.push_back(node);
+    }
+    return nodes;
+}
+
+bool WaitFor(const std::function<bool()>& done)
+{
+    for (int64_t nStart = GetTimeMillis(); GetTimeMillis() - nStart < TIMEOUT_MILLIS; ) {
+        if (done()) return true;
+        MilliSleep(10);
+    }
+    return done();
+}
+
+/** Checks that each peer's messages are processed one at a time and in
+ *  order, and has every message whose nonce is not a multiple of 3 processed
+ *  on a worker. */
+class OrderCheckingLogic : public NetEventsInterface
+{
+public:
+    CConnman* connman;
+    std::vector<std::atomic<int>> vActive;
+    std::vector<uint64_t> vNextNonce;
+    std::atomic<int> nErrors{0};
+    std::atomic<int> nProcessed{0};
+    std::mutex cs_threads;
+    std::set<std::thread::id> setThreads;
+
+    OrderCheckingLogic(CConnman* connmanIn, int nPeers) : connman(connmanIn), vActive(nPeers), vNextNonce(nPeers, 0) {}
+
+    bool CanProcessInParallel(CNode* pnode) override
+    {
+        LOCK(pnode->cs_vProcessMsg);
+        if (pnode->vProcessMsg.empty()) return false;
+        CDataStream vRecv(pnode->vProcessMsg.front().vRecv);
+        uint64_t nonce;
+        vRecv >> nonce;
+        return nonce % 3 != 0;
+    }
+
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        std::list<CNetMessage> msgs;
+        bool fMoreWork;
+        {
+            LOCK(pnode->cs_vProcessMsg);
+            if (pnode->vProcessMsg.empty())
+                return false;
+            msgs.splice(msgs.begin(), pnode->vProcessMsg, pnode->vProcessMsg.begin());
+            pnode->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+            fMoreWork = !pnode->vProcessMsg.empty();
+        }
+        if (vActive[pnode->GetId()]++ != 0) nErrors++;
+        uint64_t nonce;
+        msgs.front().vRecv >> nonce;
+        if (nonce != vNextNonce[pnode->GetId()]++) nErrors++;
+        // Give other threads a chance to run into this peer
+        std::this_thread::yield();
+        vActive[pnode->GetId()]--;
+        {
+            std::lock_guard<std::mutex> lock(cs_threads);
+            setThreads.insert(std::this_thread::get_id());
+        }
+        nProcessed++;
+        return fMoreWork;
+    }
+    bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        if (vActive[pnode->GetId()] != 0) nErrors++;
+        return false;
+    }
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override { update_connection_time = false; }
+};
+
+/** The responses to pings and getheaders queued for sending to pnode, as
+ *  "pong:<nonce>" and "headers" */
+std::vector<std::string> GetResponses(CNode& node)
+{
+    std::vector<std::string> responses;
+    LOCK(node.cs_vSend);
+    for (auto it = node.vSendMsg.begin(); it != node.vSendMsg.end(); ++it) {
+        CMessageHeader hdr(Params().MessageStart());
+        CDataStream(it->Get(), SER_NETWORK, INIT_PROTO_VERSION) >> hdr;
+        CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+        if (hdr.nMessageSize > 0) {
+            ++it;
+            payload.write((const char*)it->Get().data(), it->Get().size());
+        }
+        if (hdr.GetCommand() == NetMsgType::PONG) {
+            uint64_t nonce;
+            payload >> nonce;
+            responses.push_back(strprintf("pong:%u", nonce));
+        } else if (hdr.GetCommand() == NetMsgType::HEADERS) {
+            responses.push_back("headers");
+        }
+    }
+    return responses;
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(msgproc_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(worker_pool_keeps_peer_order)
+{
+    OrderCheckingLogic logic(connman, NUM_PEERS);
+    CConnman::Options options;
+    options.m_msgproc = &logic;
+    options.nReceiveFloodSize = 1000 * DEFAULT_MAXRECEIVEBUFFER;
+    options.nSendBufferMaxSize = 1000 * DEFAULT_MAXSENDBUFFER;
+    options.nMessageWorkers = DEFAULT_MESSAGE_WORKERS;
+    connman->Init(options);
+
+    std::vector<CNode*> nodes = AddPeers(NUM_PEERS);
+    for (CNode* node : nodes) {
+        node->fSuccessfullyConnected = true;
+        CConnmanTest::AddNode(*node);
+    }
+    CConnmanTest::StartMessageHandler();
+
+    // Messages keep arriving while earlier ones are processed
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    for (uint64_t nonce = 0; nonce < NUM_MESSAGES; nonce++) {
+        for (CNode* node : nodes) {
+            ReceiveMessage(*connman, *node, msgMaker.Make(NetMsgType::PING, nonce));
+        }
+    }
+    BOOST_CHECK(WaitFor([&] { return logic.nProcessed == NUM_PEERS * NUM_MESSAGES; }));
+
+    connman->Interrupt();
+    connman->Stop();
+
+    BOOST_CHECK_EQUAL(logic.nErrors.load(), 0);
+    for (int i = 0; i < NUM_PEERS; i++) {
+        BOOST_CHECK_EQUAL(logic.vNextNonce[i], (uint64_t)NUM_MESSAGES);
+    }
+    // The message handler and at least one worker did some of the work
+    BOOST_CHECK(logic.setThreads.size() >= 2);
+}
+
+BOOST_AUTO_TEST_CASE(ping_and_getheaders_500_peers)
+{
+    CConnman::Options options;
+    options.m_msgproc = peerLogic.get();
+    options.nReceiveFloodSize = 1000 * DEFAULT_MAXRECEIVEBUFFER;
+    options.nSendBufferMaxSize = 1000 * DEFAULT_MAXSENDBUFFER;
+    options.nMessageWorkers = DEFAULT_MESSAGE_WORKERS;
+    connman->Init(options);
+
+    std::vector<CNode*> nodes = AddPeers(NUM_PEERS);
+    for (CNode* node : nodes) {
+        peerLogic->InitializeNode(node);
+        // Getheaders is answered during initial block download only for whitelisted peers
+        node->fWhitelisted = true;
+        node->fSuccessfullyConnected = true;
+        CConnmanTest::AddNode(*node);
+    }
+    CConnmanTest::StartMessageHandler();
+
+    // Pings go to the workers, getheaders stays on the message handler
+    // thread, and the responses must still come in the order of requests.
+    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    const uint256 hashGenesis = Params().GenesisBlock().GetHash();
+    std::vector<std::string> expected;
+    for (uint64_t nonce = 0; nonce < NUM_MESSAGES; nonce++) {
+        for (CNode* node : nodes) {
+            if (nonce % 4 == 3) {
+                ReceiveMessage(*connman, *node, msgMaker.Make(NetMsgType::GETHEADERS, CBlockLocator(), hashGenesis));
+            } else {
+                ReceiveMessage(*connman, *node, msgMaker.Make(NetMsgType::PING, nonce));
+            }
+        }
+        expected.push_back(nonce % 4 == 3 ? "headers" : strprintf("pong:%u", nonce));
+    }
+    BOOST_CHECK(WaitFor([&] {
+        for (CNode* node : nodes) {
+            if (GetResponses(*node).size() < expected.size()) return false;
+        }
+        return true;
+    }));
+
+    connman->Interrupt();
+    for (CNode* node : nodes) {
+        BOOST_CHECK(GetResponses(*node) == expected);
+        BOOST_CHECK(!node->fDisconnect);
+    }
+    connman->Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
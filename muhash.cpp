@@ -0,0 +1,179 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <limits>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+
+/** 2^3072 - MAX_PRIME_DIFF is the largest prime below 2^3072 */
+const limb_t MAX_PRIME_DIFF = 1103717;
+const limb_t LIMB_MAX = std::numeric_limits<limb_t>::max();
+
+/** Hash an element to a number modulo the prime, by expanding its SHA256
+ *  with ChaCha20. */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hashed[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hashed);
+    unsigned char tmp[Num3072::BYTE_SIZE];
+    ChaCha20(hashed, sizeof(hashed)).Output(tmp, sizeof(tmp));
+    return Num3072(tmp);
+}
+
+} // namespace
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            limbs[i] = (limb_t)ReadLE32(data + 4 * i);
+        } else {
+            limbs[i] = (limb_t)ReadLE64(data + 8 * i);
+        }
+    }
+    if (IsOverflow()) FullReduce();
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + i * 4, (uint32_t)limbs[i]);
+        } else {
+            WriteLE64(out + i * 8, (uint64_t)limbs[i]);
+        }
+    }
+}
+
+/** Whether the value is at least the prime, the only values above it being
+ *  the MAX_PRIME_DIFF - 1 ones just below 2^3072. */
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= LIMB_MAX - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != LIMB_MAX) return false;
+    }
+    return true;
+}
+
+/** Subtract the prime from a value that is at least the prime: adding
+ *  MAX_PRIME_DIFF carries into 2^3072, which is dropped. */
+void Num3072::FullReduce()
+{
+    double_limb_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += limbs[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product into 6144 bits. a may be *this.
+    limb_t tmp[2 * LIMBS];
+    for (int i = 0; i < LIMBS; ++i) {
+        tmp[i] = 0;
+    }
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t c = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            c += (double_limb_t)limbs[i] * a.limbs[j] + tmp[i + j];
+            tmp[i + j] = (limb_t)c;
+            c >>= LIMB_SIZE;
+        }
+        tmp[i + LIMBS] = (limb_t)c;
+    }
+
+    // 2^3072 is congruent to MAX_PRIME_DIFF, so fold the high half into the
+    // low half multiplied by it, and again for whatever carries out of that.
+    double_limb_t c = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += (double_limb_t)tmp[LIMBS + i] * MAX_PRIME_DIFF + tmp[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+    while (c != 0) {
+        c *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c != 0; ++i) {
+            c += limbs[i];
+            limbs[i] = (limb_t)c;
+            c >>= LIMB_SIZE;
+        }
+    }
+    if (IsOverflow()) FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem: a^-1 = a^(p-2). The exponent has all bits
+    // set except in its lowest limb, 2^LIMB_SIZE - MAX_PRIME_DIFF - 2.
+    Num3072 result;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        const limb_t e = i == 0 ? (limb_t)(0 - MAX_PRIME_DIFF - 2) : LIMB_MAX;
+        for (int bit = LIMB_SIZE - 1; bit >= 0; --bit) {
+            result.Multiply(result);
+            if ((e >> bit) & 1) result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    m_numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    m_denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(unsigned char out[OUTPUT_SIZE])
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out);
+}
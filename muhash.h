@@ -0,0 +1,101 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_CRYPTO_MUHASH_H
+#define SALEMCASH_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** An integer modulo the prime 2^3072 - 1103717, always kept fully reduced. */
+class Num3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    /** Set to 1 */
+    Num3072() { SetToOne(); }
+    /** Set from 384 little-endian bytes, reduced modulo the prime */
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    /** Multiply by the inverse of a, which must not be 0 */
+    void Divide(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    Num3072 GetInverse() const;
+};
+
+/** A rolling hash of a multiset of byte strings (MuHash, Bellare-Micciancio).
+ *
+ *  Every element is hashed to a number modulo a 3072-bit prime and the set
+ *  hash is the product of these numbers. Adding and removing elements can
+ *  happen in any order, and the hashes of two sets can be combined, without
+ *  looking at the elements of the set again. Removals are kept in a separate
+ *  denominator so that the costly modular inverse is only computed when the
+ *  hash is finalized.
+ */
+class MuHash3072
+{
+public:
+    static const size_t OUTPUT_SIZE = 32;
+    static const size_t SERIALIZED_SIZE = 2 * Num3072::BYTE_SIZE;
+
+    /** The hash of the empty set */
+    MuHash3072() {}
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** Add or remove all elements of another set */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /** Compute the 32-byte hash of the set. Resets the denominator, so it
+     *  is not const, but leaves the set unchanged. */
+    void Finalize(unsigned char out[OUTPUT_SIZE]);
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        m_numerator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+        m_denominator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        m_numerator = Num3072(data);
+        s.read((char*)data, sizeof(data));
+        m_denominator = Num3072(data);
+    }
+
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+};
+
+#endif // SALEMCASH_CRYPTO_MUHASH_H
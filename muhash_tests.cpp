@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+#include <random.h>
+#include <streams.h>
+#include <uint256.h>
+#include <utilstrencodings.h>
+#include <version.h>
+#include <test/test_salemcash.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(muhash_tests, BasicTestingSetup)
+
+static MuHash3072& Insert(MuHash3072& muhash, const std::string& str)
+{
+    return muhash.Insert((const unsigned char*)str.data(), str.size());
+}
+
+static MuHash3072& Remove(MuHash3072& muhash, const std::string& str)
+{
+    return muhash.Remove((const unsigned char*)str.data(), str.size());
+}
+
+static std::string FinalizeHex(MuHash3072 muhash)
+{
+    unsigned char out[MuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(out);
+    return HexStr(out, out + sizeof(out));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_vectors)
+{
+    MuHash3072 empty;
+    BOOST_CHECK_EQUAL(FinalizeHex(empty), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+
+    MuHash3072 abc;
+    Remove(Insert(Insert(Insert(abc, "a"), "b"), "c"), "b");
+    BOOST_CHECK_EQUAL(FinalizeHex(abc), "0a717b9dd1af94b9356943ef2860261afbcc4a12929d81dca5348f9027b6cfe9");
+
+    MuHash3072 a, c;
+    Insert(a, "a");
+    Insert(c, "c");
+    c *= a;
+    BOOST_CHECK_EQUAL(FinalizeHex(c), "0a717b9dd1af94b9356943ef2860261afbcc4a12929d81dca5348f9027b6cfe9");
+
+    MuHash3072 x;
+    Insert(x, "x");
+    x /= a;
+    BOOST_CHECK_EQUAL(FinalizeHex(x), "bd8fd6941e681106f78580d57018a819c98ec37c79d337ab0513216697f9035d");
+}
+
+BOOST_AUTO_TEST_CASE(muhash_order_independent)
+{
+    std::vector<uint256> elements;
+    for (int i = 0; i < 8; i++) {
+        elements.push_back(InsecureRand256());
+    }
+
+    MuHash3072 forward, backward, removed;
+    for (size_t i = 0; i < elements.size(); i++) {
+        forward.Insert(elements[i].begin(), elements[i].size());
+        backward.Insert(elements[elements.size() - 1 - i].begin(), elements[i].size());
+    }
+    BOOST_CHECK_EQUAL(FinalizeHex(forward), FinalizeHex(backward));
+
+    // Removing an element before inserting it gives the same set
+    uint256 extra = InsecureRand256();
+    removed.Remove(extra.begin(), extra.size());
+    for (const uint256& element : elements) {
+        removed.Insert(element.begin(), element.size());
+    }
+    removed.Insert(extra.begin(), extra.size());
+    BOOST_CHECK_EQUAL(FinalizeHex(removed), FinalizeHex(forward));
+
+    // Finalizing does not change the set
+    MuHash3072 finalized = forward;
+    unsigned char out[MuHash3072::OUTPUT_SIZE];
+    finalized.Finalize(out);
+    BOOST_CHECK_EQUAL(FinalizeHex(finalized), FinalizeHex(forward));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_serialization)
+{
+    MuHash3072 muhash;
+    Remove(Insert(Insert(muhash, "a"), "b"), "c");
+
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << muhash;
+    BOOST_CHECK_EQUAL(ss.size(), MuHash3072::SERIALIZED_SIZE);
+
+    MuHash3072 muhash2;
+    ss >> muhash2;
+    BOOST_CHECK_EQUAL(FinalizeHex(muhash2), FinalizeHex(muhash));
+    // The denominator survives the round trip too
+    Insert(muhash2, "c");
+    Insert(muhash, "c");
+    BOOST_CHECK_EQUAL(FinalizeHex(muhash2), FinalizeHex(muhash));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -25,6 +25,10 @@
 #include <fcntl.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -74,6 +78,11 @@ const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
+
+/** Bytes read from a socket at once */
+static const size_t SOCKET_RECV_BUFFER_SIZE = 0x10000;
+/** Maximum number of events returned by a single epoll_wait */
+static const int EPOLL_MAX_EVENTS = 1024;
 //
 // Global state variables
 //
@@ -87,6 +96,30 @@ std::string strSubVersion;
 
 limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode)
+{
+    if (str == "select") {
+        mode = SocketEventsMode::Select;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (str == "epoll") {
+        mode = SocketEventsMode::Epoll;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string SocketEventsModeToString(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SocketEventsMode::Select: return "select";
+    case SocketEventsMode::Epoll: return "epoll";
+    }
+    assert(false);
+}
+
 void CConnman::AddOneShot(const std::string& strDest)
 {
     LOCK(cs_vOneShots);
@@ -450,6 +483,11 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
         CloseSocket(hSocket);
         return nullptr;
     }
+    if (m_socket_events_mode == SocketEventsMode::Select && !IsSelectableSocket(hSocket)) {
+        LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
+        CloseSocket(hSocket);
+        return nullptr;
+    }
 
     // Add node
     NodeId id = GetNewNodeId();
@@ -876,7 +914,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
+        const auto &data = it->Get();
         assert(data.size() > pnode->nSendOffset);
         int nBytes = 0;
         {
@@ -1094,7 +1132,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (m_socket_events_mode == SocketEventsMode::Select && !IsSelectableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1133,77 +1171,182 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
+    if (!RegisterSocketEvents(pnode)) {
+        // Let the socket handler clean it up like any other disconnected node
+        pnode->CloseSocketDisconnect();
+    }
+
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
     }
 }
 
-void CConnman::ThreadSocketHandler()
+void CConnman::DisconnectNodes()
 {
-    unsigned int nPrevNodeCount = 0;
-    while (!interruptNet)
     {
-        //
-        // Disconnect nodes
-        //
+        LOCK(cs_vNodes);
+        // Disconnect unused nodes
+        std::vector<CNode*> vNodesCopy = vNodes;
+        for (CNode* pnode : vNodesCopy)
         {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            std::vector<CNode*> vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
+            if (pnode->fDisconnect)
             {
-                if (pnode->fDisconnect)
-                {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                // remove from vNodes
+                vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
 
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
+                // release outbound grant (if any)
+                pnode->grantOutbound.Release();
 
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+                // close socket and cleanup
+                pnode->CloseSocketDisconnect();
+#ifdef USE_EPOLL
+                m_epoll_pending.erase(pnode);
+#endif
 
-                    // hold in disconnected pool until all refs are released
-                    pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
-                }
+                // hold in disconnected pool until all refs are released
+                pnode->Release();
+                vNodesDisconnected.push_back(pnode);
             }
         }
+    }
+    {
+        // Delete disconnected nodes
+        std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
+        for (CNode* pnode : vNodesDisconnectedCopy)
         {
-            // Delete disconnected nodes
-            std::list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            for (CNode* pnode : vNodesDisconnectedCopy)
-            {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pnode->cs_inventory, lockInv);
-                        if (lockInv) {
-                            TRY_LOCK(pnode->cs_vSend, lockSend);
-                            if (lockSend) {
-                                fDelete = true;
-                            }
+            // wait until threads are done using it
+            if (pnode->GetRefCount() <= 0) {
+                bool fDelete = false;
+                {
+                    TRY_LOCK(pnode->cs_inventory, lockInv);
+                    if (lockInv) {
+                        TRY_LOCK(pnode->cs_vSend, lockSend);
+                        if (lockSend) {
+                            fDelete = true;
                         }
                     }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        DeleteNode(pnode);
-                    }
+                }
+                if (fDelete) {
+                    vNodesDisconnected.remove(pnode);
+                    DeleteNode(pnode);
                 }
             }
         }
-        size_t vNodesSize;
+    }
+}
+
+void CConnman::NotifyNumConnectionsChanged()
+{
+    size_t vNodesSize;
+    {
+        LOCK(cs_vNodes);
+        vNodesSize = vNodes.size();
+    }
+    if(vNodesSize != nPrevNodeCount) {
+        nPrevNodeCount = vNodesSize;
+        if(clientInterface)
+            clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
+    }
+}
+
+void CConnman::InactivityCheck(CNode* pnode)
+{
+    int64_t nTime = GetSystemTimeInSeconds();
+    if (nTime - pnode->nTimeConnected > 60)
+    {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
+        {
+            LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->GetId());
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
         {
-            LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        }
+        else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
+        {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        }
+        else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+        {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
         }
-        if(vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            if(clientInterface)
-                clientInterface->NotifyNumConnectionsChanged(nPrevNodeCount);
+        else if (!pnode->fSuccessfullyConnected)
+        {
+            LogPrint(BCLog::NET, "version handshake timeout from %d\n", pnode->GetId());
+            pnode->fDisconnect = true;
         }
+    }
+}
+
+bool CConnman::SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[SOCKET_RECV_BUFFER_SIZE];
+    int nBytes = 0;
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET)
+            return false;
+        nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    }
+    if (nBytes > 0)
+    {
+        bool notify = false;
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
+            pnode->CloseSocketDisconnect();
+        RecordBytesRecv(nBytes);
+        if (notify) {
+            size_t nSizeAdded = 0;
+            auto it(pnode->vRecvMsg.begin());
+            for (; it != pnode->vRecvMsg.end(); ++it) {
+                if (!it->complete())
+                    break;
+                nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+            }
+            {
+                LOCK(pnode->cs_vProcessMsg);
+                pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
+                pnode->nProcessQueueSize += nSizeAdded;
+                pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
+            }
+            WakeMessageHandler();
+        }
+    }
+    else if (nBytes == 0)
+    {
+        // socket closed gracefully
+        if (!pnode->fDisconnect) {
+            LogPrint(BCLog::NET, "socket closed\n");
+        }
+        pnode->CloseSocketDisconnect();
+    }
+    else if (nBytes < 0)
+    {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+        {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+            return false;
+        }
+        return nErr != WSAEWOULDBLOCK;
+    }
+    return nBytes > 0;
+}
+
+void CConnman::SocketHandlerSelect()
+{
+    while (!interruptNet)
+    {
+        DisconnectNodes();
+        NotifyNumConnectionsChanged();
 
         //
         // Find which sockets have data to receive
@@ -1329,57 +1472,7 @@ void CConnman::ThreadSocketHandler()
             }
             if (recvSet || errorSet)
             {
-                // typical socket buffer is 8K-64K
-                char pchBuf[0x10000];
-                int nBytes = 0;
-                {
-                    LOCK(pnode->cs_hSocket);
-                    if (pnode->hSocket == INVALID_SOCKET)
-                        continue;
-                    nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                }
-                if (nBytes > 0)
-                {
-                    bool notify = false;
-                    if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
-                        pnode->CloseSocketDisconnect();
-                    RecordBytesRecv(nBytes);
-                    if (notify) {
-                        size_t nSizeAdded = 0;
-                        auto it(pnode->vRecvMsg.begin());
-                        for (; it != pnode->vRecvMsg.end(); ++it) {
-                            if (!it->complete())
-                                break;
-                            nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                        }
-                        {
-                            LOCK(pnode->cs_vProcessMsg);
-                            pnode->vProcessMsg.splice(pnode->vProcessMsg.end(), pnode->vRecvMsg, pnode->vRecvMsg.begin(), it);
-                            pnode->nProcessQueueSize += nSizeAdded;
-                            pnode->fPauseRecv = pnode->nProcessQueueSize > nReceiveFloodSize;
-                        }
-                        WakeMessageHandler();
-                    }
-                }
-                else if (nBytes == 0)
-                {
-                    // socket closed gracefully
-                    if (!pnode->fDisconnect) {
-                        LogPrint(BCLog::NET, "socket closed\n");
-                    }
-                    pnode->CloseSocketDisconnect();
-                }
-                else if (nBytes < 0)
-                {
-                    // error
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                    {
-                        if (!pnode->fDisconnect)
-                            LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                        pnode->CloseSocketDisconnect();
-                    }
-                }
+                SocketRecvData(pnode);
             }
 
             //
@@ -1394,38 +1487,7 @@ void CConnman::ThreadSocketHandler()
                 }
             }
 
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetSystemTimeInSeconds();
-            if (nTime - pnode->nTimeConnected > 60)
-            {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
-                {
-                    LogPrint(BCLog::NET, "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->GetId());
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
-                {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
-                {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-                else if (!pnode->fSuccessfullyConnected)
-                {
-                    LogPrint(BCLog::NET, "version handshake timeout from %d\n", pnode->GetId());
-                    pnode->fDisconnect = true;
-                }
-            }
+            InactivityCheck(pnode);
         }
         {
             LOCK(cs_vNodes);
@@ -1435,6 +1497,186 @@ void CConnman::ThreadSocketHandler()
     }
 }
 
+#ifdef USE_EPOLL
+/** Listening sockets are registered with the low bit of the event data set,
+ *  which is never set in the (aligned) CNode pointers of peer sockets. */
+static const uint64_t EPOLL_LISTEN_SOCKET_TAG = 1;
+#endif
+
+bool CConnman::InitSocketEvents()
+{
+#ifdef USE_EPOLL
+    if (m_socket_events_mode != SocketEventsMode::Epoll) {
+        return true;
+    }
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        LogPrintf("Unable to create epoll instance: %s\n", NetworkErrorString(errno));
+        return false;
+    }
+    for (size_t i = 0; i < vhListenSocket.size(); i++) {
+        // Listening sockets stay level-triggered: one connection is accepted
+        // per wakeup, and the rest are reported again on the next wait.
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = (i << 1) | EPOLL_LISTEN_SOCKET_TAG;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, vhListenSocket[i].socket, &event) != 0) {
+            LogPrintf("Unable to register listening socket with epoll: %s\n", NetworkErrorString(errno));
+            close(m_epoll_fd);
+            m_epoll_fd = -1;
+            return false;
+        }
+    }
+    return true;
+#else
+    return m_socket_events_mode == SocketEventsMode::Select;
+#endif
+}
+
+bool CConnman::RegisterSocketEvents(CNode* pnode)
+{
+#ifdef USE_EPOLL
+    if (m_socket_events_mode != SocketEventsMode::Epoll) {
+        return true;
+    }
+    // Edge-triggered: an event is only reported when the socket becomes
+    // readable or writable again, so the handler keeps track of readiness
+    // itself (m_socket_readable, m_socket_writable) until reads or writes
+    // would block. The registration lasts until the socket is closed.
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = pnode;
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET) {
+        return false;
+    }
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+        LogPrintf("Unable to register socket of peer=%d with epoll: %s\n", pnode->GetId(), NetworkErrorString(errno));
+        return false;
+    }
+#endif
+    return true;
+}
+
+void CConnman::SocketHandlerEpoll()
+{
+#ifdef USE_EPOLL
+    std::vector<struct epoll_event> events(EPOLL_MAX_EVENTS);
+    int64_t nLastInactivityCheck = 0;
+    bool fMoreWork = false;
+    while (!interruptNet)
+    {
+        DisconnectNodes();
+        NotifyNumConnectionsChanged();
+
+        // Don't wait if a node was left with data to read or send; it will not
+        // be reported again until it has drained its socket.
+        int nEvents = epoll_wait(m_epoll_fd, events.data(), events.size(), fMoreWork ? 0 : 50);
+        if (interruptNet)
+            return;
+
+        if (nEvents == -1)
+        {
+            int nErr = errno;
+            nEvents = 0;
+            if (nErr != EINTR) {
+                LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+                if (!interruptNet.sleep_for(std::chrono::milliseconds(50)))
+                    return;
+            }
+        }
+
+        for (int i = 0; i < nEvents; i++)
+        {
+            const struct epoll_event& event = events[i];
+            if (event.data.u64 & EPOLL_LISTEN_SOCKET_TAG) {
+                AcceptConnection(vhListenSocket[event.data.u64 >> 1]);
+                continue;
+            }
+            CNode* pnode = static_cast<CNode*>(event.data.ptr);
+            if (event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                pnode->m_socket_readable = true;
+            }
+            if (event.events & EPOLLOUT) {
+                pnode->m_socket_writable = true;
+            }
+            m_epoll_pending.insert(pnode);
+        }
+
+        //
+        // Service the sockets with events, using the same policy as the
+        // select() loop: drain pending sends before receiving more.
+        //
+        std::vector<CNode*> vNodesCopy(m_epoll_pending.begin(), m_epoll_pending.end());
+        for (CNode* pnode : vNodesCopy)
+            pnode->AddRef();
+        fMoreWork = false;
+        for (CNode* pnode : vNodesCopy)
+        {
+            if (interruptNet)
+                return;
+
+            bool fSendPending;
+            {
+                LOCK(pnode->cs_vSend);
+                if (pnode->m_socket_writable && !pnode->vSendMsg.empty()) {
+                    size_t nBytes = SocketSendData(pnode);
+                    if (nBytes) {
+                        RecordBytesSent(nBytes);
+                    }
+                    // A partial send means the socket buffer is full
+                    pnode->m_socket_writable = pnode->vSendMsg.empty();
+                }
+                fSendPending = !pnode->vSendMsg.empty();
+            }
+
+            if (pnode->m_socket_readable && !fSendPending && !pnode->fPauseRecv) {
+                // Only a read that would block (EAGAIN) shows the socket is
+                // drained; a short read or an interrupted one does not.
+                pnode->m_socket_readable = SocketRecvData(pnode);
+            }
+
+            if (pnode->fDisconnect) {
+                m_epoll_pending.erase(pnode);
+                continue;
+            }
+            bool fCanSend = fSendPending && pnode->m_socket_writable;
+            bool fCanRecv = pnode->m_socket_readable && !fSendPending && !pnode->fPauseRecv;
+            if (fCanSend || fCanRecv) {
+                fMoreWork = true;
+            } else if (!pnode->m_socket_readable) {
+                m_epoll_pending.erase(pnode);
+            }
+            // Otherwise there is data to read once the node's send queue has
+            // drained or its receive queue is processed; keep checking it
+            // every iteration as nothing else will report it.
+        }
+        for (CNode* pnode : vNodesCopy)
+            pnode->Release();
+
+        //
+        // Inactivity checking
+        //
+        int64_t nTime = GetTimeMillis();
+        if (nTime - nLastInactivityCheck >= 1000) {
+            nLastInactivityCheck = nTime;
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes)
+                InactivityCheck(pnode);
+        }
+    }
+#endif
+}
+
+void CConnman::ThreadSocketHandler()
+{
+    if (m_socket_events_mode == SocketEventsMode::Epoll) {
+        SocketHandlerEpoll();
+    } else {
+        SocketHandlerSelect();
+    }
+}
+
 void CConnman::WakeMessageHandler()
 {
     {
@@ -1971,6 +2213,9 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         pnode->m_manual_connection = true;
 
     m_msgproc->InitializeNode(pnode);
+    if (!RegisterSocketEvents(pnode)) {
+        pnode->CloseSocketDisconnect();
+    }
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -1994,8 +2239,22 @@ void CConnman::ThreadMessageHandler()
 
         for (CNode* pnode : vNodesCopy)
         {
-            if (pnode->fDisconnect)
+            if (pnode->fDisconnect || pnode->m_msgproc_in_worker)
+                continue;
+
+            // Hand the node's next message to a worker if it does not need
+            // this thread. Sending waits for the next round, after the worker
+            // has woken us up again.
+            if (nMessageWorkers > 0 && m_msgproc->CanProcessInParallel(pnode)) {
+                pnode->m_msgproc_in_worker = true;
+                pnode->AddRef();
+                {
+                    std::lock_guard<std::mutex> lock(mutexMessageWork);
+                    vMessageWorkQueue.push_back(pnode);
+                }
+                condMessageWork.notify_one();
                 continue;
+            }
 
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
@@ -2026,6 +2285,32 @@ void CConnman::ThreadMessageHandler()
     }
 }
 
+void CConnman::ThreadMessageWorker()
+{
+    while (!flagInterruptMsgProc)
+    {
+        CNode* pnode;
+        {
+            std::unique_lock<std::mutex> lock(mutexMessageWork);
+            condMessageWork.wait(lock, [this] { return flagInterruptMsgProc || !vMessageWorkQueue.empty(); });
+            if (flagInterruptMsgProc)
+                return;
+            pnode = vMessageWorkQueue.front();
+            vMessageWorkQueue.pop_front();
+        }
+
+        m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
+
+        pnode->m_msgproc_in_worker = false;
+        {
+            LOCK(cs_vNodes);
+            pnode->Release();
+        }
+        // Let the message handler send to the node and look at its next message
+        WakeMessageHandler();
+    }
+}
+
 bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, bool fWhitelisted)
 {
     strError = "";
@@ -2313,6 +2598,12 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         fMsgProcWake = false;
     }
 
+    if (!InitSocketEvents()) {
+        LogPrintf("Socket events mode %s unavailable, using select\n", SocketEventsModeToString(m_socket_events_mode));
+        m_socket_events_mode = SocketEventsMode::Select;
+    }
+    LogPrintf("Using %s for socket events\n", SocketEventsModeToString(m_socket_events_mode));
+
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&TraceThread<std::function<void()> >, "net", std::function<void()>(std::bind(&CConnman::ThreadSocketHandler, this)));
 
@@ -2337,6 +2628,9 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMessageWorkers; i++) {
+        threadMessageWorkers.emplace_back(&TraceThread<std::function<void()> >, "msgwork", std::function<void()>(std::bind(&CConnman::ThreadMessageWorker, this)));
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
@@ -2366,6 +2660,12 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    {
+        // Not waking a message worker that checked flagInterruptMsgProc but
+        // is not waiting yet
+        std::lock_guard<std::mutex> lock(mutexMessageWork);
+    }
+    condMessageWork.notify_all();
 
     interruptNet();
     InterruptSocks5(true);
@@ -2387,6 +2687,16 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (std::thread& threadMessageWorker : threadMessageWorkers) {
+        if (threadMessageWorker.joinable())
+            threadMessageWorker.join();
+    }
+    threadMessageWorkers.clear();
+    for (CNode* pnode : vMessageWorkQueue) {
+        pnode->m_msgproc_in_worker = false;
+        pnode->Release();
+    }
+    vMessageWorkQueue.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
@@ -2409,6 +2719,13 @@ void CConnman::Stop()
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+#ifdef USE_EPOLL
+    if (m_epoll_fd != -1) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+    m_epoll_pending.clear();
+#endif
 
     // clean up some globals (to help leak detection)
     for (CNode *pnode : vNodes) {
@@ -2722,6 +3039,9 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+    m_socket_readable = true;
+    m_socket_writable = true;
+    m_msgproc_in_worker = false;
     nProcessQueueSize = 0;
 
     for (const std::string &msg : getAllNetMessageTypes())
@@ -2781,13 +3101,14 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
-    size_t nMessageSize = msg.data.size();
+    const std::vector<unsigned char>& payload = msg.Payload();
+    size_t nMessageSize = payload.size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = Hash(payload.data(), payload.data() + nMessageSize);
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
@@ -2804,9 +3125,13 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(serializedHeader));
+        if (nMessageSize) {
+            if (msg.shared_data)
+                pnode->vSendMsg.emplace_back(std::move(msg.shared_data));
+            else
+                pnode->vSendMsg.emplace_back(std::move(msg.data));
+        }
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
@@ -23,6 +23,7 @@
 
 #include <atomic>
 #include <deque>
+#include <set>
 #include <stdint.h>
 #include <thread>
 #include <memory>
@@ -82,6 +83,30 @@ static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
+/** How the socket handler waits for sockets to become ready */
+enum class SocketEventsMode {
+    //! select() over all sockets on every iteration, limited to FD_SETSIZE descriptors
+    Select,
+    //! Edge-triggered epoll, sockets registered once for their lifetime (Linux only)
+    Epoll,
+};
+/** -socketevents default */
+#ifdef USE_EPOLL
+static const SocketEventsMode DEFAULT_SOCKET_EVENTS = SocketEventsMode::Epoll;
+#else
+static const SocketEventsMode DEFAULT_SOCKET_EVENTS = SocketEventsMode::Select;
+#endif
+
+/** Default number of threads processing, next to the message handler thread,
+ *  the messages the message handler hands off (see NetEventsInterface::CanProcessInParallel) */
+static const int DEFAULT_MESSAGE_WORKERS = 4;
+/** Maximum number of message worker threads */
+static const int MAX_MESSAGE_WORKERS = 16;
+
+/** Parse a -socketevents value. Fails for modes not supported on this platform. */
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode);
+std::string SocketEventsModeToString(SocketEventsMode mode);
+
 typedef int64_t NodeId;
 
 struct AddedNodeInfo
@@ -105,7 +130,24 @@ struct CSerializedNetMsg
     CSerializedNetMsg& operator=(const CSerializedNetMsg&) = delete;
 
     std::vector<unsigned char> data;
+    //! Sent instead of data when set, for a payload that is shared with
+    //! other messages instead of copied, such as a cached block
+    std::shared_ptr<const std::vector<unsigned char>> shared_data;
     std::string command;
+
+    const std::vector<unsigned char>& Payload() const { return shared_data ? *shared_data : data; }
+};
+
+/** A message header or payload queued for sending, owned or shared */
+struct CSendBuffer
+{
+    std::vector<unsigned char> data;
+    std::shared_ptr<const std::vector<unsigned char>> shared_data;
+
+    explicit CSendBuffer(std::vector<unsigned char>&& dataIn) : data(std::move(dataIn)) {}
+    explicit CSendBuffer(std::shared_ptr<const std::vector<unsigned char>> sharedDataIn) : shared_data(std::move(sharedDataIn)) {}
+
+    const std::vector<unsigned char>& Get() const { return shared_data ? *shared_data : data; }
 };
 
 class NetEventsInterface;
@@ -140,6 +182,8 @@ public:
         bool m_use_addrman_outgoing = true;
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
+        SocketEventsMode m_socket_events_mode = DEFAULT_SOCKET_EVENTS;
+        int nMessageWorkers = DEFAULT_MESSAGE_WORKERS;
     };
 
     void Init(const Options& connOptions) {
@@ -163,6 +207,8 @@ public:
             LOCK(cs_vAddedNodes);
             vAddedNodes = connOptions.m_added_nodes;
         }
+        m_socket_events_mode = connOptions.m_socket_events_mode;
+        nMessageWorkers = std::max(0, std::min(connOptions.nMessageWorkers, MAX_MESSAGE_WORKERS));
     }
 
     CConnman(uint64_t seed0, uint64_t seed1);
@@ -171,6 +217,9 @@ public:
     void Stop();
     void Interrupt();
     bool GetNetworkActive() const { return fNetworkActive; };
+    /** The socket event backend in use, which may differ from the one requested
+     *  if it could not be set up. */
+    SocketEventsMode GetSocketEventsMode() const { return m_socket_events_mode; }
     void SetNetworkActive(bool active);
     void OpenNetworkConnection(const CAddress& addrConnect, bool fCountFailure, CSemaphoreGrant *grantOutbound = nullptr, const char *strDest = nullptr, bool fOneShot = false, bool fFeeler = false, bool manual_connection = false);
     bool CheckIncomingNonce(uint64_t nonce);
@@ -325,7 +374,20 @@ private:
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
     void ThreadMessageHandler();
+    void ThreadMessageWorker();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    void DisconnectNodes();
+    void NotifyNumConnectionsChanged();
+    void InactivityCheck(CNode* pnode);
+    /** Receive once from pnode's socket and queue complete messages for
+     *  processing. Returns false once there is nothing more to read for now:
+     *  recv() would block, or the socket was closed. */
+    bool SocketRecvData(CNode* pnode);
+    bool InitSocketEvents();
+    /** Register a new node's socket with the socket event backend. */
+    bool RegisterSocketEvents(CNode* pnode);
+    void SocketHandlerSelect();
+    void SocketHandlerEpoll();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -395,6 +457,14 @@ private:
     std::vector<CNode*> vNodes;
     std::list<CNode*> vNodesDisconnected;
     mutable CCriticalSection cs_vNodes;
+    unsigned int nPrevNodeCount = 0;
+
+    SocketEventsMode m_socket_events_mode = DEFAULT_SOCKET_EVENTS;
+#ifdef USE_EPOLL
+    int m_epoll_fd = -1;
+    //! Nodes with socket events left to handle. Used only by the socket handler thread.
+    std::set<CNode*> m_epoll_pending;
+#endif
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
@@ -420,6 +490,13 @@ private:
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
 
+    /** Nodes handed off by the message handler, each with a reference held
+     *  and m_msgproc_in_worker set until a worker has processed a message. */
+    std::deque<CNode*> vMessageWorkQueue;
+    std::condition_variable condMessageWork;
+    std::mutex mutexMessageWork;
+    int nMessageWorkers = 0;
+
     CThreadInterrupt interruptNet;
 
     std::thread threadDNSAddressSeed;
@@ -427,6 +504,7 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageWorkers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -468,6 +546,13 @@ public:
     virtual bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
+    /**
+     * Whether the next ProcessMessages call for pnode may run on a message
+     * worker thread, concurrently with the message handler thread and with
+     * other nodes' processing. Messages of a single node are still processed
+     * one at a time and in order.
+     */
+    virtual bool CanProcessInParallel(CNode* pnode) { return false; }
 
 protected:
     /**
@@ -608,7 +693,7 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSendBuffer> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -661,6 +746,13 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // Readiness last reported by the epoll backend, cleared once the socket
+    // would block. Used only by the SocketHandler thread.
+    bool m_socket_readable;
+    bool m_socket_writable;
+    // Set while a message worker processes this node's next message; the
+    // message handler thread leaves the node alone in the meantime.
+    std::atomic_bool m_msgproc_in_worker;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
@@ -671,8 +763,10 @@ public:
     std::atomic<int> nStartingHeight;
 
     // flood relay
-    std::vector<CAddress> vAddrToSend;
-    CRollingBloomFilter addrKnown;
+    // Addresses may be relayed to this node from any message worker
+    CCriticalSection cs_addrSend;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(cs_addrSend);
+    CRollingBloomFilter addrKnown GUARDED_BY(cs_addrSend);
     bool fGetAddr;
     std::set<uint256> setKnown;
     int64_t nNextAddrSend;
@@ -791,6 +885,7 @@ public:
 
     void AddAddressKnown(const CAddress& _addr)
     {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -799,6 +894,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] = _addr;
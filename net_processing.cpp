@@ -798,6 +798,7 @@ static bool BlockRequestAllowed(const CBlockIndex* pindex, const Consensus::Para
 PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler) : connman(connmanIn), m_stale_tip_check_time(0) {
     // Initialize global variables that cannot be constructed at startup.
     recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
+    g_block_serve_cache.SetMaxSize(std::max<int64_t>(0, gArgs.GetArg("-blockservecache", DEFAULT_BLOCK_SERVE_CACHE_SIZE)) << 20);
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -851,6 +852,8 @@ static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_bloc
 static uint256 most_recent_block_hash;
 static bool fWitnessesPresentInMostRecentCompactBlock;
 
+CBlockServeCache g_block_serve_cache;
+
 /**
  * Maintain state about the best-seen block and fast-announce a compact block 
  * to compatible peers.
@@ -973,6 +976,15 @@ void PeerLogicValidation::BlockChecked(const CBlock& block, const CValidationSta
 //
 // Messages
 //
+
+/** Whether a transaction was turned down only because the same transaction
+ *  from another peer entered the mempool while its scripts were checked. It
+ *  is not rejected then, so must not go into recentRejects. */
+bool static LostMempoolRace(const CValidationState& state)
+{
+    return state.GetRejectCode() == REJECT_DUPLICATE && state.GetRejectReason() == "txn-already-in-mempool";
+}
+
 bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     switch (inv.type)
@@ -1088,53 +1100,108 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
         ActivateBestChain(dummy, Params(), a_recent_block);
     }
 
-    LOCK(cs_main);
-    const CBlockIndex* pindex = LookupBlockIndex(inv.hash);
-    if (pindex) {
-        send = BlockRequestAllowed(pindex, consensusParams);
-        if (!send) {
-            LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
-        }
-    }
-    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-    // disconnect node in case we have reached the outbound limit for serving historical blocks
-    // never disconnect whitelisted nodes
-    if (send && connman->OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() > HISTORICAL_BLOCK_AGE)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted)
+    // Decide what to send under cs_main, then read and send the block without
+    // it, so serving blocks to many peers does not hold up validation.
+    const CBlockIndex* pindex;
+    bool fRawBlock = false;
+    bool fPeerWantsWitness = false;
+    bool fSendCompact = false;
+    uint256 hashTip;
     {
-        LogPrint(BCLog::NET, "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
+        LOCK(cs_main);
+        pindex = LookupBlockIndex(inv.hash);
+        if (pindex) {
+            send = BlockRequestAllowed(pindex, consensusParams);
+            if (!send) {
+                LogPrint(BCLog::NET, "%s: ignoring request from peer=%i for old block that isn't in the main chain\n", __func__, pfrom->GetId());
+            }
+        }
+        // disconnect node in case we have reached the outbound limit for serving historical blocks
+        // never disconnect whitelisted nodes
+        if (send && connman->OutboundTargetReached(true) && ( ((pindexBestHeader != nullptr) && (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() > HISTORICAL_BLOCK_AGE)) || inv.type == MSG_FILTERED_BLOCK) && !pfrom->fWhitelisted)
+        {
+            LogPrint(BCLog::NET, "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
 
-        //disconnect node
-        pfrom->fDisconnect = true;
-        send = false;
-    }
-    // Avoid leaking prune-height by never sending blocks below the NODE_NETWORK_LIMITED threshold
-    if (send && !pfrom->fWhitelisted && (
-            (((pfrom->GetLocalServices() & NODE_NETWORK_LIMITED) == NODE_NETWORK_LIMITED) && ((pfrom->GetLocalServices() & NODE_NETWORK) != NODE_NETWORK) && (chainActive.Tip()->nHeight - pindex->nHeight > (int)NODE_NETWORK_LIMITED_MIN_BLOCKS + 2 /* add two blocks buffer extension for possible races */) )
-       )) {
-        LogPrint(BCLog::NET, "Ignore block request below NODE_NETWORK_LIMITED threshold from peer=%d\n", pfrom->GetId());
+            //disconnect node
+            pfrom->fDisconnect = true;
+            send = false;
+        }
+        // Avoid leaking prune-height by never sending blocks below the NODE_NETWORK_LIMITED threshold
+        if (send && !pfrom->fWhitelisted && (
+                (((pfrom->GetLocalServices() & NODE_NETWORK_LIMITED) == NODE_NETWORK_LIMITED) && ((pfrom->GetLocalServices() & NODE_NETWORK) != NODE_NETWORK) && (chainActive.Tip()->nHeight - pindex->nHeight > (int)NODE_NETWORK_LIMITED_MIN_BLOCKS + 2 /* add two blocks buffer extension for possible races */) )
+           )) {
+            LogPrint(BCLog::NET, "Ignore block request below NODE_NETWORK_LIMITED threshold from peer=%d\n", pfrom->GetId());
 
-        //disconnect node and prevent it from stalling (would otherwise wait for the missing block)
-        pfrom->fDisconnect = true;
-        send = false;
-    }
-    // Pruned nodes may have deleted the block, so check whether
-    // it's available before trying to send.
-    if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
+            //disconnect node and prevent it from stalling (would otherwise wait for the missing block)
+            pfrom->fDisconnect = true;
+            send = false;
+        }
+        // Pruned nodes may have deleted the block, so check whether
+        // it's available before trying to send.
+        send = send && (pindex->nStatus & BLOCK_HAVE_DATA);
+        if (send) {
+            // Blocks are stored with witness data, so a full block request can be
+            // answered with the bytes on disk as they are. So can a request for a
+            // stripped block from before segwit activation, which has none.
+            fRawBlock = inv.type == MSG_WITNESS_BLOCK ||
+                (inv.type == MSG_BLOCK && !IsWitnessEnabled(pindex->pprev, consensusParams));
+            if (inv.type == MSG_CMPCT_BLOCK) {
+                fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+                fSendCompact = CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+            }
+            hashTip = chainActive.Tip()->GetBlockHash();
+        }
+    } // release cs_main
+
+    if (send)
     {
+        const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
         std::shared_ptr<const CBlock> pblock;
-        if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
+        // Full blocks are sent as serialized bytes, shared through
+        // g_block_serve_cache with other peers asking for the same block.
+        const bool fSendBlock = inv.type == MSG_BLOCK || inv.type == MSG_WITNESS_BLOCK;
+        const bool fWitness = inv.type == MSG_WITNESS_BLOCK;
+        CBlockServeCache::BlockData block_data;
+        if (fSendBlock) {
+            block_data = g_block_serve_cache.Get(pindex->GetBlockHash(), fWitness);
+        }
+        if (block_data) {
+            // Served from memory
+        } else if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (fRawBlock) {
+            std::shared_ptr<std::vector<unsigned char>> raw_block = std::make_shared<std::vector<unsigned char>>();
+            if (!ReadRawBlockFromDisk(*raw_block, pindex, Params().MessageStart())) {
+                // Without cs_main held the block may have been pruned since
+                // it was checked for above
+                LogPrint(BCLog::NET, "cannot load block %s from disk, disconnect peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->GetId());
+                pfrom->fDisconnect = true;
+                return;
+            }
+            block_data = raw_block;
+            g_block_serve_cache.Put(pindex->GetBlockHash(), fWitness, block_data);
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
-                assert(!"cannot load block from disk");
+            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams)) {
+                LogPrint(BCLog::NET, "cannot load block %s from disk, disconnect peer=%d\n", pindex->GetBlockHash().ToString(), pfrom->GetId());
+                pfrom->fDisconnect = true;
+                return;
+            }
             pblock = pblockRead;
         }
-        if (inv.type == MSG_BLOCK)
-            connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
-        else if (inv.type == MSG_WITNESS_BLOCK)
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+        if (fSendBlock && !block_data) {
+            std::shared_ptr<std::vector<unsigned char>> serialized = std::make_shared<std::vector<unsigned char>>();
+            CVectorWriter(SER_NETWORK, pfrom->GetSendVersion() | (fWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS), *serialized, 0, *pblock);
+            block_data = serialized;
+            g_block_serve_cache.Put(pindex->GetBlockHash(), fWitness, block_data);
+        }
+        if (fSendBlock) {
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            msg.shared_data = block_data;
+            connman->PushMessage(pfrom, std::move(msg));
+        }
         else if (inv.type == MSG_FILTERED_BLOCK)
         {
             bool sendMerkleBlock = false;
@@ -1167,9 +1234,8 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
             // they won't have a useful mempool to match against a compact block,
             // and we don't feel like constructing the object for them, so
             // instead we respond with the full, non-compact block.
-            bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
             int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
-            if (CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+            if (fSendCompact) {
                 if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
                     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                 } else {
@@ -1188,7 +1254,7 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
             // and we want it right after the last block so they don't
             // wait for other stuff first.
             std::vector<CInv> vInv;
-            vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
+            vInv.push_back(CInv(MSG_BLOCK, hashTip));
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
             pfrom->hashContinue.SetNull();
         }
@@ -2139,18 +2205,27 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         CInv inv(MSG_TX, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        LOCK2(cs_main, g_cs_orphans);
-
         bool fMissingInputs = false;
         CValidationState state;
 
-        pfrom->setAskFor.erase(inv.hash);
-        mapAlreadyAskedFor.erase(inv.hash);
+        bool fAlreadyHave;
+        {
+            LOCK(cs_main);
+            pfrom->setAskFor.erase(inv.hash);
+            mapAlreadyAskedFor.erase(inv.hash);
+            fAlreadyHave = AlreadyHave(inv);
+        }
 
         std::list<CTransactionRef> lRemovedTxn;
 
-        if (!AlreadyHave(inv) &&
-            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+        // Without cs_main held, so that AcceptToMemoryPool can check the
+        // scripts while message workers validate transactions from other peers
+        const bool fAccepted = !fAlreadyHave &&
+            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */);
+
+        LOCK2(cs_main, g_cs_orphans);
+
+        if (fAccepted) {
             mempool.check(pcashTip.get());
             RelayTransaction(tx, connman);
             for (unsigned int i = 0; i < tx.vout.size(); i++) {
@@ -2208,7 +2283,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                         // Probably non-standard or insufficient fee
                         LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
                         vEraseQueue.push_back(orphanHash);
-                        if (!orphanTx.HasWitness() && !stateDummy.CorruptionPossible()) {
+                        if (!orphanTx.HasWitness() && !stateDummy.CorruptionPossible() && !LostMempoolRace(stateDummy)) {
                             // Do not use rejection cache for witness transactions or
                             // witness-stripped transactions, as they can have been malleated.
                             // See https://github.com/PastorOmbura/SalemCash/issues/8279 for details.
@@ -2254,7 +2329,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 recentRejects->insert(tx.GetHash());
             }
         } else {
-            if (!tx.HasWitness() && !state.CorruptionPossible()) {
+            if (LostMempoolRace(state)) {
+                // Accepted after all, through another peer
+            } else if (!tx.HasWitness() && !state.CorruptionPossible()) {
                 // Do not use rejection cache for witness transactions or
                 // witness-stripped transactions, as they can have been malleated.
                 // See https://github.com/PastorOmbura/SalemCash/issues/8279 for details.
@@ -2672,7 +2749,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrSend);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr)
@@ -2853,6 +2933,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     return true;
 }
 
+/** Messages a message worker thread may process, see PeerLogicValidation::CanProcessInParallel */
+static bool CanProcessCommandInParallel(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::PING || strCommand == NetMsgType::PONG ||
+           strCommand == NetMsgType::ADDR || strCommand == NetMsgType::INV ||
+           strCommand == NetMsgType::GETDATA || strCommand == NetMsgType::TX;
+}
+
 static bool SendRejectsAndCheckIfBanned(CNode* pnode, CConnman* connman)
 {
     AssertLockHeld(cs_main);
@@ -2914,6 +3002,10 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // A message that arrived after this node was handed to a worker may
+        // need the message handler thread
+        if (pfrom->m_msgproc_in_worker && !CanProcessCommandInParallel(pfrom->vProcessMsg.front().hdr.GetCommand()))
+            return true;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
@@ -3003,6 +3095,19 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     return fMoreWork;
 }
 
+bool PeerLogicValidation::CanProcessInParallel(CNode* pnode)
+{
+    // Keep the version handshake on the message handler thread
+    if (!pnode->fSuccessfullyConnected || pnode->fDisconnect)
+        return false;
+
+    if (!pnode->vRecvGetData.empty())
+        return true;
+
+    LOCK(pnode->cs_vProcessMsg);
+    return !pnode->vProcessMsg.empty() && CanProcessCommandInParallel(pnode->vProcessMsg.front().hdr.GetCommand());
+}
+
 void PeerLogicValidation::ConsiderEviction(CNode *pto, int64_t time_in_seconds)
 {
     AssertLockHeld(cs_main);
@@ -3210,6 +3315,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
         //
         if (pto->nNextAddrSend < nNow) {
             pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+            LOCK(pto->cs_addrSend);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend)
@@ -5,6 +5,7 @@
 #ifndef SALEMCASH_NET_PROCESSING_H
 #define SALEMCASH_NET_PROCESSING_H
 
+#include <blockservecache.h>
 #include <net.h>
 #include <validationinterface.h>
 #include <consensus/params.h>
@@ -34,6 +35,9 @@ static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
 
+/** Serialized blocks recently sent to peers */
+extern CBlockServeCache g_block_serve_cache;
+
 class PeerLogicValidation final : public CValidationInterface, public NetEventsInterface {
 private:
     CConnman* const connman;
@@ -64,6 +68,10 @@ public:
     void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) override;
     /** Process protocol messages received from a given node */
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
+    /** Whether the peer's next message only needs cs_main briefly, if at all:
+     *  ping, pong, addr, inv and getdata, including serving blocks from disk,
+     *  and tx, whose scripts are checked without cs_main */
+    bool CanProcessInParallel(CNode* pnode) override;
     /**
     * Send queued protocol messages to be sent to a give node.
     *
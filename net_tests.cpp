@@ -185,4 +185,55 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(socket_events_mode)
+{
+    SocketEventsMode mode = SocketEventsMode::Epoll;
+    BOOST_CHECK(ParseSocketEventsMode("select", mode));
+    BOOST_CHECK(mode == SocketEventsMode::Select);
+    BOOST_CHECK_EQUAL(SocketEventsModeToString(mode), "select");
+
+#ifdef USE_EPOLL
+    BOOST_CHECK(ParseSocketEventsMode("epoll", mode));
+    BOOST_CHECK(mode == SocketEventsMode::Epoll);
+    BOOST_CHECK_EQUAL(SocketEventsModeToString(mode), "epoll");
+#else
+    BOOST_CHECK(!ParseSocketEventsMode("epoll", mode));
+    BOOST_CHECK(mode == SocketEventsMode::Select);
+#endif
+
+    // Unknown modes fail and leave the mode alone
+    BOOST_CHECK(!ParseSocketEventsMode("", mode));
+    BOOST_CHECK(!ParseSocketEventsMode("poll", mode));
+    BOOST_CHECK(!ParseSocketEventsMode("Select", mode));
+    BOOST_CHECK(mode == DEFAULT_SOCKET_EVENTS);
+    BOOST_CHECK(ParseSocketEventsMode(SocketEventsModeToString(DEFAULT_SOCKET_EVENTS), mode));
+}
+
+BOOST_AUTO_TEST_CASE(cnode_shared_payload)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", false);
+    CConnman connman(0x1337, 0x1337);
+
+    // A shared payload is queued as is, and checksummed like a copy would be
+    std::shared_ptr<const std::vector<unsigned char>> payload = std::make_shared<std::vector<unsigned char>>(1000, 0x42);
+    CSerializedNetMsg msg;
+    msg.command = NetMsgType::BLOCK;
+    msg.shared_data = payload;
+    connman.PushMessage(&node, std::move(msg));
+
+    LOCK(node.cs_vSend);
+    BOOST_REQUIRE_EQUAL(node.vSendMsg.size(), 2U);
+    BOOST_CHECK(node.vSendMsg[1].shared_data == payload);
+    BOOST_CHECK_EQUAL(node.nSendSize, CMessageHeader::HEADER_SIZE + payload->size());
+
+    CMessageHeader hdr(Params().MessageStart());
+    CDataStream(node.vSendMsg[0].Get(), SER_NETWORK, INIT_PROTO_VERSION) >> hdr;
+    BOOST_CHECK_EQUAL(hdr.nMessageSize, payload->size());
+    uint256 hash = Hash(payload->begin(), payload->end());
+    BOOST_CHECK(memcmp(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,218 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_SUPPORT_ALLOCATORS_POOL_H
+#define SALEMCASH_SUPPORT_ALLOCATORS_POOL_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/** A memory resource for the nodes of node based containers.
+ *
+ *  Blocks of up to MAX_BLOCK_SIZE_BYTES are carved out of large chunks, and
+ *  freed blocks are kept in a free list per size to be handed out again. So
+ *  allocating or freeing a node is a couple of pointer operations without the
+ *  per-allocation overhead of malloc, and freeing many nodes at once, as when
+ *  the transactions of a block leave the mempool, does not call into malloc
+ *  at all. Chunks are only given back by ReleaseChunks() or when the resource
+ *  is destroyed. Larger or more aligned requests go to operator new.
+ *
+ *  Not thread safe, the containers using it need to be protected anyway.
+ */
+template <size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class PoolResource
+{
+    /** Freed blocks are linked through their first bytes */
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+    static const size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > alignof(ListNode) ? ALIGN_BYTES : alignof(ListNode);
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "ELEM_ALIGN_BYTES must be a power of two");
+    static_assert(MAX_BLOCK_SIZE_BYTES >= ELEM_ALIGN_BYTES, "MAX_BLOCK_SIZE_BYTES too small");
+
+    const size_t m_chunk_size_bytes;
+    std::vector<char*> m_allocated_chunks;
+    //! Free list per block size, indexed by the size in units of ELEM_ALIGN_BYTES
+    std::array<ListNode*, MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1> m_free_lists;
+    //! Not yet handed out part of the newest chunk
+    char* m_available_memory_it;
+    char* m_available_memory_end;
+    //! Bytes in blocks handed out from the chunks and not freed since
+    size_t m_used_bytes;
+    //! Bytes in live requests that went to operator new
+    size_t m_large_bytes;
+
+    static size_t NumElemAlignBytes(size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsFreeListUsable(size_t bytes, size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PlaceInFreeList(void* p, size_t num_alignments)
+    {
+        ListNode* node = new (p) ListNode;
+        node->m_next = m_free_lists[num_alignments];
+        m_free_lists[num_alignments] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Keep what is left of the current chunk around as a smaller block
+        const size_t remaining = m_available_memory_end - m_available_memory_it;
+        if (remaining > 0) {
+            PlaceInFreeList(m_available_memory_it, remaining / ELEM_ALIGN_BYTES);
+        }
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_allocated_chunks.push_back(chunk);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + m_chunk_size_bytes;
+    }
+
+public:
+    explicit PoolResource(size_t chunk_size_bytes = 256 * 1024)
+        : m_chunk_size_bytes(chunk_size_bytes / ELEM_ALIGN_BYTES * ELEM_ALIGN_BYTES),
+          m_available_memory_it(nullptr), m_available_memory_end(nullptr), m_used_bytes(0), m_large_bytes(0)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        m_free_lists.fill(nullptr);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(size_t bytes, size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            void* p = ::operator new(bytes);
+            m_large_bytes += bytes;
+            return p;
+        }
+        const size_t num_alignments = NumElemAlignBytes(bytes);
+        m_used_bytes += num_alignments * ELEM_ALIGN_BYTES;
+        if (m_free_lists[num_alignments] != nullptr) {
+            ListNode* node = m_free_lists[num_alignments];
+            m_free_lists[num_alignments] = node->m_next;
+            return node;
+        }
+        const size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if ((size_t)(m_available_memory_end - m_available_memory_it) < round_bytes) {
+            AllocateChunk();
+        }
+        void* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t bytes, size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            m_large_bytes -= bytes;
+            return;
+        }
+        const size_t num_alignments = NumElemAlignBytes(bytes);
+        m_used_bytes -= num_alignments * ELEM_ALIGN_BYTES;
+        PlaceInFreeList(p, num_alignments);
+    }
+
+    /** Give all chunks back to the system. Only allowed while no block is in use. */
+    void ReleaseChunks()
+    {
+        assert(m_used_bytes == 0);
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+        m_allocated_chunks.clear();
+        m_free_lists.fill(nullptr);
+        m_available_memory_it = nullptr;
+        m_available_memory_end = nullptr;
+    }
+
+    /** Memory in blocks that are in use */
+    size_t UsedBytes() const { return m_used_bytes; }
+    /** Memory in requests too large or too aligned for the chunks, such as
+     *  the bucket arrays of hashed containers */
+    size_t LargeBytes() const { return m_large_bytes; }
+    /** Memory held in chunks, whether in use or not */
+    size_t ChunkBytes() const { return m_allocated_chunks.size() * m_chunk_size_bytes; }
+    /** Memory handed out from the chunks, whether in use or on a free list
+     *  since. Only the part of the newest chunk not handed out yet is left out. */
+    size_t AllocatedBytes() const { return ChunkBytes() - (m_available_memory_end - m_available_memory_it); }
+};
+
+/** Allocator for standard and boost containers that takes its memory from a
+ *  PoolResource, which has to outlive the container. */
+template <typename T, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class PoolAllocator
+{
+public:
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+
+private:
+    ResourceType* m_resource;
+};
+
+template <typename T1, typename T2, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <typename T1, typename T2, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // SALEMCASH_SUPPORT_ALLOCATORS_POOL_H
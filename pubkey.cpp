@@ -8,10 +8,18 @@
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <algorithm>
+
 namespace
 {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context* secp256k1_context_verify = nullptr;
+
+/* Scratch space budget for CPubKey::MultiScalarMul. Strauss' algorithm needs
+ * a few KiB per point; larger inputs switch to Pippenger's algorithm, which
+ * splits the work into batches that fit whatever space it is given. */
+const size_t MULTI_SCALAR_SCRATCH_PER_POINT = 4096;
+const size_t MULTI_SCALAR_SCRATCH_MAX = 4 << 20;
 } // namespace
 
 /** This function is taken from the libsecp256k1 distribution and implements
@@ -279,6 +287,41 @@ bool CExtPubKey::Derive(CExtPubKey &out, unsigned int _nChild) const {
     return (!secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, nullptr, &sig));
 }
 
+/* static */ bool CPubKey::MultiScalarMul(CPubKey& result, const uint256* gscalar, const std::vector<CPubKey>& pubkeys, const std::vector<uint256>& scalars, bool fCompressed) {
+    if (pubkeys.size() != scalars.size()) {
+        return false;
+    }
+    std::vector<secp256k1_pubkey> parsed(pubkeys.size());
+    std::vector<const secp256k1_pubkey*> pubkey_ptrs(pubkeys.size());
+    std::vector<const unsigned char*> scalar_ptrs(scalars.size());
+    for (size_t i = 0; i < pubkeys.size(); i++) {
+        if (!pubkeys[i].IsValid() || !secp256k1_ec_pubkey_parse(secp256k1_context_verify, &parsed[i], pubkeys[i].begin(), pubkeys[i].size())) {
+            return false;
+        }
+        pubkey_ptrs[i] = &parsed[i];
+        scalar_ptrs[i] = scalars[i].begin();
+    }
+    // Without a scratch space the library falls back to one multiplication per
+    // point, so only bother allocating one when there is something to batch.
+    secp256k1_scratch_space* scratch = nullptr;
+    if (pubkeys.size() > 1) {
+        scratch = secp256k1_scratch_space_create(secp256k1_context_verify, std::min<size_t>(MULTI_SCALAR_SCRATCH_PER_POINT * (pubkeys.size() + 1), MULTI_SCALAR_SCRATCH_MAX));
+    }
+    secp256k1_pubkey out;
+    int ret = secp256k1_ecmult_multi(secp256k1_context_verify, scratch, &out, gscalar ? gscalar->begin() : nullptr, pubkey_ptrs.data(), scalar_ptrs.data(), pubkeys.size());
+    if (scratch) {
+        secp256k1_scratch_space_destroy(scratch);
+    }
+    if (!ret) {
+        return false;
+    }
+    unsigned char pub[PUBLIC_KEY_SIZE];
+    size_t publen = PUBLIC_KEY_SIZE;
+    secp256k1_ec_pubkey_serialize(secp256k1_context_verify, pub, &publen, &out, fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
+    result.Set(pub, pub + publen);
+    return true;
+}
+
 /* static */ int ECCVerifyHandle::refcount = 0;
 
 ECCVerifyHandle::ECCVerifyHandle()
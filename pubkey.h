@@ -194,6 +194,15 @@ public:
 
     //! Derive BIP32 child pubkey.
     bool Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
+
+    /**
+     * Compute gscalar*G + sum(scalars[i]*pubkeys[i]) in a single multi-scalar
+     * multiplication, which is much cheaper than one multiplication per key.
+     * Scalars are 32-byte big-endian values (as passed to Verify); gscalar may
+     * be nullptr to leave out the generator term. Fails if a key is invalid,
+     * a scalar is not below the group order, or the sum is the point at infinity.
+     */
+    static bool MultiScalarMul(CPubKey& result, const uint256* gscalar, const std::vector<CPubKey>& pubkeys, const std::vector<uint256>& scalars, bool fCompressed = true);
 };
 
 struct CExtPubKey {
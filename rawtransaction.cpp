@@ -6,6 +6,7 @@
 #include <cash.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <index/txindex.h>
 #include <init.h>
 #include <keystore.h>
 #include <validation.h>
@@ -67,10 +68,11 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             "getrawtransaction \"txid\" ( verbose \"blockhash\" )\n"
 
             "\nNOTE: By default this function only works for mempool transactions. If the -txindex option is\n"
-            "enabled, it also works for blockchain transactions. If the block which contains the transaction\n"
-            "is known, its hash can be provided even for nodes without -txindex. Note that if a blockhash is\n"
-            "provided, only that block will be searched and if the transaction is in the mempool or other\n"
-            "blocks, or if this node does not have the given block available, the transaction will not be found.\n"
+            "enabled, or the index is switched on with setindex, it also works for blockchain transactions.\n"
+            "If the block which contains the transaction is known, its hash can be provided even for nodes\n"
+            "without -txindex. Note that if a blockhash is provided, only that block will be searched and if\n"
+            "the transaction is in the mempool or other blocks, or if this node does not have the given block\n"
+            "available, the transaction will not be found.\n"
             "DEPRECATED: for now, it also works for transactions with unspent outputs.\n"
 
             "\nReturn the raw transaction data.\n"
@@ -139,8 +141,6 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             + HelpExampleCli("getrawtransaction", "\"mytxid\" true \"myblockhash\"")
         );
 
-    LOCK(cs_main);
-
     bool in_active_chain = true;
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
     CBlockIndex* blockindex = nullptr;
@@ -157,6 +157,8 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
     }
 
     if (!request.params[2].isNull()) {
+        LOCK(cs_main);
+
         uint256 blockhash = ParseHashV(request.params[2], "parameter 3");
         blockindex = LookupBlockIndex(blockhash);
         if (!blockindex) {
@@ -165,6 +167,16 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
         in_active_chain = chainActive.Contains(blockindex);
     }
 
+    // Let the index take in the blocks connected so far, which needs
+    // cs_main to be free
+    std::shared_ptr<TxIndex> txindex = GetTxIndex();
+    bool f_txindex_ready = false;
+    if (txindex && !blockindex) {
+        f_txindex_ready = txindex->BlockUntilSyncedToCurrentChain();
+    }
+
+    LOCK(cs_main);
+
     CTransactionRef tx;
     uint256 hash_block;
     if (!GetTransaction(hash, tx, Params().GetConsensus(), hash_block, true, blockindex)) {
@@ -174,10 +186,12 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
                 throw JSONRPCError(RPC_MISC_ERROR, "Block not available");
             }
             errmsg = "No such transaction found in the provided block";
+        } else if (!txindex) {
+            errmsg = "No such mempool transaction. Use -txindex or setindex to enable blockchain transaction queries";
+        } else if (!f_txindex_ready) {
+            errmsg = "No such mempool transaction. Blockchain transactions are still in the process of being indexed";
         } else {
-            errmsg = fTxIndex
-              ? "No such mempool or blockchain transaction"
-              : "No such mempool transaction. Use -txindex to enable blockchain transaction queries";
+            errmsg = "No such mempool or blockchain transaction";
         }
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, errmsg + ". Use gettransaction for wallet transactions.");
     }
@@ -227,6 +241,11 @@ UniValue gettxoutproof(const JSONRPCRequest& request)
        oneTxid = hash;
     }
 
+    std::shared_ptr<TxIndex> txindex = GetTxIndex();
+    if (txindex && request.params[1].isNull()) {
+        txindex->BlockUntilSyncedToCurrentChain();
+    }
+
     LOCK(cs_main);
 
     CBlockIndex* pblockindex = nullptr;
@@ -1133,6 +1152,150 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
     return hashTx.GetHex();
 }
 
+static std::vector<CTransactionRef> DecodePackage(const UniValue& rawtxs)
+{
+    std::vector<CTransactionRef> package;
+    package.reserve(rawtxs.size());
+    for (unsigned int idx = 0; idx < rawtxs.size(); idx++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, rawtxs[idx].get_str())) {
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for tx %d", idx));
+        }
+        package.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+    if (package.empty()) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Missing transactions");
+    }
+    return package;
+}
+
+UniValue testmempoolaccept(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "testmempoolaccept [\"rawtxs\"] ( allowhighfees )\n"
+            "\nReturns if the raw transactions (serialized, hex-encoded) would be accepted by the mempool together.\n"
+            "Each transaction may spend outputs of the ones before it, and one below the minimum feerate is\n"
+            "accepted if its descendants among them pay for it. Nothing is added to the mempool.\n"
+            "\nArguments:\n"
+            "1. [\"rawtxs\"]       (array, required) An array of hex strings of raw transactions, parents first.\n"
+            "                                        At most " + std::to_string(MAX_PACKAGE_COUNT) + " transactions.\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "[                   (array) The result of the mempool acceptance test for each raw transaction in the input array.\n"
+            "  {\n"
+            "    \"txid\"           (string) The transaction hash in hex\n"
+            "    \"allowed\"        (boolean) If the package would be accepted\n"
+            "    \"reject-reason\"  (string) Rejection string, for the transaction that failed, or all of them if the package as a whole did\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "\nCreate a transaction\n"
+            + HelpExampleCli("createrawtransaction", "\"[{\\\"txid\\\" : \\\"mytxid\\\",\\\"vout\\\":0}]\" \"{\\\"myaddress\\\":0.01}\"") +
+            "Sign the transaction, and get back the hex\n"
+            + HelpExampleCli("signrawtransaction", "\"myhex\"") +
+            "\nTest acceptance of the transaction and a child of it (signed hex)\n"
+            + HelpExampleCli("testmempoolaccept", "\"[\\\"signedhex\\\",\\\"childhex\\\"]\"") +
+            "\nAs a json rpc call\n"
+            + HelpExampleRpc("testmempoolaccept", "[\"signedhex\",\"childhex\"]")
+        );
+
+    ObserveSafeMode();
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+    const std::vector<CTransactionRef> package = DecodePackage(request.params[0].get_array());
+
+    CAmount nMaxRawTxFee = maxTxFee;
+    if (!request.params[1].isNull() && request.params[1].get_bool())
+        nMaxRawTxFee = 0;
+
+    CValidationState state;
+    size_t nFailed = package.size();
+    bool fAccepted = AcceptPackageToMemoryPool(mempool, state, package, &nFailed, true /* test_accept */, nMaxRawTxFee);
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < package.size(); i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", package[i]->GetHash().GetHex());
+        entry.pushKV("allowed", fAccepted);
+        if (!fAccepted && (nFailed == i || nFailed == package.size())) {
+            if (state.IsInvalid()) {
+                entry.pushKV("reject-reason", strprintf("%i: %s", state.GetRejectCode(), state.GetRejectReason()));
+            } else {
+                entry.pushKV("reject-reason", FormatStateMessage(state));
+            }
+        }
+        result.push_back(entry);
+    }
+    return result;
+}
+
+UniValue sendpackage(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "sendpackage [\"rawtxs\"] ( allowhighfees )\n"
+            "\nSubmits raw transactions (serialized, hex-encoded) to local node and network, all or none of them.\n"
+            "Each transaction may spend outputs of the ones before it, and one below the minimum feerate is\n"
+            "accepted if its descendants among them pay for it. Transactions already in the mempool are skipped.\n"
+            "\nArguments:\n"
+            "1. [\"rawtxs\"]       (array, required) An array of hex strings of raw transactions, parents first.\n"
+            "                                        At most " + std::to_string(MAX_PACKAGE_COUNT) + " transactions.\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "[                   (array) The transaction hashes in hex\n"
+            "  \"hex\"\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendpackage", "\"[\\\"signedhex\\\",\\\"childhex\\\"]\"") +
+            "\nAs a json rpc call\n"
+            + HelpExampleRpc("sendpackage", "[\"signedhex\",\"childhex\"]")
+        );
+
+    ObserveSafeMode();
+
+    std::promise<void> promise;
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+    const std::vector<CTransactionRef> package = DecodePackage(request.params[0].get_array());
+
+    CAmount nMaxRawTxFee = maxTxFee;
+    if (!request.params[1].isNull() && request.params[1].get_bool())
+        nMaxRawTxFee = 0;
+
+    CValidationState state;
+    size_t nFailed = package.size();
+    if (!AcceptPackageToMemoryPool(mempool, state, package, &nFailed, false /* test_accept */, nMaxRawTxFee)) {
+        std::string strTx = nFailed < package.size() ? strprintf("tx %d (%s): ", nFailed, package[nFailed]->GetHash().GetHex()) : "";
+        if (state.IsInvalid()) {
+            throw JSONRPCError(RPC_TRANSACTION_REJECTED, strTx + FormatStateMessage(state));
+        }
+        throw JSONRPCError(RPC_TRANSACTION_ERROR, strTx + FormatStateMessage(state));
+    }
+    // Make sure the wallet has seen the transactions before returning, as
+    // sendrawtransaction does
+    CallFunctionInValidationInterfaceQueue([&promise] {
+        promise.set_value();
+    });
+    promise.get_future().wait();
+
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    UniValue result(UniValue::VARR);
+    for (const CTransactionRef& ptx : package) {
+        CInv inv(MSG_TX, ptx->GetHash());
+        g_connman->ForEachNode([&inv](CNode* pnode)
+        {
+            pnode->PushInventory(inv);
+        });
+        result.push_back(ptx->GetHash().GetHex());
+    }
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                            actor (function)            argNames
   //  --------------------- ------------------------        -----------------------     ----------
@@ -1141,6 +1304,8 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring","iswitness"} },
     { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",           &sendrawtransaction,        {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "testmempoolaccept",            &testmempoolaccept,         {"rawtxs","allowhighfees"} },
+    { "rawtransactions",    "sendpackage",                  &sendpackage,               {"rawtxs","allowhighfees"} },
     { "rawtransactions",    "combinerawtransaction",        &combinerawtransaction,     {"txs"} },
     { "rawtransactions",    "signrawtransaction",           &signrawtransaction,        {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
     { "rawtransactions",    "signrawtransactionwithkey",    &signrawtransactionwithkey, {"hexstring","privkeys","prevtxs","sighashtype"} },
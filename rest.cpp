@@ -2,14 +2,20 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
+#include <index/txindex.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <script/script.h>
 #include <validation.h>
 #include <httpserver.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonwriter.h>
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
@@ -17,6 +23,8 @@
 #include <utilstrencodings.h>
 #include <version.h>
 
+#include <limits>
+
 #include <boost/algorithm/string.hpp>
 
 #include <univalue.h>
@@ -66,6 +74,37 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string me
     return false;
 }
 
+/** Reply with the JSON document written by fn, sent in chunks as it is
+ *  written once it outgrows a single chunk. If fn throws, the reply is an
+ *  error while nothing was sent yet, and is cut short otherwise. */
+template <typename WriteFn>
+static bool WriteJSONReply(HTTPRequest* req, WriteFn fn)
+{
+    bool chunked = false;
+    JSONStreamWriter writer([req, &chunked](const std::string& chunk) {
+        if (!chunked) {
+            req->WriteHeader("Content-Type", "application/json");
+            chunked = true;
+        }
+        req->WriteReplyChunk(HTTP_OK, chunk);
+    });
+    try {
+        fn(writer);
+    } catch (const std::runtime_error& e) {
+        if (!chunked) {
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, e.what());
+        }
+        LogPrintf("%s: %s failed after part of the reply was sent: %s\n", __func__, req->GetURI(), e.what());
+        req->WriteReply(HTTP_OK);
+        return false;
+    }
+    if (!chunked) {
+        req->WriteHeader("Content-Type", "application/json");
+    }
+    req->WriteReply(HTTP_OK, writer.TakeBuffer() + "\n");
+    return true;
+}
+
 static enum RetFormat ParseDataFormat(std::string& param, const std::string& strReq)
 {
     const std::string::size_type pos = strReq.rfind('.');
@@ -193,6 +232,262 @@ static bool rest_headers(HTTPRequest* req,
     }
 }
 
+static bool rest_filter_header(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilterheaders/<filtertype>/<count>/<blockhash>.<ext>");
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(path[0], filtertype))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+
+    std::shared_ptr<BlockFilterIndex> index = GetBlockFilterIndex(filtertype);
+    if (!index)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Index is not enabled for filtertype " + path[0]);
+
+    long count = strtol(path[1].c_str(), nullptr, 10);
+    if (count < 1 || count > MAX_FILTER_HEADERS_RESULTS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[1]);
+
+    uint256 hash;
+    if (!ParseHashStr(path[2], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[2]);
+
+    std::vector<const CBlockIndex*> headers;
+    headers.reserve(count);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = LookupBlockIndex(hash);
+        while (pindex != nullptr && chainActive.Contains(pindex)) {
+            headers.push_back(pindex);
+            if (headers.size() == (unsigned long)count)
+                break;
+            pindex = chainActive.Next(pindex);
+        }
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    std::vector<uint256> filter_headers;
+    filter_headers.reserve(headers.size());
+    for (const CBlockIndex* pindex : headers) {
+        uint256 filter_header;
+        if (!index->LookupFilterHeader(pindex, filter_header)) {
+            std::string errmsg = "Filter not found.";
+            if (!index_ready) {
+                errmsg += " Block filters are still in the process of being indexed.";
+            }
+            return RESTERR(req, HTTP_NOT_FOUND, errmsg);
+        }
+        filter_headers.push_back(filter_header);
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+        for (const uint256& header : filter_headers) {
+            ssHeader << header;
+        }
+
+        std::string binaryHeader = ssHeader.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryHeader);
+        return true;
+    }
+    case RF_HEX: {
+        CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+        for (const uint256& header : filter_headers) {
+            ssHeader << header;
+        }
+
+        std::string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+    case RF_JSON: {
+        UniValue jsonHeaders(UniValue::VARR);
+        for (const uint256& header : filter_headers) {
+            jsonHeaders.push_back(header.GetHex());
+        }
+
+        std::string strJSON = jsonHeaders.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex, .json)");
+    }
+    }
+}
+
+static bool rest_block_filter(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    // request is sent over URI scheme /rest/blockfilter/filtertype/blockhash
+    std::vector<std::string> uri_parts;
+    boost::split(uri_parts, param, boost::is_any_of("/"));
+    if (uri_parts.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilter/<filtertype>/<blockhash>.<ext>");
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(uri_parts[0], filtertype))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + uri_parts[0]);
+
+    std::shared_ptr<BlockFilterIndex> index = GetBlockFilterIndex(filtertype);
+    if (!index)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Index is not enabled for filtertype " + uri_parts[0]);
+
+    uint256 block_hash;
+    if (!ParseHashStr(uri_parts[1], block_hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + uri_parts[1]);
+
+    const CBlockIndex* block_index;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index)
+            return RESTERR(req, HTTP_NOT_FOUND, uri_parts[1] + " not found");
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    if (!index->LookupFilter(block_index, filter)) {
+        std::string errmsg = "Filter not found.";
+        if (!index_ready) {
+            errmsg += " Block filters are still in the process of being indexed.";
+        }
+        return RESTERR(req, HTTP_NOT_FOUND, errmsg);
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        CDataStream ssResp(SER_NETWORK, PROTOCOL_VERSION);
+        ssResp << filter;
+
+        std::string binaryResp = ssResp.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryResp);
+        return true;
+    }
+    case RF_HEX: {
+        CDataStream ssResp(SER_NETWORK, PROTOCOL_VERSION);
+        ssResp << filter;
+
+        std::string strHex = HexStr(ssResp.begin(), ssResp.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+    case RF_JSON: {
+        UniValue ret(UniValue::VOBJ);
+        ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+        std::string strJSON = ret.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex, .json)");
+    }
+    }
+}
+
+/** The address index, once it has caught up with the notifications in the queue */
+static std::shared_ptr<AddressIndex> GetSyncedAddressIndex(HTTPRequest* req)
+{
+    std::shared_ptr<AddressIndex> index = GetAddressIndex();
+    if (!index) {
+        RESTERR(req, HTTP_BAD_REQUEST, "Address index is not enabled");
+        return nullptr;
+    }
+    if (!index->BlockUntilSyncedToCurrentChain()) {
+        RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Address index is still being built");
+        return nullptr;
+    }
+    return index;
+}
+
+static bool rest_address_history(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    // request is sent over URI scheme /rest/addresshistory/address(/start_height/stop_height)
+    std::vector<std::string> uri_parts;
+    boost::split(uri_parts, param, boost::is_any_of("/"));
+    if (uri_parts.size() != 1 && uri_parts.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/addresshistory/<address>(/<start_height>/<stop_height>).json");
+
+    CScript script;
+    if (!AddressOrScriptToScript(uri_parts[0], script))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address or script: " + uri_parts[0]);
+
+    // Without a height range, the mempool transactions follow those up to the tip
+    int32_t start_height = 0;
+    int32_t stop_height = std::numeric_limits<int32_t>::max();
+    const bool include_mempool = uri_parts.size() == 1;
+    if (!include_mempool && (!ParseInt32(uri_parts[1], &start_height) || !ParseInt32(uri_parts[2], &stop_height) ||
+                             start_height < 0 || stop_height < start_height))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height range: " + uri_parts[1] + "/" + uri_parts[2]);
+
+    std::shared_ptr<AddressIndex> index = GetSyncedAddressIndex(req);
+    if (!index)
+        return false;
+
+    const uint256 script_hash = AddressScriptHash(script);
+    return WriteJSONReply(req, [&](JSONWriter& writer) {
+        addressHistoryToJSON(*index, script_hash, start_height, stop_height, include_mempool, writer);
+    });
+}
+
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+
+    // request is sent over URI scheme /rest/addressutxos/address(/checkmempool)
+    std::vector<std::string> uri_parts;
+    boost::split(uri_parts, param, boost::is_any_of("/"));
+    if (uri_parts.size() > 2 || (uri_parts.size() == 2 && uri_parts[1] != "checkmempool"))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/addressutxos/<address>(/checkmempool).json");
+
+    CScript script;
+    if (!AddressOrScriptToScript(uri_parts[0], script))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address or script: " + uri_parts[0]);
+    const bool include_mempool = uri_parts.size() == 2;
+
+    std::shared_ptr<AddressIndex> index = GetSyncedAddressIndex(req);
+    if (!index)
+        return false;
+
+    const uint256 script_hash = AddressScriptHash(script);
+    return WriteJSONReply(req, [&](JSONWriter& writer) {
+        addressUnspentToJSON(*index, script_hash, include_mempool, writer);
+    });
+}
+
 static bool rest_block(HTTPRequest* req,
                        const std::string& strURIPart,
                        bool showTxDetails)
@@ -206,7 +501,11 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    // The serialized formats can be served with the bytes on disk as they
+    // are, unless witness data has to be stripped.
+    const bool fRawBlock = (rf == RF_BINARY || rf == RF_HEX) && !(RPCSerializationFlags() & SERIALIZE_TRANSACTION_NO_WITNESS);
     CBlock block;
+    std::vector<unsigned char> vchBlock;
     CBlockIndex* pblockindex = nullptr;
     {
         LOCK(cs_main);
@@ -218,38 +517,37 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        if (fRawBlock) {
+            if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
+    if (!fRawBlock && (rf == RF_BINARY || rf == RF_HEX)) {
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags(), vchBlock, 0, block);
+    }
 
     switch (rf) {
     case RF_BINARY: {
-        std::string binaryBlock = ssBlock.str();
+        std::string binaryBlock(vchBlock.begin(), vchBlock.end());
         req->WriteHeader("Content-Type", "application/octet-stream");
         req->WriteReply(HTTP_OK, binaryBlock);
         return true;
     }
 
     case RF_HEX: {
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::string strHex = HexStr(vchBlock.begin(), vchBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock;
-        {
-            LOCK(cs_main);
-            objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        }
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return WriteJSONReply(req, [&](JSONWriter& writer) {
+            blockToJSON(block, pblockindex, showTxDetails, writer);
+        });
     }
 
     default: {
@@ -325,12 +623,9 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return WriteJSONReply(req, [](JSONWriter& writer) {
+            mempoolToJSON(true, writer);
+        });
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
@@ -349,6 +644,11 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
+    std::shared_ptr<TxIndex> txindex = GetTxIndex();
+    if (txindex) {
+        txindex->BlockUntilSyncedToCurrentChain();
+    }
+
     CTransactionRef tx;
     uint256 hashBlock = uint256();
     if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
@@ -580,13 +880,17 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockfilter/", rest_block_filter},
+      {"/rest/blockfilterheaders/", rest_filter_header},
+      {"/rest/addresshistory/", rest_address_history},
+      {"/rest/addressutxos/", rest_address_utxos},
       {"/rest/getutxos", rest_getutxos},
 };
 
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, HTTPWorkLane::REST);
     return true;
 }
 
@@ -5,12 +5,20 @@
 #include <rpc/server.h>
 #include <rpc/client.h>
 
+#include <chainparams.h>
 #include <core_io.h>
+#include <httprpc.h>
+#include <httpserver.h>
 #include <key_io.h>
 #include <netbase.h>
+#include <rpc/jsonwriter.h>
 
 #include <test/test_salemcash.h>
 
+#include <algorithm>
+#include <limits>
+#include <thread>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
@@ -230,6 +238,52 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+/** Parse str as the only element of a JSON array, returning whether it is a
+ *  valid string and its value in out */
+static bool ReadJSONString(const std::string& str, std::string& out)
+{
+    UniValue val;
+    if (!val.read("[\"" + str + "\"]") || val.size() != 1 || !val[0].isStr())
+        return false;
+    out = val[0].get_str();
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(json_parse_string_runs)
+{
+    // Plain characters are skipped eight at a time, so put each special
+    // character at every offset around and past the first 8-byte boundary
+    const std::vector<std::pair<std::string, std::string>> escapes = {
+        {"\\\"", "\""}, {"\\\\", "\\"}, {"\\/", "/"}, {"\\n", "\n"}, {"\\t", "\t"}, {"\\u0001", "\x01"}, {"\\u00e9", "\xc3\xa9"},
+        {"\x7f", "\x7f"}, {"\xc3\xa9", "\xc3\xa9"}, {"\xe2\x82\xac", "\xe2\x82\xac"}, {"\xf0\x9f\x98\x80", "\xf0\x9f\x98\x80"},
+    };
+    for (size_t pos = 0; pos <= 17; pos++) {
+        const std::string before(pos, 'a');
+        const std::string after(17 - pos, 'b');
+        std::string out;
+        for (const auto& escape : escapes) {
+            BOOST_CHECK(ReadJSONString(before + escape.first + after, out));
+            BOOST_CHECK(out == before + escape.second + after);
+        }
+
+        // Control characters have to be escaped
+        BOOST_CHECK(!ReadJSONString(before + "\x01" + after, out));
+        BOOST_CHECK(!ReadJSONString(before + "\x1f" + after, out));
+        BOOST_CHECK(!ReadJSONString(before + "\n" + after, out));
+        // A quote ends the string, leaving the rest as garbage
+        BOOST_CHECK(!ReadJSONString(before + "\"" + after, out));
+
+        // A UTF-8 sequence cut short by a run of plain characters
+        BOOST_CHECK(!ReadJSONString(before + "\xc3" + after + "aaaaaaaa", out));
+        BOOST_CHECK(!ReadJSONString(before + "\xe2\x82" + after + "aaaaaaaa", out));
+        BOOST_CHECK(!ReadJSONString(before + "\xf0\x9f\x98" + after + "aaaaaaaa", out));
+        // ... or continued where none was started
+        BOOST_CHECK(!ReadJSONString(before + "\x80" + after, out));
+        // ... or still open at the end of the string
+        BOOST_CHECK(!ReadJSONString(before + "\xe2\x82", out));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(std::string("clearbanned")));
@@ -336,4 +390,216 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_parallel)
+{
+    SetRPCWarmupFinished();
+
+    // Runs of read-only entries, separated by entries that run on their own
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("id", i);
+        UniValue params(UniValue::VARR);
+        if (i % 10 == 9) {
+            entry.pushKV("method", "echo");
+            params.push_back(i);
+        } else {
+            entry.pushKV("method", "getblockhash");
+            params.push_back(0);
+        }
+        entry.pushKV("params", params);
+        batch.push_back(entry);
+    }
+
+    std::vector<std::thread> threads;
+    RPCTaskQueue queueTask = [&threads](const std::function<void()>& task) {
+        threads.emplace_back(task);
+        return true;
+    };
+    const std::string strSerial = JSONRPCExecBatch(JSONRPCRequest(), batch);
+    const std::string strParallel = JSONRPCExecBatch(JSONRPCRequest(), batch, queueTask, 3);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(threads.size(), 30U);
+    BOOST_CHECK_EQUAL(strSerial, strParallel);
+
+    UniValue results;
+    BOOST_CHECK(results.read(strParallel));
+    BOOST_CHECK_EQUAL(results.size(), 100U);
+    BOOST_CHECK_EQUAL(results[9]["result"][0].get_int(), 9);
+    BOOST_CHECK_EQUAL(results[42]["id"].get_int(), 42);
+    BOOST_CHECK(results[42]["error"].isNull());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_peek_methods)
+{
+    BOOST_CHECK(PeekRPCMethods("").empty());
+    BOOST_CHECK(PeekRPCMethods("{\"params\":[]}").empty());
+
+    std::vector<std::string> methods = PeekRPCMethods("{\"method\": \"getblockcount\", \"params\": []}");
+    BOOST_REQUIRE_EQUAL(methods.size(), 1U);
+    BOOST_CHECK_EQUAL(methods[0], "getblockcount");
+
+    // A "method" inside a string or used as a value is not a key
+    methods = PeekRPCMethods("{\"params\":[\"{\\\"method\\\":\\\"stop\\\"}\", \"method\"], \"method\":\"echo\"}");
+    BOOST_REQUIRE_EQUAL(methods.size(), 1U);
+    BOOST_CHECK_EQUAL(methods[0], "echo");
+
+    // Each call of a batch, with methods that are not strings left empty
+    methods = PeekRPCMethods("[{\"method\":\"echo\"},{\"method\":5},{\"method\":\"gettxoutsetinfo\"}]");
+    BOOST_REQUIRE_EQUAL(methods.size(), 3U);
+    BOOST_CHECK_EQUAL(methods[0], "echo");
+    BOOST_CHECK_EQUAL(methods[1], "");
+    BOOST_CHECK_EQUAL(methods[2], "gettxoutsetinfo");
+}
+
+BOOST_AUTO_TEST_CASE(rpc_lane_selection)
+{
+    static const CRPCCommand walletCommand = {"wallet", "testwalletcall", nullptr, {}, nullptr};
+    BOOST_REQUIRE(tableRPC.appendCommand(walletCommand.name, &walletCommand));
+
+    BOOST_CHECK(SelectRPCLane("{\"method\":\"echo\"}") == HTTPWorkLane::RPC);
+    BOOST_CHECK(SelectRPCLane("{\"method\":\"gettxoutsetinfo\"}") == HTTPWorkLane::RPC_HEAVY);
+    BOOST_CHECK(SelectRPCLane("{\"method\":\"testwalletcall\"}") == HTTPWorkLane::WALLET);
+
+    // Requests that will fail to parse are cheap
+    BOOST_CHECK(SelectRPCLane("") == HTTPWorkLane::RPC);
+    BOOST_CHECK(SelectRPCLane("{\"method\":5}") == HTTPWorkLane::RPC);
+    BOOST_CHECK(SelectRPCLane("{\"params\":\"" + std::string(4096, 'a')) == HTTPWorkLane::RPC);
+
+    // A batch goes to the lane of its heaviest call
+    BOOST_CHECK(SelectRPCLane("[]") == HTTPWorkLane::RPC);
+    BOOST_CHECK(SelectRPCLane(" [{\"method\":\"echo\"},{\"method\":\"getblockcount\"}]") == HTTPWorkLane::RPC);
+    BOOST_CHECK(SelectRPCLane("[{\"method\":\"echo\"},{\"method\":\"testwalletcall\"}]") == HTTPWorkLane::WALLET);
+    BOOST_CHECK(SelectRPCLane("[{\"method\":\"testwalletcall\"},{\"method\":\"gettxoutsetinfo\"},{\"method\":\"echo\"}]") == HTTPWorkLane::RPC_HEAVY);
+
+    // A large batch is looked at as a whole
+    std::string strBatch = "[";
+    while (strBatch.size() < 64 * 1024) {
+        strBatch += "{\"method\":\"echo\"},";
+    }
+    BOOST_CHECK(SelectRPCLane(strBatch + "{\"method\":\"echo\"}]") == HTTPWorkLane::RPC);
+    BOOST_CHECK(SelectRPCLane(strBatch + "{\"method\":\"gettxoutsetinfo\"}]") == HTTPWorkLane::RPC_HEAVY);
+
+    BOOST_CHECK(tableRPC.removeCommand(walletCommand.name, &walletCommand));
+    BOOST_CHECK(SelectRPCLane("{\"method\":\"testwalletcall\"}") == HTTPWorkLane::RPC);
+}
+
+BOOST_AUTO_TEST_CASE(http_histogram)
+{
+    HTTPHistogram histogram;
+    std::vector<uint64_t> counts = histogram.Get();
+    BOOST_REQUIRE_EQUAL(counts.size(), HTTPHistogram::BUCKETS);
+    BOOST_CHECK(std::all_of(counts.begin(), counts.end(), [](uint64_t n) { return n == 0; }));
+
+    // Buckets hold samples of up to 0, 1, 2, 4, 8, ...
+    for (uint64_t value : {0, 1, 2, 3, 4, 5, 8, 9, 16}) {
+        histogram.Add(value);
+    }
+    counts = histogram.Get();
+    BOOST_CHECK_EQUAL(counts[0], 1U);
+    BOOST_CHECK_EQUAL(counts[1], 1U);
+    BOOST_CHECK_EQUAL(counts[2], 1U);
+    BOOST_CHECK_EQUAL(counts[3], 2U);
+    BOOST_CHECK_EQUAL(counts[4], 2U);
+    BOOST_CHECK_EQUAL(counts[5], 2U);
+    BOOST_CHECK_EQUAL(counts[6], 0U);
+
+    // The last bucket is open ended
+    histogram.Add(1ULL << (HTTPHistogram::BUCKETS - 3));
+    histogram.Add((1ULL << (HTTPHistogram::BUCKETS - 3)) + 1);
+    histogram.Add(std::numeric_limits<uint64_t>::max());
+    counts = histogram.Get();
+    BOOST_CHECK_EQUAL(counts[HTTPHistogram::BUCKETS - 2], 1U);
+    BOOST_CHECK_EQUAL(counts[HTTPHistogram::BUCKETS - 1], 2U);
+}
+
+/** A document with nested objects and arrays, escapes and every kind of value */
+static void WriteTestDocument(JSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.KeyValue("name", "a \"quoted\" \\ string\n");
+    writer.Key("empty_array");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("empty_object");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Key("rows");
+    writer.BeginArray();
+    for (int i = 0; i < 50; i++) {
+        writer.BeginObject();
+        writer.KeyValue("n", i);
+        writer.KeyValue("even", i % 2 == 0);
+        writer.KeyValue("amount", ValueFromAmount(i * CASH / 3));
+        writer.KeyValue("null", NullUniValue);
+        writer.Key("nested");
+        writer.BeginArray();
+        writer.Value(UniValue(UniValue::VARR));
+        writer.Value(std::string(i, 'x'));
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+/** The text a stream writer with a small chunk size hands out in total */
+template <typename WriteFn>
+static std::string StreamDocument(WriteFn fn, size_t& nChunks)
+{
+    std::string strText;
+    nChunks = 0;
+    JSONStreamWriter writer([&](const std::string& strChunk) {
+        BOOST_CHECK(!strChunk.empty());
+        strText += strChunk;
+        nChunks++;
+    }, 64);
+    fn(writer);
+    BOOST_CHECK_EQUAL(writer.HasFlushed(), nChunks > 0);
+    return strText + writer.TakeBuffer();
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_writer)
+{
+    JSONValueWriter valueWriter;
+    WriteTestDocument(valueWriter);
+    BOOST_CHECK(valueWriter.GetValue()["rows"][49]["nested"][1].get_str() == std::string(49, 'x'));
+
+    size_t nChunks;
+    const std::string strStreamed = StreamDocument(WriteTestDocument, nChunks);
+    BOOST_CHECK(nChunks > 10);
+    BOOST_CHECK_EQUAL(strStreamed, valueWriter.GetValue().write());
+
+    // A single value is a document too
+    const std::string strValue = StreamDocument([](JSONWriter& writer) { writer.Value(42); }, nChunks);
+    BOOST_CHECK_EQUAL(strValue, "42");
+    BOOST_CHECK_EQUAL(nChunks, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_stream_result)
+{
+    JSONRPCRequest request;
+    request.strMethod = "getblock";
+    request.params = UniValue(UniValue::VARR);
+    request.params.push_back(Params().GenesisBlock().GetHash().GetHex());
+    request.params.push_back(2);
+    request.fHelp = false;
+
+    const CRPCCommand* pcmd = tableRPC[request.strMethod];
+    BOOST_REQUIRE(pcmd && pcmd->streamActor);
+
+    // Streamed in chunks, the result is what the whole value renders to
+    JSONValueWriter valueWriter;
+    pcmd->streamActor(request, valueWriter);
+    size_t nChunks;
+    const std::string strStreamed = StreamDocument([&](JSONWriter& writer) {
+        pcmd->streamActor(request, writer);
+    }, nChunks);
+    BOOST_CHECK(nChunks > 1);
+    BOOST_CHECK_EQUAL(strStreamed, valueWriter.GetValue().write());
+    BOOST_CHECK_EQUAL(strStreamed, pcmd->actor(request).write());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
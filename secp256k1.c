@@ -17,6 +17,7 @@
 #include "ecdsa_impl.h"
 #include "eckey_impl.h"
 #include "hash_impl.h"
+#include "scratch_impl.h"
 
 #define ARG_CHECK(cond) do { \
     if (EXPECT(!(cond), 0)) { \
@@ -575,6 +576,65 @@ int secp256k1_ec_pubkey_combine(const secp256k1_context* ctx, secp256k1_pubkey *
     return 1;
 }
 
+secp256k1_scratch_space* secp256k1_scratch_space_create(const secp256k1_context* ctx, size_t max_size) {
+    VERIFY_CHECK(ctx != NULL);
+    return secp256k1_scratch_create(&ctx->error_callback, max_size);
+}
+
+void secp256k1_scratch_space_destroy(secp256k1_scratch_space* scratch) {
+    secp256k1_scratch_destroy(scratch);
+}
+
+typedef struct {
+    const secp256k1_context* ctx;
+    const secp256k1_pubkey * const *pubkeys;
+    const unsigned char * const *scalars;
+} secp256k1_ecmult_multi_pubkey_data;
+
+static int secp256k1_ecmult_multi_pubkey_callback(secp256k1_scalar *sc, secp256k1_ge *pt, size_t idx, void *data) {
+    const secp256k1_ecmult_multi_pubkey_data *d = (const secp256k1_ecmult_multi_pubkey_data*)data;
+    int overflow;
+    secp256k1_scalar_set_b32(sc, d->scalars[idx], &overflow);
+    if (overflow) {
+        return 0;
+    }
+    return secp256k1_pubkey_load(d->ctx, pt, d->pubkeys[idx]);
+}
+
+int secp256k1_ecmult_multi(const secp256k1_context* ctx, secp256k1_scratch_space *scratch, secp256k1_pubkey *out, const unsigned char *gscalar32, const secp256k1_pubkey * const *pubkeys, const unsigned char * const *scalars32, size_t n) {
+    secp256k1_ecmult_multi_pubkey_data data;
+    secp256k1_scalar gsc;
+    secp256k1_gej rj;
+    secp256k1_ge r;
+    int overflow = 0;
+
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(out != NULL);
+    memset(out, 0, sizeof(*out));
+    ARG_CHECK(n == 0 || pubkeys != NULL);
+    ARG_CHECK(n == 0 || scalars32 != NULL);
+
+    if (gscalar32 != NULL) {
+        secp256k1_scalar_set_b32(&gsc, gscalar32, &overflow);
+        if (overflow) {
+            return 0;
+        }
+    }
+    data.ctx = ctx;
+    data.pubkeys = pubkeys;
+    data.scalars = scalars32;
+    if (!secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, scratch, &rj, gscalar32 != NULL ? &gsc : NULL, secp256k1_ecmult_multi_pubkey_callback, &data, n)) {
+        return 0;
+    }
+    if (secp256k1_gej_is_infinity(&rj)) {
+        return 0;
+    }
+    secp256k1_ge_set_gej(&r, &rj);
+    secp256k1_pubkey_save(out, &r);
+    return 1;
+}
+
 #ifdef ENABLE_MODULE_ECDH
 # include "modules/ecdh/main_impl.h"
 #endif
@@ -42,6 +42,18 @@ extern "C" {
  */
 typedef struct secp256k1_context_struct secp256k1_context;
 
+/** Opaque data structure that holds rewriteable "scratch space"
+ *
+ *  The purpose of this structure is to replace dynamic memory allocations
+ *  inside algorithms that need large temporary tables, such as multi-scalar
+ *  multiplication. It is a block of bytes of a fixed maximum size, allocated
+ *  once at creation and reused across calls.
+ *
+ *  Unlike the context object, this cannot safely be shared between threads
+ *  without additional synchronization logic.
+ */
+typedef struct secp256k1_scratch_space_struct secp256k1_scratch_space;
+
 /** Opaque data structure that holds a parsed and valid public key.
  *
  *  The exact representation of data inside is implementation defined and not
@@ -614,6 +626,59 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_ec_pubkey_combine(
     size_t n
 ) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3);
 
+/** Create a secp256k1 scratch space object.
+ *
+ *  Returns: a newly created scratch space.
+ *  Args: ctx:  an existing context object (cannot be NULL)
+ *  In:   max_size: maximum amount of memory to allocate
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT secp256k1_scratch_space* secp256k1_scratch_space_create(
+    const secp256k1_context* ctx,
+    size_t max_size
+) SECP256K1_ARG_NONNULL(1);
+
+/** Destroy a secp256k1 scratch space.
+ *
+ *  The pointer may not be used afterwards.
+ *  Args:   scratch: space to destroy
+ */
+SECP256K1_API void secp256k1_scratch_space_destroy(
+    secp256k1_scratch_space* scratch
+);
+
+/** Multiply a number of public keys by scalars and add the results together,
+ *  optionally adding a multiple of the generator: out = g*G + sum(s[i]*P[i]).
+ *
+ *  Strauss' algorithm is used for small inputs and Pippenger's for large ones;
+ *  both share the point doublings between all terms, which makes this much
+ *  faster than n separate multiplications. Inputs that do not fit in the
+ *  scratch space are processed in batches.
+ *
+ *  Returns: 1: the result is a valid public key.
+ *           0: a scalar overflowed, a public key was invalid or the result is
+ *              the point at infinity.
+ *  Args:   ctx:        pointer to a context object initialized for validation
+ *                      (cannot be NULL)
+ *          scratch:    scratch space for the computation. If NULL, the terms
+ *                      are multiplied one at a time.
+ *  Out:    out:        pointer to a public key object for placing the result
+ *                      (cannot be NULL)
+ *  In:     gscalar32:  pointer to a 32-byte scalar for the generator, or NULL
+ *          pubkeys:    pointer to array of pointers to public keys
+ *          scalars32:  pointer to array of pointers to 32-byte scalars, one
+ *                      per public key
+ *          n:          the number of public keys and scalars
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_ecmult_multi(
+    const secp256k1_context* ctx,
+    secp256k1_scratch_space *scratch,
+    secp256k1_pubkey *out,
+    const unsigned char *gscalar32,
+    const secp256k1_pubkey * const *pubkeys,
+    const unsigned char * const *scalars32,
+    size_t n
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(3);
+
 #ifdef __cplusplus
 }
 #endif
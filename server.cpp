@@ -8,6 +8,7 @@
 #include <init.h>
 #include <key_io.h>
 #include <random.h>
+#include <rpc/jsonwriter.h>
 #include <sync.h>
 #include <ui_interface.h>
 #include <util.h>
@@ -19,7 +20,12 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 static bool fRPCRunning = false;
@@ -300,6 +306,16 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::removeCommand(const std::string& name, const CRPCCommand* pcmd)
+{
+    std::map<std::string, const CRPCCommand*>::iterator it = mapCommands.find(name);
+    if (it == mapCommands.end() || it->second != pcmd)
+        return false;
+
+    mapCommands.erase(it);
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
@@ -408,11 +424,108 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
+/**
+ * Commands that only read chain, mempool or their own arguments. Entries of
+ * a batch calling them can run at the same time without one seeing the
+ * effects of another.
+ */
+static const std::set<std::string> setParallelCommands = {
+    "decoderawtransaction",
+    "decodescript",
+    "getbestblockhash",
+    "getblock",
+    "getblockcount",
+    "getblockhash",
+    "getblockheader",
+    "getmempoolancestors",
+    "getmempooldescendants",
+    "getmempoolentry",
+    "getrawtransaction",
+    "gettxout",
+};
+
+static bool IsParallelEntry(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    return method.isStr() && setParallelCommands.count(method.get_str());
+}
+
+/**
+ * A run of batch entries executed by whichever threads pick them up. The
+ * thread that created it works on it too, so the entries are done even if
+ * none of the queued helpers gets to run before that thread is through.
+ */
+class BatchRun
+{
+public:
+    BatchRun(const JSONRPCRequest& jreqIn, const UniValue& vReqIn, size_t nBeginIn, size_t nEndIn)
+        : jreq(jreqIn), vReq(vReqIn), nBegin(nBeginIn), nEnd(nEndIn), vResults(nEndIn - nBeginIn), nNext(nBeginIn), nDone(0)
+    {
+    }
+
+    /** Execute entries until none is left to claim */
+    void Work()
+    {
+        size_t nDoneHere = 0;
+        for (size_t i = nNext++; i < nEnd; i = nNext++) {
+            vResults[i - nBegin] = JSONRPCExecOne(jreq, vReq[i]);
+            nDoneHere++;
+        }
+        if (nDoneHere > 0) {
+            std::lock_guard<std::mutex> lock(cs);
+            nDone += nDoneHere;
+            cond.notify_all();
+        }
+    }
+
+    /** Wait for the entries claimed by other threads, then take the results */
+    std::vector<UniValue> Finish()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        cond.wait(lock, [this] { return nDone == nEnd - nBegin; });
+        return std::move(vResults);
+    }
+
+private:
+    const JSONRPCRequest jreq;
+    //! Only accessed for a claimed entry, so a helper that starts after all
+    //! entries are done never touches it
+    const UniValue& vReq;
+    const size_t nBegin;
+    const size_t nEnd;
+    std::vector<UniValue> vResults;
+    std::atomic<size_t> nNext;
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nDone;
+};
+
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCTaskQueue& queueTask, int nHelpers)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsParallelEntry(vReq[nEnd]))
+            nEnd++;
+        if (nEnd - reqIdx < 2 || !queueTask || nHelpers < 1) {
+            ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx++]));
+            continue;
+        }
+
+        std::shared_ptr<BatchRun> run = std::make_shared<BatchRun>(jreq, vReq, reqIdx, nEnd);
+        const size_t nTasks = std::min<size_t>(nHelpers, nEnd - reqIdx - 1);
+        for (size_t i = 0; i < nTasks; i++) {
+            if (!queueTask([run] { run->Work(); }))
+                break;
+        }
+        run->Work();
+        for (UniValue& result : run->Finish())
+            ret.push_back(result);
+        reqIdx = nEnd;
+    }
 
     return ret.write() + "\n";
 }
@@ -467,7 +580,7 @@ static inline JSONRPCRequest transformNamedArguments(const JSONRPCRequest& in, c
     return out;
 }
 
-UniValue CRPCTable::execute(const JSONRPCRequest &request) const
+const CRPCCommand* CRPCTable::prepareExecute(const JSONRPCRequest &request) const
 {
     // Return immediately if in warmup
     {
@@ -482,6 +595,12 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
 
     g_rpcSignals.PreCommand(*pcmd);
+    return pcmd;
+}
+
+UniValue CRPCTable::execute(const JSONRPCRequest &request) const
+{
+    const CRPCCommand *pcmd = prepareExecute(request);
 
     try
     {
@@ -498,6 +617,26 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     }
 }
 
+void CRPCTable::execute(const JSONRPCRequest &request, JSONWriter& writer) const
+{
+    const CRPCCommand *pcmd = prepareExecute(request);
+
+    try
+    {
+        // Execute, convert arguments to array if necessary
+        const JSONRPCRequest& positional = request.params.isObject() ? transformNamedArguments(request, pcmd->argNames) : request;
+        if (pcmd->streamActor) {
+            pcmd->streamActor(positional, writer);
+        } else {
+            writer.Value(pcmd->actor(positional));
+        }
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
@@ -9,6 +9,7 @@
 #include <rpc/protocol.h>
 #include <uint256.h>
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -19,6 +20,7 @@
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
 
 class CRPCCommand;
+class JSONWriter;
 
 namespace RPCServer
 {
@@ -125,6 +127,7 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, std::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const JSONRPCRequest& jsonRequest);
+typedef void(*rpcstreamfn_type)(const JSONRPCRequest& jsonRequest, JSONWriter& writer);
 
 class CRPCCommand
 {
@@ -133,6 +136,9 @@ public:
     std::string name;
     rpcfn_type actor;
     std::vector<std::string> argNames;
+    //! Optional, for commands with large results: writes the result piece
+    //! by piece. actor then has to give the same result.
+    rpcstreamfn_type streamActor;
 };
 
 /**
@@ -155,12 +161,24 @@ public:
      */
     UniValue execute(const JSONRPCRequest &request) const;
 
+    /**
+     * Execute a method, writing the result to writer, piece by piece if the
+     * command has a streamActor.
+     * @throws an exception (UniValue) when an error happens. Nothing has been
+     * written then, unless a streamActor failed halfway through.
+     */
+    void execute(const JSONRPCRequest &request, JSONWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
     */
     std::vector<std::string> listCommands() const;
 
+private:
+    const CRPCCommand* prepareExecute(const JSONRPCRequest &request) const;
+public:
+
 
     /**
      * Appends a CRPCCommand to the dispatch table.
@@ -177,6 +195,11 @@ public:
      * register different names, types, and numbers of parameters.
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Remove a command registered under name, if it is pcmd.
+     */
+    bool removeCommand(const std::string& name, const CRPCCommand* pcmd);
 };
 
 bool IsDeprecatedRPCEnabled(const std::string& method);
@@ -199,7 +222,16 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq);
+/** Runs a task on some other thread, returns false if it cannot be queued */
+typedef std::function<bool(const std::function<void()>& task)> RPCTaskQueue;
+
+/**
+ * Execute a batch of requests. Runs of entries calling commands that only
+ * read state are spread over the calling thread and up to nHelpers tasks
+ * handed to queueTask. Other entries run one at a time, in order. The
+ * results are in the order of the entries either way.
+ */
+std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq, const RPCTaskQueue& queueTask = nullptr, int nHelpers = 0);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
@@ -16,6 +16,22 @@ namespace sha256_sse4
 {
 void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 }
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+namespace sha256d64_sse41
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+namespace sha256d64_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+namespace sha256d64_shani
+{
+void Transform_2way(unsigned char* out, const unsigned char* in);
+}
 #endif
 #endif
 
@@ -144,6 +160,31 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
 } // namespace sha256
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+/** Double SHA256 of a single 64-byte input, built on top of a regular transform function. */
+template<TransformType tr>
+void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
+{
+    // Padding block of a 64-byte message: 0x80 marker followed by the bit length (512).
+    static const unsigned char padding1[64] = {
+        0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0
+    };
+    // Second hash: 32 byte digest, 0x80 marker and the bit length (256).
+    unsigned char buffer2[64] = {0};
+    buffer2[32] = 0x80;
+    buffer2[62] = 1;
+
+    uint32_t s[8];
+    sha256::Initialize(s);
+    tr(s, in, 1);
+    tr(s, padding1, 1);
+    for (int i = 0; i < 8; ++i) WriteBE32(buffer2 + 4 * i, s[i]);
+    sha256::Initialize(s);
+    tr(s, buffer2, 1);
+    for (int i = 0; i < 8; ++i) WriteBE32(out + 4 * i, s[i]);
+}
 
 bool SelfTest(TransformType tr) {
     static const unsigned char in1[65] = {0, 0x80};
@@ -172,23 +213,106 @@ bool SelfTest(TransformType tr) {
     return true;
 }
 
+/** Fill 8 64-byte inputs with a deterministic pattern for the SHA256D64 self tests. */
+void SelfTestD64Input(unsigned char* in)
+{
+    for (int i = 0; i < 8 * 64; ++i) in[i] = (unsigned char)(i * 7 + 1);
+}
+
+/** Check a multi-way double SHA256 kernel against the single-way one over the self test input. */
+bool SelfTestD64(TransformD64Type single, TransformD64Type multi, int ways)
+{
+    unsigned char in[8 * 64];
+    unsigned char expected[8 * 32];
+    unsigned char out[8 * 32];
+    SelfTestD64Input(in);
+    for (int i = 0; i < 8; ++i) single(expected + 32 * i, in + 64 * i);
+    for (int i = 0; i < 8; i += ways) multi(out + 32 * i, in + 64 * i);
+    return memcmp(out, expected, sizeof(out)) == 0;
+}
+
+/** Check a single-way double SHA256 kernel against a known answer. */
+bool SelfTestD64(TransformD64Type single)
+{
+    // Double SHA256 of the first 64 bytes of SelfTestD64Input().
+    static const unsigned char out1[32] = {
+        0xf6, 0x03, 0x93, 0x21, 0x4c, 0xc9, 0xd2, 0xcf, 0x27, 0x0c, 0x50, 0x74, 0x33, 0xd8, 0x43, 0x9b,
+        0x0b, 0x39, 0x32, 0xe4, 0x92, 0xc6, 0x87, 0xac, 0xa4, 0x1a, 0xd6, 0xfd, 0xb6, 0xa9, 0xcf, 0xa1
+    };
+    unsigned char in[8 * 64];
+    unsigned char out[32];
+    SelfTestD64Input(in);
+    single(out, in);
+    return memcmp(out, out1, sizeof(out)) == 0;
+}
+
 TransformType Transform = sha256::Transform;
+TransformD64Type TransformD64 = TransformD64Wrapper<sha256::Transform>;
+TransformD64Type TransformD64_2way = nullptr;
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+/** Check whether the OS saves the AVX (YMM) registers on context switches. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
 
 } // namespace
 
 std::string SHA256AutoDetect()
 {
+    std::string ret = "standard";
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    bool have_sse4 = false;
+    bool have_avx2 = false;
+    bool have_shani = false;
     uint32_t eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 19) & 1) {
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        // AVX2 additionally needs the OS to preserve the YMM registers (OSXSAVE and AVX bits).
+        bool have_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabled();
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = have_avx && ((ebx >> 5) & 1);
+            have_shani = have_sse4 && ((ebx >> 29) & 1);
+        }
+    }
+
+    if (have_shani) {
+        // The SHA extensions outperform the vectorized kernels on every CPU that has them.
+        Transform = sha256_shani::Transform;
+        TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
+        TransformD64_2way = sha256d64_shani::Transform_2way;
+        ret = "shani(1way,2way)";
+        have_sse4 = false;
+        have_avx2 = false;
+    }
+
+    if (have_sse4) {
         Transform = sha256_sse4::Transform;
-        assert(SelfTest(Transform));
-        return "sse4";
+        TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
+        TransformD64_4way = sha256d64_sse41::Transform_4way;
+        ret = "sse4(1way),sse41(4way)";
+    }
+
+    if (have_avx2) {
+        TransformD64_8way = sha256d64_avx2::Transform_8way;
+        ret += ",avx2(8way)";
     }
 #endif
 
     assert(SelfTest(Transform));
-    return "standard";
+    assert(SelfTestD64(TransformD64));
+    assert(SelfTestD64(TransformD64Wrapper<sha256::Transform>, TransformD64, 1));
+    if (TransformD64_2way) assert(SelfTestD64(TransformD64, TransformD64_2way, 2));
+    if (TransformD64_4way) assert(SelfTestD64(TransformD64, TransformD64_4way, 4));
+    if (TransformD64_8way) assert(SelfTestD64(TransformD64, TransformD64_8way, 8));
+    return ret;
 }
 
 ////// SHA-256
@@ -247,3 +371,37 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    if (TransformD64_2way) {
+        while (blocks >= 2) {
+            TransformD64_2way(out, in);
+            out += 64;
+            in += 128;
+            blocks -= 2;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <crypto/common.h>
+#include <fs.h>
+#include <hash.h>
+#include <net.h>
+#include <netbase.h>
+#include <netmessagemaker.h>
+#include <scheduler.h>
+#include <util.h>
+
+#include <assert.h>
+#include <memory>
+#include <vector>
+
+// Drives many loopback connections through CConnman's socket handler and
+// message handler, with a peer logic that answers every ping with a pong.
+// The select() backend is limited to FD_SETSIZE descriptors, and both ends of
+// every connection live in this process, so it only runs with fewer peers.
+
+namespace {
+
+static const unsigned short BENCH_PORT_BASE = 29450;
+static const size_t PING_MESSAGE_SIZE = CMessageHeader::HEADER_SIZE + sizeof(uint64_t);
+
+class PongResponder : public NetEventsInterface
+{
+public:
+    CConnman* connman = nullptr;
+
+    bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) override
+    {
+        std::list<CNetMessage> msgs;
+        bool fMoreWork;
+        {
+            LOCK(pnode->cs_vProcessMsg);
+            if (pnode->vProcessMsg.empty())
+                return false;
+            msgs.splice(msgs.begin(), pnode->vProcessMsg, pnode->vProcessMsg.begin());
+            pnode->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+            pnode->fPauseRecv = pnode->nProcessQueueSize > connman->GetReceiveFloodSize();
+            fMoreWork = !pnode->vProcessMsg.empty();
+        }
+        uint64_t nonce = 0;
+        msgs.front().vRecv >> nonce;
+        connman->PushMessage(pnode, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::PONG, nonce));
+        return fMoreWork;
+    }
+    bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) override { return false; }
+    void InitializeNode(CNode* pnode) override {}
+    void FinalizeNode(NodeId id, bool& update_connection_time) override { update_connection_time = false; }
+};
+
+/** A CConnman listening on localhost with nPeers blocking client sockets connected to it. */
+class LoopbackNetwork
+{
+public:
+    LoopbackNetwork(SocketEventsMode mode, int nPeers)
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        // Keep peers.dat and banlist.dat out of the real data directory
+        datadir = fs::temp_directory_path() / fs::unique_path("bench_socket_events_%%%%-%%%%");
+        fs::create_directories(datadir);
+        gArgs.ForceSetArg("-datadir", datadir.string());
+        gArgs.ForceSetArg("-dnsseed", "0");
+        ClearDatadirCache();
+
+        // Both ends of every connection are in this process
+        int nFD = RaiseFileDescriptorLimit(2 * nPeers + 64);
+        nPeers = std::max(1, std::min(nPeers, (nFD - 64) / 2));
+
+        CConnman::Options options;
+        options.nMaxConnections = nPeers + 8;
+        options.nMaxOutbound = 0;
+        options.nMaxFeeler = 0;
+        options.nMaxAddnode = MAX_ADDNODE_CONNECTIONS;
+        options.m_msgproc = &responder;
+        options.nSendBufferMaxSize = 1000 * DEFAULT_MAXSENDBUFFER;
+        options.nReceiveFloodSize = 1000 * DEFAULT_MAXRECEIVEBUFFER;
+        options.m_use_addrman_outgoing = false;
+        options.m_socket_events_mode = mode;
+
+        CService addrBind;
+        for (unsigned short nPort = BENCH_PORT_BASE; nPort < BENCH_PORT_BASE + 100; nPort++) {
+            connman.reset(new CConnman(0x1337, 0x1337));
+            responder.connman = connman.get();
+            addrBind = LookupNumeric("127.0.0.1", nPort);
+            options.vBinds = {addrBind};
+            if (connman->Start(scheduler, options)) {
+                break;
+            }
+            connman->Interrupt();
+            connman->Stop();
+            connman.reset();
+        }
+        assert(connman);
+
+        for (int i = 0; i < nPeers; i++) {
+            SOCKET hSocket = CreateSocket(addrBind);
+            assert(hSocket != INVALID_SOCKET);
+            bool connected = ConnectSocketDirectly(addrBind, hSocket, 5000);
+            assert(connected);
+            SetSocketNonBlocking(hSocket, false);
+            vSockets.push_back(hSocket);
+        }
+        while (connman->GetNodeCount(CConnman::CONNECTIONS_IN) < vSockets.size()) {
+            MilliSleep(10);
+        }
+    }
+
+    ~LoopbackNetwork()
+    {
+        for (SOCKET& hSocket : vSockets) {
+            CloseSocket(hSocket);
+        }
+        connman->Interrupt();
+        connman->Stop();
+        connman.reset();
+        fs::remove_all(datadir);
+        gArgs.ForceSetArg("-datadir", "");
+        ClearDatadirCache();
+    }
+
+    size_t size() const { return vSockets.size(); }
+
+    void SendPing(size_t nPeer, uint64_t nonce)
+    {
+        CSerializedNetMsg msg = CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::PING, nonce);
+        uint256 hash = Hash(msg.data.begin(), msg.data.end());
+        CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+        memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+        std::vector<unsigned char> vData;
+        CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, vData, 0, hdr};
+        vData.insert(vData.end(), msg.data.begin(), msg.data.end());
+        assert(vData.size() == PING_MESSAGE_SIZE);
+        ssize_t nBytes = send(vSockets[nPeer], (const char*)vData.data(), vData.size(), MSG_NOSIGNAL);
+        assert(nBytes == (ssize_t)vData.size());
+    }
+
+    uint64_t ReceivePong(size_t nPeer)
+    {
+        unsigned char buf[PING_MESSAGE_SIZE];
+        size_t nRead = 0;
+        while (nRead < sizeof(buf)) {
+            ssize_t nBytes = recv(vSockets[nPeer], (char*)buf + nRead, sizeof(buf) - nRead, 0);
+            assert(nBytes > 0);
+            nRead += nBytes;
+        }
+        return ReadLE64(buf + CMessageHeader::HEADER_SIZE);
+    }
+
+private:
+    fs::path datadir;
+    CScheduler scheduler;
+    PongResponder responder;
+    std::unique_ptr<CConnman> connman;
+    std::vector<SOCKET> vSockets;
+};
+
+} // namespace
+
+// Every peer sends a ping at once and waits for its pong: measures how many
+// messages the socket and message handlers get through per second.
+static void SocketEventsThroughput(benchmark::State& state, SocketEventsMode mode, int nPeers)
+{
+    LoopbackNetwork network(mode, nPeers);
+    uint64_t nonce = 0;
+    while (state.KeepRunning()) {
+        nonce++;
+        for (size_t i = 0; i < network.size(); i++) {
+            network.SendPing(i, nonce);
+        }
+        for (size_t i = 0; i < network.size(); i++) {
+            uint64_t pong = network.ReceivePong(i);
+            assert(pong == nonce);
+        }
+    }
+}
+
+// One peer at a time does a round trip while all others are idle: measures
+// the latency added by the socket handler's per-iteration cost over all
+// connections.
+static void SocketEventsLatency(benchmark::State& state, SocketEventsMode mode, int nPeers)
+{
+    LoopbackNetwork network(mode, nPeers);
+    uint64_t nonce = 0;
+    while (state.KeepRunning()) {
+        size_t nPeer = nonce % network.size();
+        network.SendPing(nPeer, ++nonce);
+        uint64_t pong = network.ReceivePong(nPeer);
+        assert(pong == nonce);
+    }
+}
+
+static void SocketEventsThroughputSelect_400(benchmark::State& state) { SocketEventsThroughput(state, SocketEventsMode::Select, 400); }
+static void SocketEventsLatencySelect_400(benchmark::State& state) { SocketEventsLatency(state, SocketEventsMode::Select, 400); }
+
+BENCHMARK(SocketEventsThroughputSelect_400, 20);
+BENCHMARK(SocketEventsLatencySelect_400, 2000);
+
+#ifdef USE_EPOLL
+static void SocketEventsThroughputEpoll_400(benchmark::State& state) { SocketEventsThroughput(state, SocketEventsMode::Epoll, 400); }
+static void SocketEventsThroughputEpoll_1200(benchmark::State& state) { SocketEventsThroughput(state, SocketEventsMode::Epoll, 1200); }
+static void SocketEventsLatencyEpoll_400(benchmark::State& state) { SocketEventsLatency(state, SocketEventsMode::Epoll, 400); }
+static void SocketEventsLatencyEpoll_1200(benchmark::State& state) { SocketEventsLatency(state, SocketEventsMode::Epoll, 1200); }
+
+BENCHMARK(SocketEventsThroughputEpoll_400, 20);
+BENCHMARK(SocketEventsThroughputEpoll_1200, 10);
+BENCHMARK(SocketEventsLatencyEpoll_400, 2000);
+BENCHMARK(SocketEventsLatencyEpoll_1200, 2000);
+#endif
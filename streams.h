@@ -14,6 +14,7 @@
 #include <limits>
 #include <map>
 #include <set>
+#include <stdexcept>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
@@ -137,6 +138,105 @@ private:
     size_t nPos;
 };
 
+/** Minimal stream for reading from a contiguous byte range owned by someone
+ *  else, such as a memory-mapped file, without copying it first.
+ *
+ *  The referenced memory must outlive the reader.
+ */
+class CSpanReader
+{
+public:
+/*
+ * @param[in]  nTypeIn Serialization Type
+ * @param[in]  nVersionIn Serialization Version (including any flags)
+ * @param[in]  pbeginIn   Start of the bytes to read
+ * @param[in]  nSizeIn    Number of bytes available
+*/
+    CSpanReader(int nTypeIn, int nVersionIn, const unsigned char* pbeginIn, size_t nSizeIn) : nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), nSize(nSizeIn), nPos(0) {}
+
+    template<typename T>
+    CSpanReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    void read(char* pch, size_t nReadSize)
+    {
+        if (nReadSize > nSize - nPos) {
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        }
+        memcpy(pch, pbegin + nPos, nReadSize);
+        nPos += nReadSize;
+    }
+
+    void ignore(size_t nIgnoreSize)
+    {
+        if (nIgnoreSize > nSize - nPos) {
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        }
+        nPos += nIgnoreSize;
+    }
+
+    size_t size() const { return nSize - nPos; }
+    bool empty() const { return nPos == nSize; }
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* const pbegin;
+    const size_t nSize;
+    size_t nPos;
+};
+
+/**
+ * XOR size bytes at data with key, repeated as often as needed. The first
+ * byte is XOR'd with key[key_offset % key.size()], so a buffer can be
+ * XOR'd in pieces, or starting partway into the data the key was lined up
+ * with.
+ */
+inline void XorBytes(char* data, size_t size, const std::vector<unsigned char>& key, size_t key_offset = 0)
+{
+    const size_t key_size = key.size();
+    if (key_size == 0) {
+        return;
+    }
+    key_offset %= key_size;
+
+    size_t i = 0;
+    if (8 % key_size == 0) {
+        // The key repeats within a word, which holds for the 8-byte database
+        // obfuscation key: XOR a word at a time with the key turned to line
+        // up with data. The memcpys compile to plain unaligned loads and
+        // stores, and leave the compiler free to vectorize the loop.
+        unsigned char key_bytes[8];
+        for (size_t j = 0; j < 8; j++) {
+            key_bytes[j] = key[(key_offset + j) % key_size];
+        }
+        uint64_t key_word;
+        memcpy(&key_word, key_bytes, 8);
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            word ^= key_word;
+            memcpy(data + i, &word, 8);
+        }
+        // i is a multiple of the key size, so the rest starts at key_offset
+    }
+
+    for (size_t j = key_offset; i < size; i++) {
+        data[i] ^= key[j++];
+
+        // Wrap j instead of taking a % for each byte, which would effectively
+        // be a division per byte
+        if (j == key_size)
+            j = 0;
+    }
+}
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
@@ -411,24 +511,117 @@ public:
     /**
      * XOR the contents of this stream with a certain key.
      *
-     * @param[in] key    The key used to XOR the data in this stream.
+     * @param[in] key         The key used to XOR the data in this stream.
+     * @param[in] key_offset  The position in the key to start at, for data
+     *                        that begins partway into what the key was
+     *                        lined up with.
      */
-    void Xor(const std::vector<unsigned char>& key)
+    void Xor(const std::vector<unsigned char>& key, size_t key_offset = 0)
     {
-        if (key.size() == 0) {
-            return;
+        XorBytes(vch.data() + nReadPos, size(), key, key_offset);
+    }
+};
+
+/** Reads a stream bit by bit, most significant bit of each byte first */
+template <typename IStream>
+class BitStreamReader
+{
+private:
+    IStream& m_istream;
+
+    /// Buffered byte read in from the input stream. A new byte is read into the
+    /// buffer when m_offset reaches 8.
+    uint8_t m_buffer;
+
+    /// Number of high order bits in m_buffer already returned by previous
+    /// Read() calls. The next bit to be returned is at this offset from the
+    /// most significant bit position.
+    int m_offset;
+
+public:
+    explicit BitStreamReader(IStream& istream) : m_istream(istream), m_buffer(0), m_offset(8) {}
+
+    /** Read the specified number of bits from the stream. The data is returned
+     * in the nbits least significant bits of a 64-bit uint.
+     */
+    uint64_t Read(int nbits) {
+        if (nbits < 0 || nbits > 64) {
+            throw std::out_of_range("nbits must be between 0 and 64");
+        }
+
+        uint64_t data = 0;
+        while (nbits > 0) {
+            if (m_offset == 8) {
+                m_istream >> m_buffer;
+                m_offset = 0;
+            }
+
+            int bits = std::min(8 - m_offset, nbits);
+            data <<= bits;
+            data |= static_cast<uint8_t>(m_buffer << m_offset) >> (8 - bits);
+            m_offset += bits;
+            nbits -= bits;
+        }
+        return data;
+    }
+};
+
+/** Writes to a stream bit by bit, most significant bit of each byte first.
+ *  A partly filled last byte is padded with zero bits when flushed. */
+template <typename OStream>
+class BitStreamWriter
+{
+private:
+    OStream& m_ostream;
+
+    /// Buffered byte waiting to be written to the output stream. The byte is
+    /// written out when m_offset reaches 8 or Flush() is called.
+    uint8_t m_buffer;
+
+    /// Number of high order bits in m_buffer already written by previous
+    /// Write() calls and not yet flushed to the stream. The next bit to be
+    /// written to is at this offset from the most significant bit position.
+    int m_offset;
+
+public:
+    explicit BitStreamWriter(OStream& ostream) : m_ostream(ostream), m_buffer(0), m_offset(0) {}
+
+    ~BitStreamWriter()
+    {
+        Flush();
+    }
+
+    /** Write the nbits least significant bits of a 64-bit int to the output
+     * stream. Data is buffered until it completes an octet.
+     */
+    void Write(uint64_t data, int nbits) {
+        if (nbits < 0 || nbits > 64) {
+            throw std::out_of_range("nbits must be between 0 and 64");
         }
 
-        for (size_type i = 0, j = 0; i != size(); i++) {
-            vch[i] ^= key[j++];
+        while (nbits > 0) {
+            int bits = std::min(8 - m_offset, nbits);
+            m_buffer |= (data << (64 - nbits)) >> (64 - 8 + m_offset);
+            m_offset += bits;
+            nbits -= bits;
+
+            if (m_offset == 8) {
+                Flush();
+            }
+        }
+    }
 
-            // This potentially acts on very many bytes of data, so it's
-            // important that we calculate `j`, i.e. the `key` index in this
-            // way instead of doing a %, which would effectively be a division
-            // for each byte Xor'd -- much slower than need be.
-            if (j == key.size())
-                j = 0;
+    /** Flush any unwritten bits to the output stream, padding with 0's to the
+     * next byte boundary.
+     */
+    void Flush() {
+        if (m_offset == 0) {
+            return;
         }
+
+        m_ostream << m_buffer;
+        m_buffer = 0;
+        m_offset = 0;
     }
 };
 
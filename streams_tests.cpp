@@ -71,6 +71,76 @@ BOOST_AUTO_TEST_CASE(streams_vector_writer)
     vch.clear();
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const unsigned char data[] = {1, 255, 3, 4, 5, 6};
+    CSpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, data, sizeof(data));
+    BOOST_CHECK_EQUAL(reader.size(), 6);
+    BOOST_CHECK(!reader.empty());
+
+    unsigned char a;
+    unsigned char b;
+    reader >> a >> b;
+    BOOST_CHECK_EQUAL(a, 1);
+    BOOST_CHECK_EQUAL(b, 255);
+    BOOST_CHECK_EQUAL(reader.size(), 4);
+
+    uint16_t c;
+    reader >> c;
+    BOOST_CHECK_EQUAL(c, 0x0403); // little endian
+    reader.ignore(1);
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, 6);
+    BOOST_CHECK(reader.empty());
+
+    // Reading or skipping past the end throws and leaves the position alone
+    BOOST_CHECK_THROW(reader >> a, std::ios_base::failure);
+    BOOST_CHECK_THROW(reader.ignore(1), std::ios_base::failure);
+
+    CSpanReader reader2(SER_NETWORK, INIT_PROTO_VERSION, data, sizeof(data));
+    BOOST_CHECK_THROW(reader2.ignore(7), std::ios_base::failure);
+    uint32_t d;
+    reader2 >> d;
+    BOOST_CHECK_EQUAL(d, 0x0403FF01U);
+    BOOST_CHECK_THROW(reader2 >> d, std::ios_base::failure);
+    BOOST_CHECK_EQUAL(reader2.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
+{
+    CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
+
+    BitStreamWriter<CDataStream> bit_writer(data);
+    bit_writer.Write(0, 1);
+    bit_writer.Write(2, 2);
+    bit_writer.Write(6, 3);
+    bit_writer.Write(11, 4);
+    bit_writer.Write(1, 5);
+    bit_writer.Write(32, 6);
+    bit_writer.Write(7, 7);
+    bit_writer.Write(30497, 16);
+    bit_writer.Flush();
+
+    CDataStream data_copy(data);
+    uint32_t serialized_int1;
+    data >> serialized_int1;
+    BOOST_CHECK_EQUAL(serialized_int1, (uint32_t)0x7700C35A); // NOTE: Serialized as LE
+    uint16_t serialized_int2;
+    data >> serialized_int2;
+    BOOST_CHECK_EQUAL(serialized_int2, (uint16_t)0x1072); // NOTE: Serialized as LE
+
+    BitStreamReader<CDataStream> bit_reader(data_copy);
+    BOOST_CHECK_EQUAL(bit_reader.Read(1), 0);
+    BOOST_CHECK_EQUAL(bit_reader.Read(2), 2);
+    BOOST_CHECK_EQUAL(bit_reader.Read(3), 6);
+    BOOST_CHECK_EQUAL(bit_reader.Read(4), 11);
+    BOOST_CHECK_EQUAL(bit_reader.Read(5), 1);
+    BOOST_CHECK_EQUAL(bit_reader.Read(6), 32);
+    BOOST_CHECK_EQUAL(bit_reader.Read(7), 7);
+    BOOST_CHECK_EQUAL(bit_reader.Read(16), 30497);
+    BOOST_CHECK_THROW(bit_reader.Read(8), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
 {
     std::vector<char> in;
@@ -120,4 +190,46 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));  
 }         
 
+BOOST_AUTO_TEST_CASE(streams_xor_bytes)
+{
+    // Compare the word at a time XOR with XOR'ing byte by byte, for keys
+    // that do and do not fit a word, data of all lengths around a few words
+    // and every key offset
+    for (size_t key_size : {1, 2, 3, 4, 5, 8}) {
+        std::vector<unsigned char> key(key_size);
+        for (size_t i = 0; i < key_size; i++) {
+            key[i] = InsecureRandBits(8);
+        }
+        for (size_t size = 0; size < 40; size++) {
+            std::vector<char> data(size);
+            for (char& c : data) {
+                c = InsecureRandBits(8);
+            }
+            for (size_t offset = 0; offset < 2 * key_size; offset++) {
+                std::vector<char> expected = data;
+                for (size_t i = 0; i < size; i++) {
+                    expected[i] ^= key[(offset + i) % key_size];
+                }
+                std::vector<char> actual = data;
+                XorBytes(actual.data(), actual.size(), key, offset);
+                BOOST_CHECK(actual == expected);
+            }
+        }
+    }
+
+    // XOR'ing a stream in two pieces matches XOR'ing it at once
+    std::vector<unsigned char> key{'\x01', '\x02', '\x03', '\x04', '\x05', '\x06', '\x07', '\x08'};
+    CDataStream whole(SER_DISK, 0);
+    for (int i = 0; i < 21; i++) {
+        whole << static_cast<uint8_t>(i);
+    }
+    CDataStream first(whole.begin(), whole.begin() + 11, SER_DISK, 0);
+    CDataStream second(whole.begin() + 11, whole.end(), SER_DISK, 0);
+    whole.Xor(key);
+    first.Xor(key);
+    second.Xor(key, 11);
+    BOOST_CHECK(std::string(whole.begin(), whole.begin() + 11) == std::string(first.begin(), first.end()));
+    BOOST_CHECK(std::string(whole.begin() + 11, whole.end()) == std::string(second.begin(), second.end()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
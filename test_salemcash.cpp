@@ -34,6 +34,15 @@ void CConnmanTest::ClearNodes()
     g_connman->vNodes.clear();
 }
 
+void CConnmanTest::StartMessageHandler()
+{
+    g_connman->flagInterruptMsgProc = false;
+    g_connman->threadMessageHandler = std::thread(&CConnman::ThreadMessageHandler, g_connman.get());
+    for (int i = 0; i < g_connman->nMessageWorkers; i++) {
+        g_connman->threadMessageWorkers.emplace_back(&CConnman::ThreadMessageWorker, g_connman.get());
+    }
+}
+
 uint256 insecure_rand_seed = GetRandHash();
 FastRandomContext insecure_rand_ctx(insecure_rand_seed);
 
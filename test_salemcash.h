@@ -53,6 +53,8 @@ class CNode;
 struct CConnmanTest {
     static void AddNode(CNode& node);
     static void ClearNodes();
+    /** Run the message handler and message worker threads, without sockets */
+    static void StartMessageHandler();
 };
 
 class PeerLogicValidation;
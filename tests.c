@@ -2487,6 +2487,243 @@ void run_ecmult_const_tests(void) {
     ecmult_const_chain_multiply();
 }
 
+typedef struct {
+    secp256k1_scalar *sc;
+    secp256k1_ge *pt;
+} ecmult_multi_data;
+
+static int ecmult_multi_callback(secp256k1_scalar *sc, secp256k1_ge *pt, size_t idx, void *cbdata) {
+    ecmult_multi_data *data = (ecmult_multi_data*) cbdata;
+    *sc = data->sc[idx];
+    *pt = data->pt[idx];
+    return 1;
+}
+
+static int ecmult_multi_false_callback(secp256k1_scalar *sc, secp256k1_ge *pt, size_t idx, void *cbdata) {
+    (void)sc;
+    (void)pt;
+    (void)idx;
+    (void)cbdata;
+    return 0;
+}
+
+/* Check r == g*G + sum(sc[i]*pt[i]) computed one multiplication at a time. */
+static void ecmult_multi_check(const secp256k1_gej *r, const secp256k1_scalar *g, const secp256k1_scalar *sc, const secp256k1_ge *pt, size_t n) {
+    secp256k1_gej expected, tmp, ptj;
+    secp256k1_scalar szero;
+    size_t i;
+
+    secp256k1_scalar_set_int(&szero, 0);
+    secp256k1_gej_set_infinity(&expected);
+    secp256k1_gej_set_infinity(&ptj);
+    if (g != NULL) {
+        secp256k1_ecmult(&ctx->ecmult_ctx, &expected, &ptj, &szero, g);
+    }
+    for (i = 0; i < n; i++) {
+        secp256k1_gej_set_ge(&ptj, &pt[i]);
+        secp256k1_ecmult(&ctx->ecmult_ctx, &tmp, &ptj, &sc[i], NULL);
+        secp256k1_gej_add_var(&expected, &expected, &tmp, NULL);
+    }
+    secp256k1_gej_neg(&expected, &expected);
+    secp256k1_gej_add_var(&expected, &expected, r, NULL);
+    CHECK(secp256k1_gej_is_infinity(&expected));
+}
+
+void test_ecmult_multi(secp256k1_scratch *scratch) {
+    secp256k1_scalar sc[64];
+    secp256k1_ge pt[64];
+    secp256k1_scalar g;
+    secp256k1_gej r;
+    ecmult_multi_data data;
+    size_t ncount;
+
+    data.sc = sc;
+    data.pt = pt;
+    random_scalar_order(&g);
+
+    /* No points, with and without G */
+    CHECK(secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, scratch, &r, NULL, ecmult_multi_callback, &data, 0));
+    CHECK(secp256k1_gej_is_infinity(&r));
+    CHECK(secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, scratch, &r, &g, ecmult_multi_callback, &data, 0));
+    ecmult_multi_check(&r, &g, sc, pt, 0);
+
+    /* A failing callback is reported */
+    CHECK(!secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, scratch, &r, &g, ecmult_multi_false_callback, &data, 1));
+
+    /* Random inputs, sprinkled with zero scalars and points at infinity */
+    for (ncount = 0; ncount < (size_t)count; ncount++) {
+        size_t i;
+        size_t n = secp256k1_rand_int(64) + 1;
+        for (i = 0; i < n; i++) {
+            random_scalar_order(&sc[i]);
+            random_group_element_test(&pt[i]);
+            if (secp256k1_rand_int(16) == 0) {
+                secp256k1_scalar_set_int(&sc[i], 0);
+            }
+            if (secp256k1_rand_int(16) == 0) {
+                secp256k1_gej infj;
+                secp256k1_gej_set_infinity(&infj);
+                secp256k1_ge_set_gej_var(&pt[i], &infj);
+            }
+        }
+        CHECK(secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, scratch, &r, ncount & 1 ? &g : NULL, ecmult_multi_callback, &data, n));
+        ecmult_multi_check(&r, ncount & 1 ? &g : NULL, sc, pt, n);
+    }
+
+    /* Terms that cancel out sum to infinity */
+    random_scalar_order(&sc[0]);
+    random_group_element_test(&pt[0]);
+    secp256k1_scalar_negate(&sc[1], &sc[0]);
+    pt[1] = pt[0];
+    CHECK(secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, scratch, &r, NULL, ecmult_multi_callback, &data, 2));
+    CHECK(secp256k1_gej_is_infinity(&r));
+}
+
+void test_ecmult_multi_pippenger(void) {
+    /* Run pippenger_batch directly on a large scratch space, so small inputs take that path too. */
+    secp256k1_scratch *scratch = secp256k1_scratch_create(&ctx->error_callback, 1 << 20);
+    secp256k1_scalar sc[32];
+    secp256k1_ge pt[32];
+    secp256k1_scalar g;
+    secp256k1_gej r;
+    ecmult_multi_data data;
+    size_t i;
+
+    data.sc = sc;
+    data.pt = pt;
+    random_scalar_order(&g);
+    for (i = 0; i < 32; i++) {
+        random_scalar_order(&sc[i]);
+        random_group_element_test(&pt[i]);
+    }
+    /* Scalars with few bits set stress the wnaf carries. */
+    secp256k1_scalar_set_int(&sc[0], 1);
+    secp256k1_scalar_set_int(&sc[1], 2);
+    secp256k1_scalar_negate(&sc[2], &sc[0]);
+    for (i = 1; i <= 32; i++) {
+        CHECK(secp256k1_ecmult_pippenger_batch(&ctx->ecmult_ctx, scratch, &r, &g, ecmult_multi_callback, &data, i, 0));
+        ecmult_multi_check(&r, &g, sc, pt, i);
+        CHECK(secp256k1_ecmult_strauss_batch(&ctx->ecmult_ctx, scratch, &r, &g, ecmult_multi_callback, &data, i, 0));
+        ecmult_multi_check(&r, &g, sc, pt, i);
+    }
+    secp256k1_scratch_destroy(scratch);
+}
+
+void test_ecmult_multi_batch_size_helper(void) {
+    size_t n_batches, n_batch_points, max_n_batch_points, n;
+
+    max_n_batch_points = 0;
+    n = 1;
+    CHECK(secp256k1_ecmult_multi_batch_size_helper(&n_batches, &n_batch_points, max_n_batch_points, n) == 0);
+
+    max_n_batch_points = 1;
+    n = 0;
+    CHECK(secp256k1_ecmult_multi_batch_size_helper(&n_batches, &n_batch_points, max_n_batch_points, n) == 1);
+    CHECK(n_batches == 0);
+    CHECK(n_batch_points == 0);
+
+    max_n_batch_points = 2;
+    n = 5;
+    CHECK(secp256k1_ecmult_multi_batch_size_helper(&n_batches, &n_batch_points, max_n_batch_points, n) == 1);
+    CHECK(n_batches == 3);
+    CHECK(n_batch_points == 2);
+
+    max_n_batch_points = ECMULT_MAX_POINTS_PER_BATCH;
+    n = ECMULT_MAX_POINTS_PER_BATCH;
+    CHECK(secp256k1_ecmult_multi_batch_size_helper(&n_batches, &n_batch_points, max_n_batch_points, n) == 1);
+    CHECK(n_batches == 1);
+    CHECK(n_batch_points == ECMULT_MAX_POINTS_PER_BATCH);
+
+    max_n_batch_points = ECMULT_MAX_POINTS_PER_BATCH + 1;
+    n = ECMULT_MAX_POINTS_PER_BATCH + 1;
+    CHECK(secp256k1_ecmult_multi_batch_size_helper(&n_batches, &n_batch_points, max_n_batch_points, n) == 1);
+    CHECK(n_batches == 2);
+    CHECK(n_batch_points == ECMULT_MAX_POINTS_PER_BATCH/2 + 1);
+}
+
+void test_ecmult_multi_api(void) {
+    /* The public API must agree with adding up separately tweaked public keys. */
+    secp256k1_scratch_space *scratch = secp256k1_scratch_space_create(ctx, 1 << 16);
+    unsigned char seckeys[8][32];
+    unsigned char scalars[8][32];
+    unsigned char gscalar[32];
+    secp256k1_pubkey pubkeys[8];
+    secp256k1_pubkey terms[9];
+    const secp256k1_pubkey *pubkey_ptrs[9];
+    const unsigned char *scalar_ptrs[8];
+    secp256k1_pubkey sum, out;
+    unsigned char sum_ser[33], out_ser[33];
+    size_t len;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        secp256k1_scalar s;
+        random_scalar_order_test(&s);
+        secp256k1_scalar_get_b32(seckeys[i], &s);
+        random_scalar_order_test(&s);
+        secp256k1_scalar_get_b32(scalars[i], &s);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &pubkeys[i], seckeys[i]) == 1);
+        terms[i] = pubkeys[i];
+        CHECK(secp256k1_ec_pubkey_tweak_mul(ctx, &terms[i], scalars[i]) == 1);
+        pubkey_ptrs[i] = &terms[i];
+        scalar_ptrs[i] = scalars[i];
+    }
+    memset(gscalar, 0, sizeof(gscalar));
+    gscalar[31] = 7;
+    CHECK(secp256k1_ec_pubkey_create(ctx, &terms[8], gscalar) == 1);
+    pubkey_ptrs[8] = &terms[8];
+    CHECK(secp256k1_ec_pubkey_combine(ctx, &sum, pubkey_ptrs, 9) == 1);
+
+    for (i = 0; i < 8; i++) {
+        pubkey_ptrs[i] = &pubkeys[i];
+    }
+    CHECK(secp256k1_ecmult_multi(ctx, scratch, &out, gscalar, pubkey_ptrs, scalar_ptrs, 8) == 1);
+    len = 33;
+    CHECK(secp256k1_ec_pubkey_serialize(ctx, sum_ser, &len, &sum, SECP256K1_EC_COMPRESSED) == 1);
+    len = 33;
+    CHECK(secp256k1_ec_pubkey_serialize(ctx, out_ser, &len, &out, SECP256K1_EC_COMPRESSED) == 1);
+    CHECK(memcmp(sum_ser, out_ser, 33) == 0);
+    /* Same result without a scratch space */
+    CHECK(secp256k1_ecmult_multi(ctx, NULL, &out, gscalar, pubkey_ptrs, scalar_ptrs, 8) == 1);
+    len = 33;
+    CHECK(secp256k1_ec_pubkey_serialize(ctx, out_ser, &len, &out, SECP256K1_EC_COMPRESSED) == 1);
+    CHECK(memcmp(sum_ser, out_ser, 33) == 0);
+    /* Overflowing scalars are rejected */
+    memset(gscalar, 0xFF, sizeof(gscalar));
+    CHECK(secp256k1_ecmult_multi(ctx, scratch, &out, gscalar, pubkey_ptrs, scalar_ptrs, 8) == 0);
+    /* An empty sum is the point at infinity */
+    CHECK(secp256k1_ecmult_multi(ctx, scratch, &out, NULL, pubkey_ptrs, scalar_ptrs, 0) == 0);
+    secp256k1_scratch_space_destroy(scratch);
+}
+
+void run_ecmult_multi_tests(void) {
+    secp256k1_scratch *scratch;
+
+    /* A scratch space too small for a single point falls back to the simple algorithm. */
+    scratch = secp256k1_scratch_create(&ctx->error_callback, 0);
+    test_ecmult_multi(scratch);
+    secp256k1_scratch_destroy(scratch);
+    test_ecmult_multi(NULL);
+
+    /* Room for a few points only: many Strauss batches. */
+    scratch = secp256k1_scratch_create(&ctx->error_callback, secp256k1_strauss_scratch_size(3) + STRAUSS_SCRATCH_OBJECTS * 16);
+    test_ecmult_multi(scratch);
+    secp256k1_scratch_destroy(scratch);
+
+    /* Room for a few Pippenger points only. */
+    scratch = secp256k1_scratch_create(&ctx->error_callback, secp256k1_pippenger_scratch_size(1, 1) + PIPPENGER_SCRATCH_OBJECTS * 16);
+    test_ecmult_multi(scratch);
+    secp256k1_scratch_destroy(scratch);
+
+    scratch = secp256k1_scratch_create(&ctx->error_callback, 1 << 20);
+    test_ecmult_multi(scratch);
+    secp256k1_scratch_destroy(scratch);
+
+    test_ecmult_multi_pippenger();
+    test_ecmult_multi_batch_size_helper();
+    test_ecmult_multi_api();
+}
+
 void test_wnaf(const secp256k1_scalar *number, int w) {
     secp256k1_scalar x, two, t;
     int wnaf[256];
@@ -2575,6 +2812,44 @@ void test_constant_wnaf(const secp256k1_scalar *number, int w) {
     CHECK(secp256k1_scalar_eq(&x, &num));
 }
 
+void test_fixed_wnaf(const secp256k1_scalar *number, int w) {
+    secp256k1_scalar x, shift;
+    int wnaf[256] = {0};
+    int i;
+    int skew;
+    secp256k1_scalar num = *number;
+
+    secp256k1_scalar_set_int(&x, 0);
+    secp256k1_scalar_set_int(&shift, 1 << w);
+    /* With USE_ENDOMORPHISM on we only consider 128-bit numbers */
+#ifdef USE_ENDOMORPHISM
+    for (i = 0; i < 16; ++i) {
+        secp256k1_scalar_shr_int(&num, 8);
+    }
+#endif
+    skew = secp256k1_wnaf_fixed(wnaf, &num, w);
+
+    for (i = WNAF_SIZE(w)-1; i >= 0; --i) {
+        secp256k1_scalar t;
+        int v = wnaf[i];
+        CHECK(v == 0 || v & 1);  /* check parity */
+        CHECK(v > -(1 << w)); /* check range above */
+        CHECK(v < (1 << w));  /* check range below */
+
+        secp256k1_scalar_mul(&x, &x, &shift);
+        if (v >= 0) {
+            secp256k1_scalar_set_int(&t, v);
+        } else {
+            secp256k1_scalar_set_int(&t, -v);
+            secp256k1_scalar_negate(&t, &t);
+        }
+        secp256k1_scalar_add(&x, &x, &t);
+    }
+    /* If skew is 1 then add 1 to num */
+    secp256k1_scalar_cadd_bit(&num, 0, skew == 1);
+    CHECK(secp256k1_scalar_eq(&x, &num));
+}
+
 void run_wnaf(void) {
     int i;
     secp256k1_scalar n = {{0}};
@@ -2591,6 +2866,7 @@ void run_wnaf(void) {
         test_wnaf(&n, 4+(i%10));
         test_constant_wnaf_negate(&n);
         test_constant_wnaf(&n, 4 + (i % 10));
+        test_fixed_wnaf(&n, 4 + (i % 10));
     }
     secp256k1_scalar_set_int(&n, 0);
     CHECK(secp256k1_scalar_cond_negate(&n, 1) == -1);
@@ -4492,6 +4768,7 @@ int main(int argc, char **argv) {
     run_ecmult_constants();
     run_ecmult_gen_blind();
     run_ecmult_const_tests();
+    run_ecmult_multi_tests();
     run_ec_combine();
 
     /* endomorphism tests */
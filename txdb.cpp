@@ -20,7 +20,6 @@
 static const char DB_CASH = 'C';
 static const char DB_CASH = 'c';
 static const char DB_BLOCK_FILES = 'f';
-static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -28,6 +27,7 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_UTXO_STATS = 's';
 
 namespace {
 
@@ -103,6 +103,7 @@ bool CCashViewDB::BatchWrite(CCashMap &mapCash, const uint256 &hashBlock) {
     // A vector is used for future extensibility, as we may want to support
     // interrupting after partial writes from multiple independent reorgs.
     batch.Erase(DB_BEST_BLOCK);
+    batch.Erase(DB_UTXO_STATS);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
     for (CCashMap::iterator it = mapCash.begin(); it != mapCash.end();) {
@@ -134,6 +135,9 @@ bool CCashViewDB::BatchWrite(CCashMap &mapCash, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    if (statsToWrite.hashBlock == hashBlock) {
+        batch.Write(DB_UTXO_STATS, statsToWrite);
+    }
 
     LogPrint(BCLog::CASHDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -141,6 +145,14 @@ bool CCashViewDB::BatchWrite(CCashMap &mapCash, const uint256 &hashBlock) {
     return ret;
 }
 
+void CCashViewDB::SetUTXOStats(const CUTXOStats &stats) {
+    statsToWrite = stats;
+}
+
+bool CCashViewDB::ReadUTXOStats(CUTXOStats &stats) const {
+    return db.Read(DB_UTXO_STATS, stats);
+}
+
 size_t CCashViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_CASH, (char)(DB_CASH+1));
@@ -235,17 +247,6 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
-}
-
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -8,6 +8,7 @@
 #include <cash.h>
 #include <dbwrapper.h>
 #include <chain.h>
+#include <utxostats.h>
 
 #include <map>
 #include <string>
@@ -67,6 +68,7 @@ class CCashViewDB final : public CCashView
 {
 protected:
     CDBWrapper db;
+    CUTXOStats statsToWrite;
 public:
     explicit CCashViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -77,6 +79,11 @@ public:
     bool BatchWrite(CCashMap &mapCash, const uint256 &hashBlock) override;
     CCashViewCursor *Cursor() const override;
 
+    //! Statistics to write along with the next BatchWrite, if they are for its block
+    void SetUTXOStats(const CUTXOStats &stats);
+    //! The statistics last written, which may be for an older block than GetBestBlock()
+    bool ReadUTXOStats(CUTXOStats &stats) const;
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -118,8 +125,6 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     bool ReadReindexing(bool &fReindexing);
-    bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
@@ -0,0 +1,135 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/txindex.h>
+#include <txdb.h>
+#include <util.h>
+#include <validation.h>
+
+#include <mutex>
+
+constexpr char DB_TXINDEX = 't';
+
+static std::shared_ptr<TxIndex> g_txindex;
+//! Serializes StartTxIndex and StopTxIndex; readers go through GetTxIndex
+static std::mutex g_txindex_mutex;
+
+/**
+ * Access to the txindex database (indexes/txindex/)
+ *
+ * Maps the hash of each transaction in the active chain to its position in
+ * the block files.
+ */
+class TxIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Read the disk location of the transaction data with the given hash. Returns false if the
+    /// transaction hash is not indexed.
+    bool ReadTxPos(const uint256& txid, CDiskTxPos& pos) const;
+
+    /// Add the disk locations of the given transactions to batch.
+    void WriteTxs(CDBBatch& batch, const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos);
+};
+
+TxIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "txindex", n_cache_size, f_memory, f_wipe)
+{}
+
+bool TxIndex::DB::ReadTxPos(const uint256& txid, CDiskTxPos& pos) const
+{
+    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+}
+
+void TxIndex::DB::WriteTxs(CDBBatch& batch, const std::vector<std::pair<uint256, CDiskTxPos>>& v_pos)
+{
+    for (const auto& tuple : v_pos) {
+        batch.Write(std::make_pair(DB_TXINDEX, tuple.first), tuple.second);
+    }
+}
+
+TxIndex::TxIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<TxIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+TxIndex::~TxIndex()
+{
+    // Stop the sync thread before the database it writes to goes away
+    Interrupt();
+    Stop();
+}
+
+bool TxIndex::WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex)
+{
+    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+    vPos.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        vPos.emplace_back(tx->GetHash(), pos);
+        pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+    }
+    m_db->WriteTxs(batch, vPos);
+    return true;
+}
+
+BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
+
+bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
+{
+    CDiskTxPos postx;
+    if (!m_db->ReadTxPos(tx_hash, postx)) {
+        return false;
+    }
+
+    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        return error("%s: OpenBlockFile failed", __func__);
+    }
+    CBlockHeader header;
+    try {
+        file >> header;
+        if (fseek(file.Get(), postx.nTxOffset, SEEK_CUR)) {
+            return error("%s: fseek(...) failed", __func__);
+        }
+        file >> tx;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    if (tx->GetHash() != tx_hash) {
+        return error("%s: txid mismatch", __func__);
+    }
+    block_hash = header.GetHash();
+    return true;
+}
+
+std::shared_ptr<TxIndex> GetTxIndex()
+{
+    return std::atomic_load(&g_txindex);
+}
+
+bool StartTxIndex(size_t n_cache_size)
+{
+    std::lock_guard<std::mutex> lock(g_txindex_mutex);
+    if (std::atomic_load(&g_txindex)) {
+        return true;
+    }
+    auto txindex = std::make_shared<TxIndex>(n_cache_size);
+    if (!txindex->Start()) {
+        return false;
+    }
+    std::atomic_store(&g_txindex, txindex);
+    return true;
+}
+
+std::shared_ptr<TxIndex> StopTxIndex()
+{
+    std::lock_guard<std::mutex> lock(g_txindex_mutex);
+    std::shared_ptr<TxIndex> txindex = std::atomic_exchange(&g_txindex, std::shared_ptr<TxIndex>());
+    if (txindex) {
+        txindex->Interrupt();
+        txindex->Stop();
+    }
+    return txindex;
+}
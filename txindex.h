@@ -0,0 +1,65 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_INDEX_TXINDEX_H
+#define SALEMCASH_INDEX_TXINDEX_H
+
+#include <index/base.h>
+
+#include <memory>
+
+//! -txindexcache default (MiB)
+static const int64_t DEFAULT_TXINDEX_CACHE = 64;
+
+/**
+ * TxIndex is used to look up transactions included in the blockchain by hash.
+ * The index is written to a LevelDB database and records the filesystem
+ * location of each transaction by transaction hash.
+ */
+class TxIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "txindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit TxIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    ~TxIndex() override;
+
+    /// Look up a transaction by hash.
+    ///
+    /// @param[in]   tx_hash  The hash of the transaction to be returned.
+    /// @param[out]  block_hash  The hash of the block the transaction is found in.
+    /// @param[out]  tx  The transaction itself.
+    /// @return  true if transaction is found, false otherwise
+    bool FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const;
+};
+
+/// The global transaction index, used in GetTransaction. Null while the index
+/// is disabled. As it can be switched on and off while the node runs, callers
+/// hold on to the pointer returned here for as long as they use the index.
+std::shared_ptr<TxIndex> GetTxIndex();
+
+/// Open the transaction index and start building it in the background from
+/// where it left off. Does nothing if it is running already.
+bool StartTxIndex(size_t n_cache_size);
+
+/// Stop updating the transaction index and drop it as the global one. The
+/// stopped index is returned, so that the caller can keep it alive until
+/// any notification still being delivered to it has finished.
+std::shared_ptr<TxIndex> StopTxIndex();
+
+#endif // SALEMCASH_INDEX_TXINDEX_H
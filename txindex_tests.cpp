@@ -0,0 +1,94 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/txindex.h>
+#include <script/standard.h>
+#include <test/test_salemcash.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txindex_tests)
+
+static bool WaitUntilSynced(const BaseIndex& index)
+{
+    // Allow the sync thread up to 10 seconds to catch up with the chain
+    int64_t time_start = GetTimeMillis();
+    while (!index.IsSynced()) {
+        if (GetTimeMillis() - time_start > 10000) {
+            return false;
+        }
+        MilliSleep(100);
+    }
+    return true;
+}
+
+BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
+{
+    TxIndex txindex(1 << 20, true);
+
+    CTransactionRef tx_disk;
+    uint256 block_hash;
+
+    // Transactions should not be found in the index before it is started.
+    for (const auto& txn : cashbaseTxns) {
+        BOOST_CHECK(!txindex.FindTx(txn.GetHash(), block_hash, tx_disk));
+    }
+
+    // BlockUntilSyncedToCurrentChain should return false before txindex is started.
+    BOOST_CHECK(!txindex.BlockUntilSyncedToCurrentChain());
+
+    BOOST_REQUIRE(txindex.Start());
+    BOOST_REQUIRE(WaitUntilSynced(txindex));
+    BOOST_CHECK_EQUAL(txindex.GetBestHeight(), chainActive.Height());
+
+    // Check that txindex has all txs that were in the chain before it started.
+    for (const auto& txn : cashbaseTxns) {
+        BOOST_REQUIRE(txindex.FindTx(txn.GetHash(), block_hash, tx_disk));
+        BOOST_CHECK(tx_disk->GetHash() == txn.GetHash());
+    }
+
+    // Check that new transactions in new blocks make it into the index.
+    CScript cashbase_script_pub_key = GetScriptForDestination(cashbaseKey.GetPubKey().GetID());
+    for (int i = 0; i < 10; i++) {
+        std::vector<CMutableTransaction> no_txns;
+        const CBlock& block = CreateAndProcessBlock(no_txns, cashbase_script_pub_key);
+        const CTransaction& txn = *block.vtx[0];
+
+        BOOST_CHECK(txindex.BlockUntilSyncedToCurrentChain());
+        BOOST_REQUIRE(txindex.FindTx(txn.GetHash(), block_hash, tx_disk));
+        BOOST_CHECK(block_hash == block.GetHash());
+    }
+
+    txindex.Stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(txindex_switch, TestChain100Setup)
+{
+    BOOST_CHECK(!GetTxIndex());
+
+    BOOST_REQUIRE(StartTxIndex(1 << 20));
+    std::shared_ptr<TxIndex> txindex = GetTxIndex();
+    BOOST_REQUIRE(txindex);
+    BOOST_REQUIRE(WaitUntilSynced(*txindex));
+
+    // Starting it again leaves the running index in place
+    BOOST_REQUIRE(StartTxIndex(1 << 20));
+    BOOST_CHECK(GetTxIndex() == txindex);
+
+    // Lookups through GetTransaction go to the index once it is there
+    CTransactionRef tx_disk;
+    uint256 block_hash;
+    BOOST_CHECK(GetTransaction(cashbaseTxns[0].GetHash(), tx_disk, Params().GetConsensus(), block_hash));
+    BOOST_CHECK(block_hash == chainActive[1]->GetBlockHash());
+
+    BOOST_CHECK(StopTxIndex() == txindex);
+    BOOST_CHECK(!GetTxIndex());
+    BOOST_CHECK(!StopTxIndex());
+    SyncWithValidationInterfaceQueue();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -17,6 +17,9 @@
 #include <utilmoneystr.h>
 #include <utiltime.h>
 
+#include <algorithm>
+#include <limits>
+
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
                                  bool _spendsCashbase, int64_t _sigOpsCost, LockPoints lp):
@@ -60,14 +63,14 @@ size_t CTxMemPoolEntry::GetTxSize() const
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const linkEntries &setUpdateChildren = GetMemPoolChildren(updateIt);
+    setEntries stageEntries(setUpdateChildren.begin(), setUpdateChildren.end()), setAllDescendants;
 
     while (!stageEntries.empty()) {
         const txiter cit = *stageEntries.begin();
         setAllDescendants.insert(cit);
         stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
+        const linkEntries &setChildren = GetMemPoolChildren(cit);
         for (const txiter childEntry : setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
@@ -173,7 +176,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        const linkEntries &setMemPoolParents = GetMemPoolParents(it);
+        parentHashes.insert(setMemPoolParents.begin(), setMemPoolParents.end());
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
@@ -196,7 +200,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
             return false;
         }
 
-        const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
+        const linkEntries & setMemPoolParents = GetMemPoolParents(stageit);
         for (const txiter &phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
             if (setAncestors.count(phash) == 0) {
@@ -214,7 +218,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
-    setEntries parentIters = GetMemPoolParents(it);
+    const linkEntries &parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
     for (txiter piter : parentIters) {
         UpdateChild(piter, it, add);
@@ -243,7 +247,7 @@ void CTxMemPool::UpdateEntryForAncestors(txiter it, const setEntries &setAncesto
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
+    const linkEntries &setMemPoolChildren = GetMemPoolChildren(it);
     for (txiter updateIt : setMemPoolChildren) {
         UpdateParent(updateIt, it, false);
     }
@@ -328,7 +332,9 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
-    nTransactionsUpdated(0), minerPolicyEstimator(estimator)
+    nTransactionsUpdated(0), minerPolicyEstimator(estimator),
+    mapTx(indexed_transaction_set::ctor_args_list(), NodePoolAllocator<CTxMemPoolEntry>(&nodePool)),
+    mapLinks(CompareIteratorByHash(), NodePoolAllocator<txlinksMap::value_type>(&nodePool))
 {
     _clear(); //lock free clear
 
@@ -364,7 +370,8 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // all the appropriate checks.
     LOCK(cs);
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
+    mapLinks.insert(std::make_pair(newit, TxLinks()));
+    AddToNewCluster(newit);
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -433,7 +440,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
+    cachedLinksUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
+    RemoveFromCluster(it);
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
@@ -460,7 +468,7 @@ void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants
         setDescendants.insert(it);
         stage.erase(it);
 
-        const setEntries &setChildren = GetMemPoolChildren(it);
+        const linkEntries &setChildren = GetMemPoolChildren(it);
         for (const txiter &childiter : setChildren) {
             if (!setDescendants.count(childiter)) {
                 stage.insert(childiter);
@@ -590,10 +598,17 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 void CTxMemPool::_clear()
 {
     mapLinks.clear();
+    mapClusters.clear();
+    nNextClusterId = 1;
+    setDirtyClusters.clear();
+    setClustersByWorstChunk.clear();
+    // The chunks of nodePool stay: the multi_index header node and hash
+    // buckets of mapTx live in them and survive the clear
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
+    cachedLinksUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -627,6 +642,7 @@ void CTxMemPool::check(const CCashViewCache *pcash) const
 
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
+    uint64_t linksUsage = 0;
 
     CCashViewCache mempoolDuplicate(const_cast<CCashViewCache*>(pcash));
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
@@ -641,7 +657,15 @@ void CTxMemPool::check(const CCashViewCache *pcash) const
         txlinksMap::const_iterator linksiter = mapLinks.find(it);
         assert(linksiter != mapLinks.end());
         const TxLinks &links = linksiter->second;
-        innerUsage += memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
+        linksUsage += memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
+        // Check that the transaction is where its cluster says, and in the
+        // same cluster as its parents
+        auto clusterit = mapClusters.find(links.nClusterId);
+        assert(clusterit != mapClusters.end());
+        assert(links.nClusterPos < clusterit->second.vTxs.size() && clusterit->second.vTxs[links.nClusterPos] == it);
+        for (const txiter& parentit : links.parents) {
+            assert(mapLinks.find(parentit)->second.nClusterId == links.nClusterId);
+        }
         bool fDependsWait = false;
         setEntries setParentCheck;
         int64_t parentSizes = 0;
@@ -667,7 +691,8 @@ void CTxMemPool::check(const CCashViewCache *pcash) const
             assert(it3->second == &tx);
             i++;
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        const linkEntries &parents = GetMemPoolParents(it);
+        assert(setParentCheck.size() == parents.size() && setParentCheck == setEntries(parents.begin(), parents.end()));
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -700,7 +725,8 @@ void CTxMemPool::check(const CCashViewCache *pcash) const
                 childSizes += childit->GetTxSize();
             }
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        const linkEntries &children = GetMemPoolChildren(it);
+        assert(setChildrenCheck.size() == children.size() && setChildrenCheck == setEntries(children.begin(), children.end()));
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         assert(it->GetSizeWithDescendants() >= childSizes + it->GetTxSize());
@@ -733,8 +759,18 @@ void CTxMemPool::check(const CCashViewCache *pcash) const
         assert(&tx == it->second);
     }
 
+    size_t nClusterTxs = 0;
+    for (const auto& entry : mapClusters) {
+        assert(!entry.second.vTxs.empty());
+        assert(entry.second.fDirty == (setDirtyClusters.count(entry.first) != 0));
+        nClusterTxs += entry.second.vTxs.size();
+    }
+    assert(nClusterTxs == mapTx.size());
+    assert(setDirtyClusters.size() + setClustersByWorstChunk.size() == mapClusters.size());
+
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+    assert(linksUsage == cachedLinksUsage);
 }
 
 bool CTxMemPool::CompareDepthAndScore(const uint256& hasha, const uint256& hashb)
@@ -855,6 +891,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             for (txiter descendantIt : setDescendants) {
                 mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
             }
+            MarkClusterDirty(mapLinks[it].nClusterId);
             ++nTransactionsUpdated;
         }
     }
@@ -905,8 +942,26 @@ bool CCashViewMemPool::GetCash(const COutPoint &outpoint, Cash &cash) const {
 
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
-    // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    // The nodes of mapTx and mapLinks are counted exactly by the pool they
+    // are allocated from, including the freed blocks it keeps for reuse, as
+    // the pool never gives those back. The bucket array of mapTx is too large
+    // for the pool's blocks and is counted by it separately.
+    // Each transaction also has a slot in its cluster's and in a chunk's vector.
+    return nodePool.AllocatedBytes() + nodePool.LargeBytes() + 2 * sizeof(txiter) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage + cachedLinksUsage;
+}
+
+CTxMemPool::MemoryUsageStats CTxMemPool::GetMemoryUsageStats() const
+{
+    LOCK(cs);
+    MemoryUsageStats stats;
+    stats.nTransactions = cachedInnerUsage;
+    stats.nEntries = nodePool.UsedBytes() + nodePool.LargeBytes();
+    stats.nLinks = cachedLinksUsage;
+    stats.nClusters = 2 * sizeof(txiter) * mapTx.size();
+    stats.nSpends = memusage::DynamicUsage(mapNextTx);
+    stats.nOther = memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes);
+    stats.nPoolFree = nodePool.AllocatedBytes() - nodePool.UsedBytes();
+    return stats;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -943,27 +998,336 @@ bool CTxMemPool::addUnchecked(const uint256&hash, const CTxMemPoolEntry &entry,
     return addUnchecked(hash, entry, setAncestors, validFeeEstimate);
 }
 
-void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+bool CTxMemPool::UpdateLinkEntries(linkEntries& links, txiter other, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    linkEntries::iterator it = std::find(links.begin(), links.end(), other);
+    if (add == (it != links.end())) {
+        return false;
+    }
+    cachedLinksUsage -= memusage::DynamicUsage(links);
+    if (add) {
+        links.push_back(other);
+    } else {
+        // The order does not matter, fill the gap with the last one
+        *it = links.back();
+        links.pop_back();
     }
+    cachedLinksUsage += memusage::DynamicUsage(links);
+    return true;
+}
+
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+{
+    UpdateLinkEntries(mapLinks[entry].children, child, add);
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    if (UpdateLinkEntries(mapLinks[entry].parents, parent, add) && add) {
+        MergeClusters(entry, parent);
+    }
+}
+
+void CTxMemPool::AddToNewCluster(txiter entry)
+{
+    const uint64_t nClusterId = nNextClusterId++;
+    mapClusters[nClusterId].vTxs.push_back(entry);
+    TxLinks& links = mapLinks[entry];
+    links.nClusterId = nClusterId;
+    links.nClusterPos = 0;
+    MarkClusterDirty(nClusterId);
+}
+
+void CTxMemPool::MergeClusters(txiter a, txiter b)
+{
+    uint64_t nIntoId = mapLinks[a].nClusterId;
+    uint64_t nFromId = mapLinks[b].nClusterId;
+    if (nIntoId == nFromId) return;
+    // Move the members of the smaller cluster, so that every transaction
+    // is only moved O(log n) times
+    if (mapClusters[nIntoId].vTxs.size() < mapClusters[nFromId].vTxs.size()) {
+        std::swap(nIntoId, nFromId);
+    }
+    MarkClusterDirty(nIntoId);
+    MarkClusterDirty(nFromId);
+    TxCluster& into = mapClusters[nIntoId];
+    for (txiter it : mapClusters[nFromId].vTxs) {
+        TxLinks& links = mapLinks[it];
+        links.nClusterId = nIntoId;
+        links.nClusterPos = into.vTxs.size();
+        into.vTxs.push_back(it);
+    }
+    setDirtyClusters.erase(nFromId);
+    mapClusters.erase(nFromId);
+}
+
+void CTxMemPool::RemoveFromCluster(txiter entry)
+{
+    const TxLinks& links = mapLinks[entry];
+    const uint64_t nClusterId = links.nClusterId;
+    MarkClusterDirty(nClusterId);
+    TxCluster& cluster = mapClusters[nClusterId];
+    txiter last = cluster.vTxs.back();
+    cluster.vTxs[links.nClusterPos] = last;
+    mapLinks[last].nClusterPos = links.nClusterPos;
+    cluster.vTxs.pop_back();
+    if (cluster.vTxs.empty()) {
+        setDirtyClusters.erase(nClusterId);
+        mapClusters.erase(nClusterId);
+    }
+}
+
+void CTxMemPool::MarkClusterDirty(uint64_t nClusterId)
+{
+    TxCluster& cluster = mapClusters[nClusterId];
+    if (cluster.fDirty) return;
+    if (!cluster.vChunks.empty()) {
+        const TxClusterChunk& last = cluster.vChunks.back();
+        setClustersByWorstChunk.erase(TxClusterScore{last.nModFees, last.nSize, nClusterId});
+        cluster.vChunks.clear();
     }
+    cluster.fDirty = true;
+    setDirtyClusters.insert(nClusterId);
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
+void CTxMemPool::UpdateCluster(uint64_t nClusterId)
+{
+    std::vector<txiter> vTxs;
+    vTxs.swap(mapClusters[nClusterId].vTxs);
+
+    // Walk the graph from each transaction not reached yet. The first
+    // component stays in this cluster, the others get a new one.
+    const size_t nNotReached = std::numeric_limits<size_t>::max();
+    std::vector<size_t> vComponent(vTxs.size(), nNotReached);
+    std::vector<uint64_t> vClusterIds;
+    for (size_t i = 0; i < vTxs.size(); i++) {
+        if (vComponent[i] != nNotReached) continue;
+        const uint64_t nComponentId = vClusterIds.empty() ? nClusterId : nNextClusterId++;
+        TxCluster& component = mapClusters[nComponentId];
+        component.fDirty = true;
+        vClusterIds.push_back(nComponentId);
+        vComponent[i] = vClusterIds.size() - 1;
+        std::vector<size_t> vStack{i};
+        while (!vStack.empty()) {
+            txiter it = vTxs[vStack.back()];
+            vStack.pop_back();
+            TxLinks& links = mapLinks[it];
+            links.nClusterId = nComponentId;
+            links.nClusterPos = component.vTxs.size();
+            component.vTxs.push_back(it);
+            for (const linkEntries* pset : {&links.parents, &links.children}) {
+                for (txiter other : *pset) {
+                    // Positions still refer to vTxs for transactions not reached yet
+                    const size_t pos = mapLinks[other].nClusterPos;
+                    if (pos < vTxs.size() && vTxs[pos] == other && vComponent[pos] == nNotReached) {
+                        vComponent[pos] = vComponent[i];
+                        vStack.push_back(pos);
+                    }
+                }
+            }
+        }
+    }
+
+    setDirtyClusters.erase(nClusterId);
+    for (uint64_t nComponentId : vClusterIds) {
+        LinearizeCluster(nComponentId);
+    }
+}
+
+/** Whether a has a higher feerate than b */
+static bool HigherFeeRate(CAmount nFeesA, int64_t nSizeA, CAmount nFeesB, int64_t nSizeB)
+{
+    return (double)nFeesA * nSizeB > (double)nFeesB * nSizeA;
+}
+
+void CTxMemPool::LinearizeCluster(uint64_t nClusterId)
+{
+    TxCluster& cluster = mapClusters[nClusterId];
+    const size_t k = cluster.vTxs.size();
+
+    std::vector<std::vector<size_t>> vParents(k), vChildren(k);
+    for (size_t i = 0; i < k; i++) {
+        for (txiter parent : mapLinks[cluster.vTxs[i]].parents) {
+            const size_t pos = mapLinks[parent].nClusterPos;
+            assert(pos < k && cluster.vTxs[pos] == parent);
+            vParents[i].push_back(pos);
+            vChildren[pos].push_back(i);
+        }
+    }
+
+    std::vector<bool> vDone(k, false);
+    std::vector<size_t> vSeen(k, 0);
+    size_t nWalk = 0;
+    // Collect nStart and the transactions reachable from it that are not
+    // done yet, with nStart first
+    auto walk = [&](size_t nStart, const std::vector<std::vector<size_t>>& vEdges, std::vector<size_t>& vOut) {
+        ++nWalk;
+        vOut.assign(1, nStart);
+        vSeen[nStart] = nWalk;
+        for (size_t n = 0; n < vOut.size(); n++) {
+            for (size_t next : vEdges[vOut[n]]) {
+                if (!vDone[next] && vSeen[next] != nWalk) {
+                    vSeen[next] = nWalk;
+                    vOut.push_back(next);
+                }
+            }
+        }
+    };
+
+    // Fees and sizes of each transaction with its ancestors that are not
+    // in the linearization yet
+    std::vector<CAmount> vAncFees(k, 0);
+    std::vector<int64_t> vAncSize(k, 0);
+    std::vector<size_t> vWalked;
+    for (size_t i = 0; i < k; i++) {
+        walk(i, vParents, vWalked);
+        for (size_t a : vWalked) {
+            vAncFees[i] += cluster.vTxs[a]->GetModifiedFee();
+            vAncSize[i] += cluster.vTxs[a]->GetTxSize();
+        }
+    }
+
+    std::vector<size_t> vOrder;
+    vOrder.reserve(k);
+    std::vector<size_t> vPicked;
+    std::vector<std::pair<size_t, size_t>> vStack;
+    while (vOrder.size() < k) {
+        // Pick the remaining ancestor set with the highest feerate
+        size_t nBest = k;
+        for (size_t i = 0; i < k; i++) {
+            if (vDone[i]) continue;
+            if (nBest == k || HigherFeeRate(vAncFees[i], vAncSize[i], vAncFees[nBest], vAncSize[nBest])) {
+                nBest = i;
+            }
+        }
+
+        // Append it parents first, by a depth-first walk over the parents
+        vPicked.clear();
+        ++nWalk;
+        vSeen[nBest] = nWalk;
+        vStack.assign(1, std::make_pair(nBest, (size_t)0));
+        while (!vStack.empty()) {
+            const size_t n = vStack.back().first;
+            const size_t nNextParent = vStack.back().second++;
+            if (nNextParent < vParents[n].size()) {
+                const size_t parent = vParents[n][nNextParent];
+                if (!vDone[parent] && vSeen[parent] != nWalk) {
+                    vSeen[parent] = nWalk;
+                    vStack.emplace_back(parent, 0);
+                }
+            } else {
+                vPicked.push_back(n);
+                vStack.pop_back();
+            }
+        }
+        for (size_t a : vPicked) {
+            vDone[a] = true;
+            vOrder.push_back(a);
+        }
+
+        // Take them out of the ancestor state of their descendants
+        for (size_t a : vPicked) {
+            walk(a, vChildren, vWalked);
+            for (size_t n = 1; n < vWalked.size(); n++) {
+                vAncFees[vWalked[n]] -= cluster.vTxs[a]->GetModifiedFee();
+                vAncSize[vWalked[n]] -= cluster.vTxs[a]->GetTxSize();
+            }
+        }
+    }
+
+    // Chunk the linearization: merge a transaction into the chunk before
+    // it for as long as that raises the feerate of the earlier chunk
+    std::vector<txiter> vLinearized;
+    vLinearized.reserve(k);
+    cluster.vChunks.clear();
+    for (size_t n : vOrder) {
+        txiter it = cluster.vTxs[n];
+        vLinearized.push_back(it);
+        cluster.vChunks.push_back(TxClusterChunk{{it}, it->GetModifiedFee(), (int64_t)it->GetTxSize(), it->GetSigOpCost()});
+        while (cluster.vChunks.size() >= 2) {
+            TxClusterChunk& last = cluster.vChunks.back();
+            TxClusterChunk& prev = cluster.vChunks[cluster.vChunks.size() - 2];
+            if (!HigherFeeRate(last.nModFees, last.nSize, prev.nModFees, prev.nSize)) break;
+            prev.vTxs.insert(prev.vTxs.end(), last.vTxs.begin(), last.vTxs.end());
+            prev.nModFees += last.nModFees;
+            prev.nSize += last.nSize;
+            prev.nSigOpCost += last.nSigOpCost;
+            cluster.vChunks.pop_back();
+        }
+    }
+
+    cluster.vTxs.swap(vLinearized);
+    for (size_t pos = 0; pos < k; pos++) {
+        mapLinks[cluster.vTxs[pos]].nClusterPos = pos;
+    }
+    cluster.fDirty = false;
+    const TxClusterChunk& last = cluster.vChunks.back();
+    setClustersByWorstChunk.insert(TxClusterScore{last.nModFees, last.nSize, nClusterId});
+}
+
+void CTxMemPool::UpdateDirtyClusters()
+{
+    AssertLockHeld(cs);
+    while (!setDirtyClusters.empty()) {
+        UpdateCluster(*setDirtyClusters.begin());
+    }
+}
+
+std::vector<const CTxMemPool::TxClusterChunk*> CTxMemPool::GetChunksByFeeRate()
+{
+    LOCK(cs);
+    UpdateDirtyClusters();
+    std::vector<const TxClusterChunk*> vChunks;
+    vChunks.reserve(mapClusters.size());
+    for (const auto& entry : mapClusters) {
+        for (const TxClusterChunk& chunk : entry.second.vChunks) {
+            vChunks.push_back(&chunk);
+        }
+    }
+    // Stable, so that chunks of a cluster with equal feerates keep their order
+    std::stable_sort(vChunks.begin(), vChunks.end(), [](const TxClusterChunk* a, const TxClusterChunk* b) {
+        return HigherFeeRate(a->nModFees, a->nSize, b->nModFees, b->nSize);
+    });
+    return vChunks;
+}
+
+CFeeRate CTxMemPool::GetChunkFeeRate(txiter entry)
+{
+    AssertLockHeld(cs);
+    if (mapClusters[mapLinks[entry].nClusterId].fDirty) {
+        UpdateCluster(mapLinks[entry].nClusterId);
+    }
+    const TxLinks& links = mapLinks[entry];
+    size_t nEnd = 0;
+    for (const TxClusterChunk& chunk : mapClusters[links.nClusterId].vChunks) {
+        nEnd += chunk.vTxs.size();
+        if (links.nClusterPos < nEnd) {
+            return CFeeRate(chunk.nModFees, chunk.nSize);
+        }
+    }
+    assert(false);
+    return CFeeRate();
+}
+
+uint64_t CTxMemPool::CalculateClusterCount(const setEntries& setAncestors)
+{
+    AssertLockHeld(cs);
+    std::set<uint64_t> setClusterIds;
+    for (txiter it : setAncestors) {
+        const uint64_t nClusterId = mapLinks[it].nClusterId;
+        if (mapClusters[nClusterId].fDirty) {
+            UpdateCluster(nClusterId);
+        }
+        setClusterIds.insert(mapLinks[it].nClusterId);
+    }
+    uint64_t nCount = 0;
+    for (uint64_t nClusterId : setClusterIds) {
+        nCount += mapClusters[nClusterId].vTxs.size();
+    }
+    return nCount;
+}
+
+const CTxMemPool::linkEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
     txlinksMap::const_iterator it = mapLinks.find(entry);
@@ -971,7 +1335,7 @@ const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
     return it->second.parents;
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
+const CTxMemPool::linkEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
 {
     assert (entry != mapTx.end());
     txlinksMap::const_iterator it = mapLinks.find(entry);
@@ -1016,20 +1380,27 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
-    while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
-
-        // We set the new mempool min fee to the feerate of the removed set, plus the
+    // The nodes of evicted entries stay in nodePool for the entries the trim
+    // makes room for, so they do not count against the limit here
+    const size_t nPoolUsedStart = nodePool.UsedBytes();
+    while (!mapTx.empty() && DynamicMemoryUsage() - (nPoolUsedStart - std::min(nPoolUsedStart, nodePool.UsedBytes())) > sizelimit) {
+        // The last chunk of the linearization whose last chunk has the
+        // lowest feerate: it would be mined last, and nothing outside it
+        // depends on it.
+        UpdateDirtyClusters();
+        const TxClusterScore& worst = *setClustersByWorstChunk.begin();
+        const TxClusterChunk& chunk = mapClusters[worst.nClusterId].vChunks.back();
+
+        // We set the new mempool min fee to the feerate of the removed chunk, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
         // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
         // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+        CFeeRate removed(worst.nModFees, worst.nSize);
         removed += incrementalRelayFee;
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        setEntries stage(chunk.vTxs.begin(), chunk.vTxs.end());
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -16,7 +16,9 @@
 #include <cash.h>
 #include <indirectmap.h>
 #include <policy/feerate.h>
+#include <prevector.h>
 #include <primitives/transaction.h>
+#include <support/allocators/pool.h>
 #include <sync.h>
 #include <random.h>
 
@@ -428,6 +430,23 @@ public:
  * CalculateMemPoolAncestors() and CalculateDescendants() that rely
  * on them to walk the mempool are not generally safe to use).
  *
+ * Clusters:
+ *
+ * The transactions are also grouped into clusters, the connected components
+ * of the graph in mapLinks. Each cluster caches a linearization: an order of
+ * its transactions that is valid in a block, built by repeatedly picking
+ * the best remaining ancestor set, and split into chunks of non-increasing
+ * feerate. Adding a transaction merges the clusters of its parents, removing
+ * one may split its cluster. Either marks the cluster dirty, and it is only
+ * split and linearized again when a chunk order is needed, by
+ * GetChunksByFeeRate() for mining, TrimToSize() for eviction and
+ * GetChunkFeeRate() for replacements.
+ *
+ * As linearizing is quadratic in the size of a cluster, AcceptToMemoryPool
+ * rejects transactions that would make a cluster larger than
+ * -limitclustercount. Clusters can still grow past it when a reorg returns
+ * transactions to the mempool underneath their in-mempool descendants.
+ *
  * Computational limits:
  *
  * Updating all in-mempool ancestors of a newly added transaction can be slow,
@@ -445,6 +464,7 @@ private:
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t cachedLinksUsage; //!< sum of the heap memory of parent and child lists that did not fit in place
 
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
@@ -456,6 +476,12 @@ public:
 
     static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
 
+    //! The nodes of mapTx and mapLinks are allocated from a pool, see nodePool
+    static const size_t NODE_POOL_MAX_BLOCK_BYTES = 512;
+    typedef PoolResource<NODE_POOL_MAX_BLOCK_BYTES, alignof(CTxMemPoolEntry)> NodePoolResource;
+    template <typename T>
+    using NodePoolAllocator = PoolAllocator<T, NODE_POOL_MAX_BLOCK_BYTES, alignof(CTxMemPoolEntry)>;
+
     typedef boost::multi_index_container<
         CTxMemPoolEntry,
         boost::multi_index::indexed_by<
@@ -479,10 +505,16 @@ public:
                 boost::multi_index::identity<CTxMemPoolEntry>,
                 CompareTxMemPoolEntryByAncestorFee
             >
-        >
+        >,
+        NodePoolAllocator<CTxMemPoolEntry>
     > indexed_transaction_set;
 
     mutable CCriticalSection cs;
+private:
+    /** Memory for the entries in mapTx and mapLinks. Has to be declared
+     *  before them, as they give their nodes back to it when destroyed. */
+    NodePoolResource nodePool;
+public:
     indexed_transaction_set mapTx;
 
     typedef indexed_transaction_set::nth_index<0>::type::iterator txiter;
@@ -494,22 +526,82 @@ public:
         }
     };
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
-
-    const setEntries & GetMemPoolParents(txiter entry) const;
-    const setEntries & GetMemPoolChildren(txiter entry) const;
+    /** The in-mempool parents or children of a transaction. Most have only
+     *  one or two, which are then stored without a separate allocation. */
+    typedef prevector<2, txiter> linkEntries;
+
+    const linkEntries & GetMemPoolParents(txiter entry) const;
+    const linkEntries & GetMemPoolChildren(txiter entry) const;
+
+    /** A chunk of a cluster's linearization: transactions that are best
+     *  mined, or evicted, together */
+    struct TxClusterChunk {
+        std::vector<txiter> vTxs; //!< In an order that is valid in a block
+        CAmount nModFees;
+        int64_t nSize;
+        int64_t nSigOpCost;
+    };
 private:
     typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
 
     struct TxLinks {
-        setEntries parents;
-        setEntries children;
+        linkEntries parents;
+        linkEntries children;
+        uint64_t nClusterId;
+        size_t nClusterPos; //!< Position in the cluster's vTxs
+        TxLinks() : nClusterId(0), nClusterPos(0) {}
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
+    typedef std::map<txiter, TxLinks, CompareIteratorByHash, NodePoolAllocator<std::pair<const txiter, TxLinks>>> txlinksMap;
     txlinksMap mapLinks;
 
+    /** A connected component of the transaction graph, with its cached
+     *  linearization */
+    struct TxCluster {
+        //! Members, in linearization order unless fDirty
+        std::vector<txiter> vTxs;
+        //! The linearization, split into chunks of non-increasing feerate.
+        //! Empty while fDirty.
+        std::vector<TxClusterChunk> vChunks;
+        //! Members or fees changed since the last linearization
+        bool fDirty;
+        TxCluster() : fDirty(false) {}
+    };
+
+    /** A linearized cluster, keyed by the feerate of its last chunk */
+    struct TxClusterScore {
+        CAmount nModFees;
+        int64_t nSize;
+        uint64_t nClusterId;
+        bool operator<(const TxClusterScore& b) const
+        {
+            double f1 = (double)nModFees * b.nSize;
+            double f2 = (double)b.nModFees * nSize;
+            if (f1 != f2) return f1 < f2;
+            return nClusterId < b.nClusterId;
+        }
+    };
+
+    std::map<uint64_t, TxCluster> mapClusters;
+    uint64_t nNextClusterId;
+    //! Clusters that need to be split and linearized again
+    std::set<uint64_t> setDirtyClusters;
+    //! All other clusters, lowest feerate last chunk first
+    std::set<TxClusterScore> setClustersByWorstChunk;
+
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
+    /** Add or remove other in a parent or child list. Returns whether it changed. */
+    bool UpdateLinkEntries(linkEntries& links, txiter other, bool add);
+
+    void AddToNewCluster(txiter entry);
+    void MergeClusters(txiter a, txiter b);
+    void RemoveFromCluster(txiter entry);
+    void MarkClusterDirty(uint64_t nClusterId);
+    /** Split a dirty cluster into its connected components and linearize them */
+    void UpdateCluster(uint64_t nClusterId);
+    void LinearizeCluster(uint64_t nClusterId);
+    void UpdateDirtyClusters();
 
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const;
 
@@ -601,6 +693,11 @@ public:
      *  already in it.  */
     void CalculateDescendants(txiter it, setEntries &setDescendants);
 
+    /** The number of transactions in the clusters of setAncestors, which a
+     *  transaction with these in-mempool ancestors would join. Clusters
+     *  that lost members are split first, so that they are not overcounted. */
+    uint64_t CalculateClusterCount(const setEntries& setAncestors);
+
     /** The minimum fee to get into the mempool, which may itself not be enough
       *  for larger-sized transactions.
       *  The incrementalRelayFee policy variable is used to bound the time it
@@ -609,7 +706,18 @@ public:
       */
     CFeeRate GetMinFee(size_t sizelimit) const;
 
+    /** Return every chunk in the mempool, by decreasing feerate. Clusters
+     *  that changed are linearized first. Chunks of the same cluster keep
+     *  their order, so taking chunks in this order yields a valid block.
+     *  The chunks are valid until the mempool is modified. */
+    std::vector<const TxClusterChunk*> GetChunksByFeeRate();
+
+    /** The feerate of the chunk entry is in, which is what it would be mined at */
+    CFeeRate GetChunkFeeRate(txiter entry);
+
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
+      *  Transactions are evicted a chunk at a time, taking the last chunk of
+      *  the cluster whose last chunk has the lowest feerate.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
       */
@@ -645,6 +753,18 @@ public:
 
     size_t DynamicMemoryUsage() const;
 
+    /** DynamicMemoryUsage() by component */
+    struct MemoryUsageStats {
+        size_t nTransactions; //!< The transactions themselves
+        size_t nEntries;      //!< Entries in mapTx and mapLinks, and the bucket array of mapTx
+        size_t nLinks;        //!< Parent and child lists that did not fit in their entry
+        size_t nClusters;     //!< Cluster linearizations
+        size_t nSpends;       //!< mapNextTx
+        size_t nOther;        //!< Prioritisation deltas and the witness hash list
+        size_t nPoolFree;     //!< Freed entries kept by the entry pool for reuse
+    };
+    MemoryUsageStats GetMemoryUsageStats() const;
+
     boost::signals2::signal<void (CTransactionRef)> NotifyEntryAdded;
     boost::signals2::signal<void (CTransactionRef, MemPoolRemovalReason)> NotifyEntryRemoved;
 
@@ -7,9 +7,12 @@
 #include <amount.h>
 #include <consensus/validation.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <test/test_salemcash.h>
 
+#include <numeric>
+
 #include <boost/test/unit_test.hpp>
 
 
@@ -58,4 +61,198 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_cashbase, TestChain100Setup)
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+/**
+ * Ensure that a package is accepted as a whole, a child paying for a parent
+ * below the minimum relay fee.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_package, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    auto spend = [&](const CTransaction& txFrom, CAmount nFee) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(txFrom.GetHash(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = txFrom.vout[0].nValue - nFee;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(txFrom.vout[0].scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(cashbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(std::move(tx));
+    };
+
+    CTransactionRef parent = spend(cashbaseTxns[0], 0);
+    CTransactionRef child = spend(*parent, 10000);
+    unsigned int initialPoolSize = mempool.size();
+
+    // The parent alone does not pay the minimum relay fee
+    CValidationState state;
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, parent, nullptr, nullptr, false, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "min relay fee not met");
+
+    // Children have to come after their parents
+    size_t nFailed = 0;
+    state = CValidationState();
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, {child, parent}, &nFailed, false, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "package-not-sorted");
+    BOOST_CHECK_EQUAL(nFailed, 0U);
+
+    // Testing acceptance leaves the mempool alone
+    state = CValidationState();
+    BOOST_CHECK(AcceptPackageToMemoryPool(mempool, state, {parent, child}, nullptr, true, 0));
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize);
+
+    state = CValidationState();
+    BOOST_CHECK(AcceptPackageToMemoryPool(mempool, state, {parent, child}, nullptr, false, 0));
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize + 2);
+    BOOST_CHECK(mempool.exists(parent->GetHash()));
+    BOOST_CHECK(mempool.exists(child->GetHash()));
+
+    // A parent cannot pay for its children
+    CTransactionRef parent2 = spend(*child, 10000);
+    CTransactionRef child2 = spend(*parent2, 0);
+    state = CValidationState();
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, {parent2, child2}, &nFailed, false, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "min relay fee not met");
+    BOOST_CHECK_EQUAL(nFailed, 1U);
+    BOOST_CHECK(!mempool.exists(parent2->GetHash()));
+}
+
+/**
+ * Ensure that a child paying for many parents below the minimum relay fee
+ * pays for all of them together, not for each one on its own.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_package_feerate, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    // Spend the given outputs, all paying to scriptPubKey
+    auto spend = [&](const std::vector<std::pair<CTransactionRef, uint32_t>>& vPrevouts, int nOutputs, CAmount nFee) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        CAmount nValueIn = 0;
+        for (const auto& prevout : vPrevouts) {
+            tx.vin.emplace_back(COutPoint(prevout.first->GetHash(), prevout.second));
+            nValueIn += prevout.first->vout[prevout.second].nValue;
+        }
+        tx.vout.resize(nOutputs);
+        for (CTxOut& out : tx.vout) {
+            out.nValue = (nValueIn - nFee) / nOutputs;
+            out.scriptPubKey = scriptPubKey;
+        }
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            std::vector<unsigned char> vchSig;
+            uint256 hash = SignatureHash(scriptPubKey, tx, i, SIGHASH_ALL, 0, SIGVERSION_BASE);
+            BOOST_CHECK(cashbaseKey.Sign(hash, vchSig));
+            vchSig.push_back((unsigned char)SIGHASH_ALL);
+            tx.vin[i].scriptSig << vchSig;
+        }
+        return MakeTransactionRef(std::move(tx));
+    };
+
+    // Confirmed outputs for the parents to spend
+    const uint32_t nParents = 20;
+    CTransactionRef fanout = spend({{MakeTransactionRef(cashbaseTxns[0]), 0}}, nParents, 10000);
+    CreateAndProcessBlock({CMutableTransaction(*fanout)}, scriptPubKey);
+    BOOST_REQUIRE(pcashTip->HaveCash(COutPoint(fanout->GetHash(), 0)));
+
+    // Parents without fee, and a child spending all of them
+    std::vector<CTransactionRef> parents;
+    std::vector<std::pair<CTransactionRef, uint32_t>> vParentOutputs;
+    for (uint32_t n = 0; n < nParents; n++) {
+        parents.push_back(spend({{fanout, n}}, 1, 0));
+        vParentOutputs.emplace_back(parents.back(), 0);
+    }
+    auto make_package = [&](CAmount nChildFee) {
+        std::vector<CTransactionRef> package = parents;
+        package.push_back(spend(vParentOutputs, 1, nChildFee));
+        return package;
+    };
+
+    std::vector<CTransactionRef> package = make_package(0);
+    const size_t nPackageSize = std::accumulate(package.begin(), package.end(), (size_t)0, [](size_t n, const CTransactionRef& tx) {
+        return n + ::GetSerializeSize(*tx, SER_NETWORK, PROTOCOL_VERSION);
+    });
+
+    // The child pays for itself and any one of its parents, but not for all of them
+    package = make_package(::minRelayTxFee.GetFee(nPackageSize) / 2);
+    unsigned int initialPoolSize = mempool.size();
+    size_t nFailed = 0;
+    CValidationState state;
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, package, &nFailed, false, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "min relay fee not met");
+    BOOST_CHECK_EQUAL(nFailed, package.size());
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize);
+
+    // Paying for all of them gets the package in
+    package = make_package(::minRelayTxFee.GetFee(nPackageSize) + 1000);
+    state = CValidationState();
+    BOOST_CHECK(AcceptPackageToMemoryPool(mempool, state, package, nullptr, false, 0));
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize + package.size());
+}
+
+/**
+ * Ensure that transactions joining a cluster that is full are rejected, on
+ * their own and in packages.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_cluster_limit, TestChain100Setup)
+{
+    gArgs.ForceSetArg("-limitclustercount", "5");
+    CScript scriptPubKey = CScript() << ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    auto spend = [&](const CTransaction& txFrom, uint32_t n, int nOutputs, CAmount nFee) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(txFrom.GetHash(), n);
+        tx.vout.resize(nOutputs);
+        for (CTxOut& out : tx.vout) {
+            out.nValue = (txFrom.vout[n].nValue - nFee) / nOutputs;
+            out.scriptPubKey = scriptPubKey;
+        }
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(txFrom.vout[n].scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(cashbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(std::move(tx));
+    };
+
+    CTransactionRef parent = spend(cashbaseTxns[0], 0, 10, 10000);
+    CValidationState state;
+    BOOST_CHECK(AcceptToMemoryPool(mempool, state, parent, nullptr, nullptr, false, 0));
+
+    // The children are not each other's ancestors, but share the parent's cluster
+    std::vector<CTransactionRef> children;
+    for (uint32_t n = 0; n < parent->vout.size(); n++) {
+        children.push_back(spend(*parent, n, 1, 10000));
+    }
+    for (size_t i = 0; i < 4; i++) {
+        BOOST_CHECK(AcceptToMemoryPool(mempool, state, children[i], nullptr, nullptr, false, 0));
+    }
+    BOOST_CHECK(!AcceptToMemoryPool(mempool, state, children[4], nullptr, nullptr, false, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "too-large-cluster");
+    BOOST_CHECK_EQUAL(mempool.size(), 5U);
+
+    // Once a member is gone, there is room again
+    mempool.removeRecursive(*children[0], MemPoolRemovalReason::REPLACED);
+    state = CValidationState();
+    BOOST_CHECK(AcceptToMemoryPool(mempool, state, children[4], nullptr, nullptr, false, 0));
+
+    // A package counts as a whole
+    mempool.removeRecursive(*children[1], MemPoolRemovalReason::REPLACED);
+    mempool.removeRecursive(*children[2], MemPoolRemovalReason::REPLACED);
+    CTransactionRef grandchild = spend(*children[5], 0, 1, 10000);
+    size_t nFailed = 0;
+    state = CValidationState();
+    BOOST_CHECK(!AcceptPackageToMemoryPool(mempool, state, {children[5], children[6], grandchild}, &nFailed, false, 0));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "too-large-cluster");
+    state = CValidationState();
+    BOOST_CHECK(AcceptPackageToMemoryPool(mempool, state, {children[5], grandchild}, nullptr, false, 0));
+    BOOST_CHECK_EQUAL(mempool.size(), 5U);
+
+    gArgs.ForceSetArg("-limitclustercount", std::to_string(DEFAULT_CLUSTER_LIMIT));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -91,6 +91,134 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(block_prefetch_doublespend, TestChain100Setup)
+{
+    // An output spent by a block that is not flushed yet is still unspent in
+    // the chainstate database; prefetching the inputs of the next block must
+    // not read it back from there.
+    CScript scriptPubKey = CScript() <<  ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CScript scriptTrue = CScript() << OP_TRUE;
+    const size_t nOutputs = 80;
+
+    CMutableTransaction fanout;
+    fanout.nVersion = 1;
+    fanout.vin.resize(1);
+    fanout.vin[0].prevout = COutPoint(cashbaseTxns[0].GetHash(), 0);
+    fanout.vout.resize(nOutputs);
+    for (CTxOut& out : fanout.vout) {
+        out.nValue = cashbaseTxns[0].vout[0].nValue / (nOutputs + 1);
+        out.scriptPubKey = scriptTrue;
+    }
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, fanout, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(cashbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    fanout.vin[0].scriptSig << vchSig;
+
+    CBlock block = CreateAndProcessBlock({fanout}, scriptPubKey);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    {
+        // Leave the outputs on disk only
+        LOCK(cs_main);
+        BOOST_REQUIRE(pcashTip->Flush());
+        BOOST_CHECK(!pcashTip->HaveCacheEntry(COutPoint(fanout.GetHash(), 0)));
+    }
+
+    // Spend the first output in a block that stays in pcashTip
+    CMutableTransaction spend1;
+    spend1.nVersion = 1;
+    spend1.vin.resize(1);
+    spend1.vin[0].prevout = COutPoint(fanout.GetHash(), 0);
+    spend1.vout.resize(1);
+    spend1.vout[0].nValue = fanout.vout[0].nValue;
+    spend1.vout[0].scriptPubKey = scriptTrue;
+    block = CreateAndProcessBlock({spend1}, scriptPubKey);
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    const uint256 hashTip = block.GetHash();
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcashTip->HaveCacheEntry(COutPoint(fanout.GetHash(), 0)));
+        BOOST_CHECK(!pcashTip->HaveCashInCache(COutPoint(fanout.GetHash(), 0)));
+    }
+
+    // Spending it again along with enough outputs on disk to be prefetched
+    // is rejected
+    CMutableTransaction spend2;
+    spend2.nVersion = 1;
+    spend2.vin.resize(nOutputs);
+    for (size_t i = 0; i < nOutputs; i++) {
+        spend2.vin[i].prevout = COutPoint(fanout.GetHash(), i);
+    }
+    spend2.vout.resize(1);
+    spend2.vout[0].nValue = fanout.vout[0].nValue * nOutputs;
+    spend2.vout[0].scriptPubKey = scriptTrue;
+    block = CreateAndProcessBlock({spend2}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+}
+
+BOOST_FIXTURE_TEST_CASE(tx_replacement_feerate, TestChain100Setup)
+{
+    // A replacement has to beat both the feerate of the chunk the replaced
+    // transaction is mined in and the feerate of the transaction itself
+    CScript scriptPubKey = CScript() <<  ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CScript scriptTrue = CScript() << OP_TRUE;
+
+    // A low-fee parent
+    CMutableTransaction parent;
+    parent.nVersion = 1;
+    parent.vin.resize(1);
+    parent.vin[0].prevout = COutPoint(cashbaseTxns[0].GetHash(), 0);
+    parent.vout.resize(1);
+    parent.vout[0].nValue = cashbaseTxns[0].vout[0].nValue - 1000;
+    parent.vout[0].scriptPubKey = scriptTrue;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, parent, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(cashbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    parent.vin[0].scriptSig << vchSig;
+    BOOST_REQUIRE(ToMemPool(parent));
+
+    // A replaceable high-fee child, in one chunk with its parent
+    CMutableTransaction child;
+    child.nVersion = 1;
+    child.vin.resize(1);
+    child.vin[0].prevout = COutPoint(parent.GetHash(), 0);
+    child.vin[0].nSequence = 0;
+    child.vout.resize(1);
+    child.vout[0].nValue = parent.vout[0].nValue - 3000;
+    child.vout[0].scriptPubKey = scriptTrue;
+    BOOST_REQUIRE(ToMemPool(child));
+
+    // A larger replacement paying more fees, at a feerate above the chunk's
+    // but below the child's
+    CMutableTransaction replacement = child;
+    replacement.vout[0].nValue = parent.vout[0].nValue - 4500;
+    replacement.vout.resize(2);
+    replacement.vout[1].nValue = 0;
+    replacement.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(80, 0);
+    {
+        LOCK2(cs_main, mempool.cs);
+        CTxMemPool::txiter it = mempool.mapTx.find(child.GetHash());
+        const CFeeRate newFeeRate(4500, GetVirtualTransactionSize(replacement));
+        BOOST_REQUIRE(newFeeRate > mempool.GetChunkFeeRate(it));
+        BOOST_REQUIRE(newFeeRate < CFeeRate(it->GetModifiedFee(), it->GetTxSize()));
+    }
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(replacement), nullptr /* pfMissingInputs */,
+                                        nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+    }
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "insufficient fee");
+    BOOST_CHECK(mempool.exists(child.GetHash()));
+
+    // Beating the child's own feerate as well is enough
+    replacement.vout[0].nValue = parent.vout[0].nValue - 12000;
+    BOOST_CHECK(ToMemPool(replacement));
+    BOOST_CHECK(!mempool.exists(child.GetHash()));
+    mempool.clear();
+}
+
 // Run CheckInputs (using pcashTip) on the given transaction, for all script
 // flags.  Test that CheckInputs passes for all flags that don't overlap with
 // the failing_flags argument, but otherwise fails.
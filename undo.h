@@ -5,10 +5,12 @@
 #ifndef SALEMCASH_UNDO_H
 #define SALEMCASH_UNDO_H
 
+#include <cash.h>
 #include <compressor.h>
 #include <consensus/consensus.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
+#include <version.h>
 
 /** Undo information for a CTxIn
  *
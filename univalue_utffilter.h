@@ -48,6 +48,13 @@ public:
                 push_back_u(codepoint);
         }
     }
+    // Write a run of 7-bit ASCII characters at once
+    void append(const char *first, const char *last)
+    {
+        if (state) // An ASCII character cannot continue a UTF-8 sequence
+            is_valid = false;
+        str.append(first, last);
+    }
     // Write codepoint directly, possibly collating surrogate pairs
     void push_back_u(unsigned int codepoint_)
     {
@@ -10,22 +10,23 @@
 
 using namespace std;
 
-static string json_escape(const string& inS)
+// append inS to s as a quoted string, copying the runs of characters that
+// need no escaping at once
+static void json_escape(const string& inS, string& s)
 {
-    string outS;
-    outS.reserve(inS.size() * 2);
-
-    for (unsigned int i = 0; i < inS.size(); i++) {
-        unsigned char ch = inS[i];
-        const char *escStr = escapes[ch];
-
-        if (escStr)
-            outS += escStr;
-        else
-            outS += ch;
+    s += '"';
+    const char *run = inS.data();
+    const char *end = inS.data() + inS.size();
+    for (const char *p = run; p != end; p++) {
+        const char *escStr = escapes[(unsigned char)*p];
+        if (escStr) {
+            s.append(run, p);
+            s += escStr;
+            run = p + 1;
+        }
     }
-
-    return outS;
+    s.append(run, end);
+    s += '"';
 }
 
 string UniValue::write(unsigned int prettyIndent,
@@ -38,18 +39,25 @@ string UniValue::write(unsigned int prettyIndent,
     if (modIndent == 0)
         modIndent = 1;
 
+    writeValue(prettyIndent, modIndent, s);
+
+    return s;
+}
+
+void UniValue::writeValue(unsigned int prettyIndent, unsigned int indentLevel, string& s) const
+{
     switch (typ) {
     case VNULL:
         s += "null";
         break;
     case VOBJ:
-        writeObject(prettyIndent, modIndent, s);
+        writeObject(prettyIndent, indentLevel, s);
         break;
     case VARR:
-        writeArray(prettyIndent, modIndent, s);
+        writeArray(prettyIndent, indentLevel, s);
         break;
     case VSTR:
-        s += "\"" + json_escape(val) + "\"";
+        json_escape(val, s);
         break;
     case VNUM:
         s += val;
@@ -58,8 +66,6 @@ string UniValue::write(unsigned int prettyIndent,
         s += (val == "1" ? "true" : "false");
         break;
     }
-
-    return s;
 }
 
 static void indentStr(unsigned int prettyIndent, unsigned int indentLevel, string& s)
@@ -76,7 +82,7 @@ void UniValue::writeArray(unsigned int prettyIndent, unsigned int indentLevel, s
     for (unsigned int i = 0; i < values.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += values[i].write(prettyIndent, indentLevel + 1);
+        values[i].writeValue(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1)) {
             s += ",";
         }
@@ -98,10 +104,11 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     for (unsigned int i = 0; i < keys.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += "\"" + json_escape(keys[i]) + "\":";
+        json_escape(keys[i], s);
+        s += ':';
         if (prettyIndent)
             s += " ";
-        s += values.at(i).write(prettyIndent, indentLevel + 1);
+        values.at(i).writeValue(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1))
             s += ",";
         if (prettyIndent)
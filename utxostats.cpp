@@ -0,0 +1,153 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <utxostats.h>
+
+#include <cash.h>
+#include <chain.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+#include <version.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+namespace {
+
+/** The element an unspent output contributes to the set hash */
+void SerializeOutput(std::vector<unsigned char>& data, const COutPoint& outpoint, const Cash& cash)
+{
+    data.clear();
+    CVectorWriter(SER_DISK, PROTOCOL_VERSION, data, 0, outpoint, (uint32_t)(cash.nHeight * 2 + cash.fCashBase), cash.out);
+}
+
+uint64_t GetBogoSize(const Cash& cash)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + cashbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + cash.out.scriptPubKey.size() /* scriptPubKey */;
+}
+
+bool UndoMatchesBlock(const CBlock& block, const CBlockUndo& blockundo)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size()) return false;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        if (blockundo.vtxundo[i - 1].vprevout.size() != block.vtx[i]->vin.size()) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void CUTXOStats::AddCash(const COutPoint& outpoint, const Cash& cash)
+{
+    std::vector<unsigned char> data;
+    SerializeOutput(data, outpoint, cash);
+    muhash.Insert(data.data(), data.size());
+    nTransactionOutputs++;
+    nBogoSize += GetBogoSize(cash);
+    nTotalAmount += cash.out.nValue;
+}
+
+void CUTXOStats::SpendCash(const COutPoint& outpoint, const Cash& cash)
+{
+    std::vector<unsigned char> data;
+    SerializeOutput(data, outpoint, cash);
+    muhash.Remove(data.data(), data.size());
+    nTransactionOutputs--;
+    nBogoSize -= GetBogoSize(cash);
+    nTotalAmount -= cash.out.nValue;
+}
+
+bool CUTXOStats::ConnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    if (!pindex->pprev || hashBlock != pindex->pprev->GetBlockHash() || !UndoMatchesBlock(block, blockundo)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& hash = tx.GetHash();
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            // Unspendable outputs never enter the set
+            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
+                AddCash(COutPoint(hash, o), Cash(tx.vout[o], pindex->nHeight, tx.IsCashBase()));
+            }
+        }
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                SpendCash(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+        }
+    }
+
+    hashBlock = pindex->GetBlockHash();
+    nHeight = pindex->nHeight;
+    return true;
+}
+
+bool CUTXOStats::DisconnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    if (!pindex->pprev || hashBlock != pindex->GetBlockHash() || !UndoMatchesBlock(block, blockundo)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& hash = tx.GetHash();
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
+                SpendCash(COutPoint(hash, o), Cash(tx.vout[o], pindex->nHeight, tx.IsCashBase()));
+            }
+        }
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                AddCash(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+        }
+    }
+
+    hashBlock = pindex->pprev->GetBlockHash();
+    nHeight = pindex->pprev->nHeight;
+    return true;
+}
+
+uint256 CUTXOStats::GetSetHash() const
+{
+    MuHash3072 finalized = muhash;
+    uint256 hash;
+    finalized.Finalize(hash.begin());
+    return hash;
+}
+
+bool ComputeUTXOStats(CCashView* view, CUTXOStats& stats)
+{
+    std::unique_ptr<CCashViewCursor> pcursor(view->Cursor());
+    assert(pcursor);
+
+    stats = CUTXOStats();
+    stats.hashBlock = pcursor->GetBestBlock();
+    {
+        LOCK(cs_main);
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Cash cash;
+        if (pcursor->GetKey(key) && pcursor->GetValue(cash)) {
+            stats.AddCash(key, cash);
+        } else {
+            return error("%s: unable to read value", __func__);
+        }
+        pcursor->Next();
+    }
+    return true;
+}
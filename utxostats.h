@@ -0,0 +1,70 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SALEMCASH_UTXOSTATS_H
+#define SALEMCASH_UTXOSTATS_H
+
+#include <amount.h>
+#include <crypto/muhash.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+class CCashView;
+class COutPoint;
+class Cash;
+
+/** Statistics about the unspent transaction output set as of a block. Unlike
+ *  a hash over the serialized set, they can be carried from a block to the
+ *  next by only looking at the outputs the block creates and spends. */
+class CUTXOStats
+{
+public:
+    //! The block the statistics are for, null while they are unknown
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    CAmount nTotalAmount;
+    //! Rolling hash over the set of unspent outputs
+    MuHash3072 muhash;
+
+    CUTXOStats() : nHeight(0), nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    void AddCash(const COutPoint& outpoint, const Cash& cash);
+    void SpendCash(const COutPoint& outpoint, const Cash& cash);
+
+    /** Apply the outputs created and spent by a block on top of the
+     *  statistics for its parent. Returns false, leaving the statistics
+     *  alone, if they are not for pindex's parent or the undo data does not
+     *  match the block. */
+    bool ConnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+    /** Undo ConnectBlock for the block the statistics are for. */
+    bool DisconnectBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+    /** The hash of the set of unspent outputs. Finalizing the rolling hash
+     *  takes a few tens of milliseconds. */
+    uint256 GetSetHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+        READWRITE(muhash);
+    }
+};
+
+/** Compute the statistics from scratch by walking the whole set. */
+bool ComputeUTXOStats(CCashView* view, CUTXOStats& stats);
+
+#endif // SALEMCASH_UTXOSTATS_H
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The SalemCash developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <key.h>
+#include <script/standard.h>
+#include <txdb.h>
+#include <utxostats.h>
+#include <validation.h>
+#include <test/test_salemcash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(utxostats_tests)
+
+/** Compare the statistics kept for the tip with a full scan of the set */
+static void CheckTipStats()
+{
+    FlushStateToDisk();
+    CUTXOStats scanned;
+    BOOST_REQUIRE(ComputeUTXOStats(pcashdbview.get(), scanned));
+
+    LOCK(cs_main);
+    BOOST_CHECK(utxoStatsTip.hashBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(scanned.hashBlock == utxoStatsTip.hashBlock);
+    BOOST_CHECK_EQUAL(scanned.nHeight, utxoStatsTip.nHeight);
+    BOOST_CHECK_EQUAL(scanned.nTransactionOutputs, utxoStatsTip.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(scanned.nBogoSize, utxoStatsTip.nBogoSize);
+    BOOST_CHECK_EQUAL(scanned.nTotalAmount, utxoStatsTip.nTotalAmount);
+    BOOST_CHECK(scanned.GetSetHash() == utxoStatsTip.GetSetHash());
+
+    // And what was written along with the chainstate
+    CUTXOStats stored;
+    BOOST_CHECK(pcashdbview->ReadUTXOStats(stored));
+    BOOST_CHECK(stored.hashBlock == utxoStatsTip.hashBlock);
+    BOOST_CHECK(stored.GetSetHash() == utxoStatsTip.GetSetHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(utxostats_follow_tip, TestChain100Setup)
+{
+    CheckTipStats();
+    uint256 hashBefore;
+    {
+        LOCK(cs_main);
+        hashBefore = utxoStatsTip.GetSetHash();
+    }
+
+    // A block spending a cashbase, with an unspendable output
+    CScript scriptPubKey = CScript() << ToByteVector(cashbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout.hash = cashbaseTxns[0].GetHash();
+    spend.vin[0].prevout.n = 0;
+    spend.vout.resize(2);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    spend.vout[1].nValue = 0;
+    spend.vout[1].scriptPubKey = CScript() << OP_RETURN;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(cashbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    CheckTipStats();
+
+    // Disconnecting the block brings back the previous statistics
+    CValidationState state;
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = chainActive.Tip();
+    }
+    BOOST_CHECK(InvalidateBlock(state, Params(), pindex));
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+    CheckTipStats();
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(utxoStatsTip.GetSetHash() == hashBefore);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
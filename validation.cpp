@@ -5,6 +5,7 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockfilemap.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -13,8 +14,10 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <cuckoocache.h>
 #include <hash.h>
+#include <index/txindex.h>
 #include <init.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
@@ -36,11 +39,15 @@
 #include <util.h>
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
+#include <utxostats.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
+#include <atomic>
 #include <future>
+#include <limits>
 #include <sstream>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -160,9 +167,9 @@ public:
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock);
 
     // Block (dis)connection on a given view:
-    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCashViewCache& view);
+    DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCashViewCache& view, CUTXOStats* pstats = nullptr);
     bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                    CCashViewCache& view, const CChainParams& chainparams, bool fJustCheck = false);
+                    CCashViewCache& view, const CChainParams& chainparams, bool fJustCheck = false, CUTXOStats* pstats = nullptr);
 
     // Block disconnection on our pcashTip:
     bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions *disconnectpool);
@@ -206,7 +213,6 @@ CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
-bool fTxIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -279,6 +285,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 std::unique_ptr<CCashViewDB> pcashdbview;
 std::unique_ptr<CCashViewCache> pcashTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
+CUTXOStats utxoStatsTip;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -344,7 +351,7 @@ bool TestLockPointValidity(const LockPoints* lp)
     return true;
 }
 
-bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool useExistingLockPoints)
+bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool useExistingLockPoints, const CCashView* pview)
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(mempool.cs);
@@ -371,12 +378,13 @@ bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool
     else {
         // pcashTip contains the UTXO set for chainActive.Tip()
         CCashViewMemPool viewMemPool(pcashTip.get(), mempool);
+        const CCashView& view = pview ? *pview : viewMemPool;
         std::vector<int> prevheights;
         prevheights.resize(tx.vin.size());
         for (size_t txinIndex = 0; txinIndex < tx.vin.size(); txinIndex++) {
             const CTxIn& txin = tx.vin[txinIndex];
             Cash cash;
-            if (!viewMemPool.GetCash(txin.prevout, cash)) {
+            if (!view.GetCash(txin.prevout, cash)) {
                 return error("%s: Missing input", __func__);
             }
             if (cash.nHeight == MEMPOOL_HEIGHT) {
@@ -540,14 +548,56 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
     return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata);
 }
 
-static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
-                              bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& cash_to_uncache)
+namespace {
+
+/** A transaction on its way into the mempool. PreChecks fills it in under
+ *  cs_main and pool.cs, then the scripts are checked without holding either,
+ *  so that transactions from different peers can be validated concurrently,
+ *  and Finalize takes the locks again to add it. */
+struct MemPoolAccept
 {
+    explicit MemPoolAccept(const CTransactionRef& ptxIn) : ptx(ptxIn), view(&dummy), txdata(*ptxIn) {}
+
+    const CTransactionRef ptx;
+    CCashView dummy;
+    //! The inputs of the transaction, detached from the chainstate and the mempool
+    CCashViewCache view;
+    PrecomputedTransactionData txdata;
+    std::unique_ptr<CTxMemPoolEntry> entry;
+    std::set<uint256> setConflicts;
+    CTxMemPool::setEntries setAncestors;
+    CTxMemPool::setEntries allConflicting;
+    CAmount nModifiedFees = 0;
+    CAmount nConflictingFees = 0;
+    size_t nConflictingSize = 0;
+    unsigned int scriptVerifyFlags = 0;
+    //! Script checks against scriptVerifyFlags, none if the script cache knew the transaction
+    std::vector<CScriptCheck> vChecks;
+    //! The state of the mempool and the chain PreChecks saw. The iterators
+    //! above are only valid while it is unchanged.
+    unsigned int nPoolUpdated = 0;
+    const CBlockIndex* pindexTip = nullptr;
+    //! Set for a transaction of a package: the view its inputs are looked up
+    //! in, which has the outputs of the earlier transactions of the package.
+    //! The fee and ancestor limits are then checked for the package as a whole.
+    CCashView* pPackageView = nullptr;
+};
+
+} // namespace
+
+// Everything up to the script checks, which are only collected in ws.vChecks
+static bool PreChecks(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, MemPoolAccept& ws,
+                      bool* pfMissingInputs, int64_t nAcceptTime, bool bypass_limits, const CAmount& nAbsurdFee,
+                      std::vector<COutPoint>& cash_to_uncache)
+{
+    const CTransactionRef& ptx = ws.ptx;
     const CTransaction& tx = *ptx;
     const uint256 hash = tx.GetHash();
+    const bool fPackage = ws.pPackageView != nullptr;
     AssertLockHeld(cs_main);
-    LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
+    AssertLockHeld(pool.cs);
+    ws.nPoolUpdated = pool.GetTransactionsUpdated();
+    ws.pindexTip = chainActive.Tip();
     if (pfMissingInputs) {
         *pfMissingInputs = false;
     }
@@ -582,7 +632,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
     }
 
     // Check for conflicts with in-memory transactions
-    std::set<uint256> setConflicts;
+    std::set<uint256>& setConflicts = ws.setConflicts;
     for (const CTxIn &txin : tx.vin)
     {
         auto itConflicting = pool.mapNextTx.find(txin.prevout);
@@ -625,12 +675,11 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
     }
 
     {
-        CCashView dummy;
-        CCashViewCache view(&dummy);
+        CCashViewCache& view = ws.view;
 
         LockPoints lp;
         CCashViewMemPool viewMemPool(pcashTip.get(), pool);
-        view.SetBackend(viewMemPool);
+        view.SetBackend(fPackage ? *ws.pPackageView : viewMemPool);
 
         // do all inputs exist?
         for (const CTxIn txin : tx.vin) {
@@ -657,14 +706,13 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         view.GetBestBlock();
 
         // we have all inputs cached now, so switch back to dummy, so we don't need to keep lock on mempool
-        view.SetBackend(dummy);
+        view.SetBackend(ws.dummy);
 
         // Only accept BIP68 sequence locked transactions that can be mined in the next
         // block; we don't want our mempool filled up with transactions that can't
-        // be mined yet.
-        // Must keep pool.cs for this unless we change CheckSequenceLocks to take a
-        // CashViewCache instead of create its own
-        if (!CheckSequenceLocks(tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp))
+        // be mined yet. The inputs are looked up in view, which also has
+        // the outputs of earlier transactions of a package.
+        if (!CheckSequenceLocks(tx, STANDARD_LOCKTIME_VERIFY_FLAGS, &lp, false, &view))
             return state.DoS(0, false, REJECT_NONSTANDARD, "non-BIP68-final");
 
         CAmount nFees = 0;
@@ -683,7 +731,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         int64_t nSigOpsCost = GetTransactionSigOpCost(tx, view, STANDARD_SCRIPT_VERIFY_FLAGS);
 
         // nModifiedFees includes any fee deltas from PrioritiseTransaction
-        CAmount nModifiedFees = nFees;
+        CAmount& nModifiedFees = ws.nModifiedFees;
+        nModifiedFees = nFees;
         pool.ApplyDelta(hash, nModifiedFees);
 
         // Keep track of transactions that spend a cashbase, which we re-scan
@@ -697,8 +746,9 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             }
         }
 
-        CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, chainActive.Height(),
-                              fSpendsCashbase, nSigOpsCost, lp);
+        ws.entry.reset(new CTxMemPoolEntry(ptx, nFees, nAcceptTime, chainActive.Height(),
+                                           fSpendsCashbase, nSigOpsCost, lp));
+        const CTxMemPoolEntry& entry = *ws.entry;
         unsigned int nSize = entry.GetTxSize();
 
         // Check that the transaction doesn't have an excessive number of
@@ -711,12 +761,12 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 strprintf("%d", nSigOpsCost));
 
         CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
-        if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+        if (!bypass_limits && !fPackage && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
         }
 
         // No transactions are allowed below minRelayTxFee except from disconnected blocks
-        if (!bypass_limits && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
+        if (!bypass_limits && !fPackage && nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met");
         }
 
@@ -726,16 +776,30 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 strprintf("%d > %d", nFees, nAbsurdFee));
 
         // Calculate in-mempool ancestors, up to a limit.
-        CTxMemPool::setEntries setAncestors;
+        CTxMemPool::setEntries& setAncestors = ws.setAncestors;
         size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
         size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
         size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
         size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+        if (fPackage) {
+            nLimitAncestors = nLimitAncestorSize = nLimitDescendants = nLimitDescendantSize = std::numeric_limits<size_t>::max();
+        }
         std::string errString;
         if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
             return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, errString);
         }
 
+        // The clusters of its ancestors are merged into one, which is
+        // linearized as a whole. Packages check this for all of them at once.
+        if (!fPackage) {
+            const uint64_t nLimitClusterCount = gArgs.GetArg("-limitclustercount", DEFAULT_CLUSTER_LIMIT);
+            const uint64_t nClusterCount = pool.CalculateClusterCount(setAncestors) + 1;
+            if (nClusterCount > nLimitClusterCount) {
+                return state.DoS(0, false, REJECT_NONSTANDARD, "too-large-cluster", false,
+                                 strprintf("%u > %u", nClusterCount, nLimitClusterCount));
+            }
+        }
+
         // A transaction that spends outputs that would be replaced by it is invalid. Now
         // that we have the set of all ancestors we can detect this
         // pathological case by making sure setConflicts and setAncestors don't
@@ -755,16 +819,15 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
         // Check if it's economically rational to mine this transaction rather
         // than the ones it replaces.
-        CAmount nConflictingFees = 0;
-        size_t nConflictingSize = 0;
+        CAmount& nConflictingFees = ws.nConflictingFees;
+        size_t& nConflictingSize = ws.nConflictingSize;
         uint64_t nConflictingCount = 0;
-        CTxMemPool::setEntries allConflicting;
+        CTxMemPool::setEntries& allConflicting = ws.allConflicting;
 
         // If we don't hold the lock allConflicting might be incomplete; the
         // subsequent RemoveStaged() and addUnchecked() calls don't guarantee
         // mempool consistency for us.
-        const bool fReplacementTransaction = setConflicts.size();
-        if (fReplacementTransaction)
+        if (!setConflicts.empty())
         {
             CFeeRate newFeeRate(nModifiedFees, nSize);
             std::set<uint256> setConflictsParents;
@@ -788,14 +851,15 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
                 // be increased is also an easy-to-reason about way to prevent
                 // DoS attacks via replacements.
                 //
-                // The mining code doesn't (currently) take children into
-                // account (CPFP) so we only consider the feerates of
-                // transactions being directly replaced, not their indirect
-                // descendants. While that does mean high feerate children are
-                // ignored when deciding whether or not to replace, we do
-                // require the replacement to pay more overall fees too,
-                // mitigating most cases.
-                CFeeRate oldFeeRate(mi->GetModifiedFee(), mi->GetTxSize());
+                // Transactions are mined by the feerate of the chunk they are
+                // in, which includes the children paying for them (CPFP), so
+                // the replacement has to beat that. The chunk may also hold
+                // low-fee parents, pulling its feerate below that of the
+                // transaction itself, so the replacement has to beat the
+                // transaction's own feerate too. We also require the
+                // replacement to pay more overall fees, which covers the
+                // descendants that would be evicted along.
+                CFeeRate oldFeeRate = std::max(CFeeRate(mi->GetModifiedFee(), mi->GetTxSize()), pool.GetChunkFeeRate(mi));
                 if (newFeeRate <= oldFeeRate)
                 {
                     return state.DoS(0, false,
@@ -879,26 +943,78 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             }
         }
 
-        unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+        ws.scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
         if (!chainparams.RequireStandard()) {
-            scriptVerifyFlags = gArgs.GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
-        }
-
-        // Check against previous transactions
-        // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        PrecomputedTransactionData txdata(tx);
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
-            // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
-            // need to turn both off, and compare against just turning off CLEANSTACK
-            // to see if the failure is specifically due to witness validation.
-            CValidationState stateDummy; // Want reported failures to be from first CheckInputs
-            if (!tx.HasWitness() && CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, false, txdata) &&
-                !CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, false, txdata)) {
-                // Only the witness is missing, so the transaction itself may be fine.
-                state.SetCorruptionPossible();
-            }
-            return false; // state filled in by CheckInputs
+            ws.scriptVerifyFlags = gArgs.GetArg("-promiscuousmempoolflags", ws.scriptVerifyFlags);
+        }
+
+        // Look the scripts up in the script cache and collect the checks to
+        // run if they are not there
+        ws.vChecks.clear();
+        if (!CheckInputs(tx, state, view, true, ws.scriptVerifyFlags, true, false, ws.txdata, &ws.vChecks)) {
+            return false;
         }
+    }
+
+    return true;
+}
+
+// Runs the script checks PreChecks collected, without holding any lock
+static bool PolicyScriptChecks(CValidationState& state, MemPoolAccept& ws)
+{
+    bool fValid = true;
+    for (CScriptCheck& check : ws.vChecks) {
+        if (!check()) {
+            fValid = false;
+            break;
+        }
+    }
+    if (fValid) {
+        return true;
+    }
+
+    // Check again input by input to find out why it failed
+    LOCK(cs_main);
+    const CTransaction& tx = *ws.ptx;
+    const CCashViewCache& view = ws.view;
+    const unsigned int scriptVerifyFlags = ws.scriptVerifyFlags;
+    PrecomputedTransactionData& txdata = ws.txdata;
+    if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
+        // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
+        // need to turn both off, and compare against just turning off CLEANSTACK
+        // to see if the failure is specifically due to witness validation.
+        CValidationState stateDummy; // Want reported failures to be from first CheckInputs
+        if (!tx.HasWitness() && CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~(SCRIPT_VERIFY_WITNESS | SCRIPT_VERIFY_CLEANSTACK), true, false, txdata) &&
+            !CheckInputs(tx, stateDummy, view, true, scriptVerifyFlags & ~SCRIPT_VERIFY_CLEANSTACK, true, false, txdata)) {
+            // Only the witness is missing, so the transaction itself may be fine.
+            state.SetCorruptionPossible();
+        }
+        return false; // state filled in by CheckInputs
+    }
+    return error("%s: script checks of %s failed only the first time", __func__, tx.GetHash().ToString());
+}
+
+// Adds the transaction PreChecks and PolicyScriptChecks accepted to the mempool
+static bool Finalize(CTxMemPool& pool, CValidationState& state, MemPoolAccept& ws,
+                     std::list<CTransactionRef>* plTxnReplaced, bool bypass_limits)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pool.cs);
+    const CTransactionRef& ptx = ws.ptx;
+    const CTransaction& tx = *ptx;
+    const uint256 hash = tx.GetHash();
+    {
+        const CCashViewCache& view = ws.view;
+        PrecomputedTransactionData& txdata = ws.txdata;
+        const unsigned int scriptVerifyFlags = ws.scriptVerifyFlags;
+        const CTxMemPoolEntry& entry = *ws.entry;
+        const unsigned int nSize = entry.GetTxSize();
+        const CAmount nModifiedFees = ws.nModifiedFees;
+        const CAmount nConflictingFees = ws.nConflictingFees;
+        const size_t nConflictingSize = ws.nConflictingSize;
+        CTxMemPool::setEntries& allConflicting = ws.allConflicting;
+        CTxMemPool::setEntries& setAncestors = ws.setAncestors;
+        const bool fReplacementTransaction = !ws.setConflicts.empty();
 
         // Check again against the current block tip's script verification
         // flags to cache our script execution flags. This is, of course,
@@ -970,6 +1086,39 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
     return true;
 }
 
+static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
+                              bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& cash_to_uncache)
+{
+    std::unique_ptr<MemPoolAccept> ws(new MemPoolAccept(ptx));
+    {
+        LOCK2(cs_main, pool.cs);
+        if (!PreChecks(chainparams, pool, state, *ws, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, cash_to_uncache)) {
+            return false;
+        }
+    }
+
+    // Check against previous transactions
+    // This is done last to help prevent CPU exhaustion denial-of-service
+    // attacks, and without the locks, so that other transactions and blocks
+    // can be validated meanwhile. Callers that hold cs_main still serialize.
+    if (!PolicyScriptChecks(state, *ws)) {
+        return false;
+    }
+
+    LOCK2(cs_main, pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
+    if (ws->nPoolUpdated != pool.GetTransactionsUpdated() || ws->pindexTip != chainActive.Tip()) {
+        // Conflicts, ancestors and limits may have changed and the inputs
+        // may be gone, so check again. The scripts need not be run again,
+        // the outputs they spend are committed to by the prevouts.
+        ws.reset(new MemPoolAccept(ptx));
+        if (!PreChecks(chainparams, pool, state, *ws, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, cash_to_uncache)) {
+            return false;
+        }
+    }
+    return Finalize(pool, state, *ws, plTxnReplaced, bypass_limits);
+}
+
 /** (try to) add transaction to memory pool with a specified acceptance time **/
 static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
@@ -978,6 +1127,7 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
     std::vector<COutPoint> cash_to_uncache;
     bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, plTxnReplaced, bypass_limits, nAbsurdFee, cash_to_uncache);
     if (!res) {
+        LOCK(cs_main);
         for (const COutPoint& hashTx : cash_to_uncache)
             pcashTip->Uncache(hashTx);
     }
@@ -995,6 +1145,277 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee);
 }
 
+// Checks of a package that need neither the chainstate nor the mempool
+static bool CheckPackage(const std::vector<CTransactionRef>& package, CValidationState& state, size_t& nFailed)
+{
+    if (package.empty()) {
+        return state.Invalid(false, REJECT_INVALID, "package-empty");
+    }
+    if (package.size() > MAX_PACKAGE_COUNT) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "package-too-many-transactions");
+    }
+    int64_t nWeight = 0;
+    for (const CTransactionRef& ptx : package) {
+        nWeight += GetTransactionWeight(*ptx);
+    }
+    if (nWeight > MAX_PACKAGE_WEIGHT) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "package-too-large", false, strprintf("%d > %d", nWeight, MAX_PACKAGE_WEIGHT));
+    }
+
+    // Each transaction may only spend outputs of the transactions before it,
+    // and no two may spend the same output
+    std::set<uint256> setLater;
+    for (const CTransactionRef& ptx : package) {
+        if (!setLater.insert(ptx->GetHash()).second) {
+            return state.Invalid(false, REJECT_INVALID, "package-contains-duplicates");
+        }
+    }
+    std::set<COutPoint> setSpent;
+    for (size_t i = 0; i < package.size(); i++) {
+        setLater.erase(package[i]->GetHash());
+        for (const CTxIn& txin : package[i]->vin) {
+            if (setLater.count(txin.prevout.hash)) {
+                nFailed = i;
+                return state.Invalid(false, REJECT_INVALID, "package-not-sorted");
+            }
+            if (!setSpent.insert(txin.prevout).second) {
+                nFailed = i;
+                return state.Invalid(false, REJECT_INVALID, "package-contains-conflicts");
+            }
+        }
+    }
+    return true;
+}
+
+// PreChecks for each transaction of a package not in the mempool yet, in
+// order, followed by the fee and ancestor limits for the package as a whole
+static bool PackagePreChecks(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state,
+                             const std::vector<CTransactionRef>& package, std::vector<std::unique_ptr<MemPoolAccept>>& vws,
+                             size_t& nFailed, int64_t nAcceptTime, const CAmount& nAbsurdFee, std::vector<COutPoint>& cash_to_uncache)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(pool.cs);
+
+    CCashViewMemPool viewMemPool(pcashTip.get(), pool);
+    CCashViewCache viewPackage(&viewMemPool);
+    vws.clear();
+    vws.resize(package.size());
+    for (size_t i = 0; i < package.size(); i++) {
+        const CTransactionRef& ptx = package[i];
+        if (pool.exists(ptx->GetHash())) {
+            // Its outputs are found through viewMemPool
+            continue;
+        }
+        vws[i].reset(new MemPoolAccept(ptx));
+        vws[i]->pPackageView = &viewPackage;
+        bool fMissingInputs = false;
+        if (!PreChecks(chainparams, pool, state, *vws[i], &fMissingInputs, nAcceptTime, false, nAbsurdFee, cash_to_uncache)) {
+            nFailed = i;
+            if (fMissingInputs) {
+                return state.Invalid(false, REJECT_INVALID, "missing-inputs");
+            }
+            return false;
+        }
+        // Replacing mempool transactions is only supported one transaction at a time
+        if (!vws[i]->setConflicts.empty()) {
+            nFailed = i;
+            return state.Invalid(false, REJECT_DUPLICATE, "txn-mempool-conflict");
+        }
+        AddCash(viewPackage, *ptx, MEMPOOL_HEIGHT);
+    }
+
+    // The in-package descendants of each transaction, which pay for it
+    std::vector<std::set<size_t>> vDescendants(package.size());
+    std::map<uint256, size_t> mapIndex;
+    for (size_t i = 0; i < package.size(); i++) {
+        for (const CTxIn& txin : package[i]->vin) {
+            auto it = mapIndex.find(txin.prevout.hash);
+            if (it != mapIndex.end()) {
+                vDescendants[it->second].insert(i);
+            }
+        }
+        mapIndex.emplace(package[i]->GetHash(), i);
+    }
+    for (size_t i = package.size(); i-- > 0;) {
+        std::set<size_t> setChildren = vDescendants[i];
+        for (size_t child : setChildren) {
+            vDescendants[i].insert(vDescendants[child].begin(), vDescendants[child].end());
+        }
+    }
+
+    // A transaction below the minimum feerate is accepted if it is above it
+    // together with its descendants
+    const CFeeRate mempoolMinFeeRate = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+    for (size_t i = 0; i < package.size(); i++) {
+        if (!vws[i]) continue;
+        CAmount nModifiedFees = vws[i]->nModifiedFees;
+        size_t nSize = vws[i]->entry->GetTxSize();
+        for (size_t d : vDescendants[i]) {
+            if (!vws[d]) continue;
+            nModifiedFees += vws[d]->nModifiedFees;
+            nSize += vws[d]->entry->GetTxSize();
+        }
+        CAmount mempoolRejectFee = mempoolMinFeeRate.GetFee(nSize);
+        if (mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
+            nFailed = i;
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
+        }
+        if (nModifiedFees < ::minRelayTxFee.GetFee(nSize)) {
+            nFailed = i;
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met");
+        }
+    }
+
+    // A child is counted above for each of its ancestors, so together they
+    // have to pay for the whole package too
+    CAmount nTotalModifiedFees = 0;
+    size_t nTotalSize = 0;
+    for (const std::unique_ptr<MemPoolAccept>& ws : vws) {
+        if (!ws) continue;
+        nTotalModifiedFees += ws->nModifiedFees;
+        nTotalSize += ws->entry->GetTxSize();
+    }
+    CAmount mempoolRejectFee = mempoolMinFeeRate.GetFee(nTotalSize);
+    if (mempoolRejectFee > 0 && nTotalModifiedFees < mempoolRejectFee) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("package %d < %d", nTotalModifiedFees, mempoolRejectFee));
+    }
+    if (nTotalModifiedFees < ::minRelayTxFee.GetFee(nTotalSize)) {
+        return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "min relay fee not met", false, "package");
+    }
+
+    // The package counts against the limits of each in-mempool ancestor of
+    // any of its transactions. This overestimates, as not every transaction
+    // of the package descends from every one of them.
+    size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+    size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
+    size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+    size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+    CTxMemPool::setEntries setAncestors;
+    uint64_t nPackageCount = 0;
+    uint64_t nPackageSize = 0;
+    for (const std::unique_ptr<MemPoolAccept>& ws : vws) {
+        if (!ws) continue;
+        setAncestors.insert(ws->setAncestors.begin(), ws->setAncestors.end());
+        nPackageCount++;
+        nPackageSize += ws->entry->GetTxSize();
+    }
+    uint64_t nAncestorsSize = nPackageSize;
+    for (CTxMemPool::txiter it : setAncestors) {
+        nAncestorsSize += it->GetTxSize();
+        if (it->GetCountWithDescendants() + nPackageCount > nLimitDescendants || it->GetSizeWithDescendants() + nPackageSize > nLimitDescendantSize) {
+            return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false,
+                             strprintf("exceeds descendant limits of in-mempool ancestor %s", it->GetTx().GetHash().ToString()));
+        }
+    }
+    if (setAncestors.size() + nPackageCount > nLimitAncestors || nAncestorsSize > nLimitAncestorSize) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "too-long-mempool-chain", false, "exceeds ancestor limits");
+    }
+    const uint64_t nLimitClusterCount = gArgs.GetArg("-limitclustercount", DEFAULT_CLUSTER_LIMIT);
+    const uint64_t nClusterCount = pool.CalculateClusterCount(setAncestors) + nPackageCount;
+    if (nClusterCount > nLimitClusterCount) {
+        return state.DoS(0, false, REJECT_NONSTANDARD, "too-large-cluster", false,
+                         strprintf("%u > %u", nClusterCount, nLimitClusterCount));
+    }
+    return true;
+}
+
+static bool AcceptPackageWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state,
+                                const std::vector<CTransactionRef>& package, size_t& nFailed, int64_t nAcceptTime,
+                                bool test_accept, const CAmount& nAbsurdFee, std::vector<COutPoint>& cash_to_uncache)
+{
+    nFailed = package.size();
+    if (!CheckPackage(package, state, nFailed)) {
+        return false;
+    }
+
+    std::vector<std::unique_ptr<MemPoolAccept>> vws;
+    unsigned int nPoolUpdated;
+    const CBlockIndex* pindexTip;
+    {
+        LOCK2(cs_main, pool.cs);
+        nPoolUpdated = pool.GetTransactionsUpdated();
+        pindexTip = chainActive.Tip();
+        if (!PackagePreChecks(chainparams, pool, state, package, vws, nFailed, nAcceptTime, nAbsurdFee, cash_to_uncache)) {
+            return false;
+        }
+    }
+
+    // The script checks of the whole package, without the locks
+    for (size_t i = 0; i < package.size(); i++) {
+        if (vws[i] && !PolicyScriptChecks(state, *vws[i])) {
+            nFailed = i;
+            return false;
+        }
+    }
+    if (test_accept) {
+        return true;
+    }
+
+    LOCK2(cs_main, pool.cs);
+    if (nPoolUpdated != pool.GetTransactionsUpdated() || pindexTip != chainActive.Tip()) {
+        if (!PackagePreChecks(chainparams, pool, state, package, vws, nFailed, nAcceptTime, nAbsurdFee, cash_to_uncache)) {
+            return false;
+        }
+    }
+
+    // Add the transactions parents first. They do not count for fee
+    // estimation, their feerates being set by each other, and the mempool is
+    // only trimmed once all of them are in, so that no parent is evicted
+    // before the child paying for it arrives.
+    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::vector<uint256> vAdded;
+    // The package is accepted as a whole or not at all
+    auto removeAdded = [&] {
+        for (const uint256& hash : vAdded) {
+            CTransactionRef ptx = pool.get(hash);
+            if (ptx) pool.removeRecursive(*ptx);
+        }
+    };
+    for (size_t i = 0; i < package.size(); i++) {
+        if (!vws[i]) continue;
+        MemPoolAccept& ws = *vws[i];
+        // Its ancestors now include the transactions of the package added before it
+        std::string dummy;
+        ws.setAncestors.clear();
+        pool.CalculateMemPoolAncestors(*ws.entry, ws.setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy);
+        if (!Finalize(pool, state, ws, nullptr, true)) {
+            nFailed = i;
+            removeAdded();
+            return false;
+        }
+        vAdded.push_back(package[i]->GetHash());
+    }
+
+    LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    for (const uint256& hash : vAdded) {
+        if (!pool.exists(hash)) {
+            removeAdded();
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+        }
+    }
+    return true;
+}
+
+bool AcceptPackageToMemoryPool(CTxMemPool& pool, CValidationState& state, const std::vector<CTransactionRef>& package,
+                               size_t* pnFailed, bool test_accept, const CAmount nAbsurdFee)
+{
+    const CChainParams& chainparams = Params();
+    std::vector<COutPoint> cash_to_uncache;
+    size_t nFailed;
+    bool res = AcceptPackageWorker(chainparams, pool, state, package, nFailed, GetTime(), test_accept, nAbsurdFee, cash_to_uncache);
+    if (!res || test_accept) {
+        LOCK(cs_main);
+        for (const COutPoint& hashTx : cash_to_uncache)
+            pcashTip->Uncache(hashTx);
+    }
+    if (!res && pnFailed) {
+        *pnFailed = nFailed;
+    }
+    CValidationState stateDummy;
+    FlushStateToDisk(chainparams, stateDummy, FLUSH_STATE_PERIODIC);
+    return res;
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1012,28 +1433,10 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
             return true;
         }
 
-        if (fTxIndex) {
-            CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (const std::exception& e) {
-                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut->GetHash() != hash)
-                    return error("%s: txid mismatch", __func__);
-                return true;
-            }
-
+        std::shared_ptr<TxIndex> txindex = GetTxIndex();
+        if (txindex) {
             // transaction not found in index, nothing more can be done
-            return false;
+            return txindex->FindTx(hash, hashBlock, txOut);
         }
 
         if (fAllowSlow) { // use the cash database to locate block that contains transaction, and scan it
@@ -1083,21 +1486,72 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
+/** Read-only mappings of recently read block files, so that blocks served to
+ *  peers and REST clients are read straight out of the page cache. */
+static CBlockFileMapCache blockFileMaps([](int nFile) { return GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"); }, DEFAULT_BLOCKFILE_MAPPINGS);
+
+/** Locate the serialized block at pos inside a mapping of its block file,
+ *  checking the message start and size that precede it on disk. Returns
+ *  false if the file cannot be mapped; the caller then falls back to reading
+ *  the file. */
+static bool MapBlockFromDisk(const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, std::shared_ptr<const CMappedBlockFile>& mapping, const unsigned char*& pblock, unsigned int& nSize)
+{
+    static const unsigned int HEADER_SIZE = CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
+    if (pos.IsNull() || pos.nPos < HEADER_SIZE) {
+        return false;
+    }
+    mapping = blockFileMaps.Get(pos.nFile, pos.nPos);
+    if (!mapping) {
+        return false;
+    }
+    const unsigned char* pheader = mapping->data() + pos.nPos - HEADER_SIZE;
+    if (memcmp(pheader, messageStart, CMessageHeader::MESSAGE_START_SIZE)) {
+        return false;
+    }
+    nSize = ReadLE32(pheader + CMessageHeader::MESSAGE_START_SIZE);
+    if (nSize > MAX_BLOCK_SERIALIZED_SIZE) {
+        return false;
+    }
+    if ((size_t)pos.nPos + nSize > mapping->size()) {
+        // The block was written after the file was mapped.
+        mapping = blockFileMaps.Get(pos.nFile, (size_t)pos.nPos + nSize);
+        if (!mapping) {
+            return false;
+        }
+    }
+    pblock = mapping->data() + pos.nPos;
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    std::shared_ptr<const CMappedBlockFile> mapping;
+    const unsigned char* pblock;
+    unsigned int nSize;
+    if (MapBlockFromDisk(pos, Params().MessageStart(), mapping, pblock, nSize)) {
+        // Deserialize directly from the mapped file
+        try {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, pblock, nSize);
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1123,6 +1577,58 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        pos = pindex->GetBlockPos();
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapping;
+    const unsigned char* pblock;
+    unsigned int nSize;
+    if (MapBlockFromDisk(pos, messageStart, mapping, pblock, nSize)) {
+        block.assign(pblock, pblock + nSize);
+    } else {
+        if (pos.IsNull() || pos.nPos < CMessageHeader::MESSAGE_START_SIZE + sizeof(nSize)) {
+            return error("%s: Invalid block position %s", __func__, pos.ToString());
+        }
+        // Open history file at the message start preceding the block
+        pos.nPos -= CMessageHeader::MESSAGE_START_SIZE + sizeof(nSize);
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+
+        try {
+            CMessageHeader::MessageStartChars blk_start;
+            filein >> FLATDATA(blk_start) >> nSize;
+            if (memcmp(blk_start, messageStart, CMessageHeader::MESSAGE_START_SIZE))
+                return error("%s: Block magic mismatch for %s", __func__, pos.ToString());
+            if (nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                return error("%s: Block data is larger than maximum deserialization size for %s", __func__, pos.ToString());
+            block.resize(nSize);
+            filein.read((char*)block.data(), nSize);
+        }
+        catch (const std::exception& e) {
+            return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+        }
+    }
+
+    // The header comes first; make sure this is the block we were asked for
+    CBlockHeader header;
+    try {
+        CSpanReader reader(SER_DISK, CLIENT_VERSION, block.data(), block.size());
+        reader >> header;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    if (header.GetHash() != pindex->GetBlockHash())
+        return error("%s: GetHash() doesn't match index for %s at %s", __func__, pindex->ToString(), pos.ToString());
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1452,7 +1958,27 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+/** Abort with a message */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+    return false;
+}
+
+bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+{
+    AbortNode(strMessage, userMessage);
+    return state.Error(strMessage);
+}
+
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1483,26 +2009,6 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
-/** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
-{
-    SetMiscWarning(strMessage);
-    LogPrintf("*** %s\n", strMessage);
-    uiInterface.ThreadSafeMessageBox(
-        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
-        "", CClientUIInterface::MSG_ERROR);
-    StartShutdown();
-    return false;
-}
-
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
-{
-    AbortNode(strMessage, userMessage);
-    return state.Error(strMessage);
-}
-
-} // namespace
-
 /**
  * Restore the UTXO in Cash at a given COutPoint
  * @param undo the Cash to be restored.
@@ -1538,8 +2044,10 @@ int ApplyTxInUndo(Cash&& undo, CCashViewCache& view, const COutPoint& out)
 }
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by cash.
- *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCashViewCache& view)
+ *  When FAILED is returned, view is left in an indeterminate state. If
+ *  pstats is given, it is moved back along with view, or marked unknown
+ *  when that is not possible. */
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCashViewCache& view, CUTXOStats* pstats)
 {
     bool fClean = true;
 
@@ -1554,6 +2062,10 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
         return DISCONNECT_FAILED;
     }
 
+    // Done before the undo data is moved into the view below
+    CUTXOStats statsPrev;
+    bool fStats = pstats && (statsPrev = *pstats).DisconnectBlock(block, blockUndo, pindex);
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = *(block.vtx[i]);
@@ -1582,7 +2094,21 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
+                Cash& undo = txundo.vprevout[j];
+                if (fStats && undo.nHeight == 0) {
+                    // A legacy entry, without the metadata ApplyTxInUndo
+                    // takes from another output of the transaction. The
+                    // statistics were rolled back with the entry as stored,
+                    // so fill it in here and correct them.
+                    const Cash& alternate = AccessByTxid(view, out.hash);
+                    if (!alternate.IsSpent()) {
+                        statsPrev.SpendCash(out, undo);
+                        undo.nHeight = alternate.nHeight;
+                        undo.fCashBase = alternate.fCashBase;
+                        statsPrev.AddCash(out, undo);
+                    }
+                }
+                int res = ApplyTxInUndo(std::move(undo), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
             }
@@ -1593,6 +2119,10 @@ DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockI
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
+    if (pstats) {
+        *pstats = fStats && fClean ? std::move(statsPrev) : CUTXOStats();
+    }
+
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
@@ -1604,8 +2134,11 @@ void static FlushBlockFile(bool fFinalize = false)
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
+            // Make sure no mapping outlives the preallocated space being cut off
+            blockFileMaps.Invalidate(nLastBlockFile);
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+        }
         FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1640,31 +2173,63 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     return true;
 }
 
-static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex)
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+/** Minimum number of uncached inputs for which PrefetchBlockInputs() queues lookups. */
+static const size_t PREFETCH_MIN_INPUTS = 64;
+/** Number of inputs a prefetch worker takes at a time. */
+static const size_t PREFETCH_BATCH = 16;
+
+/** A lookup of a block input in the chainstate database, done ahead of connecting the block */
+class CInputPrefetch
 {
-    if (!fTxIndex) return true;
+private:
+    const COutPoint* m_outpoint;
+    Cash* m_cash;
+    char* m_found;
+
+public:
+    CInputPrefetch() : m_outpoint(nullptr), m_cash(nullptr), m_found(nullptr) {}
+    CInputPrefetch(const COutPoint& outpoint, Cash& cash, char& found) : m_outpoint(&outpoint), m_cash(&cash), m_found(&found) {}
 
-    CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
-    for (const CTransactionRef& tx : block.vtx)
+    bool operator()()
     {
-        vPos.push_back(std::make_pair(tx->GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+        // LevelDB reads are thread safe, so the lookups run while the
+        // thread connecting the block holds cs_main and waits for them.
+        try {
+            *m_found = pcashdbview->GetCash(*m_outpoint, *m_cash);
+        } catch (const std::exception&) {
+            // Leave it to the regular lookup path to report database errors.
+            *m_found = 0;
+        }
+        return true;
     }
 
-    if (!pblocktree->WriteTxIndex(vPos)) {
-        return AbortNode(state, "Failed to write transaction index");
+    void swap(CInputPrefetch& prefetch)
+    {
+        std::swap(m_outpoint, prefetch.m_outpoint);
+        std::swap(m_cash, prefetch.m_cash);
+        std::swap(m_found, prefetch.m_found);
     }
+};
 
-    return true;
-}
-
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CInputPrefetch> inputprefetchqueue(PREFETCH_BATCH);
 
 void ThreadScriptCheck() {
     RenameThread("salemcash-scriptch");
-    scriptcheckqueue.Thread();
+    // Each script check thread comes with an input prefetch worker, which
+    // stops along with it.
+    boost::thread prefetch_thread([] {
+        RenameThread("salemcash-prefetch");
+        inputprefetchqueue.Thread();
+    });
+    try {
+        scriptcheckqueue.Thread();
+    } catch (...) {
+        prefetch_thread.interrupt();
+        prefetch_thread.join();
+        throw;
+    }
 }
 
 // Protected by cs_main
@@ -1748,6 +2313,7 @@ static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consens
 
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeVerify = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
@@ -1755,11 +2321,74 @@ static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
 
+/**
+ * Warm view with the inputs of block before they are fetched one by one
+ * while connecting it. Inputs that view does not hold yet are read from the
+ * chainstate database by the input prefetch workers; outputs created by the
+ * block itself are skipped. view has to be backed by pcashTip, whose cached
+ * entries count as hits, or by pcashdbview directly, as in VerifyDB(). An
+ * entry counts even if it is spent: an output spent by a block that is not
+ * flushed yet is still unspent on disk, and must not be read from there. hits
+ * and misses receive the number of inputs that were already cached and that
+ * had to be looked up on disk.
+ */
+static void PrefetchBlockInputs(const CBlock& block, CCashViewCache& view, size_t& hits, size_t& misses)
+{
+    AssertLockHeld(cs_main);
+    hits = misses = 0;
+    if (!pcashdbview || !pcashTip) return;
+    const bool fOverTip = view.GetBackend() == pcashTip.get();
+    if (!fOverTip && view.GetBackend() != pcashdbview.get()) return;
+
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx) {
+        setBlockTxids.insert(tx->GetHash());
+    }
+
+    std::vector<COutPoint> vMissing;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCashBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (setBlockTxids.count(txin.prevout.hash)) continue;
+            if (view.HaveCacheEntry(txin.prevout) || (fOverTip && pcashTip->HaveCacheEntry(txin.prevout))) {
+                hits++;
+            } else {
+                vMissing.push_back(txin.prevout);
+            }
+        }
+    }
+    misses = vMissing.size();
+    if (nScriptCheckThreads == 0 || vMissing.size() < PREFETCH_MIN_INPUTS) {
+        // Not worth handing out; ConnectBlock will fetch these itself.
+        return;
+    }
+
+    std::vector<Cash> vCash(vMissing.size());
+    std::vector<char> vFound(vMissing.size(), 0);
+    {
+        std::vector<CInputPrefetch> vPrefetch;
+        vPrefetch.reserve(vMissing.size());
+        for (size_t i = 0; i < vMissing.size(); i++) {
+            vPrefetch.emplace_back(vMissing[i], vCash[i], vFound[i]);
+        }
+        CCheckQueueControl<CInputPrefetch> control(&inputprefetchqueue);
+        control.Add(vPrefetch);
+        control.Wait();
+    }
+
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        if (vFound[i]) {
+            view.WarmCash(vMissing[i], std::move(vCash[i]));
+        }
+    }
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by cash.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
- *  can fail if those validity checks fail (among other reasons). */
+ *  can fail if those validity checks fail (among other reasons). If pstats
+ *  is given, it is moved forward along with view. */
 bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCashViewsCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCashViewsCache& view, const CChainParams& chainparams, bool fJustCheck, CUTXOStats* pstats)
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -1791,6 +2420,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
         if (!fJustCheck)
             view.SetBestBlock(pindex->GetBlockHash());
+        if (pstats && !fJustCheck) {
+            // The set is still empty
+            *pstats = CUTXOStats();
+            pstats->hashBlock = pindex->GetBlockHash();
+        }
         return true;
     }
 
@@ -1927,6 +2561,14 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
 
+    if (!fJustCheck) {
+        size_t nPrefetchHits, nPrefetchMisses;
+        PrefetchBlockInputs(block, view, nPrefetchHits, nPrefetchMisses);
+        int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+        LogPrint(BCLog::BENCH, "    - Prefetch %u txins (%u cached, %u from disk): %.2fms [%.2fs (%.2fms/blk)]\n", (unsigned)(nPrefetchHits + nPrefetchMisses), (unsigned)nPrefetchHits, (unsigned)nPrefetchMisses, MILLI * (nTimePrefetched - nTime2), nTimePrefetch * MICRO, nTimePrefetch * MILLI / nBlocksTotal);
+        nTime2 = nTimePrefetched;
+    }
+
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
@@ -2022,13 +2664,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (!WriteTxIndexDataForBlock(block, state, pindex))
-        return false;
-
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
+    // Statistics that were unknown stay so until they are computed again
+    if (pstats && !pstats->ConnectBlock(block, blockundo, pindex)) {
+        *pstats = CUTXOStats();
+    }
+
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
@@ -2136,6 +2780,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!CheckDiskSpace(48 * 2 * 2 * pcashTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
+            pcashdbview->SetUTXOStats(utxoStatsTip);
             if (!pcashTip->Flush())
                 return AbortNode(state, "Failed to write to the cash database");
             nLastFlush = nNow;
@@ -2251,7 +2896,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     {
         CCashViewCache view(pcashTip.get());
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
-        if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
+        if (DisconnectBlock(block, pindexDelete, view, &utxoStatsTip) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = view.Flush();
         assert(flushed);
@@ -2381,7 +3026,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
     {
         CCashViewCache view(pcashTip.get());
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, &utxoStatsTip);
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -3553,6 +4198,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMaps.Invalidate(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3821,10 +4467,6 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadReindexing(fReindexing);
     if(fReindexing) fReindex = true;
 
-    // Check whether we have a transaction index
-    pblocktree->ReadFlag("txindex", fTxIndex);
-    LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
-
     return true;
 }
 
@@ -3851,6 +4493,14 @@ bool LoadChainTip(const CChainParams& chainparams)
     }
     chainActive.SetTip(pindex);
 
+    // Pick up the statistics written along with the chainstate, if they are
+    // for the same block
+    if (utxoStatsTip.hashBlock != pindex->GetBlockHash()) {
+        if (!pcashdbview->ReadUTXOStats(utxoStatsTip) || utxoStatsTip.hashBlock != pindex->GetBlockHash()) {
+            utxoStatsTip = CUTXOStats();
+        }
+    }
+
     g_chainstate.PruneBlockIndexCandidates();
 
     LogPrintf("Loaded best chain: hashBestChain=%s height=%d date=%s progress=%f\n",
@@ -4189,6 +4839,7 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    utxoStatsTip = CUTXOStats();
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4211,9 +4862,6 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // needs_init.
 
         LogPrintf("Initializing databases...\n");
-        // Use the provided setting for -txindex in the new database
-        fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
-        pblocktree->WriteFlag("txindex", fTxIndex);
     }
     return true;
 }